@@ -0,0 +1,296 @@
+// コマンド表（joybus_command.h）で応答の長さを決め、長さの違うやりとりを続けて行う
+// 本体側として1本のデータ線でidentify → origin → pollを1組にして送り、応答を受信する
+// 1回のやりとりはexamples/dmaと同じDMAの制御ブロックの列（joybus_dma_chain）で行い、先頭のブロックが
+// 送るコマンドの1バイト目でコマンド表を引いて、応答の転送数をRXのDMAチャネルのTRANS_COUNTへ運ぶ
+// rxは応答のバイト数+ストップビットの0x01を受けたら完了する
+// 表を引く手順（表の転送数の列は256バイト境界にある）
+//   1. 送信フレームのコマンドの1バイト目を、表の先頭アドレスを入れたワードの下位バイトへ書く
+//   2. できたアドレスを3.のブロックのREAD_ADDRへ書く（ctrlが読む前のブロックを書き換える）
+//   3. 表のエントリ（1バイト）を上位が0のワードの下位バイトへ書く
+//   4. そのワードをrxのTRANS_COUNTへ書く（レジスタは8ビットの書き込みを4バイトに複製して
+//      受け取るので、エントリを直接書かずにRAMのワードで32ビットにしてから運ぶ）
+// 応答の長さはやりとりのたびにDMAが表から引くので、ブロックの列を作った後で送信フレームの
+// コマンドを書き換えても、その応答の長さで受信する
+// やりとりのたびにCPUが書くのはctrlの起動（1ワード）だけで、応答の長さをRXのFIFOや
+// DMAに書くことはない
+// rxの完了割り込みで次のコマンドのctrlを起動し、1組を終えたらメインループへ知らせる
+//
+// 受信はjoy_txrx（half_duplexと同じ）で、応答の終端にストップビットを0x01としてpushする
+// 応答が表の長さより短いとrxが完了しないので、タイムアウトしてSMとDMAをやり直す
+//
+// 配線: DATA_PINをコントローラのデータ線につなぐ（3.3Vプルアップ）
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/pio.h"
+#include "joy_txrx.pio.h"
+#include "joybus_command.h"
+#include "joybus_dma_chain.h"
+#include "joybus_frame.h"
+#include "joybus_half_duplex.h"
+#include "pico/bootrom.h"
+#include "pico/stdlib.h"
+#include <stdio.h>
+
+namespace {
+constexpr size_t RX_BUFFER_SIZE = JOYBUS_MAX_FRAME_BYTES + 1; // ストップビット分も確保
+
+// 通電確認用のオンボードLED
+constexpr uint ONBOARD_LED_PIN = PICO_DEFAULT_LED_PIN;
+// BOOTSELに入るためのボタン入力
+constexpr uint BOOT_BTN_PIN = 26; // GP26
+// JoyBusのデータ線（送受信とも）
+constexpr uint DATA_PIN = 15; // GP15
+
+// 1組で送るコマンド（応答は3, 10, 8バイト）
+constexpr uint8_t GC_CMD_IDENTIFY[] = {0x00};
+constexpr uint8_t GC_CMD_ORIGIN[] = {0x41};
+constexpr uint8_t GC_CMD_POLL[] = {0x40, 0x03, 0x00};
+constexpr size_t SEQUENCE_LENGTH = 3;
+
+// 1組を送る間隔
+constexpr uint32_t POLL_INTERVAL_US = 10'000;
+// 1組の開始から最後の応答の終端までの待ち時間（3つのやりとりで約0.9ms）
+constexpr uint32_t SEQUENCE_TIMEOUT_US = 2000;
+
+// 応答の長さの表（DMAはXIPからも読めるが、フラッシュの待ち時間やキャッシュの取り合いで
+// やりとりの途中の転送が遅れないようにRAMに置く）
+__not_in_flash("command_table") const JoyBusCommandTable command_table =
+    joybus_command_table_make(JOYBUS_GC_COMMANDS);
+
+// 1回のやりとりのブロック数（表を引く4つ・RX起動・TXワード・終端）
+constexpr size_t TRANSACTION_BLOCKS = 7;
+// 表のエントリを読むブロック（READ_ADDRを前のブロックが書き換える）
+constexpr size_t LOOKUP_BLOCK = 2;
+
+// 起動前に作っておくコマンド1つ分のやりとり
+struct PreparedCommand {
+    uint8_t command = 0;
+    JoyBusTxFrame frame;
+    JoyBusDmaBlock blocks[TRANSACTION_BLOCKS] = {};
+    // ブロックが読み書きする値
+    uint32_t entry_addr = 0;     // 表の先頭アドレス（下位バイトにコマンドが入る）
+    uint32_t reply_count = 0;    // 下位バイトに表のエントリが入る（上位は0のまま）
+    uint32_t rx_buffer_addr = 0;
+    uint8_t rx_data[RX_BUFFER_SIZE] = {0};
+};
+
+struct JoyBusSequence {
+    PIO pio = nullptr;
+    uint sm = 0;
+    uint offset = 0;
+    JoyBusDmaChain chain; // TXもRXも同じSM
+
+    PreparedCommand commands[SEQUENCE_LENGTH];
+
+    // 完了割り込みとメインループで共有
+    volatile uint32_t position = 0; // 実行中のコマンド
+    volatile bool done = false;
+};
+
+JoyBusSequence sequence;
+
+void boot_btn_irq(uint gpio, uint32_t events) {
+    // ちょいデバウンス（押しっぱなし連打対策）
+    busy_wait_ms(100);
+    if (gpio_get(BOOT_BTN_PIN) == 0) {
+        printf("BOOTSEL button pressed. Entering USB boot mode...\n");
+        reset_usb_boot(0, 0);
+    }
+}
+
+void bootsel_button_init() {
+    gpio_init(BOOT_BTN_PIN);
+    gpio_set_dir(BOOT_BTN_PIN, GPIO_IN);
+    gpio_pull_up(BOOT_BTN_PIN);
+    gpio_set_irq_enabled_with_callback(BOOT_BTN_PIN, GPIO_IRQ_EDGE_FALL, true, &boot_btn_irq);
+}
+
+void init_bus_pins_safe() {
+    // バスへ接続するピンをHi-Zに設定
+    gpio_init(DATA_PIN);
+    gpio_put(DATA_PIN, 0);
+    gpio_set_dir(DATA_PIN, GPIO_IN);
+}
+
+void init_led() {
+    gpio_init(ONBOARD_LED_PIN);
+    gpio_set_dir(ONBOARD_LED_PIN, GPIO_OUT);
+    gpio_put(ONBOARD_LED_PIN, 1);
+}
+
+// ctrlを起動してindex番目のコマンドのブロックの列を実行する
+void __not_in_flash_func(command_start)(uint32_t index) {
+    joybus_dma_chain_start(&sequence.chain, sequence.commands[index].blocks);
+}
+
+// rxの完了（応答の全バイト+ストップビット受信）割り込み。残っていれば次のコマンドを起動する
+void __isr __not_in_flash_func(sequence_irq_handler)() {
+    if (!joybus_dma_chain_take_rx_irq0(&sequence.chain)) {
+        return;
+    }
+    const uint32_t next = sequence.position + 1;
+    if (next < SEQUENCE_LENGTH) {
+        sequence.position = next;
+        command_start(next);
+        return;
+    }
+    sequence.done = true;
+}
+
+void sequence_start() {
+    sequence.done = false;
+    sequence.position = 0;
+    command_start(0);
+}
+
+void joybus_init(PIO pio, uint sm) {
+    JoyBusSequence &s = sequence;
+    s.pio = pio;
+    s.sm = sm;
+    s.offset = pio_add_program(pio, &joy_txrx_program);
+
+    joybus_half_duplex_sm_init(pio, sm, s.offset, joy_txrx_program_get_default_config(s.offset),
+                               DATA_PIN);
+
+    // 転送数と書き込み先はブロックが書く
+    joybus_dma_chain_init(&s.chain, pio, sm, pio, sm);
+
+    // 完了割り込みはrxだけ（joy_txrxのirq 0は使わない）
+    irq_set_exclusive_handler(DMA_IRQ_0, sequence_irq_handler);
+    irq_set_enabled(DMA_IRQ_0, true);
+
+    pio_sm_set_enabled(pio, sm, true);
+}
+
+// コマンドのブロックの列を作る（表にないコマンドならfalse）
+// 応答の転送数はここで決めず、やりとりのたびにブロックが送信フレームのコマンドで表を引く
+bool command_prepare(PreparedCommand *p, const uint8_t *data, size_t nbytes) {
+    const JoyBusDmaChain *c = &sequence.chain;
+    const uint8_t command = data[0];
+    if (command_table.request_bytes[command] != nbytes ||
+        !joybus_tx_frame_encode(&p->frame, data, nbytes)) {
+        return false;
+    }
+    p->command = command;
+    p->entry_addr = (uint32_t)(uintptr_t)command_table.reply_dma_count;
+    p->reply_count = 0;
+    p->rx_buffer_addr = (uint32_t)(uintptr_t)p->rx_data;
+    // フレームの1ワード目はデータのMSB-firstなので、コマンドはその最上位バイト
+    const uint8_t *command_byte = (const uint8_t *)&p->frame.words[1] + 3;
+    // アドレスの下位にコマンドを書き、次のブロックの読み込み元にする
+    p->blocks[0] = joybus_dma_block_byte(c, command_byte, &p->entry_addr);
+    p->blocks[1] = joybus_dma_block_word(c, &p->entry_addr, &p->blocks[LOOKUP_BLOCK].read_addr);
+    // 表のエントリ（読み込み元は前のブロックが書く）
+    p->blocks[LOOKUP_BLOCK] = joybus_dma_block_byte(c, nullptr, &p->reply_count);
+    p->blocks[3] = joybus_dma_block_rx_count(c, &p->reply_count);
+    p->blocks[4] = joybus_dma_block_rx_start(c, &p->rx_buffer_addr);
+    // TXのワード列（SMが送り終えると受信に移る）
+    p->blocks[5] = joybus_dma_block_tx_words(c, &p->frame);
+    p->blocks[6] = joybus_dma_block_end();
+    return true;
+}
+
+// 応答が来ずに止まったDMAとSMを先頭（コマンド待ち）からやり直す
+void joybus_reset() {
+    JoyBusSequence &s = sequence;
+    joybus_dma_chain_abort(&s.chain);
+    joybus_half_duplex_sm_reset(s.pio, s.sm, s.offset, DATA_PIN);
+}
+
+// 応答の最後（表の長さの位置）がストップビット(0x01)になっているか
+bool reply_ok(const PreparedCommand &p) {
+    return p.rx_data[command_table.reply_bytes[p.command]] == 0x01;
+}
+
+const char *command_name(uint8_t command) {
+    return joybus_command_name(JOYBUS_GC_COMMANDS, command);
+}
+} // namespace
+
+int main() {
+    stdio_init_all();
+    bootsel_button_init();
+
+    // 動作開始の確認用にオンボードLEDを光らせる
+    init_led();
+
+    init_bus_pins_safe();
+
+    joybus_init(pio0, 0);
+
+    PreparedCommand *cmds = sequence.commands;
+    if (!command_prepare(&cmds[0], GC_CMD_IDENTIFY, sizeof(GC_CMD_IDENTIFY)) ||
+        !command_prepare(&cmds[1], GC_CMD_ORIGIN, sizeof(GC_CMD_ORIGIN)) ||
+        !command_prepare(&cmds[2], GC_CMD_POLL, sizeof(GC_CMD_POLL))) {
+        printf("Error: command not in JOYBUS_GC_COMMANDS\n");
+        while (true) {
+            tight_loop_contents();
+        }
+    }
+    printf("command_table ready (DATA=GP%u):", DATA_PIN);
+    for (const PreparedCommand &p : sequence.commands) {
+        printf(" %s(%u->%u)", command_name(p.command), command_table.request_bytes[p.command],
+               command_table.reply_bytes[p.command]);
+    }
+    printf("\n");
+
+    uint32_t ok = 0;
+    uint32_t bad = 0;
+    uint32_t timeout = 0;
+    uint32_t timeout_at[SEQUENCE_LENGTH] = {0}; // どのコマンドの応答を待って止まったか
+    uint32_t max_us = 0;
+    uint32_t last_report_ms = 0;
+    absolute_time_t next_poll = get_absolute_time();
+    while (true) {
+        sleep_until(next_poll);
+        next_poll = delayed_by_us(next_poll, POLL_INTERVAL_US);
+
+        const uint32_t start_us = time_us_32();
+        sequence_start();
+        bool timed_out = false;
+        while (!sequence.done) {
+            if (time_us_32() - start_us > SEQUENCE_TIMEOUT_US) {
+                timed_out = true;
+                break;
+            }
+            tight_loop_contents();
+        }
+        const uint32_t elapsed_us = time_us_32() - start_us;
+        if (timed_out) {
+            joybus_reset();
+            ++timeout;
+            ++timeout_at[sequence.position];
+        } else {
+            bool all_ok = true;
+            for (const PreparedCommand &p : sequence.commands) {
+                all_ok = all_ok && reply_ok(p);
+            }
+            if (all_ok) {
+                ++ok;
+                max_us = elapsed_us > max_us ? elapsed_us : max_us;
+            } else {
+                ++bad;
+            }
+        }
+
+        const uint32_t now_ms = to_ms_since_boot(get_absolute_time());
+        if (now_ms - last_report_ms >= 1000) {
+            last_report_ms = now_ms;
+            printf("ok=%lu bad=%lu timeout=%lu (", (unsigned long)ok, (unsigned long)bad,
+                   (unsigned long)timeout);
+            for (size_t i = 0; i < SEQUENCE_LENGTH; ++i) {
+                printf(i == 0 ? "%s=%lu" : " %s=%lu", command_name(sequence.commands[i].command),
+                       (unsigned long)timeout_at[i]);
+            }
+            printf(") max=%luus", (unsigned long)max_us);
+            for (const PreparedCommand &p : sequence.commands) {
+                printf(" %s:", command_name(p.command));
+                for (uint32_t i = 0; i < command_table.reply_bytes[p.command]; ++i) {
+                    printf(" %02X", p.rx_data[i]);
+                }
+            }
+            printf("\n");
+            max_us = 0;
+        }
+    }
+}
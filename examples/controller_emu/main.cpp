@@ -0,0 +1,684 @@
+// GameCubeコントローラとして本体のコマンドに応答する
+// 受信はdetect_stop_bitと同じjoy_rx5（ストップビット検出+DMA+PIO割り込み）
+// 応答は事前にDMA用のワード列に詰めておき、割り込みハンドラではDMAを起動するだけにする
+// ポーリング応答はメインループが裏側のバッファを書き換えてから表裏を入れ替える（ダブルバッファ）
+//
+// 応答のしかたは2通り（REPLY_MODEで切り替え）
+//   ReplyMode::Cpu : フレーム終端の割り込みでCPUが応答を選んでDMAを起動する
+//   ReplyMode::Auto: ポーリングだけはjoy_matchがコマンドを見つけてDMAとTXを起動する
+//                    CPUは次に送る応答のポインタを差し替えるだけで、コアの負荷に関係なく
+//                    ストップビットから一定の時間で応答が始まる
+//                    （identifyなど起動時にしか来ないコマンドはCpuと同じく割り込みで応答）
+//
+// 配線: TX_PINとRX_PINを両方とも本体のデータ線につなぐ（3.3Vプルアップ）
+// ターンアラウンド（コマンドのストップビットの立ち上がり→応答の最初の立ち下がり）は
+// joy_gapのSMが信号線を直接数えて測るので、CPUの割り込み応答に影響されない
+//
+// コアの分担（BUS_ON_CORE1で切り替え）
+//   core1: バスの処理だけ（受信・応答のPIO割り込みとDMA、応答の詰め直し）。コードはRAMに置く
+//   core0: 入力の生成、ログ出力、ターンアラウンドの集計
+//   core0→core1はコントローラの状態をメールボックスで、core1→core0はランブルの変化や
+//   identifyなどのイベントをコア間FIFOで渡す（どちらもロックなし、core1は待たされない）
+// LOAD_TESTを有効にすると、core0に負荷をかける区間とかけない区間を交互に作り、
+// 区間ごとのターンアラウンドのばらつき（最大-最小）を表示する
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/pio.h"
+#include "hardware/sync.h"
+#include "joy_gap.pio.h"
+#include "joy_match.pio.h"
+#include "joy_reply4.pio.h"
+#include "joy_rx5.pio.h"
+#include "joybus_mailbox.h"
+#include "joybus_tx.h"
+#include "pico/bootrom.h"
+#include "pico/multicore.h"
+#include "pico/stdlib.h"
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+constexpr size_t RX_BUFFER_SIZE = JOYBUS_MAX_FRAME_BYTES + 1; // ストップビット分も確保
+
+// 通電確認用のオンボードLED
+constexpr uint ONBOARD_LED_PIN = PICO_DEFAULT_LED_PIN;
+// BOOTSELに入るためのボタン入力
+constexpr uint BOOT_BTN_PIN = 26; // GP26
+// JoyBus（どちらも本体のデータ線につなぐ）
+constexpr uint TX_PIN = 15; // GP15
+constexpr uint RX_PIN = 16; // GP16
+
+// pio0: 応答の送信とポーリング検出（irq 0/1を共有するので同じPIOに置く）
+// pio1: コマンドの受信とターンアラウンド計測
+constexpr uint SM_TX = 0;    // pio0
+constexpr uint SM_MATCH = 1; // pio0
+constexpr uint SM_RX = 0;    // pio1
+constexpr uint SM_GAP = 1;   // pio1
+
+// 本体からのコマンド
+constexpr uint8_t GC_CMD_IDENTIFY = 0x00;  // 1バイト → 3バイト応答
+constexpr uint8_t GC_CMD_POLL = 0x40;      // 3バイト（0x40 モード ランブル） → 8バイト応答
+constexpr uint8_t GC_CMD_ORIGIN = 0x41;    // 1バイト → 10バイト応答
+constexpr uint8_t GC_CMD_CALIBRATE = 0x42; // 3バイト → 10バイト応答
+constexpr uint8_t GC_CMD_RESET = 0xFF;     // 1バイト → identifyと同じ3バイト応答
+
+// 標準コントローラのidentify応答
+constexpr uint8_t GC_IDENTIFY_REPLY[] = {0x09, 0x00, 0x03};
+
+enum class ReplyMode { Cpu, Auto };
+constexpr ReplyMode REPLY_MODE = ReplyMode::Auto;
+
+// ポーリング応答のワード数（ビット数ワード + 8バイト+ストップビットの65ビット分）
+// TX FIFO（4段）にちょうど収まるので、DMAはコマンド受信中に転送を終えられる
+constexpr uint32_t POLL_REPLY_WORDS = 1 + (8 * 8 + 1 + 31) / 32;
+
+// ターンアラウンドとして扱うHighの範囲
+//   Cpu : ビット内のHigh（最長3.75us）より長く、次のポーリングまでの間隔よりずっと短いもの
+//         （joy_rx5がフレーム終端と判断するまで約5us待つので、それより短くはならない）
+//   Auto: 本体の'0'(1.25us)と'1'(3.75us)、応答の'0'(1us)と'1'(3us)のHighのどれとも重ならない範囲
+//         （joy_matchはストップビットの立ち上がりから約2.5usで応答を始める）
+constexpr float GAP_MIN_US = REPLY_MODE == ReplyMode::Auto ? 1.5f : 4.5f;
+constexpr float GAP_MAX_US = REPLY_MODE == ReplyMode::Auto ? 2.9f : 200.0f;
+
+// trueならバスの処理をcore1で動かす（falseにするとcore0だけで動かし、負荷の影響を比べられる）
+constexpr bool BUS_ON_CORE1 = true;
+
+// core0の負荷試験
+// 負荷はcore0でよくある重い処理の代わり: 割り込み禁止区間、SRAMの大きなコピー、
+// キャッシュを通さないフラッシュ読み出し（core1がフラッシュのコードを実行していれば待たされる）
+constexpr bool LOAD_TEST = true;
+constexpr uint32_t LOAD_PHASE_MS = 5000;      // 負荷なし・負荷ありを切り替える間隔
+constexpr uint32_t LOAD_IRQ_OFF_US = 50;      // 1回の割り込み禁止の長さ
+constexpr size_t LOAD_COPY_BYTES = 8 * 1024;  // 1回にコピーする量
+constexpr uint32_t LOAD_FLASH_READS = 256;    // 1回にフラッシュから読むワード数
+
+// コントローラの状態（ポーリング応答のモード3の並び）
+struct GcPadState {
+    uint8_t buttons0 = 0x00;  // 0 0 0 Start Y X B A
+    uint8_t buttons1 = 0x80;  // 1 L R Z Up Down Right Left
+    uint8_t stick_x = 0x80;   // メインスティック
+    uint8_t stick_y = 0x80;
+    uint8_t cstick_x = 0x80;  // Cスティック
+    uint8_t cstick_y = 0x80;
+    uint8_t trigger_l = 0x00; // アナログトリガ
+    uint8_t trigger_r = 0x00;
+};
+
+struct JoyBusRx {
+    PIO pio = nullptr;
+    uint sm = 0;
+    int dma_channel = -1;
+    dma_channel_config dma_config{};
+    uint8_t work[RX_BUFFER_SIZE] = {0}; // 受信バッファ（ストップビット分も確保）
+};
+
+// 割り込みハンドラとメインループで共有する集計
+struct EmuStats {
+    volatile uint32_t identify = 0;
+    volatile uint32_t poll = 0;
+    volatile uint32_t origin = 0;
+    volatile uint32_t unknown = 0;
+    volatile uint32_t bad = 0;
+    volatile uint32_t tx_busy = 0;
+    volatile uint32_t event_drop = 0; // コア間FIFOが満杯で捨てたイベント
+    volatile uint8_t rumble = 0;
+    volatile uint8_t last_command = 0;
+};
+
+// core1→core0のイベント（コア間FIFOの1ワード: 種類<<24 | 値）
+enum class BusEvent : uint32_t { Identify = 1, Origin = 2, Rumble = 3 };
+
+JoyBusRx joybus_rx;
+JoyBusTx joybus_tx;
+EmuStats emu_stats;
+
+// 応答フレーム（すべて起動時またはメインループで詰めておく）
+JoyBusTxFrame identify_reply;
+JoyBusTxFrame origin_reply;
+JoyBusTxFrame poll_reply[2];
+// 割り込みハンドラが送るポーリング応答（表）の番号。メインループだけが書き換える
+volatile uint32_t poll_front = 0;
+// 最後にDMAへ渡した応答（送信中の可能性があるので書き換えない）
+const JoyBusTxFrame *volatile tx_last_sent = nullptr;
+// 自分の応答も同じ線を通ってRXに入ってくるので、応答の次の1フレームは捨てる
+volatile bool echo_pending = false;
+
+// 自動応答用のDMA（pop → ctrl → data → pop の順につながっている）
+//   pop : joy_matchのRX FIFOから1ワード読み捨てる（ポーリングを見つけた合図）
+//   ctrl: auto_reply_wordsの指す先をdataの読み込み元に書き込んで起動する
+//   data: 応答のワード列をTX FIFOへ転送する
+int auto_pop_chan = -1;
+int auto_ctrl_chan = -1;
+int auto_data_chan = -1;
+uint32_t auto_pop_sink = 0;
+// 次のポーリングで送る応答のワード列（CPUはこのポインタを差し替えるだけ）
+const uint32_t *volatile auto_reply_words = nullptr;
+
+// core0が書き、バスの処理が読むコントローラの状態
+JoyBusMailbox<GcPadState> pad_mailbox;
+// バスの処理側で最後に読んだメールボックスの番号
+uint32_t pad_seq = 0;
+// バスの処理の初期化が終わったらtrue（core1で動かすときの待ち合わせ）
+volatile bool bus_ready = false;
+
+// 負荷試験用のコピー元・コピー先
+uint8_t load_src[LOAD_COPY_BYTES];
+uint8_t load_dst[LOAD_COPY_BYTES];
+volatile uint32_t load_sink = 0;
+
+void boot_btn_irq(uint gpio, uint32_t events) {
+    // ちょいデバウンス（押しっぱなし連打対策）
+    busy_wait_ms(100);
+    if (gpio_get(BOOT_BTN_PIN) == 0) {
+        printf("BOOTSEL button pressed. Entering USB boot mode...\n");
+        reset_usb_boot(0, 0);
+    }
+}
+
+void bootsel_button_init() {
+    gpio_init(BOOT_BTN_PIN);
+    gpio_set_dir(BOOT_BTN_PIN, GPIO_IN);
+    gpio_pull_up(BOOT_BTN_PIN);
+    gpio_set_irq_enabled_with_callback(BOOT_BTN_PIN, GPIO_IRQ_EDGE_FALL, true, &boot_btn_irq);
+}
+
+void init_bus_pins_safe() {
+    // バスへ接続するピンをHi-Zに設定
+    gpio_init(TX_PIN);
+    gpio_put(TX_PIN, 0);
+    gpio_set_dir(TX_PIN, GPIO_IN);
+
+    gpio_init(RX_PIN);
+    gpio_set_dir(RX_PIN, GPIO_IN);
+}
+
+void init_led() {
+    gpio_init(ONBOARD_LED_PIN);
+    gpio_set_dir(ONBOARD_LED_PIN, GPIO_OUT);
+    gpio_put(ONBOARD_LED_PIN, 1);
+}
+
+void __not_in_flash_func(encode_poll_reply)(JoyBusTxFrame *frame, const GcPadState &s) {
+    const uint8_t data[] = {s.buttons0, s.buttons1, s.stick_x,   s.stick_y,
+                            s.cstick_x, s.cstick_y, s.trigger_l, s.trigger_r};
+    joybus_tx_frame_encode_with_stop(frame, data, sizeof(data));
+}
+
+void encode_origin_reply(JoyBusTxFrame *frame, const GcPadState &s) {
+    // ポーリング応答の8バイト + 予備2バイト
+    const uint8_t data[] = {s.buttons0, s.buttons1,  s.stick_x,   s.stick_y, s.cstick_x,
+                            s.cstick_y, s.trigger_l, s.trigger_r, 0x00,      0x00};
+    joybus_tx_frame_encode_with_stop(frame, data, sizeof(data));
+}
+
+// core0へイベントを送る
+// FIFOが満杯でも待たない（core0のログが詰まっていてもバスの処理は止めない）
+void __not_in_flash_func(post_bus_event)(BusEvent type, uint32_t value) {
+    if (!BUS_ON_CORE1) {
+        return; // 1コアのときは自分宛てのFIFOがないのでemu_statsの集計だけ
+    }
+    if (multicore_fifo_wready()) {
+        sio_hw->fifo_wr = (uint32_t)type << 24 | value;
+        __sev();
+    } else {
+        emu_stats.event_drop = emu_stats.event_drop + 1;
+    }
+}
+
+void __not_in_flash_func(update_rumble)(uint8_t rumble) {
+    if (rumble != emu_stats.rumble) {
+        emu_stats.rumble = rumble;
+        post_bus_event(BusEvent::Rumble, rumble);
+    }
+}
+
+// 受信したコマンドに対応する応答を選ぶ（該当しなければnullptr）
+const JoyBusTxFrame *__not_in_flash_func(select_reply)(const uint8_t *cmd, uint32_t length) {
+    switch (cmd[0]) {
+    case GC_CMD_IDENTIFY:
+    case GC_CMD_RESET:
+        if (length == 1) {
+            emu_stats.identify = emu_stats.identify + 1;
+            post_bus_event(BusEvent::Identify, cmd[0]);
+            return &identify_reply;
+        }
+        break;
+    case GC_CMD_POLL:
+        if (length == 3) {
+            emu_stats.poll = emu_stats.poll + 1;
+            update_rumble(cmd[2] & 0x01);
+            return &poll_reply[poll_front];
+        }
+        break;
+    case GC_CMD_ORIGIN:
+    case GC_CMD_CALIBRATE:
+        if ((cmd[0] == GC_CMD_ORIGIN && length == 1) ||
+            (cmd[0] == GC_CMD_CALIBRATE && length == 3)) {
+            emu_stats.origin = emu_stats.origin + 1;
+            post_bus_event(BusEvent::Origin, cmd[0]);
+            return &origin_reply;
+        }
+        break;
+    default:
+        break;
+    }
+    emu_stats.unknown = emu_stats.unknown + 1;
+    return nullptr;
+}
+
+void __not_in_flash_func(rx_start_receive)() {
+    dma_channel_abort(joybus_rx.dma_channel);
+    dma_channel_set_config(joybus_rx.dma_channel, &joybus_rx.dma_config, false);
+    dma_channel_set_read_addr(joybus_rx.dma_channel, &joybus_rx.pio->rxf[joybus_rx.sm], false);
+    dma_channel_set_write_addr(joybus_rx.dma_channel, joybus_rx.work, false);
+    dma_channel_transfer_to_buffer_now(joybus_rx.dma_channel, joybus_rx.work, RX_BUFFER_SIZE);
+}
+
+// フレーム終端の割り込みで応答を送り始める
+// 応答を選んでDMAを起動するまでを最優先にし、集計や次の受信準備はその後に回す
+void __isr __not_in_flash_func(rx_pio_irq_handler)() {
+    if (!pio_interrupt_get(joybus_rx.pio, joybus_rx.sm)) {
+        return;
+    }
+    pio_interrupt_clear(joybus_rx.pio, joybus_rx.sm);
+
+    dma_channel_hw_t *dma = dma_channel_hw_addr(joybus_rx.dma_channel);
+    const uint32_t count = RX_BUFFER_SIZE - dma->transfer_count;
+
+    if (echo_pending) {
+        // 直前に送った自分の応答
+        echo_pending = false;
+    } else if (REPLY_MODE == ReplyMode::Auto && count >= 3 && joybus_rx.work[0] == GC_CMD_POLL) {
+        // joy_matchが応答済み
+        // ストップビットの約2.5us後に応答が始まるのでjoy_rx5からはコマンドと応答が
+        // 1つのフレームに見える（先頭3バイトはコマンドのまま）
+        emu_stats.poll = emu_stats.poll + 1;
+        update_rumble(joybus_rx.work[2] & 0x01);
+        emu_stats.last_command = GC_CMD_POLL;
+    } else if (count >= 2 && joybus_rx.work[count - 1] == 0x01) {
+        // 2バイト以上受信+最後のバイトがストップビット(0x01)
+        const JoyBusTxFrame *reply = select_reply(joybus_rx.work, count - 1);
+        if (reply != nullptr) {
+            if (joybus_tx_ready(&joybus_tx)) {
+                joybus_tx_send(&joybus_tx, reply);
+                tx_last_sent = reply;
+                echo_pending = true;
+            } else {
+                emu_stats.tx_busy = emu_stats.tx_busy + 1;
+            }
+        }
+        emu_stats.last_command = joybus_rx.work[0];
+    } else {
+        emu_stats.bad = emu_stats.bad + 1;
+    }
+    rx_start_receive();
+}
+
+void rx_init(PIO pio, uint sm) {
+    joybus_rx.pio = pio;
+    joybus_rx.sm = sm;
+    // DMAの初期設定
+    joybus_rx.dma_channel = dma_claim_unused_channel(true);
+    joybus_rx.dma_config = dma_channel_get_default_config(joybus_rx.dma_channel);
+    channel_config_set_transfer_data_size(&joybus_rx.dma_config, DMA_SIZE_8);
+    channel_config_set_dreq(&joybus_rx.dma_config, pio_get_dreq(pio, sm, false));
+    channel_config_set_read_increment(&joybus_rx.dma_config, false);
+    channel_config_set_write_increment(&joybus_rx.dma_config, true);
+
+    // PIO IRQへ割り込みを接続
+    pio_interrupt_clear(pio, sm);
+    pio_set_irq0_source_enabled(pio, (pio_interrupt_source_t)(pis_interrupt0 + sm), true);
+
+    int irq = (pio_get_index(pio) == 0) ? PIO0_IRQ_0 : PIO1_IRQ_0;
+    irq_set_exclusive_handler(irq, rx_pio_irq_handler);
+    irq_set_priority(irq, PICO_HIGHEST_IRQ_PRIORITY);
+    irq_set_enabled(irq, true);
+    rx_start_receive();
+}
+
+void auto_reply_init(PIO pio, uint sm_match, uint sm_tx) {
+    auto_pop_chan = dma_claim_unused_channel(true);
+    auto_ctrl_chan = dma_claim_unused_channel(true);
+    auto_data_chan = dma_claim_unused_channel(true);
+
+    // data: 応答 → TX FIFO（読み込み元はctrlが毎回書き込む）
+    dma_channel_config c = dma_channel_get_default_config(auto_data_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, pio_get_dreq(pio, sm_tx, true));
+    channel_config_set_chain_to(&c, auto_pop_chan); // 次のポーリングに備える
+    dma_channel_configure(auto_data_chan, &c, &pio->txf[sm_tx], nullptr, POLL_REPLY_WORDS, false);
+
+    // ctrl: auto_reply_words → dataの読み込み元（トリガ付きレジスタ）
+    c = dma_channel_get_default_config(auto_ctrl_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, false);
+    dma_channel_configure(auto_ctrl_chan, &c, &dma_hw->ch[auto_data_chan].al3_read_addr_trig,
+                          &auto_reply_words, 1, false);
+
+    // pop: joy_matchのRX FIFO → 読み捨て
+    c = dma_channel_get_default_config(auto_pop_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, pio_get_dreq(pio, sm_match, false));
+    channel_config_set_chain_to(&c, auto_ctrl_chan);
+    dma_channel_configure(auto_pop_chan, &c, &auto_pop_sink, &pio->rxf[sm_match], 1, true);
+}
+
+// ポーリング応答を裏側のバッファに詰めてから表裏を入れ替える
+void __not_in_flash_func(publish_pad_state)(const GcPadState &s) {
+    const uint32_t back = poll_front ^ 1u;
+    if (REPLY_MODE == ReplyMode::Auto) {
+        // 入れ替え前のポインタをctrlが読んだ直後なら、dataが読み終わるまで待つ
+        // （TX FIFOに収まる長さなのでコマンド受信中の一瞬で終わる）
+        while (dma_channel_is_busy(auto_ctrl_chan) || dma_channel_is_busy(auto_data_chan)) {
+            tight_loop_contents();
+        }
+    } else {
+        // 入れ替え前に表だったバッファがまだ送信中なら終わるまで待つ
+        // （割り込みハンドラは表しか読まないので、この確認のあとで裏が送られ始めることはない）
+        while (tx_last_sent == &poll_reply[back] && !joybus_tx_ready(&joybus_tx)) {
+            tight_loop_contents();
+        }
+    }
+    encode_poll_reply(&poll_reply[back], s);
+    poll_front = back;
+    auto_reply_words = poll_reply[back].words;
+}
+
+struct GapStats {
+    uint32_t min = UINT32_MAX;
+    uint32_t max = 0;
+    uint64_t sum = 0;
+    uint32_t count = 0;
+
+    void add(uint32_t cycles) {
+        min = cycles < min ? cycles : min;
+        max = cycles > max ? cycles : max;
+        sum += cycles;
+        ++count;
+    }
+    uint32_t jitter() const { return count > 0 ? max - min : 0; }
+};
+
+void print_cycles_us(const char *label, uint32_t cycles, uint32_t mhz) {
+    printf(" %s=%lu.%02luus", label, (unsigned long)(cycles / mhz),
+           (unsigned long)(cycles % mhz * 100 / mhz));
+}
+// デモ用の入力: メインスティックを左右に往復させ、1秒ごとにAボタンを切り替える
+GcPadState demo_pad_state(uint32_t now_ms) {
+    GcPadState s;
+    const uint32_t phase = (now_ms / 4) % 512; // 約2秒で1往復
+    const uint32_t x = phase < 256 ? phase : 511 - phase;
+    s.stick_x = (uint8_t)x;
+    if ((now_ms / 1000) % 2 == 1) {
+        s.buttons0 |= 0x01; // A
+    }
+    return s;
+}
+
+// core0の負荷: 割り込み禁止 → SRAMのコピー → キャッシュを通さないフラッシュ読み出し
+void core0_load_step() {
+    const uint32_t irq_state = save_and_disable_interrupts();
+    busy_wait_us_32(LOAD_IRQ_OFF_US);
+    restore_interrupts(irq_state);
+
+    memcpy(load_dst, load_src, sizeof(load_dst));
+
+    // XIP_NOCACHE_NOALLOCから読むと毎回QSPIの転送を待つ（キャッシュも汚さない）
+    const volatile uint32_t *flash = (const volatile uint32_t *)XIP_NOCACHE_NOALLOC_BASE;
+    uint32_t sum = 0;
+    for (uint32_t i = 0; i < LOAD_FLASH_READS; ++i) {
+        sum += flash[i * 16];
+    }
+    load_sink = sum;
+}
+
+// 受信・応答のPIO/DMAを設定して受信を始める
+// PIOの割り込みはこの関数を呼んだコアに登録される
+void bus_init() {
+    PIO pio_tx = pio0;
+    PIO pio_rx = pio1;
+
+    uint off_tx = pio_add_program(pio_tx, &joy_reply4_program);
+    uint off_match = pio_add_program(pio_tx, &joy_match_program);
+    uint off_rx = pio_add_program(pio_rx, &joy_rx5_program);
+
+    // --- TX（応答）ステートマシン設定 ---
+    pio_sm_config c_tx = joy_reply4_program_get_default_config(off_tx);
+    sm_config_set_set_pins(&c_tx, TX_PIN, 1);
+    sm_config_set_out_shift(&c_tx,
+                            /*shift_right=*/false,
+                            /*autopull=*/true,
+                            /*pull_thresh=*/32);
+
+    // --- RX（コマンド）ステートマシン設定 ---
+    pio_sm_config c_rx = joy_rx5_program_get_default_config(off_rx);
+    sm_config_set_in_pins(&c_rx, RX_PIN);
+    sm_config_set_in_shift(&c_rx,
+                           /*shift_right=*/false,
+                           /*autopush=*/true,
+                           /*push_thresh=*/8);
+    sm_config_set_jmp_pin(&c_rx, RX_PIN);
+
+    // --- ポーリング検出のステートマシン設定 ---
+    pio_sm_config c_match = joy_match_program_get_default_config(off_match);
+    sm_config_set_in_pins(&c_match, RX_PIN);
+    sm_config_set_jmp_pin(&c_match, RX_PIN);
+    // 1バイト分をISRにためてyと比べるのでautopushしない
+    sm_config_set_in_shift(&c_match,
+                           /*shift_right=*/false,
+                           /*autopush=*/false,
+                           /*push_thresh=*/32);
+
+    // クロック分周設定
+    const float pio_hz = 4'000'000; // 4MHz
+    float div = (float)clock_get_hz(clk_sys) / pio_hz;
+    sm_config_set_clkdiv(&c_tx, div);
+    sm_config_set_clkdiv(&c_rx, div);
+    sm_config_set_clkdiv(&c_match, div);
+
+    // ステートマシン初期化
+    pio_gpio_init(pio_tx, TX_PIN);
+    pio_gpio_init(pio_rx, RX_PIN);
+    gpio_pull_up(TX_PIN); // open-drainのHigh維持の補助（外付けがあるなら無くてもOK）
+    gpio_pull_up(RX_PIN); // 必須寄り
+    // TXを開放状態に設定
+    pio_sm_set_consecutive_pindirs(pio_tx, SM_TX, TX_PIN, 1, false);
+    pio_sm_set_pins_with_mask(pio_tx, SM_TX, 0u, 1u << TX_PIN);
+    // RXを入力に設定
+    pio_sm_set_consecutive_pindirs(pio_rx, SM_RX, RX_PIN, 1, false);
+
+    pio_sm_init(pio_tx, SM_TX, off_tx, &c_tx);
+    pio_sm_init(pio_rx, SM_RX, off_rx, &c_rx);
+    pio_sm_init(pio_tx, SM_MATCH, off_match, &c_match);
+    // 比較するコマンドバイトをyに入れておく
+    pio_sm_put_blocking(pio_tx, SM_MATCH, GC_CMD_POLL);
+    pio_sm_exec(pio_tx, SM_MATCH, pio_encode_pull(false, true));
+    pio_sm_exec(pio_tx, SM_MATCH, pio_encode_mov(pio_y, pio_osr));
+
+    // 応答フレームを用意してからRXを起動する
+    const GcPadState neutral{};
+    joybus_tx_frame_encode_with_stop(&identify_reply, GC_IDENTIFY_REPLY,
+                                     sizeof(GC_IDENTIFY_REPLY));
+    encode_origin_reply(&origin_reply, neutral);
+    encode_poll_reply(&poll_reply[0], neutral);
+    encode_poll_reply(&poll_reply[1], neutral);
+    auto_reply_words = poll_reply[poll_front].words;
+    joybus_tx_init(&joybus_tx, pio_tx, SM_TX);
+    pio_sm_set_enabled(pio_tx, SM_TX, true);
+    if (REPLY_MODE == ReplyMode::Auto) {
+        auto_reply_init(pio_tx, SM_MATCH, SM_TX);
+        pio_sm_set_enabled(pio_tx, SM_MATCH, true);
+    }
+
+    pio_sm_set_enabled(pio_rx, SM_RX, true);
+    rx_init(pio_rx, SM_RX);
+}
+
+// メールボックスに新しい状態があれば応答を詰め直す
+void __not_in_flash_func(bus_poll)() {
+    GcPadState s;
+    if (joybus_mailbox_read(&pad_mailbox, &s, &pad_seq)) {
+        publish_pad_state(s);
+    }
+}
+
+// core1: バスの処理だけを回す
+void __not_in_flash_func(bus_core1_main)() {
+    bus_init();
+    bus_ready = true;
+    while (true) {
+        bus_poll();
+    }
+}
+
+// core1から届いたイベントをログに出す
+void drain_bus_events() {
+    while (multicore_fifo_rvalid()) {
+        const uint32_t event = multicore_fifo_pop_blocking();
+        const uint32_t value = event & 0x00FFFFFFu;
+        switch ((BusEvent)(event >> 24)) {
+        case BusEvent::Identify:
+            printf("event: identify (0x%02lX)\n", (unsigned long)value);
+            break;
+        case BusEvent::Origin:
+            printf("event: origin (0x%02lX)\n", (unsigned long)value);
+            break;
+        case BusEvent::Rumble:
+            printf("event: rumble %s\n", value ? "on" : "off");
+            break;
+        default:
+            printf("event: unknown 0x%08lX\n", (unsigned long)event);
+            break;
+        }
+    }
+}
+} // namespace
+
+int main() {
+    stdio_init_all();
+    bootsel_button_init();
+
+    // 動作開始の確認用にオンボードLEDを光らせる
+    init_led();
+
+    init_bus_pins_safe();
+
+    // --- ターンアラウンド計測のステートマシン設定（clk_sysそのままで数える） ---
+    // バスの処理とは独立にcore0で集計する
+    PIO pio_gap = pio1;
+    uint off_gap = pio_add_program(pio_gap, &joy_gap_program);
+    pio_sm_config c_gap = joy_gap_program_get_default_config(off_gap);
+    sm_config_set_in_pins(&c_gap, RX_PIN);
+    sm_config_set_jmp_pin(&c_gap, RX_PIN);
+    sm_config_set_fifo_join(&c_gap, PIO_FIFO_JOIN_RX);
+    pio_sm_init(pio_gap, SM_GAP, off_gap, &c_gap);
+
+    // 下限と上限（2サイクル単位）を渡してから計測開始
+    const uint32_t clk_mhz = clock_get_hz(clk_sys) / 1'000'000;
+    const uint32_t gap_min = (uint32_t)(GAP_MIN_US * clk_mhz / 2);
+    const uint32_t gap_span = (uint32_t)(GAP_MAX_US * clk_mhz / 2) - gap_min;
+    pio_sm_put_blocking(pio_gap, SM_GAP, gap_min);
+    pio_sm_put_blocking(pio_gap, SM_GAP, gap_span);
+    pio_sm_set_enabled(pio_gap, SM_GAP, true);
+
+    if (BUS_ON_CORE1) {
+        multicore_launch_core1(bus_core1_main);
+    } else {
+        bus_init();
+        bus_ready = true;
+    }
+    while (!bus_ready) {
+        tight_loop_contents();
+    }
+
+    printf("controller_emu ready (TX=GP%u RX=GP%u, %s reply, bus on core%u%s).\n", TX_PIN, RX_PIN,
+           REPLY_MODE == ReplyMode::Auto ? "auto" : "cpu", BUS_ON_CORE1 ? 1u : 0u,
+           LOAD_TEST ? ", load test" : "");
+
+    GapStats gap;
+    GapStats phase_gap;
+    // 負荷なし[0]・負荷あり[1]それぞれの区間で最も大きかったばらつきと最大値
+    uint32_t worst_jitter[2] = {0, 0};
+    uint32_t worst_max[2] = {0, 0};
+    bool load_on = false;
+    uint32_t phase_start_ms = to_ms_since_boot(get_absolute_time());
+    uint32_t last_report_ms = 0;
+    uint32_t last_update_ms = 0;
+    while (true) {
+        const uint32_t now_ms = to_ms_since_boot(get_absolute_time());
+
+        // 入力の更新（実機のポーリング間隔より細かく）
+        if (now_ms - last_update_ms >= 4) {
+            last_update_ms = now_ms;
+            joybus_mailbox_write(&pad_mailbox, demo_pad_state(now_ms));
+        }
+        if (!BUS_ON_CORE1) {
+            bus_poll();
+        } else {
+            drain_bus_events();
+        }
+
+        // ターンアラウンドの計測値を回収
+        while (!pio_sm_is_rx_fifo_empty(pio_gap, SM_GAP)) {
+            const uint32_t remaining = pio_sm_get(pio_gap, SM_GAP);
+            // 下限分 + 上限までに数えた分、ループ1周2サイクル
+            const uint32_t cycles = (gap_min + 1 + gap_span + 1 - remaining) * 2;
+            gap.add(cycles);
+            phase_gap.add(cycles);
+        }
+
+        if (LOAD_TEST && load_on) {
+            core0_load_step();
+        }
+
+        // 区間の終わりにその区間のばらつきを出して、負荷のあり・なしを切り替える
+        if (LOAD_TEST && now_ms - phase_start_ms >= LOAD_PHASE_MS) {
+            const int k = load_on ? 1 : 0;
+            if (phase_gap.count > 0) {
+                worst_jitter[k] = phase_gap.jitter() > worst_jitter[k] ? phase_gap.jitter()
+                                                                       : worst_jitter[k];
+                worst_max[k] = phase_gap.max > worst_max[k] ? phase_gap.max : worst_max[k];
+                printf("phase %s: n=%lu", load_on ? "load" : "idle",
+                       (unsigned long)phase_gap.count);
+                print_cycles_us("min", phase_gap.min, clk_mhz);
+                print_cycles_us("max", phase_gap.max, clk_mhz);
+                print_cycles_us("jitter", phase_gap.jitter(), clk_mhz);
+                printf(" | worst");
+                print_cycles_us("idle_jitter", worst_jitter[0], clk_mhz);
+                print_cycles_us("idle_max", worst_max[0], clk_mhz);
+                print_cycles_us("load_jitter", worst_jitter[1], clk_mhz);
+                print_cycles_us("load_max", worst_max[1], clk_mhz);
+                printf("\n");
+            }
+            phase_gap = GapStats{};
+            load_on = !load_on;
+            phase_start_ms = now_ms;
+        }
+
+        if (now_ms - last_report_ms >= 1000) {
+            last_report_ms = now_ms;
+            printf("id=%lu poll=%lu origin=%lu unknown=%lu bad=%lu busy=%lu drop=%lu last=0x%02X "
+                   "rumble=%u",
+                   (unsigned long)emu_stats.identify, (unsigned long)emu_stats.poll,
+                   (unsigned long)emu_stats.origin, (unsigned long)emu_stats.unknown,
+                   (unsigned long)emu_stats.bad, (unsigned long)emu_stats.tx_busy,
+                   (unsigned long)emu_stats.event_drop, emu_stats.last_command,
+                   emu_stats.rumble);
+            if (gap.count > 0) {
+                // ストップビットの立ち上がりから応答の最初の立ち下がりまで
+                printf(" | stop->reply n=%lu", (unsigned long)gap.count);
+                print_cycles_us("min", gap.min, clk_mhz);
+                print_cycles_us("avg", (uint32_t)(gap.sum / gap.count), clk_mhz);
+                print_cycles_us("max", gap.max, clk_mhz);
+            }
+            printf("%s\n", LOAD_TEST && load_on ? " [load]" : "");
+            gap = GapStats{};
+        }
+    }
+}
@@ -0,0 +1,131 @@
+// 3点サンプリングのデコーダを実機で比べるベンチマーク
+// SysTick（clk_sysで動く24ビットのダウンカウンタ）で1バイトあたりのサイクル数を測る
+// ホスト側の比較は host/decode_bench を使う
+#include "hardware/clocks.h"
+#include "hardware/structs/systick.h"
+#include "hardware/sync.h"
+#include "joybus_decode.h"
+#include "pico/rand.h"
+#include "pico/stdlib.h"
+#include <stdio.h>
+
+namespace {
+constexpr uint ONBOARD_LED_PIN = PICO_DEFAULT_LED_PIN;
+
+// JoyBusで最大の応答（10バイト）と、まとめて処理したときの傾向を見るための長いバッファ
+constexpr size_t POLL_WORDS = 10;
+constexpr size_t BULK_WORDS = 1000;
+
+uint32_t words[BULK_WORDS];
+uint8_t out[BULK_WORDS];
+
+void init_led() {
+    gpio_init(ONBOARD_LED_PIN);
+    gpio_set_dir(ONBOARD_LED_PIN, GPIO_OUT);
+    gpio_put(ONBOARD_LED_PIN, 1);
+}
+
+void systick_init() {
+    // 割り込みなし・clk_sysをそのまま数える
+    systick_hw->csr = 0;
+    systick_hw->rvr = 0x00FFFFFFu;
+    systick_hw->cvr = 0;
+    systick_hw->csr = M0PLUS_SYST_CSR_CLKSOURCE_BITS | M0PLUS_SYST_CSR_ENABLE_BITS;
+}
+
+// fを1回実行するのにかかったサイクル数（24ビットのダウンカウンタなので約134ms以内）
+template <typename F> uint32_t measure_cycles(F &&f) {
+    uint32_t irq_state = save_and_disable_interrupts();
+    const uint32_t start = systick_hw->cvr;
+    f();
+    const uint32_t end = systick_hw->cvr;
+    restore_interrupts(irq_state);
+    return (start - end) & 0x00FFFFFFu;
+}
+
+void fill_words() {
+    for (size_t i = 0; i < BULK_WORDS; ++i) {
+        uint32_t w = 0;
+        if (i % 2 == 0) {
+            // 実際の受信データに近い、3サンプルがそろったワード
+            const uint32_t bits = get_rand_32();
+            for (int b = 0; b < 8; ++b) {
+                w = (w << 3) | (((bits >> b) & 1u) ? 0x7u : 0x0u);
+            }
+        } else {
+            w = get_rand_32() & 0x00FFFFFFu;
+        }
+        words[i] = w;
+    }
+}
+
+bool verify() {
+    for (size_t i = 0; i < BULK_WORDS; ++i) {
+        const uint8_t ref = joybus_decode_3sample_loop(words[i]);
+        if (joybus_decode_3sample_swar(words[i]) != ref ||
+            joybus_decode_3sample_lut(words[i]) != ref) {
+            printf("mismatch: w=0x%06lX loop=0x%02X swar=0x%02X lut=0x%02X\n",
+                   (unsigned long)words[i], ref, joybus_decode_3sample_swar(words[i]),
+                   joybus_decode_3sample_lut(words[i]));
+            return false;
+        }
+    }
+    return true;
+}
+
+void report(const char *name, uint32_t poll_cycles, uint32_t bulk_cycles) {
+    printf("  %-10s poll(%u bytes): %5lu cycles (%3lu.%02lu/byte)  bulk: %3lu.%02lu cycles/byte\n",
+           name, (unsigned)POLL_WORDS, (unsigned long)poll_cycles,
+           (unsigned long)(poll_cycles / POLL_WORDS),
+           (unsigned long)(poll_cycles * 100 / POLL_WORDS % 100),
+           (unsigned long)(bulk_cycles / BULK_WORDS),
+           (unsigned long)(bulk_cycles * 100 / BULK_WORDS % 100));
+}
+
+// 1バイトずつ呼ぶ版（examplesの受信ループと同じ使い方）
+template <typename Decode> void decode_each(Decode decode, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = decode(words[i]);
+    }
+}
+
+void run_bench() {
+    fill_words();
+    if (!verify()) {
+        return;
+    }
+    printf("decode bench (clk_sys=%lu Hz)\n", (unsigned long)clock_get_hz(clk_sys));
+    uint32_t poll, bulk;
+
+    poll = measure_cycles([] { decode_each(joybus_decode_3sample_loop, POLL_WORDS); });
+    bulk = measure_cycles([] { decode_each(joybus_decode_3sample_loop, BULK_WORDS); });
+    report("loop", poll, bulk);
+
+    poll = measure_cycles([] { decode_each(joybus_decode_3sample_swar, POLL_WORDS); });
+    bulk = measure_cycles([] { decode_each(joybus_decode_3sample_swar, BULK_WORDS); });
+    report("swar", poll, bulk);
+
+    poll = measure_cycles([] { decode_each(joybus_decode_3sample_lut, POLL_WORDS); });
+    bulk = measure_cycles([] { decode_each(joybus_decode_3sample_lut, BULK_WORDS); });
+    report("lut", poll, bulk);
+
+    poll = measure_cycles([] { joybus_decode_3sample_words(words, out, POLL_WORDS); });
+    bulk = measure_cycles([] { joybus_decode_3sample_words(words, out, BULK_WORDS); });
+    report("words", poll, bulk);
+
+    poll = measure_cycles([] { joybus_decode_3sample_words_lut(words, out, POLL_WORDS); });
+    bulk = measure_cycles([] { joybus_decode_3sample_words_lut(words, out, BULK_WORDS); });
+    report("words_lut", poll, bulk);
+}
+} // namespace
+
+int main() {
+    stdio_init_all();
+    init_led();
+    systick_init();
+
+    while (true) {
+        run_bench();
+        sleep_ms(5000);
+    }
+}
@@ -1,9 +1,21 @@
+// ループバックで送ったフレームをストップビット検出で受信する
+// 受信はDMAを止めずに2のべき乗のリングバッファへ書き続け、
+// フレーム終端の割り込みでは書き込み位置（フレーム境界）を記録するだけにする
+//   data: RX FIFO → リング（書き込みアドレスをRX_RING_SIZEで折り返す）
+//   ctrl: dataの転送が尽きたら転送数を書き戻して再起動する（dataとctrlで張り直し合う）
+// フレームごとにDMAを止めて設定し直さないので、連続したフレームでも取りこぼす隙間がない
+//
+// 送信開始・最初の立ち下がり・ストップビット・受信完了などのタイミングはprintfで見ずに
+// トレースリング（joybus_trace_ring.h）に記録し、次の周までの空き時間にまとめて書き出す
+// 書き出した"#"で始まる行はhost/trace_decodeで区間ごとの遅れのヒストグラムにできる
 #include "hardware/clocks.h"
 #include "hardware/dma.h"
 #include "hardware/irq.h"
 #include "hardware/pio.h"
 #include "joy_rx5.pio.h"
 #include "joy_tx5.pio.h"
+#include "joybus_trace_ring.h"
+#include "joybus_tx.h"
 #include "pico/bootrom.h"
 #include "pico/stdlib.h"
 #include <stdio.h>
@@ -12,11 +24,21 @@
 namespace {
 // TX FIFOに積める最大バイト数
 constexpr size_t DEFAULT_MAX_FIFO_BYTES = 4 * 8;
-// JoyBusでやりとりする最大フレーム長（バイト数）
-// 実際はせいぜい10バイトだが非DMAでの限界を超えられるか試すため16に拡張
-constexpr size_t JOYBUS_MAX_FRAME_BYTES = 16;
 constexpr size_t RX_BUFFER_SIZE = JOYBUS_MAX_FRAME_BYTES + 1; // ストップビット分も確保
 
+// 受信リングの大きさ（2のべき乗、DMAのリング指定はバイト数のlog2）
+constexpr uint RX_RING_BITS = 8;
+constexpr size_t RX_RING_SIZE = 1u << RX_RING_BITS;
+// 割り込みハンドラが記録できるフレーム境界の数（2のべき乗）
+constexpr uint32_t RX_BOUNDARY_COUNT = 16;
+// dataの転送数（尽きるとctrlが同じ値を書き戻す。1バイト40usなので実質止まらない）
+constexpr uint32_t RX_RING_RELOAD_COUNT = 0xFFFFFFFFu;
+// 受信の締め切りはフレームの長さから決め、固定の長さでは待たない
+// joy_rx5は最後のエッジから2ビット周期ほどでフレーム終端と判定するので、その分と割り込みの
+// 遅れを見込んでフレームの長さに足す
+constexpr uint32_t BIT_PERIOD_US = 5;
+constexpr uint32_t RX_GRACE_US = 3 * BIT_PERIOD_US;
+
 // 通電確認用のオンボードLED
 constexpr uint ONBOARD_LED_PIN = PICO_DEFAULT_LED_PIN;
 // BOOTSELに入るためのボタン入力
@@ -25,27 +47,38 @@ constexpr uint BOOT_BTN_PIN = 26; // GP26
 constexpr uint TX_PIN = 15; // GP15
 constexpr uint RX_PIN = 16; // GP16
 
-// DMAチャンネルはあとで空きを割り当てるので未初期化の意味を込めて-1設定
-int rx_dma_chan = -1;
-int tx_dma_chan = -1;
-
-// 割り込みハンドラから不意にいじられるのでvolatile
-volatile bool tx_dma_done = false;
-volatile bool tx_dma_error = false;
-
 struct JoyBusRx {
     PIO pio = nullptr;
     uint sm = 0;
-    int dma_channel = -1;
-    dma_channel_config dma_config{};
-    uint8_t work[RX_BUFFER_SIZE] = {0};  // 受信バッファ（ストップビット分も確保）
-    uint8_t frame[RX_BUFFER_SIZE] = {0}; // フレーム格納用バッファ
-    volatile uint32_t length = 0;
-    volatile bool ready = false;
-    volatile bool bad = false;
+    int data_channel = -1; // RX FIFO → リング
+    int ctrl_channel = -1; // dataの転送数を張り直す
+    uint32_t reload_count = RX_RING_RELOAD_COUNT; // ctrlの読み込み元
+
+    // フレーム終端の通算バイト位置（割り込みハンドラが書き、メインループが読む）
+    volatile uint32_t boundary[RX_BOUNDARY_COUNT] = {0};
+    volatile uint32_t boundary_head = 0; // 割り込みハンドラだけが進める
+    volatile uint32_t boundary_tail = 0; // メインループだけが進める
+    volatile uint32_t boundary_drop = 0; // 境界の記録が追いつかず捨てた数
+
+    // 割り込みハンドラだけが使う
+    uint32_t last_offset = 0; // 前回のリング内の書き込み位置
+    uint32_t total = 0;       // これまでに受信した通算バイト数
+
+    // メインループだけが使う
+    uint32_t frame_start = 0; // 次のフレームの先頭（通算バイト位置）
 };
 
+enum class RxFrameStatus {
+    Ok,      // ストップビットまで正しく受信
+    Bad,     // 長さが不正かストップビットがない
+    Overrun, // 取り出す前にリングが上書きされた
+};
+
+// DMAのリング指定はバッファがその大きさにそろっている必要がある
+alignas(RX_RING_SIZE) uint8_t rx_ring[RX_RING_SIZE];
+
 JoyBusRx joybus_rx;
+JoyBusTx joybus_tx;
 
 void boot_btn_irq(uint gpio, uint32_t events) {
     // ちょいデバウンス（押しっぱなし連打対策）
@@ -79,125 +112,119 @@ void init_led() {
     gpio_put(ONBOARD_LED_PIN, 1);
 }
 
-// TXのDMA割り込みハンドラ
-void __isr dma_tx_handler() {
-    uint32_t status = dma_hw->ints1;
-    if (tx_dma_chan >= 0 && (status & (1u << tx_dma_chan))) {
-        dma_hw->ints1 = 1u << tx_dma_chan;
-        tx_dma_done = true;
-    } else {
-        tx_dma_error = true;
+// 送信を指示したあとの最初の立ち下がりを1回だけトレースに記録する
+// 毎ビットの立ち下がりで割り込まないように、記録したらすぐに割り込みを止める
+void __isr __not_in_flash_func(rx_first_edge_irq_handler)() {
+    if (gpio_get_irq_event_mask(RX_PIN) & GPIO_IRQ_EDGE_FALL) {
+        gpio_acknowledge_irq(RX_PIN, GPIO_IRQ_EDGE_FALL);
+        gpio_set_irq_enabled(RX_PIN, GPIO_IRQ_EDGE_FALL, false);
+        joybus_trace(JoyBusTraceEvent::FirstEdge);
     }
 }
 
-void joybus_tx_send_dma(PIO pio, uint sm, const uint8_t *data, size_t nbytes, int tx_dma_chan,
-                        dma_channel_config *tx_dma_config) {
-    if (nbytes == 0) {
-        return;
-    }
-    if (nbytes > JOYBUS_MAX_FRAME_BYTES) {
-        printf("Error: joybus_tx_send_dma: nbytes=%zu exceeds max=%zu\n", nbytes,
-               JOYBUS_MAX_FRAME_BYTES);
+// 次の立ち下がりを記録できるようにする（送信の直前に呼ぶ）
+void arm_first_edge_trace() {
+    gpio_acknowledge_irq(RX_PIN, GPIO_IRQ_EDGE_FALL);
+    gpio_set_irq_enabled(RX_PIN, GPIO_IRQ_EDGE_FALL, true);
+}
+
+// フレーム終端の割り込み: リングの書き込み位置を境界として記録するだけ
+// DMAは止めないので、次のフレームの受信はこの間も続いている
+void __isr __not_in_flash_func(rx_pio_irq_handler)() {
+    if (!pio_interrupt_get(joybus_rx.pio, joybus_rx.sm)) {
         return;
     }
+    pio_interrupt_clear(joybus_rx.pio, joybus_rx.sm);
+    joybus_trace(JoyBusTraceEvent::StopBit);
 
-    printf("Waiting for previous TX complete...\n");
-    // 万が一同期が崩れてもautopullされないように前の送信が完了しないうちはFIFOに積まない
-    while (!pio_interrupt_get(pio, 1)) {
-        // 送信が完了するのを待つ
+    // 最後にpushされたバイト（ストップビット）がDMAでリングに移るのを待つ
+    while (!pio_sm_is_rx_fifo_empty(joybus_rx.pio, joybus_rx.sm)) {
         tight_loop_contents();
     }
-    printf("Previous TX complete.\n");
-    pio_interrupt_clear(pio, 1);
-
-    // 期待する送信ビット数-1
-    uint32_t bits_to_send_minus1 = (uint32_t)(nbytes * 8 - 1);
-    const size_t words_of_data = (nbytes + 3) / 4;
-    const size_t words_to_send = words_of_data + 1; // bits_to_send_minus1 + データワード数
-    uint32_t tx_buffer[words_to_send] = {0};
-    tx_buffer[0] = bits_to_send_minus1;
-    printf("[TX] bits_to_send_minus1=%lu\n", (unsigned long)bits_to_send_minus1);
-    for (size_t w = 0; w < words_of_data; ++w) {
-        uint32_t word = 0;
-        for (size_t b = 0; b < 4; ++b) {
-            size_t byte_index = w * 4 + b;
-            uint8_t byte = (byte_index < nbytes) ? data[byte_index] : 0;
-            word |= ((uint32_t)byte) << (8 * (3 - b));
-        }
-        tx_buffer[w + 1] = word;
-        printf("[TX] Prepared word %zu: 0x%08lX\n", w, (unsigned long)word);
-    }
-    tx_dma_done = false;
-    tx_dma_error = false;
-    dma_channel_configure(tx_dma_chan, tx_dma_config,
-                          &pio->txf[sm], // 書き込み先
-                          tx_buffer,     // 読み込み元
-                          words_to_send, // 転送するワード数（bits_to_send_minus1 + データワード数）
-                          true           // 即時開始
-    );
-    pio->irq_force = (1u << 0);
-    printf("[TX] TX start notified via DMA.\n");
-    while (!tx_dma_done && !tx_dma_error) {
-        // 送信完了待ち
-        tight_loop_contents();
-    }
-    if (tx_dma_error) {
-        printf("[TX] TX DMA error occurred.\n");
+    const uint32_t write_addr = dma_hw->ch[joybus_rx.data_channel].write_addr;
+    const uint32_t offset = (write_addr - (uint32_t)(uintptr_t)rx_ring) & (RX_RING_SIZE - 1);
+    // 1フレームはリングより十分短いので、前回からの差分は折り返しを考えるだけでよい
+    joybus_rx.total += (offset - joybus_rx.last_offset) & (RX_RING_SIZE - 1);
+    joybus_rx.last_offset = offset;
+
+    const uint32_t head = joybus_rx.boundary_head;
+    if (head - joybus_rx.boundary_tail >= RX_BOUNDARY_COUNT) {
+        // 境界が記録できないと次のフレームとつながって見える（取り出し側でBadになる）
+        joybus_rx.boundary_drop = joybus_rx.boundary_drop + 1;
         return;
     }
-    printf("[TX] TX DMA complete.\n");
+    joybus_rx.boundary[head & (RX_BOUNDARY_COUNT - 1)] = joybus_rx.total;
+    joybus_rx.boundary_head = head + 1;
 }
 
-void rx_start_receive() {
-    dma_channel_abort(joybus_rx.dma_channel);
-    dma_channel_set_config(joybus_rx.dma_channel, &joybus_rx.dma_config, false);
-    dma_channel_set_read_addr(joybus_rx.dma_channel, &joybus_rx.pio->rxf[joybus_rx.sm], false);
-    dma_channel_set_write_addr(joybus_rx.dma_channel, joybus_rx.work, false);
-    dma_channel_transfer_to_buffer_now(joybus_rx.dma_channel, joybus_rx.work, RX_BUFFER_SIZE);
-}
-
-void rx_finish_receive_from_irq() {
-    dma_channel_hw_t *dma = dma_channel_hw_addr(joybus_rx.dma_channel);
-    uint32_t count = RX_BUFFER_SIZE - dma->transfer_count;
-    dma_channel_abort(joybus_rx.dma_channel);
-    joybus_rx.ready = false;
-    joybus_rx.bad = false;
-    joybus_rx.length = 0;
-
-    // 2バイト以上受信+最後のバイトがストップビット(0x01)
-    if (count >= 2 && joybus_rx.work[count - 1] == 0x01) {
-        uint32_t frame_length = count - 1; // ストップビット分を除く
-        if (frame_length > RX_BUFFER_SIZE) {
-            frame_length = RX_BUFFER_SIZE;
+// 受信済みのフレームを1つ取り出す（なければfalse）
+// ストップビットは除いてframeに書き、長さを*lengthに返す
+bool rx_pop_frame(uint8_t *frame, uint32_t *length, RxFrameStatus *status) {
+    const uint32_t tail = joybus_rx.boundary_tail;
+    const uint32_t head = joybus_rx.boundary_head;
+    if (tail == head) {
+        return false;
+    }
+    const uint32_t start = joybus_rx.frame_start;
+    const uint32_t end = joybus_rx.boundary[tail & (RX_BOUNDARY_COUNT - 1)];
+    const uint32_t count = end - start;
+    *length = 0;
+    *status = RxFrameStatus::Ok;
+
+    if (count < 2 || count > RX_BUFFER_SIZE) {
+        *status = RxFrameStatus::Bad;
+    } else {
+        for (uint32_t i = 0; i < count; ++i) {
+            frame[i] = rx_ring[(start + i) & (RX_RING_SIZE - 1)];
         }
-        for (uint32_t i = 0; i < frame_length; ++i) {
-            joybus_rx.frame[i] = joybus_rx.work[i];
+        // 最後のバイトがストップビット(0x01)
+        if (frame[count - 1] != 0x01) {
+            *status = RxFrameStatus::Bad;
+        } else {
+            *length = count - 1;
         }
-        joybus_rx.length = frame_length;
-        joybus_rx.ready = true;
-    } else {
-        joybus_rx.bad = true;
     }
-}
 
-void __isr rx_pio_irq_handler() {
-    if (pio_interrupt_get(joybus_rx.pio, joybus_rx.sm)) {
-        pio_interrupt_clear(joybus_rx.pio, joybus_rx.sm);
-        rx_finish_receive_from_irq();
-        rx_start_receive();
+    // 読み終わるまでにDMAがこのフレームの先頭を上書きしていないか
+    // （受信中のフレームは最大でもRX_BUFFER_SIZEなので、最新の境界にその分を足して比べる）
+    const uint32_t newest = joybus_rx.boundary_head - 1;
+    const uint32_t latest = joybus_rx.boundary[newest & (RX_BOUNDARY_COUNT - 1)];
+    if (latest + RX_BUFFER_SIZE - start > RX_RING_SIZE) {
+        *status = RxFrameStatus::Overrun;
+        *length = 0;
     }
+
+    joybus_rx.frame_start = end;
+    joybus_rx.boundary_tail = tail + 1;
+    return true;
 }
 
 void rx_init(PIO pio, uint sm) {
     joybus_rx.pio = pio;
     joybus_rx.sm = sm;
-    // DMAの初期設定
-    joybus_rx.dma_channel = dma_claim_unused_channel(true);
-    joybus_rx.dma_config = dma_channel_get_default_config(joybus_rx.dma_channel);
-    channel_config_set_transfer_data_size(&joybus_rx.dma_config, DMA_SIZE_8);
-    channel_config_set_dreq(&joybus_rx.dma_config, pio_get_dreq(pio, sm, false));
-    channel_config_set_read_increment(&joybus_rx.dma_config, false);
-    channel_config_set_write_increment(&joybus_rx.dma_config, true);
+    joybus_rx.data_channel = dma_claim_unused_channel(true);
+    joybus_rx.ctrl_channel = dma_claim_unused_channel(true);
+
+    // data: RX FIFO → リング（書き込みアドレスの下位RX_RING_BITSビットだけが進む）
+    dma_channel_config c = dma_channel_get_default_config(joybus_rx.data_channel);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_dreq(&c, pio_get_dreq(pio, sm, false));
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_ring(&c, /*write=*/true, RX_RING_BITS);
+    channel_config_set_chain_to(&c, joybus_rx.ctrl_channel);
+    dma_channel_configure(joybus_rx.data_channel, &c, rx_ring, &pio->rxf[sm], RX_RING_RELOAD_COUNT,
+                          false);
+
+    // ctrl: reload_count → dataの転送数（トリガ付きレジスタ）
+    // 書き込みアドレスはそのまま引き継ぐので、リングの続きから受信が再開する
+    c = dma_channel_get_default_config(joybus_rx.ctrl_channel);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, false);
+    dma_channel_configure(joybus_rx.ctrl_channel, &c,
+                          &dma_hw->ch[joybus_rx.data_channel].al1_transfer_count_trig,
+                          &joybus_rx.reload_count, 1, false);
 
     // PIO IRQへ割り込みを接続
     pio_interrupt_clear(pio, sm);
@@ -207,7 +234,7 @@ void rx_init(PIO pio, uint sm) {
     irq_set_exclusive_handler(irq, rx_pio_irq_handler);
     irq_set_priority(irq, PICO_HIGHEST_IRQ_PRIORITY);
     irq_set_enabled(irq, true);
-    rx_start_receive();
+    dma_channel_start(joybus_rx.data_channel);
 }
 } // namespace
 
@@ -219,6 +246,7 @@ int main() {
     init_led();
 
     init_bus_pins_safe();
+    joybus_trace_init();
 
     PIO pio_tx = pio0;
     uint sm_tx = 0;
@@ -286,18 +314,10 @@ int main() {
     pio_sm_set_enabled(pio_tx, sm_tx, true); // RXが受信待ち状態になってからTXを起動
 
     // TX向けDMAの初期化
-    tx_dma_chan = dma_claim_unused_channel(true);
-    dma_channel_config tx_dma_config = dma_channel_get_default_config(tx_dma_chan);
-    channel_config_set_transfer_data_size(&tx_dma_config, DMA_SIZE_32);
-    // バッファから順次読み込むのでインクリメント
-    channel_config_set_read_increment(&tx_dma_config, true);
-    // TX FIFOへ書き続けるので固定
-    channel_config_set_write_increment(&tx_dma_config, false);
-    channel_config_set_dreq(&tx_dma_config, pio_get_dreq(pio_tx, sm_tx, true));
-    // TX向けDMA割り込み設定
-    dma_channel_set_irq1_enabled(tx_dma_chan, true);
-    irq_set_exclusive_handler(DMA_IRQ_1, dma_tx_handler);
-    irq_set_enabled(DMA_IRQ_1, true);
+    joybus_tx_init(&joybus_tx, pio_tx, sm_tx);
+
+    // 最初の立ち下がりの記録用（BOOTSELボタンのコールバックより先に呼ばれる）
+    gpio_add_raw_irq_handler(RX_PIN, rx_first_edge_irq_handler);
 
     printf("Loopback test ready.\n");
 
@@ -326,50 +346,92 @@ int main() {
          0xF0, 0x01} // 17バイト（バッファの最大長超過で送信前に弾くはずの長さ）
     };
 
+    // 送信フレームは最初に一度だけDMA用のワード列に詰めておく
+    std::vector<const JoyBusTxFrame *> tx_frames;
+    for (const auto &frame : test_frames) {
+        tx_frames.push_back(joybus_tx_frame_create(frame.data(), frame.size()));
+    }
+
     while (true) {
-        for (const auto &frame : test_frames) {
+        for (size_t f = 0; f < test_frames.size(); ++f) {
+            const auto &frame = test_frames[f];
             const uint32_t expected_bytes = (uint32_t)frame.size();
             if (expected_bytes == 0) {
                 continue;
             }
-            uint32_t raw_received_words[JOYBUS_MAX_FRAME_BYTES] = {0};
-            if (expected_bytes > JOYBUS_MAX_FRAME_BYTES) {
+            if (tx_frames[f] == nullptr) {
                 printf("Error: frame size %u exceeds JOYBUS_MAX_FRAME_BYTES=%u\n", expected_bytes,
                        JOYBUS_MAX_FRAME_BYTES);
                 continue;
             }
 
-            joybus_rx.ready = false;
-            joybus_rx.bad = false;
-
-            joybus_tx_send_dma(pio_tx, sm_tx, frame.data(), expected_bytes, tx_dma_chan,
-                               &tx_dma_config);
-            printf("TX(%lu bytes): ", (unsigned long)expected_bytes);
-            for (size_t i = 0; i < expected_bytes; ++i) {
-                printf(" 0x%02X ", frame[i]);
+            // 前のフレームが締め切りの後に届いていたら捨てる
+            // （残しておくと送ったフレームと受信したフレームの対応がずれる）
+            uint8_t late_frame[RX_BUFFER_SIZE];
+            uint32_t late_length = 0;
+            RxFrameStatus late_status = RxFrameStatus::Ok;
+            while (rx_pop_frame(late_frame, &late_length, &late_status)) {
+                printf("Dropped a frame that arrived after its deadline.\n");
             }
-            printf("\n");
 
+            arm_first_edge_trace();
+            joybus_tx_send(&joybus_tx, tx_frames[f]);
+            joybus_trace(JoyBusTraceEvent::TxArmed, (uint16_t)expected_bytes);
+
+            uint8_t rx_frame[RX_BUFFER_SIZE];
+            uint32_t rx_length = 0;
+            RxFrameStatus status = RxFrameStatus::Ok;
+            bool received = false;
+            const int64_t deadline_us =
+                joybus_frame_duration_us(expected_bytes, BIT_PERIOD_US) + RX_GRACE_US;
             absolute_time_t start_time = get_absolute_time();
-            while (!joybus_rx.ready && !joybus_rx.bad) {
+            while (!(received = rx_pop_frame(rx_frame, &rx_length, &status))) {
                 // タイムアウト判定
-                if (absolute_time_diff_us(start_time, get_absolute_time()) > 2000) {
-                    printf("Error: RX timeout waiting for frame.\n");
+                if (absolute_time_diff_us(start_time, get_absolute_time()) > deadline_us) {
                     break;
                 }
                 tight_loop_contents();
             }
-            if (joybus_rx.bad) {
+            if (received && status == RxFrameStatus::Ok) {
+                joybus_trace(JoyBusTraceEvent::RxComplete, (uint16_t)rx_length);
+            } else if (received) {
+                joybus_trace(JoyBusTraceEvent::Error, (uint16_t)status);
+            } else {
+                joybus_trace(JoyBusTraceEvent::Timeout);
+            }
+
+            // 表示はやりとりが終わってから（受信中のprintfで取り出しが遅れないように）
+            printf("TX(%lu bytes): ", (unsigned long)expected_bytes);
+            for (size_t i = 0; i < expected_bytes; ++i) {
+                printf(" 0x%02X ", frame[i]);
+            }
+            printf("\n");
+            if (!received) {
+                printf("Error: RX timeout waiting for frame.\n");
+                continue;
+            }
+            if (status == RxFrameStatus::Bad) {
                 printf("Error: RX bad frame (missing or invalid stop bit).\n");
                 continue;
             }
+            if (status == RxFrameStatus::Overrun) {
+                printf("Error: RX ring overrun (frame overwritten before it was read).\n");
+                continue;
+            }
 
-            printf("RX(%lu bytes): ", (unsigned long)joybus_rx.length);
-            for (size_t i = 0; i < joybus_rx.length; ++i) {
-                printf(" 0x%02X ", joybus_rx.frame[i]);
+            printf("RX(%lu bytes): ", (unsigned long)rx_length);
+            for (size_t i = 0; i < rx_length; ++i) {
+                printf(" 0x%02X ", rx_frame[i]);
             }
             printf("\n");
         }
-        sleep_ms(5000);
+
+        // 次の周までの空き時間にトレースを書き出す
+        const absolute_time_t next_round = make_timeout_time_ms(5000);
+        while (!time_reached(next_round)) {
+            if (joybus_trace_drain(16) == 0) {
+                sleep_ms(10);
+            }
+        }
     }
 }
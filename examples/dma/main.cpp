@@ -1,9 +1,20 @@
+// 本体側としてコマンドを送り、応答を受信するループバック試験
+// 1回のやりとり（RXの準備→TXへのワード供給→送信開始→受信）をDMAの制御ブロックの列で行う
+// （ctrl/worker/rxの3チャンネルのエンジンはjoybus_dma_chain）
+// CPUはブロックの列を用意してctrlを起動するだけで、完了はrxの割り込み1回で知る
+// 完了割り込みの中で次のやりとりを起動すれば、バスの速度の上限でポーリングできる
+//
+// 受信はjoy_rx_os（1ビットをRX_OVERSAMPLINGサンプルで数えてPIOの中で判定する）
+// 3点サンプリング版のように1バイトを24ビットのワードで運んでCPUで多数決をとる必要がなく、
+// FIFOとDMAで運ぶのは判定済みの1バイト（+ストップビットの0x01）だけになる
 #include "hardware/clocks.h"
 #include "hardware/dma.h"
 #include "hardware/irq.h"
 #include "hardware/pio.h"
-#include "joy_rx5.pio.h"
+#include "joy_rx_os.pio.h"
 #include "joy_tx5.pio.h"
+#include "joybus_dma_chain.h"
+#include "joybus_frame.h"
 #include "pico/bootrom.h"
 #include "pico/stdlib.h"
 #include <stdio.h>
@@ -12,9 +23,16 @@
 namespace {
 // TX FIFOに積める最大バイト数
 constexpr size_t DEFAULT_MAX_FIFO_BYTES = 4 * 8;
-// JoyBusでやりとりする最大フレーム長（バイト数）
-// 実際はせいぜい10バイトだが非DMAでの限界を超えられるか試すため16に拡張
-constexpr size_t JOYBUS_MAX_FRAME_BYTES = 16;
+
+// 連続ポーリングの試験で送るコマンド（ポーリング 0x40 0x03 0x00）と回数
+constexpr uint8_t BURST_COMMAND[] = {0x40, 0x03, 0x00};
+constexpr uint32_t BURST_COUNT = 1000;
+
+// 受信の1ビットあたりのサンプル数（偶数）。1サンプルはPIOの2サイクル
+// 上限はclk_sysを分周しない場合（125MHz・5us/bitで312）。多いほど'0'と'1'の境目が正確になる
+constexpr uint32_t RX_OVERSAMPLING = 16;
+// 受信側が想定するビット周期
+constexpr uint32_t RX_BIT_PERIOD_NS = 5000;
 
 // 通電確認用のオンボードLED
 constexpr uint ONBOARD_LED_PIN = PICO_DEFAULT_LED_PIN;
@@ -24,15 +42,25 @@ constexpr uint BOOT_BTN_PIN = 26; // GP26
 constexpr uint TX_PIN = 15; // GP15
 constexpr uint RX_PIN = 16; // GP16
 
-// DMAチャンネルはあとで空きを割り当てるので未初期化の意味を込めて-1設定
-int rx_dma_chan = -1;
-int tx_dma_chan = -1;
+// 1回のやりとりのブロック数（RX起動・送信開始・TXワード・終端）
+constexpr size_t TRANSACTION_BLOCKS = 4;
+
+struct JoyBusTransaction {
+    JoyBusDmaChain chain;
+    JoyBusDmaBlock blocks[TRANSACTION_BLOCKS] = {};
+    // ブロックが読み込む値
+    uint32_t rx_buffer_addr = 0;
+    uint32_t start_irq_mask = 1u << 0;
+    uint8_t rx_data[JOYBUS_MAX_FRAME_BYTES + 1] = {0}; // ストップビット(0x01)分も確保
+    uint32_t rx_bytes = 0;
+
+    // 完了割り込みとメインループで共有
+    volatile bool done = false;
+    volatile uint32_t completed = 0;
+    volatile uint32_t burst_remaining = 0; // 残っていれば完了割り込みで次を起動する
+};
 
-// 割り込みハンドラから不意にいじられるのでvolatile
-volatile bool rx_dma_done = false;
-volatile bool rx_dma_error = false;
-volatile bool tx_dma_done = false;
-volatile bool tx_dma_error = false;
+JoyBusTransaction transaction;
 
 void boot_btn_irq(uint gpio, uint32_t events) {
     // ちょいデバウンス（押しっぱなし連打対策）
@@ -66,106 +94,48 @@ void init_led() {
     gpio_put(ONBOARD_LED_PIN, 1);
 }
 
-inline uint8_t decode_3sample_msbfirst(uint32_t w) {
-    // wは24ビットのサンプルデータ
-    // あるbitの受信結果について3つのサンプルが8組並んでいる
-    // 00000000 | s0, s1, s2 | s0, s1, s2 | ... | s0, s1, s2
-    // 最も古いサンプルがビット23、最新がビット0
-
-    uint8_t out = 0;
-    // 上位iビット目の3サンプルを抽出し多数決をとる
-    for (int i = 0; i < 8; ++i) {
-        int base = 23 - 3 * i;
-        uint32_t s0 = (w >> base) & 1u;
-        uint32_t s1 = (w >> (base - 1)) & 1u;
-        uint32_t s2 = (w >> (base - 2)) & 1u;
-        uint32_t majority = (s0 & s1) | (s1 & s2) | (s2 & s0);
-        out = (uint8_t)((out << 1) | (majority & 1u));
-    }
-    return out;
-}
-
-// RXのDMA割り込みハンドラ
-void __isr dma_rx_handler() {
-    uint32_t status = dma_hw->ints0;
-    if (rx_dma_chan >= 0 && (status & (1u << rx_dma_chan))) {
-        // 書き戻して割り込みフラグクリア
-        dma_hw->ints0 = 1u << rx_dma_chan;
-        // 受信完了
-        rx_dma_done = true;
-    } else {
-        // エラー発生
-        rx_dma_error = true;
-    }
-}
-
-// TXのDMA割り込みハンドラ
-void __isr dma_tx_handler() {
-    uint32_t status = dma_hw->ints1;
-    if (tx_dma_chan >= 0 && (status & (1u << tx_dma_chan))) {
-        dma_hw->ints1 = 1u << tx_dma_chan;
-        tx_dma_done = true;
-    } else {
-        tx_dma_error = true;
-    }
+// ctrlを起動してブロックの列を最初から実行する
+void __not_in_flash_func(transaction_start)() {
+    transaction.done = false;
+    joybus_dma_chain_start(&transaction.chain, transaction.blocks);
 }
 
-void joybus_tx_send_dma(PIO pio, uint sm, const uint8_t *data, size_t nbytes, int tx_dma_chan,
-                        dma_channel_config *tx_dma_config) {
-    if (nbytes == 0) {
+// rxの完了（応答の全バイト受信）割り込み。やりとり1回につき1回だけ入る
+void __isr __not_in_flash_func(transaction_irq_handler)() {
+    if (!joybus_dma_chain_take_rx_irq0(&transaction.chain)) {
         return;
     }
-    if (nbytes > JOYBUS_MAX_FRAME_BYTES) {
-        printf("Error: joybus_tx_send_dma: nbytes=%zu exceeds max=%zu\n", nbytes,
-               JOYBUS_MAX_FRAME_BYTES);
+    transaction.completed = transaction.completed + 1;
+    if (transaction.burst_remaining > 0) {
+        transaction.burst_remaining = transaction.burst_remaining - 1;
+        transaction_start();
         return;
     }
+    transaction.done = true;
+}
 
-    printf("Waiting for previous TX complete...\n");
-    // 万が一同期が崩れてもautopullされないように前の送信が完了しないうちはFIFOに積まない
-    while (!pio_interrupt_get(pio, 1)) {
-        // 送信が完了するのを待つ
-        tight_loop_contents();
-    }
-    printf("Previous TX complete.\n");
-    pio_interrupt_clear(pio, 1);
-
-    // 期待する送信ビット数-1
-    uint32_t bits_to_send_minus1 = (uint32_t)(nbytes * 8 - 1);
-    const size_t words_of_data = (nbytes + 3) / 4;
-    const size_t words_to_send = words_of_data + 1; // bits_to_send_minus1 + データワード数
-    uint32_t tx_buffer[words_to_send] = {0};
-    tx_buffer[0] = bits_to_send_minus1;
-    printf("[TX] bits_to_send_minus1=%lu\n", (unsigned long)bits_to_send_minus1);
-    for (size_t w = 0; w < words_of_data; ++w) {
-        uint32_t word = 0;
-        for (size_t b = 0; b < 4; ++b) {
-            size_t byte_index = w * 4 + b;
-            uint8_t byte = (byte_index < nbytes) ? data[byte_index] : 0;
-            word |= ((uint32_t)byte) << (8 * (3 - b));
-        }
-        tx_buffer[w + 1] = word;
-        printf("[TX] Prepared word %zu: 0x%08lX\n", w, (unsigned long)word);
-    }
-    tx_dma_done = false;
-    tx_dma_error = false;
-    dma_channel_configure(tx_dma_chan, tx_dma_config,
-                          &pio->txf[sm], // 書き込み先
-                          tx_buffer,     // 読み込み元
-                          words_to_send, // 転送するワード数（bits_to_send_minus1 + データワード数）
-                          true           // 即時開始
-    );
-    pio->irq_force = (1u << 0);
-    printf("[TX] TX start notified via DMA.\n");
-    while (!tx_dma_done && !tx_dma_error) {
-        // 送信完了待ち
-        tight_loop_contents();
-    }
-    if (tx_dma_error) {
-        printf("[TX] TX DMA error occurred.\n");
-        return;
-    }
-    printf("[TX] TX DMA complete.\n");
+void transaction_init(PIO pio_tx, uint sm_tx, PIO pio_rx, uint sm_rx) {
+    joybus_dma_chain_init(&transaction.chain, pio_tx, sm_tx, pio_rx, sm_rx);
+    irq_set_exclusive_handler(DMA_IRQ_0, transaction_irq_handler);
+    irq_set_enabled(DMA_IRQ_0, true);
+}
+
+// コマンドと応答のバイト数からブロックの列を作る
+// 同じコマンドを繰り返すときは作り直さずにtransaction_startだけ呼べばよい
+void transaction_prepare(const JoyBusTxFrame *command, uint32_t reply_bytes) {
+    JoyBusTransaction &t = transaction;
+    const JoyBusDmaChain *c = &t.chain;
+    t.rx_bytes = reply_bytes;
+    t.rx_buffer_addr = (uint32_t)(uintptr_t)t.rx_data;
+    // 起動時の転送数はここで書いておく（トリガ付きレジスタへの書き込みで毎回読み直される）
+    // RXのSMはストップビットでフレームの終わりを知るので、ビット数を渡す必要はない
+    joybus_dma_chain_set_rx_count(c, reply_bytes + 1);
+
+    t.blocks[0] = joybus_dma_block_rx_start(c, &t.rx_buffer_addr);
+    // TXに送信開始を指示（SMはpull blockでワードを待つ）
+    t.blocks[1] = joybus_dma_block_tx_start(c, &t.start_irq_mask);
+    t.blocks[2] = joybus_dma_block_tx_words(c, command);
+    t.blocks[3] = joybus_dma_block_end();
 }
 } // namespace
 
@@ -186,12 +156,12 @@ int main() {
     // PIOプログラムをロード
     printf("Loading PIO programs...\n");
     printf("tx len=%u origin=%d\n", joy_tx5_program.length, joy_tx5_program.origin);
-    printf("rx len=%u origin=%d\n", joy_rx5_program.length, joy_rx5_program.origin);
+    printf("rx len=%u origin=%d\n", joy_rx_os_program.length, joy_rx_os_program.origin);
     printf("can add tx=%d rx=%d\n", pio_can_add_program(pio0, &joy_tx5_program),
-           pio_can_add_program(pio0, &joy_rx5_program));
+           pio_can_add_program(pio0, &joy_rx_os_program));
 
     uint off_tx = pio_add_program(pio_tx, &joy_tx5_program);
-    uint off_rx = pio_add_program(pio_rx, &joy_rx5_program);
+    uint off_rx = pio_add_program(pio_rx, &joy_rx_os_program);
     printf("Added PIO programs at off_tx=%u off_rx=%u\n", off_tx, off_rx);
 
     // --- TXステートマシン設定 ---
@@ -206,21 +176,28 @@ int main() {
                             /*pull_thresh=*/32);
 
     // --- RXステートマシン設定 ---
-    pio_sm_config c_rx = joy_rx5_program_get_default_config(off_rx);
+    pio_sm_config c_rx = joy_rx_os_program_get_default_config(off_rx);
     // RXはRX_PINからサンプリング
     sm_config_set_in_pins(&c_rx, RX_PIN);
-    // 3点でサンプリングするため3 * 8 = 24ビットずつ受信
+    // PIOの中で判定したビットを8ビットずつ受信
     sm_config_set_in_shift(&c_rx,
                            /*shift_right=*/false,
                            /*autopush=*/true,
-                           /*push_thresh=*/24);
+                           /*push_thresh=*/8);
     sm_config_set_jmp_pin(&c_rx, RX_PIN);
 
     // クロック分周設定
     const float pio_hz = 4'000'000; // 4MHz
     float div = (float)clock_get_hz(clk_sys) / pio_hz;
     sm_config_set_clkdiv(&c_tx, div);
-    sm_config_set_clkdiv(&c_rx, div);
+    // RXは1サンプル2サイクルでRX_OVERSAMPLINGサンプル/ビットになるように分周する
+    const float rx_hz = 2.0f * RX_OVERSAMPLING * 1e9f / RX_BIT_PERIOD_NS;
+    const float rx_div = (float)clock_get_hz(clk_sys) / rx_hz;
+    if (rx_div < 1.0f) {
+        printf("Error: RX_OVERSAMPLING=%lu needs %.0fHz, above clk_sys\n",
+               (unsigned long)RX_OVERSAMPLING, rx_hz);
+    }
+    sm_config_set_clkdiv(&c_rx, rx_div < 1.0f ? 1.0f : rx_div);
 
     // ステートマシン初期化
     pio_gpio_init(pio_tx, TX_PIN);
@@ -236,39 +213,20 @@ int main() {
     // ステートマシン初期化
     pio_sm_init(pio_tx, sm_tx, off_tx, &c_tx);
     pio_sm_init(pio_rx, sm_rx, off_rx, &c_rx);
+    // しきい値（y）とフレーム終端の長さ（osr）をサンプル数で渡す
+    pio_sm_put_blocking(pio_rx, sm_rx, RX_OVERSAMPLING / 2 - 1);
+    pio_sm_exec(pio_rx, sm_rx, pio_encode_pull(false, true));
+    pio_sm_exec(pio_rx, sm_rx, pio_encode_mov(pio_y, pio_osr));
+    pio_sm_put_blocking(pio_rx, sm_rx, RX_OVERSAMPLING);
+    pio_sm_exec(pio_rx, sm_rx, pio_encode_pull(false, true));
 
     // RXステートマシンを先に起動
     pio_sm_set_enabled(pio_rx, sm_rx, true);
     sleep_ms(200);                           // 安全のため少し待つ
     pio_sm_set_enabled(pio_tx, sm_tx, true); // RXが受信待ち状態になってからTXを起動
 
-    // RX向けDMAの初期化
-    rx_dma_chan = dma_claim_unused_channel(true);
-    dma_channel_config rx_dma_config = dma_channel_get_default_config(rx_dma_chan);
-    channel_config_set_transfer_data_size(&rx_dma_config, DMA_SIZE_32);
-    // RX FIFOから読み続けるので固定
-    channel_config_set_read_increment(&rx_dma_config, false);
-    // バッファに順次書き込むのでインクリメント
-    channel_config_set_write_increment(&rx_dma_config, true);
-    channel_config_set_dreq(&rx_dma_config, pio_get_dreq(pio_rx, sm_rx, false));
-    // RX向けDMA割り込み設定
-    dma_channel_set_irq0_enabled(rx_dma_chan, true);      // RX向けチャンネルにDMA_IRQ_0を紐付け
-    irq_set_exclusive_handler(DMA_IRQ_0, dma_rx_handler); // DMA_IRQ_0にハンドラを登録
-    irq_set_enabled(DMA_IRQ_0, true);                     // DMA_IRQ_0割り込みを有効化
-
-    // TX向けDMAの初期化
-    tx_dma_chan = dma_claim_unused_channel(true);
-    dma_channel_config tx_dma_config = dma_channel_get_default_config(tx_dma_chan);
-    channel_config_set_transfer_data_size(&tx_dma_config, DMA_SIZE_32);
-    // バッファから順次読み込むのでインクリメント
-    channel_config_set_read_increment(&tx_dma_config, true);
-    // TX FIFOへ書き続けるので固定
-    channel_config_set_write_increment(&tx_dma_config, false);
-    channel_config_set_dreq(&tx_dma_config, pio_get_dreq(pio_tx, sm_tx, true));
-    // TX向けDMA割り込み設定
-    dma_channel_set_irq1_enabled(tx_dma_chan, true);
-    irq_set_exclusive_handler(DMA_IRQ_1, dma_tx_handler);
-    irq_set_enabled(DMA_IRQ_1, true);
+    // やりとり用DMAの初期化
+    transaction_init(pio_tx, sm_tx, pio_rx, sm_rx);
 
     printf("Loopback test ready.\n");
 
@@ -303,26 +261,16 @@ int main() {
             if (expected_bytes == 0) {
                 continue;
             }
-            uint32_t raw_received_words[JOYBUS_MAX_FRAME_BYTES] = {0};
-            rx_dma_done = false;
-            rx_dma_error = false;
             if (expected_bytes > JOYBUS_MAX_FRAME_BYTES) {
                 printf("Error: frame size %u exceeds JOYBUS_MAX_FRAME_BYTES=%u\n", expected_bytes,
                        JOYBUS_MAX_FRAME_BYTES);
                 continue;
             }
-            dma_channel_configure(rx_dma_chan, &rx_dma_config,
-                                  raw_received_words,  // 書き込み先
-                                  &pio_rx->rxf[sm_rx], // 読み込み元
-                                  expected_bytes,      // 転送するワード数（1ワード=4バイト）
-                                  true                 // 即時開始
-            );
-
-            const uint32_t bits_to_receive_minus1 = expected_bytes * 8 - 1;
-            pio_sm_put_blocking(pio_rx, sm_rx, bits_to_receive_minus1);
-
-            joybus_tx_send_dma(pio_tx, sm_tx, frame.data(), expected_bytes, tx_dma_chan,
-                               &tx_dma_config);
+            JoyBusTxFrame command;
+            joybus_tx_frame_encode(&command, frame.data(), expected_bytes);
+            // ループバックなので応答は送ったコマンドそのもの
+            transaction_prepare(&command, expected_bytes);
+            transaction_start();
 
             printf("TX(%lu bytes): ", (unsigned long)expected_bytes);
             for (size_t i = 0; i < expected_bytes; ++i) {
@@ -331,26 +279,59 @@ int main() {
             printf("\n");
 
             absolute_time_t start_time = get_absolute_time();
-            while (!rx_dma_done && !rx_dma_error) {
-                // タイムアウト処理
-                if (absolute_time_diff_us(start_time, get_absolute_time()) > 65) {
-                    dma_channel_abort(rx_dma_chan);
-                    printf("RX DMA timeout (expected %u bytes)\n", expected_bytes);
+            bool timed_out = false;
+            while (!transaction.done) {
+                // タイムアウト処理（送信+受信で最大約170us）
+                if (absolute_time_diff_us(start_time, get_absolute_time()) > 2000) {
+                    timed_out = true;
                     break;
                 }
                 tight_loop_contents();
             }
-            if (rx_dma_error) {
-                printf("RX DMA error occurred.\n");
+            if (timed_out) {
+                joybus_dma_chain_abort(&transaction.chain);
+                // RXのSMはビット待ちで止まっているので先頭（アイドル待ち）からやり直す
+                // restartしてもyとosrの中身は残る
+                pio_sm_clear_fifos(pio_rx, sm_rx);
+                pio_sm_restart(pio_rx, sm_rx);
+                pio_sm_exec(pio_rx, sm_rx, pio_encode_jmp(off_rx));
+                printf("RX DMA timeout (expected %u bytes)\n", expected_bytes);
                 continue;
             }
+            // 受信データは判定済みのバイト列（最後がストップビット）
+            const uint8_t *received = transaction.rx_data;
+            if (received[expected_bytes] != 0x01) {
+                printf("Error: RX missing stop bit (0x%02X)\n", received[expected_bytes]);
+            }
             printf("RX(%u bytes): ", expected_bytes);
             for (size_t i = 0; i < expected_bytes; ++i) {
-                uint8_t decoded_byte = decode_3sample_msbfirst(raw_received_words[i]);
-                printf(" 0x%02X ", decoded_byte);
+                printf(" 0x%02X ", received[i]);
             }
             printf("\n");
         }
+
+        // 連続ポーリング: 完了割り込みの中で次のやりとりを起動し続ける
+        JoyBusTxFrame burst_command;
+        joybus_tx_frame_encode(&burst_command, BURST_COMMAND, sizeof(BURST_COMMAND));
+        transaction_prepare(&burst_command, sizeof(BURST_COMMAND));
+        const uint32_t completed_before = transaction.completed;
+        transaction.burst_remaining = BURST_COUNT - 1;
+        const absolute_time_t burst_start = get_absolute_time();
+        transaction_start();
+        while (!transaction.done) {
+            if (absolute_time_diff_us(burst_start, get_absolute_time()) > 1'000'000) {
+                break;
+            }
+            tight_loop_contents();
+        }
+        const int64_t burst_us = absolute_time_diff_us(burst_start, get_absolute_time());
+        const uint32_t burst_done = transaction.completed - completed_before;
+        transaction.burst_remaining = 0;
+        const uint8_t *last = transaction.rx_data;
+        printf("Burst: %lu/%lu polls in %lldus (%lldus/poll), last RX 0x%02X 0x%02X 0x%02X\n",
+               (unsigned long)burst_done, (unsigned long)BURST_COUNT, (long long)burst_us,
+               (long long)(burst_done > 0 ? burst_us / burst_done : 0), last[0], last[1], last[2]);
+
         sleep_ms(5000);
     }
 }
@@ -0,0 +1,348 @@
+// ループバックで送ったフレームをエッジ間隔のキャプチャで受信する
+// joy_edgeはビットの判定をせず、1ビットごとにLowとHighの長さをワードにしてpushするだけ
+// DMAはそれを止めずにワード単位のリングへ書き続け、CPUがリングを読んでビットに戻す
+//   data: RX FIFO → リング（書き込みアドレスをEDGE_RING_SIZEで折り返す）
+//   ctrl: dataの転送が尽きたら転送数を書き戻して再起動する
+// 判定はLowとHighの比で行うので、送信側のビット周期が公称からずれていても読める
+// 同じデータからフレームごとのビット周期やLowの長さ（タイミングの統計）もわかる
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/pio.h"
+#include "joy_edge.pio.h"
+#include "joy_tx5.pio.h"
+#include "joybus_edge.h"
+#include "joybus_tx.h"
+#include "pico/bootrom.h"
+#include "pico/stdlib.h"
+#include <stdio.h>
+
+namespace {
+// 受信リングの大きさ（2のべき乗のワード数、DMAのリング指定はバイト数のlog2）
+constexpr uint EDGE_RING_BITS = 10;
+constexpr size_t EDGE_RING_WORDS = (1u << EDGE_RING_BITS) / sizeof(uint32_t);
+// dataの転送数（尽きるとctrlが同じ値を書き戻す。1ワード4usなので実質止まらない）
+constexpr uint32_t EDGE_RING_RELOAD_COUNT = 0xFFFFFFFFu;
+
+// joy_edgeの上限（us）。これより長いHighはフレーム終端として扱う
+// 5us版の'0'のHighは1.25us、'1'は3.75usなので、少し遅い相手でも途中で切れない長さにする
+constexpr uint32_t EDGE_LIMIT_US = 5;
+// 送信側のビット周期を公称からずらして受信の余裕を確かめる（1.0で公称の5us）
+constexpr float TX_BIT_PERIOD_SCALE = 1.0f;
+
+// 通電確認用のオンボードLED
+constexpr uint ONBOARD_LED_PIN = PICO_DEFAULT_LED_PIN;
+// BOOTSELに入るためのボタン入力
+constexpr uint BOOT_BTN_PIN = 26; // GP26
+// JoyBus
+constexpr uint TX_PIN = 15; // GP15
+constexpr uint RX_PIN = 16; // GP16
+
+struct EdgeRx {
+    PIO pio = nullptr;
+    uint sm = 0;
+    int data_channel = -1; // RX FIFO → リング
+    int ctrl_channel = -1; // dataの転送数を張り直す
+    uint32_t reload_count = EDGE_RING_RELOAD_COUNT; // ctrlの読み込み元
+
+    JoyBusEdgeDecoder decoder;
+    uint32_t read_index = 0; // 次に読むリング内の位置（ワード単位）
+
+    // 組み立て中のフレーム（フレーム終端のワードが来たらデコードする）
+    uint32_t words[JOYBUS_EDGE_MAX_WORDS] = {};
+    uint32_t word_count = 0;
+    bool overflow = false; // 最大長を超えた（終端まで読み捨てる）
+};
+
+// フレームをまたいだタイミングの統計（カウント単位）
+struct EdgeStats {
+    uint32_t frames = 0;
+    uint32_t errors = 0;
+    uint32_t period_min = 0xFFFFFFFFu;
+    uint32_t period_max = 0;
+    uint32_t low1_max = 0;
+    uint32_t low0_min = 0xFFFFFFFFu;
+
+    void add(const JoyBusEdgeFrame &f) {
+        ++frames;
+        if (f.status != JoyBusEdgeStatus::Ok) {
+            ++errors;
+            return;
+        }
+        period_min = f.period_min < period_min ? f.period_min : period_min;
+        period_max = f.period_max > period_max ? f.period_max : period_max;
+        low1_max = f.low1_max > low1_max ? f.low1_max : low1_max;
+        low0_min = f.low0_min < low0_min ? f.low0_min : low0_min;
+    }
+};
+
+// DMAのリング指定はバッファがその大きさにそろっている必要がある
+alignas(1u << EDGE_RING_BITS) uint32_t edge_ring[EDGE_RING_WORDS];
+
+EdgeRx edge_rx;
+EdgeStats edge_stats;
+JoyBusTx joybus_tx;
+
+// カウント→ns換算用（joy_edgeは1カウント2サイクル）
+uint32_t clk_mhz = 125;
+
+void boot_btn_irq(uint gpio, uint32_t events) {
+    // ちょいデバウンス（押しっぱなし連打対策）
+    busy_wait_ms(100);
+    if (gpio_get(BOOT_BTN_PIN) == 0) {
+        printf("BOOTSEL button pressed. Entering USB boot mode...\n");
+        reset_usb_boot(0, 0);
+    }
+}
+
+void bootsel_button_init() {
+    gpio_init(BOOT_BTN_PIN);
+    gpio_set_dir(BOOT_BTN_PIN, GPIO_IN);
+    gpio_pull_up(BOOT_BTN_PIN);
+    gpio_set_irq_enabled_with_callback(BOOT_BTN_PIN, GPIO_IRQ_EDGE_FALL, true, &boot_btn_irq);
+}
+
+void init_bus_pins_safe() {
+    // バスへ接続するピンをHi-Zに設定
+    gpio_init(TX_PIN);
+    gpio_put(TX_PIN, 0);
+    gpio_set_dir(TX_PIN, GPIO_IN);
+
+    gpio_init(RX_PIN);
+    gpio_set_dir(RX_PIN, GPIO_IN);
+}
+
+void init_led() {
+    gpio_init(ONBOARD_LED_PIN);
+    gpio_set_dir(ONBOARD_LED_PIN, GPIO_OUT);
+    gpio_put(ONBOARD_LED_PIN, 1);
+}
+
+uint32_t counts_to_ns(uint32_t counts) {
+    return counts * 2 * 1000 / clk_mhz;
+}
+
+// リングに届いたワードを読み進め、フレームが1つそろったらデコードしてtrueを返す
+// 割り込みは使わず、DMAの書き込みアドレスまでをメインループから読む
+bool edge_rx_poll(JoyBusEdgeFrame *frame) {
+    const uint32_t write_addr = dma_hw->ch[edge_rx.data_channel].write_addr;
+    const uint32_t write_index =
+        ((write_addr - (uint32_t)(uintptr_t)edge_ring) / sizeof(uint32_t)) & (EDGE_RING_WORDS - 1);
+
+    while (edge_rx.read_index != write_index) {
+        const uint32_t word = edge_ring[edge_rx.read_index];
+        edge_rx.read_index = (edge_rx.read_index + 1) & (EDGE_RING_WORDS - 1);
+
+        if (edge_rx.word_count < JOYBUS_EDGE_MAX_WORDS) {
+            edge_rx.words[edge_rx.word_count++] = word;
+        } else {
+            edge_rx.overflow = true;
+        }
+        if (!joybus_edge_is_frame_end(word)) {
+            continue;
+        }
+
+        if (edge_rx.overflow) {
+            *frame = JoyBusEdgeFrame{};
+            frame->status = JoyBusEdgeStatus::BadLength;
+        } else {
+            joybus_edge_decode(&edge_rx.decoder, edge_rx.words, edge_rx.word_count, frame);
+        }
+        edge_rx.word_count = 0;
+        edge_rx.overflow = false;
+        return true;
+    }
+    return false;
+}
+
+void edge_rx_init(PIO pio, uint sm, uint32_t limit, uint32_t nominal_period) {
+    edge_rx.pio = pio;
+    edge_rx.sm = sm;
+    joybus_edge_decoder_init(&edge_rx.decoder, limit, nominal_period);
+    edge_rx.data_channel = dma_claim_unused_channel(true);
+    edge_rx.ctrl_channel = dma_claim_unused_channel(true);
+
+    // data: RX FIFO → リング（書き込みアドレスの下位EDGE_RING_BITSビットだけが進む）
+    dma_channel_config c = dma_channel_get_default_config(edge_rx.data_channel);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_dreq(&c, pio_get_dreq(pio, sm, false));
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_ring(&c, /*write=*/true, EDGE_RING_BITS);
+    channel_config_set_chain_to(&c, edge_rx.ctrl_channel);
+    dma_channel_configure(edge_rx.data_channel, &c, edge_ring, &pio->rxf[sm],
+                          EDGE_RING_RELOAD_COUNT, false);
+
+    // ctrl: reload_count → dataの転送数（トリガ付きレジスタ）
+    c = dma_channel_get_default_config(edge_rx.ctrl_channel);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, false);
+    dma_channel_configure(edge_rx.ctrl_channel, &c,
+                          &dma_hw->ch[edge_rx.data_channel].al1_transfer_count_trig,
+                          &edge_rx.reload_count, 1, false);
+
+    dma_channel_start(edge_rx.data_channel);
+}
+
+void print_frame(const JoyBusEdgeFrame &f) {
+    switch (f.status) {
+    case JoyBusEdgeStatus::Ok:
+        break;
+    case JoyBusEdgeStatus::LowTimeout:
+        printf("Error: RX low longer than the limit (%lu bits).\n", (unsigned long)f.nbits);
+        return;
+    case JoyBusEdgeStatus::NoStopBit:
+        printf("Error: RX missing stop bit (%lu bits).\n", (unsigned long)f.nbits);
+        return;
+    case JoyBusEdgeStatus::BadLength:
+        printf("Error: RX bad length (%lu bits).\n", (unsigned long)f.nbits);
+        return;
+    }
+
+    printf("RX(%lu bytes): ", (unsigned long)f.nbytes);
+    for (uint32_t i = 0; i < f.nbytes; ++i) {
+        printf(" 0x%02X ", f.data[i]);
+    }
+    printf("\n");
+    const uint32_t period_avg = f.period_count ? f.period_sum / f.period_count : 0;
+    printf("  bit period avg=%luns min=%luns max=%luns, stop threshold=%luns\n",
+           (unsigned long)counts_to_ns(period_avg), (unsigned long)counts_to_ns(f.period_min),
+           (unsigned long)counts_to_ns(f.period_max), (unsigned long)counts_to_ns(f.threshold));
+    if (f.low1_max) {
+        printf("  low '1' %lu-%luns", (unsigned long)counts_to_ns(f.low1_min),
+               (unsigned long)counts_to_ns(f.low1_max));
+    }
+    if (f.low0_max) {
+        printf("  low '0' %lu-%luns", (unsigned long)counts_to_ns(f.low0_min),
+               (unsigned long)counts_to_ns(f.low0_max));
+    }
+    printf("\n");
+}
+} // namespace
+
+int main() {
+    stdio_init_all();
+    bootsel_button_init();
+
+    // 動作開始の確認用にオンボードLEDを光らせる
+    init_led();
+
+    init_bus_pins_safe();
+
+    PIO pio_tx = pio0;
+    uint sm_tx = 0;
+    PIO pio_rx = pio1;
+    uint sm_rx = 0;
+    clk_mhz = clock_get_hz(clk_sys) / 1'000'000;
+
+    // PIOプログラムをロード
+    printf("Loading PIO programs...\n");
+    printf("tx len=%u edge len=%u\n", joy_tx5_program.length, joy_edge_program.length);
+    uint off_tx = pio_add_program(pio_tx, &joy_tx5_program);
+    uint off_rx = pio_add_program(pio_rx, &joy_edge_program);
+    printf("Added PIO programs at off_tx=%u off_rx=%u\n", off_tx, off_rx);
+
+    // --- TXステートマシン設定 ---
+    pio_sm_config c_tx = joy_tx5_program_get_default_config(off_tx);
+    sm_config_set_set_pins(&c_tx, TX_PIN, 1);
+    sm_config_set_out_shift(&c_tx,
+                            /*shift_right=*/false,
+                            /*autopull=*/true,
+                            /*pull_thresh=*/32);
+    const float pio_hz = 4'000'000; // 4MHz（TX_BIT_PERIOD_SCALEでずらす）
+    sm_config_set_clkdiv(&c_tx, (float)clock_get_hz(clk_sys) / pio_hz * TX_BIT_PERIOD_SCALE);
+
+    // --- エッジキャプチャのステートマシン設定 ---
+    // 分解能を上げるため分周しない（1カウント = 2サイクル = 125MHzで16ns）
+    pio_sm_config c_rx = joy_edge_program_get_default_config(off_rx);
+    sm_config_set_in_pins(&c_rx, RX_PIN);
+    sm_config_set_jmp_pin(&c_rx, RX_PIN);
+    // Low・Highの残りを16ビットずつINし、1ビット分（32ビット）そろったらpush
+    sm_config_set_in_shift(&c_rx,
+                           /*shift_right=*/false,
+                           /*autopush=*/true,
+                           /*push_thresh=*/32);
+    sm_config_set_clkdiv(&c_rx, 1.0f);
+    const uint32_t counts_per_us = clk_mhz / 2;
+    const uint32_t limit = EDGE_LIMIT_US * counts_per_us;
+    const uint32_t nominal_period = 5 * counts_per_us; // 公称のビット周期5us
+
+    // ステートマシン初期化
+    pio_gpio_init(pio_tx, TX_PIN);
+    pio_gpio_init(pio_rx, RX_PIN);
+    gpio_pull_up(TX_PIN); // open-drainのHigh維持の補助（外付けがあるなら無くてもOK）
+    gpio_pull_up(RX_PIN); // 必須寄り
+    // TXを開放状態に設定
+    pio_sm_set_consecutive_pindirs(pio_tx, sm_tx, TX_PIN, 1, false);
+    pio_sm_set_pins_with_mask(pio_tx, sm_tx, 0u, 1u << TX_PIN);
+    // RXを入力に設定
+    pio_sm_set_consecutive_pindirs(pio_rx, sm_rx, RX_PIN, 1, false);
+
+    pio_sm_init(pio_tx, sm_tx, off_tx, &c_tx);
+    pio_sm_init(pio_rx, sm_rx, off_rx, &c_rx);
+
+    // 上限カウントをyに設定してからキャプチャを起動
+    pio_sm_put_blocking(pio_rx, sm_rx, limit);
+    pio_sm_exec(pio_rx, sm_rx, pio_encode_pull(false, true));
+    pio_sm_exec(pio_rx, sm_rx, pio_encode_mov(pio_y, pio_osr));
+    edge_rx_init(pio_rx, sm_rx, limit, nominal_period);
+    pio_sm_set_enabled(pio_rx, sm_rx, true);
+    sleep_ms(200);                           // 安全のため少し待つ
+    pio_sm_set_enabled(pio_tx, sm_tx, true); // キャプチャが動き出してからTXを起動
+
+    joybus_tx_init(&joybus_tx, pio_tx, sm_tx);
+
+    printf("Edge capture loopback ready (limit=%lu counts, tx scale=%.2f).\n",
+           (unsigned long)limit, TX_BIT_PERIOD_SCALE);
+
+    const uint8_t test_frames[][8] = {
+        {0x00},                                           // identify
+        {0x40, 0x03, 0x00},                               // poll
+        {0x00, 0x80, 0x12, 0x34, 0x56, 0x78, 0x9A, 0xFF}, // pollの応答
+        {0xFF, 0x00, 0xA5, 0x5A},
+    };
+    const size_t test_lengths[] = {1, 3, 8, 4};
+    constexpr size_t TEST_FRAME_COUNT = sizeof(test_lengths) / sizeof(test_lengths[0]);
+
+    // 送信フレームは最初に一度だけDMA用のワード列に詰めておく
+    const JoyBusTxFrame *tx_frames[TEST_FRAME_COUNT];
+    for (size_t f = 0; f < TEST_FRAME_COUNT; ++f) {
+        tx_frames[f] = joybus_tx_frame_create(test_frames[f], test_lengths[f]);
+    }
+
+    while (true) {
+        for (size_t f = 0; f < TEST_FRAME_COUNT; ++f) {
+            joybus_tx_send(&joybus_tx, tx_frames[f]);
+            printf("TX(%lu bytes): ", (unsigned long)test_lengths[f]);
+            for (size_t i = 0; i < test_lengths[f]; ++i) {
+                printf(" 0x%02X ", test_frames[f][i]);
+            }
+            printf("\n");
+
+            JoyBusEdgeFrame frame;
+            bool received = false;
+            absolute_time_t start_time = get_absolute_time();
+            while (!(received = edge_rx_poll(&frame))) {
+                // タイムアウト判定
+                if (absolute_time_diff_us(start_time, get_absolute_time()) > 2000) {
+                    printf("Error: RX timeout waiting for frame.\n");
+                    break;
+                }
+                tight_loop_contents();
+            }
+            if (!received) {
+                continue;
+            }
+            edge_stats.add(frame);
+            print_frame(frame);
+        }
+
+        printf("frames=%lu errors=%lu period %lu-%luns, low '1' max=%luns, low '0' min=%luns\n",
+               (unsigned long)edge_stats.frames, (unsigned long)edge_stats.errors,
+               (unsigned long)counts_to_ns(edge_stats.period_min),
+               (unsigned long)counts_to_ns(edge_stats.period_max),
+               (unsigned long)counts_to_ns(edge_stats.low1_max),
+               (unsigned long)counts_to_ns(edge_stats.low0_min));
+        sleep_ms(5000);
+    }
+}
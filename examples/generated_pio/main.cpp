@@ -0,0 +1,241 @@
+// joybus_pio_gen.hでコンパイル時に作ったjoy_tx5 / joy_rx5でループバック試験をする
+// .pioの代わりにclk_sysと整数の分周比からプログラムを組み立てるので、
+// 4MHz（clk_sys 125MHzを31.25で分周）より細かいPIOのクロックでも手で遅延を数え直さずに済む
+// ここではclk_sys 125MHzを5で分周した25MHz（1ビット125サイクル）で動かす
+// プログラムが32命令に収まらない・サイクルの割り振りが成り立たないパラメータはビルドで弾く
+//
+// 送受信の手順はsoakと同じ（TXはjoybus_tx、RXは24ビットのワードをDMAで受けて多数決、
+// 同期が崩れたらjoybus_resyncでRXのSMをその場で先頭に戻す）
+//
+// 配線: TX_PINとRX_PINをつなぐ（3.3Vプルアップ）
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/pio.h"
+#include "joybus_decode.h"
+#include "joybus_frame.h"
+#include "joybus_pio_gen.h"
+#include "joybus_resync.h"
+#include "joybus_tx.h"
+#include "pico/bootrom.h"
+#include "pico/stdlib.h"
+#include <stdio.h>
+
+namespace {
+// PIOのクロック（clk_sys / PIO_CLKDIV）と、そこから作るプログラム
+constexpr uint32_t CLK_SYS_HZ = 125'000'000;
+constexpr uint32_t PIO_CLKDIV = 5;
+constexpr JoyBusPioTiming PIO_TIMING = joybus_pio_timing(CLK_SYS_HZ, PIO_CLKDIV);
+constexpr JoyBusPioCode TX_CODE = joybus_pio_gen_tx(PIO_TIMING);
+constexpr JoyBusPioCode RX_CODE = joybus_pio_gen_rx(PIO_TIMING);
+static_assert(TX_CODE.error == nullptr, "TX program cannot be generated for PIO_TIMING");
+static_assert(RX_CODE.error == nullptr, "RX program cannot be generated for PIO_TIMING");
+
+// 1回にやりとりするフレーム数と乱数の種
+constexpr uint32_t FRAMES_PER_ROUND = 1000;
+constexpr uint32_t SEED = 1;
+// 送信の完了から受信の完了までの猶予（1ビット周期）
+constexpr uint32_t BIT_PERIOD_US = 5;
+// 送信の完了を待つ上限（最長の16バイトでも約0.7ms）
+constexpr uint32_t FRAME_TIMEOUT_US = 2000;
+
+// 通電確認用のオンボードLED
+constexpr uint ONBOARD_LED_PIN = PICO_DEFAULT_LED_PIN;
+// BOOTSELに入るためのボタン入力
+constexpr uint BOOT_BTN_PIN = 26; // GP26
+// JoyBus
+constexpr uint TX_PIN = 15; // GP15
+constexpr uint RX_PIN = 16; // GP16
+
+// pio0: 送信、pio1: 受信
+constexpr uint SM_TX = 0; // pio0
+constexpr uint SM_RX = 0; // pio1
+// 受信プログラムがストップビットの欠けを知らせるIRQフラグ
+constexpr uint RX_STOP_ERROR_IRQ = 2;
+
+// pio_add_programが読むのはinstructionsとlengthとoriginだけ
+const pio_program_t TX_PROGRAM = {TX_CODE.instructions, (uint8_t)TX_CODE.length, -1};
+const pio_program_t RX_PROGRAM = {RX_CODE.instructions, (uint8_t)RX_CODE.length, -1};
+
+struct RoundStats {
+    uint32_t ok = 0;
+    uint32_t corrupted = 0;
+    uint32_t stop_errors = 0;
+    uint32_t short_frames = 0;
+};
+
+JoyBusTx joybus_tx;
+JoyBusTxFrame tx_frame; // TXのDMAが読むので、送信が終わるまで書き換えない
+JoyBusResync rx_resync;
+int rx_dma_channel = -1;
+dma_channel_config rx_dma_config{};
+uint32_t rx_words[JOYBUS_MAX_FRAME_BYTES]; // 1バイト = 24ビットのワード1つ
+
+void boot_btn_irq(uint gpio, uint32_t events) {
+    // ちょいデバウンス（押しっぱなし連打対策）
+    busy_wait_ms(100);
+    if (gpio_get(BOOT_BTN_PIN) == 0) {
+        printf("BOOTSEL button pressed. Entering USB boot mode...\n");
+        reset_usb_boot(0, 0);
+    }
+}
+
+void bootsel_button_init() {
+    gpio_init(BOOT_BTN_PIN);
+    gpio_set_dir(BOOT_BTN_PIN, GPIO_IN);
+    gpio_pull_up(BOOT_BTN_PIN);
+    gpio_set_irq_enabled_with_callback(BOOT_BTN_PIN, GPIO_IRQ_EDGE_FALL, true, &boot_btn_irq);
+}
+
+void init_bus_pins_safe() {
+    // バスへ接続するピンをHi-Zに設定
+    gpio_init(TX_PIN);
+    gpio_put(TX_PIN, 0);
+    gpio_set_dir(TX_PIN, GPIO_IN);
+
+    gpio_init(RX_PIN);
+    gpio_set_dir(RX_PIN, GPIO_IN);
+}
+
+void init_led() {
+    gpio_init(ONBOARD_LED_PIN);
+    gpio_set_dir(ONBOARD_LED_PIN, GPIO_OUT);
+    gpio_put(ONBOARD_LED_PIN, 1);
+}
+
+void loopback_init() {
+    const uint off_tx = pio_add_program(pio0, &TX_PROGRAM);
+    const uint off_rx = pio_add_program(pio1, &RX_PROGRAM);
+
+    // .pio.hのget_default_configの代わりにwrapだけ設定する
+    pio_sm_config c_tx = pio_get_default_sm_config();
+    sm_config_set_wrap(&c_tx, off_tx + TX_CODE.wrap_target, off_tx + TX_CODE.wrap);
+    sm_config_set_set_pins(&c_tx, TX_PIN, 1);
+    sm_config_set_out_shift(&c_tx,
+                            /*shift_right=*/false,
+                            /*autopull=*/true,
+                            /*pull_thresh=*/32);
+
+    pio_sm_config c_rx = pio_get_default_sm_config();
+    sm_config_set_wrap(&c_rx, off_rx + RX_CODE.wrap_target, off_rx + RX_CODE.wrap);
+    sm_config_set_in_pins(&c_rx, RX_PIN);
+    sm_config_set_jmp_pin(&c_rx, RX_PIN);
+    // 3点でサンプリングするため3 * 8 = 24ビットずつ受信
+    sm_config_set_in_shift(&c_rx,
+                           /*shift_right=*/false,
+                           /*autopush=*/true,
+                           /*push_thresh=*/24);
+
+    // 整数分周なのでPIOの1サイクルの長さが揃う
+    sm_config_set_clkdiv_int_frac(&c_tx, PIO_CLKDIV, 0);
+    sm_config_set_clkdiv_int_frac(&c_rx, PIO_CLKDIV, 0);
+
+    pio_gpio_init(pio0, TX_PIN);
+    pio_gpio_init(pio1, RX_PIN);
+    gpio_pull_up(TX_PIN); // open-drainのHigh維持の補助（外付けがあるなら無くてもOK）
+    gpio_pull_up(RX_PIN); // 必須寄り
+    pio_sm_set_consecutive_pindirs(pio0, SM_TX, TX_PIN, 1, false);
+    pio_sm_set_pins_with_mask(pio0, SM_TX, 0u, 1u << TX_PIN);
+    pio_sm_set_consecutive_pindirs(pio1, SM_RX, RX_PIN, 1, false);
+    pio_sm_init(pio0, SM_TX, off_tx, &c_tx);
+    pio_sm_init(pio1, SM_RX, off_rx, &c_rx);
+
+    // 生成した送信プログラムもjoy_tx5と同じくirq 0で開始・irq 1で完了
+    joybus_tx_init(&joybus_tx, pio0, SM_TX);
+
+    // RX用DMA（24ビットのワードをそのままバッファへ）
+    rx_dma_channel = dma_claim_unused_channel(true);
+    rx_dma_config = dma_channel_get_default_config(rx_dma_channel);
+    channel_config_set_transfer_data_size(&rx_dma_config, DMA_SIZE_32);
+    channel_config_set_dreq(&rx_dma_config, pio_get_dreq(pio1, SM_RX, false));
+    channel_config_set_read_increment(&rx_dma_config, false);
+    channel_config_set_write_increment(&rx_dma_config, true);
+
+    // 生成した受信プログラムもjoy_rx5と同じく先頭でビット数をpullする
+    joybus_resync_init(&rx_resync, pio1, SM_RX, off_rx, RX_STOP_ERROR_IRQ);
+    // RXステートマシンを先に起動
+    pio_sm_set_enabled(pio1, SM_RX, true);
+    sleep_ms(200);                         // 安全のため少し待つ
+    pio_sm_set_enabled(pio0, SM_TX, true); // RXが受信待ち状態になってからTXを起動
+}
+
+void run_frame(uint32_t *random_state, RoundStats *stats) {
+    uint8_t data[JOYBUS_MAX_FRAME_BYTES];
+    joybus_frame_random(&tx_frame, data, random_state);
+    const uint32_t nbytes = tx_frame.nbytes;
+
+    dma_channel_set_config(rx_dma_channel, &rx_dma_config, false);
+    dma_channel_set_read_addr(rx_dma_channel, &pio1->rxf[SM_RX], false);
+    dma_channel_transfer_to_buffer_now(rx_dma_channel, rx_words, nbytes);
+    pio_sm_put(pio1, SM_RX, nbytes * 8 - 1);
+    joybus_tx_send(&joybus_tx, &tx_frame);
+
+    const uint32_t start_us = time_us_32();
+    while (!joybus_tx_ready(&joybus_tx) && time_us_32() - start_us <= FRAME_TIMEOUT_US) {
+        tight_loop_contents();
+    }
+    if (!joybus_tx_ready(&joybus_tx)) {
+        // 送り終わらなかったときは、次のフレームでtx_frameを書き換える前にTXのDMAを止める
+        dma_channel_abort(joybus_tx.dma_channel);
+    }
+    const uint32_t tx_done_us = time_us_32();
+    while (dma_channel_is_busy(rx_dma_channel) && time_us_32() - tx_done_us <= BIT_PERIOD_US) {
+        tight_loop_contents();
+    }
+    const uint32_t received = nbytes - dma_channel_hw_addr(rx_dma_channel)->transfer_count;
+    if (received < nbytes) {
+        // DMAは次のフレームで張り直す
+        dma_channel_abort(rx_dma_channel);
+        joybus_resync_sm(&rx_resync, received == 0 ? JoyBusDesync::Timeout : JoyBusDesync::Short);
+        ++stats->short_frames;
+        return;
+    }
+    // 1回だけならSMは自分で先頭に戻っている（続けて立てばjoybus_resyncがSMを戻す）
+    if (joybus_resync_check_stop_error(&rx_resync)) {
+        ++stats->stop_errors;
+        return;
+    }
+    for (uint32_t i = 0; i < nbytes; ++i) {
+        if (joybus_decode_3sample(rx_words[i]) != data[i]) {
+            ++stats->corrupted;
+            return;
+        }
+    }
+    ++stats->ok;
+}
+} // namespace
+
+int main() {
+    stdio_init_all();
+    bootsel_button_init();
+
+    // 動作開始の確認用にオンボードLEDを光らせる
+    init_led();
+
+    init_bus_pins_safe();
+
+    // 遅延はCLK_SYS_HZで数えてあるので、違うクロックで動いていたら始めない
+    if (clock_get_hz(clk_sys) != CLK_SYS_HZ) {
+        printf("Error: clk_sys is %luHz, programs were generated for %luHz\n",
+               (unsigned long)clock_get_hz(clk_sys), (unsigned long)CLK_SYS_HZ);
+        while (true) {
+            tight_loop_contents();
+        }
+    }
+    loopback_init();
+    printf("generated_pio ready (clkdiv=%lu, %lu cycles/bit, tx %lu + rx %lu instructions).\n",
+           (unsigned long)PIO_CLKDIV, (unsigned long)TX_CODE.bit_cycles,
+           (unsigned long)TX_CODE.length, (unsigned long)RX_CODE.length);
+
+    uint32_t random_state = SEED;
+    while (true) {
+        RoundStats stats;
+        for (uint32_t i = 0; i < FRAMES_PER_ROUND; ++i) {
+            run_frame(&random_state, &stats);
+        }
+        printf("frames=%lu ok=%lu corrupted=%lu stop=%lu short=%lu resync=%lu\n",
+               (unsigned long)FRAMES_PER_ROUND, (unsigned long)stats.ok,
+               (unsigned long)stats.corrupted, (unsigned long)stats.stop_errors,
+               (unsigned long)stats.short_frames, (unsigned long)rx_resync.stats.resyncs);
+        sleep_ms(1000);
+    }
+}
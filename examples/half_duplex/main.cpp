@@ -0,0 +1,163 @@
+// 1本のデータ線だけで本体側としてコントローラをポーリングする
+// joy_txrxが送信→ストップビット→線の開放→応答の受信までを1つのSMで続けて行うので、
+// TXとRXの2つのSMをirq 1で同期させる必要がなく、ポートあたりSM1つ・ピン1本で済む
+// 送信から受信への切り替えにCPUが関わらないので、応答の始まりが早いコントローラでも取りこぼさない
+//
+// 配線: DATA_PINをコントローラのデータ線につなぐ（3.3Vプルアップ）
+#include "hardware/pio.h"
+#include "joy_txrx.pio.h"
+#include "joybus_frame.h"
+#include "joybus_half_duplex.h"
+#include "pico/bootrom.h"
+#include "pico/stdlib.h"
+#include <stdio.h>
+
+namespace {
+// 通電確認用のオンボードLED
+constexpr uint ONBOARD_LED_PIN = PICO_DEFAULT_LED_PIN;
+// BOOTSELに入るためのボタン入力
+constexpr uint BOOT_BTN_PIN = 26; // GP26
+// JoyBusのデータ線（送受信とも）
+constexpr uint DATA_PIN = 15; // GP15
+
+// 本体からのコマンド
+constexpr uint8_t GC_CMD_IDENTIFY[] = {0x00};         // → 3バイト応答
+constexpr uint8_t GC_CMD_POLL[] = {0x40, 0x03, 0x00}; // → 8バイト応答
+constexpr uint32_t GC_IDENTIFY_REPLY_BYTES = 3;
+constexpr uint32_t GC_POLL_REPLY_BYTES = 8;
+
+// ポーリング間隔
+constexpr uint32_t POLL_INTERVAL_US = 10'000;
+// 送信開始から応答の終端までの待ち時間（ポーリングなら約0.5ms）
+constexpr uint32_t REPLY_TIMEOUT_US = 1000;
+
+JoyBusHalfDuplex joybus;
+
+void boot_btn_irq(uint gpio, uint32_t events) {
+    // ちょいデバウンス（押しっぱなし連打対策）
+    busy_wait_ms(100);
+    if (gpio_get(BOOT_BTN_PIN) == 0) {
+        printf("BOOTSEL button pressed. Entering USB boot mode...\n");
+        reset_usb_boot(0, 0);
+    }
+}
+
+void bootsel_button_init() {
+    gpio_init(BOOT_BTN_PIN);
+    gpio_set_dir(BOOT_BTN_PIN, GPIO_IN);
+    gpio_pull_up(BOOT_BTN_PIN);
+    gpio_set_irq_enabled_with_callback(BOOT_BTN_PIN, GPIO_IRQ_EDGE_FALL, true, &boot_btn_irq);
+}
+
+void init_bus_pins_safe() {
+    // バスへ接続するピンをHi-Zに設定
+    gpio_init(DATA_PIN);
+    gpio_put(DATA_PIN, 0);
+    gpio_set_dir(DATA_PIN, GPIO_IN);
+}
+
+void init_led() {
+    gpio_init(ONBOARD_LED_PIN);
+    gpio_set_dir(ONBOARD_LED_PIN, GPIO_OUT);
+    gpio_put(ONBOARD_LED_PIN, 1);
+}
+
+// 応答の終端（joy_txrxのirq set 0 rel）
+void __isr __not_in_flash_func(rx_pio_irq_handler)() { joybus_half_duplex_irq(&joybus); }
+
+void joybus_init(PIO pio, uint sm) {
+    const uint offset = pio_add_program(pio, &joy_txrx_program);
+    joybus_half_duplex_init(&joybus, pio, sm, offset, joy_txrx_program_get_default_config(offset),
+                            DATA_PIN, rx_pio_irq_handler);
+}
+
+enum class TransactionResult { Ok, Bad, Timeout };
+
+// コマンドを送り、応答の終端まで待つ
+// コマンドは最大でも3バイト（2ワード）なのでTX FIFOに収まり、DMAは使わない
+TransactionResult joybus_transaction(const JoyBusTxFrame *command, uint32_t *elapsed_us) {
+    joybus_half_duplex_arm_rx(&joybus);
+
+    const uint32_t start_us = time_us_32();
+    for (uint32_t i = 0; i < command->word_count; ++i) {
+        pio_sm_put_blocking(joybus.pio, joybus.sm, command->words[i]);
+    }
+    while (!joybus.ready && !joybus.bad) {
+        if (time_us_32() - start_us > REPLY_TIMEOUT_US) {
+            joybus_half_duplex_reset(&joybus);
+            return TransactionResult::Timeout;
+        }
+        tight_loop_contents();
+    }
+    *elapsed_us = time_us_32() - start_us;
+    return joybus.ready ? TransactionResult::Ok : TransactionResult::Bad;
+}
+} // namespace
+
+int main() {
+    stdio_init_all();
+    bootsel_button_init();
+
+    // 動作開始の確認用にオンボードLEDを光らせる
+    init_led();
+
+    init_bus_pins_safe();
+
+    joybus_init(pio0, 0);
+    printf("half_duplex ready (DATA=GP%u, joy_txrx len=%u).\n", DATA_PIN,
+           joy_txrx_program.length);
+
+    JoyBusTxFrame identify;
+    JoyBusTxFrame poll;
+    joybus_tx_frame_encode(&identify, GC_CMD_IDENTIFY, sizeof(GC_CMD_IDENTIFY));
+    joybus_tx_frame_encode(&poll, GC_CMD_POLL, sizeof(GC_CMD_POLL));
+
+    // コントローラが応答するまでidentifyを送り続ける
+    uint32_t elapsed_us = 0;
+    while (joybus_transaction(&identify, &elapsed_us) != TransactionResult::Ok ||
+           joybus.length != GC_IDENTIFY_REPLY_BYTES) {
+        sleep_ms(100);
+    }
+    printf("identify: %02X %02X %02X (%luus)\n", joybus.work[0], joybus.work[1], joybus.work[2],
+           (unsigned long)elapsed_us);
+
+    uint32_t ok = 0;
+    uint32_t bad = 0;
+    uint32_t timeout = 0;
+    uint32_t max_us = 0;
+    uint32_t last_report_ms = 0;
+    absolute_time_t next_poll = get_absolute_time();
+    while (true) {
+        sleep_until(next_poll);
+        next_poll = delayed_by_us(next_poll, POLL_INTERVAL_US);
+
+        switch (joybus_transaction(&poll, &elapsed_us)) {
+        case TransactionResult::Ok:
+            if (joybus.length == GC_POLL_REPLY_BYTES) {
+                ++ok;
+                max_us = elapsed_us > max_us ? elapsed_us : max_us;
+            } else {
+                ++bad;
+            }
+            break;
+        case TransactionResult::Bad:
+            ++bad;
+            break;
+        case TransactionResult::Timeout:
+            ++timeout;
+            break;
+        }
+
+        const uint32_t now_ms = to_ms_since_boot(get_absolute_time());
+        if (now_ms - last_report_ms >= 1000) {
+            last_report_ms = now_ms;
+            printf("ok=%lu bad=%lu timeout=%lu max=%luus last:", (unsigned long)ok,
+                   (unsigned long)bad, (unsigned long)timeout, (unsigned long)max_us);
+            for (uint32_t i = 0; i < GC_POLL_REPLY_BYTES; ++i) {
+                printf(" %02X", joybus.work[i]);
+            }
+            printf("\n");
+            max_us = 0;
+        }
+    }
+}
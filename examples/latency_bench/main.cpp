@@ -0,0 +1,284 @@
+// 本体側としてコントローラをポーリングし続け、1回のやりとりの中の3つの区間の遅れを
+// 数十万回分のヒストグラムにしてバイナリダンプで書き出す
+//   tx_arm   → first_edge : 送信の開始を指示してからコマンドの最初の立ち下がりまで
+//   stop_bit → reply_edge : コマンドのストップビットの終わりから応答の最初の立ち下がりまで
+//   last_bit → cpu_notify : 応答のストップビットの終わりからフレーム終端の割り込みハンドラまで
+// 送受信はhalf_duplexと同じjoy_txrx（pio0）で行い、時間はpio1の空いているSMで
+// joy_stamp.pioが同じデータ線を見ながらclk_sys単位で数える（CPUの割り込みやprintfに左右されない）
+// ダンプ（lib/joybus/include/joybus_latency.h）はhost/latency_plotで読んでグラフ用のCSVにする
+//
+// 配線: DATA_PINをコントローラ（またはcontroller_emuを書いたもう1枚のPico）のデータ線につなぐ
+#include "hardware/clocks.h"
+#include "hardware/pio.h"
+#include "joy_stamp.pio.h"
+#include "joy_txrx.pio.h"
+#include "joybus_frame.h"
+#include "joybus_half_duplex.h"
+#include "joybus_latency.h"
+#include "pico/bootrom.h"
+#include "pico/stdlib.h"
+#include <stdio.h>
+
+namespace {
+// 通電確認用のオンボードLED
+constexpr uint ONBOARD_LED_PIN = PICO_DEFAULT_LED_PIN;
+// BOOTSELに入るためのボタン入力
+constexpr uint BOOT_BTN_PIN = 26; // GP26
+// JoyBusのデータ線（送受信・時間の計測とも）
+constexpr uint DATA_PIN = 15; // GP15
+
+// pio0: 送受信（joy_txrx）
+// pio1: 時間の計測（joy_stampは31命令あるので1ブロックを占める）
+constexpr uint SM_TXRX = 0;  // pio0
+constexpr uint SM_STAMP = 0; // pio1
+
+// 本体からのコマンド
+constexpr uint8_t GC_CMD_IDENTIFY[] = {0x00};         // → 3バイト応答
+constexpr uint8_t GC_CMD_POLL[] = {0x40, 0x03, 0x00}; // → 8バイト応答
+constexpr uint32_t GC_IDENTIFY_REPLY_BYTES = 3;
+constexpr uint32_t GC_POLL_REPLY_BYTES = 8;
+
+// 1回のダンプにまとめるやりとりの数と、その間隔（20万回×1msで約200秒）
+constexpr uint32_t BENCH_TRANSACTIONS = 200'000;
+constexpr uint32_t POLL_INTERVAL_US = 1000;
+constexpr uint32_t PROGRESS_EVERY = 20'000;
+// 送信開始から応答の終端までの待ち時間（ポーリングなら約0.5ms）
+constexpr uint32_t REPLY_TIMEOUT_US = 1000;
+// 割り込みハンドラの通知からjoy_stampが最後の区間をpushするまでの待ち時間
+constexpr uint32_t STAMP_TIMEOUT_US = 20;
+
+// joy_stamp.pioのループ1回あたりのサイクル数（区間ごと）
+constexpr uint32_t STAMP_CYCLES_PER_COUNT[JOYBUS_LATENCY_INTERVALS] = {2, 2, 3};
+// ヒストグラムの1ビンの幅（125MHzで64ns、512ビンで約33usまで）
+constexpr uint32_t HISTOGRAM_BIN_CYCLES = 8;
+
+JoyBusHalfDuplex joybus;
+uint stamp_offset = 0;
+
+// 6KB強あるのでスタックではなく静的に置く
+JoyBusLatencyDump dump;
+
+void boot_btn_irq(uint gpio, uint32_t events) {
+    // ちょいデバウンス（押しっぱなし連打対策）
+    busy_wait_ms(100);
+    if (gpio_get(BOOT_BTN_PIN) == 0) {
+        printf("BOOTSEL button pressed. Entering USB boot mode...\n");
+        reset_usb_boot(0, 0);
+    }
+}
+
+void bootsel_button_init() {
+    gpio_init(BOOT_BTN_PIN);
+    gpio_set_dir(BOOT_BTN_PIN, GPIO_IN);
+    gpio_pull_up(BOOT_BTN_PIN);
+    gpio_set_irq_enabled_with_callback(BOOT_BTN_PIN, GPIO_IRQ_EDGE_FALL, true, &boot_btn_irq);
+}
+
+void init_bus_pins_safe() {
+    // バスへ接続するピンをHi-Zに設定
+    gpio_init(DATA_PIN);
+    gpio_put(DATA_PIN, 0);
+    gpio_set_dir(DATA_PIN, GPIO_IN);
+}
+
+void init_led() {
+    gpio_init(ONBOARD_LED_PIN);
+    gpio_set_dir(ONBOARD_LED_PIN, GPIO_OUT);
+    gpio_put(ONBOARD_LED_PIN, 1);
+}
+
+// 応答の終端（joy_txrxのirq set 0 rel）
+void __isr __not_in_flash_func(rx_pio_irq_handler)() {
+    if (!joybus_half_duplex_frame_end(&joybus)) {
+        return;
+    }
+    // 最初にjoy_stampへ通知が届いたことを知らせる（word4、ここまでが最後の区間）
+    pio1->txf[SM_STAMP] = 0;
+    joybus_half_duplex_finish_rx(&joybus);
+}
+
+void joybus_init() {
+    const uint offset = pio_add_program(pio0, &joy_txrx_program);
+    joybus_half_duplex_init(&joybus, pio0, SM_TXRX, offset,
+                            joy_txrx_program_get_default_config(offset), DATA_PIN,
+                            rx_pio_irq_handler);
+}
+
+void stamp_init() {
+    stamp_offset = pio_add_program(pio1, &joy_stamp_program);
+
+    pio_sm_config c = joy_stamp_program_get_default_config(stamp_offset);
+    // データ線は読むだけ（pio_gpio_initしなくてもPIOの入力には見える）
+    sm_config_set_in_pins(&c, DATA_PIN);
+    sm_config_set_jmp_pin(&c, DATA_PIN);
+    sm_config_set_in_shift(&c,
+                           /*shift_right=*/false,
+                           /*autopush=*/true,
+                           /*push_thresh=*/32);
+    // mov y, statusはTX FIFOが空の間だけ全ビット1（割り込みハンドラの通知を待つ）
+    sm_config_set_mov_status(&c, STATUS_TX_LESSTHAN, 1);
+    sm_config_set_clkdiv(&c, 1.0f); // clk_sysで数える
+    pio_sm_init(pio1, SM_STAMP, stamp_offset, &c);
+    pio_sm_set_enabled(pio1, SM_STAMP, true);
+}
+
+// 区間の途中で止まったjoy_stampを先頭（word1待ち）からやり直す
+void stamp_reset() {
+    pio_sm_set_enabled(pio1, SM_STAMP, false);
+    pio_sm_clear_fifos(pio1, SM_STAMP);
+    pio_sm_restart(pio1, SM_STAMP);
+    pio_sm_exec(pio1, SM_STAMP, pio_encode_jmp(stamp_offset));
+    pio_sm_set_enabled(pio1, SM_STAMP, true);
+}
+
+enum class TransactionResult { Ok, Bad, Timeout };
+
+// コマンドを送り、応答の終端まで待つ
+// Okならcycles[]に3つの区間のサイクル数を入れる（joy_stampがpushし終えるまで待つ）
+TransactionResult bench_transaction(const JoyBusTxFrame *command, uint32_t reply_bytes,
+                                    uint32_t cycles[JOYBUS_LATENCY_INTERVALS]) {
+    joybus_half_duplex_arm_rx(&joybus);
+
+    // word1（コマンドのビット数-1）は先に渡し、joy_stampをword2待ちにしておく
+    pio_sm_put(pio1, SM_STAMP, command->nbytes * 8);
+
+    const uint32_t start_us = time_us_32();
+    // word2の直後に送信を指示し、word3（応答のビット数-1）も続けて渡す
+    // コマンドは最大でも3バイト（2ワード）なのでTX FIFOに収まり、DMAは使わない
+    pio_sm_put(pio1, SM_STAMP, 0);
+    for (uint32_t i = 0; i < command->word_count; ++i) {
+        pio_sm_put(pio0, SM_TXRX, command->words[i]);
+    }
+    pio_sm_put(pio1, SM_STAMP, reply_bytes * 8);
+
+    while (!joybus.ready && !joybus.bad) {
+        if (time_us_32() - start_us > REPLY_TIMEOUT_US) {
+            joybus_half_duplex_reset(&joybus);
+            stamp_reset();
+            return TransactionResult::Timeout;
+        }
+        tight_loop_contents();
+    }
+    if (joybus.bad || joybus.length != reply_bytes) {
+        // 応答のビット数が違うとjoy_stampは数え終わらずに止まっている
+        stamp_reset();
+        return TransactionResult::Bad;
+    }
+
+    const uint32_t stamp_start_us = time_us_32();
+    while (pio_sm_get_rx_fifo_level(pio1, SM_STAMP) < JOYBUS_LATENCY_INTERVALS) {
+        if (time_us_32() - stamp_start_us > STAMP_TIMEOUT_US) {
+            stamp_reset();
+            return TransactionResult::Bad;
+        }
+        tight_loop_contents();
+    }
+    for (uint32_t i = 0; i < JOYBUS_LATENCY_INTERVALS; ++i) {
+        // xは~0から減っていくので、反転すると数えた回数になる
+        cycles[i] = ~pio_sm_get(pio1, SM_STAMP) * STAMP_CYCLES_PER_COUNT[i];
+    }
+    return TransactionResult::Ok;
+}
+
+void dump_reset() {
+    dump.magic = JOYBUS_LATENCY_MAGIC;
+    dump.version = JOYBUS_LATENCY_VERSION;
+    dump.clk_hz = clock_get_hz(clk_sys);
+    dump.transactions = 0;
+    dump.timeouts = 0;
+    dump.errors = 0;
+    for (JoyBusLatencyHistogram &h : dump.histograms) {
+        joybus_latency_reset(&h, HISTOGRAM_BIN_CYCLES);
+    }
+}
+
+void print_summary() {
+    const float cycles_per_us = dump.clk_hz / 1e6f;
+    printf("%lu transactions, timeout=%lu error=%lu\n", (unsigned long)dump.transactions,
+           (unsigned long)dump.timeouts, (unsigned long)dump.errors);
+    for (uint32_t i = 0; i < JOYBUS_LATENCY_INTERVALS; ++i) {
+        const JoyBusLatencyHistogram &h = dump.histograms[i];
+        if (h.count == 0) {
+            continue;
+        }
+        printf("  %-24s min=%.3fus median=%.3fus p99=%.3fus max=%.3fus\n",
+               joybus_latency_interval_name(i), h.min / cycles_per_us,
+               joybus_latency_percentile(h, 500) / cycles_per_us,
+               joybus_latency_percentile(h, 990) / cycles_per_us, h.max / cycles_per_us);
+    }
+}
+
+// "#LATENCY <バイト数>"の行に続けて構造体をそのまま送る（CRLF変換を通さない）
+void write_dump() {
+    dump.checksum = joybus_latency_checksum(dump);
+    printf("#LATENCY %u\n", (unsigned)sizeof(dump));
+    stdio_flush();
+    const uint8_t *bytes = (const uint8_t *)&dump;
+    for (size_t i = 0; i < sizeof(dump); ++i) {
+        putchar_raw(bytes[i]);
+    }
+    stdio_flush();
+    printf("\n");
+}
+} // namespace
+
+int main() {
+    stdio_init_all();
+    bootsel_button_init();
+
+    // 動作開始の確認用にオンボードLEDを光らせる
+    init_led();
+
+    init_bus_pins_safe();
+
+    joybus_init();
+    stamp_init();
+    printf("latency_bench ready (DATA=GP%u, joy_txrx len=%u, joy_stamp len=%u).\n", DATA_PIN,
+           joy_txrx_program.length, joy_stamp_program.length);
+
+    JoyBusTxFrame identify;
+    JoyBusTxFrame poll;
+    joybus_tx_frame_encode(&identify, GC_CMD_IDENTIFY, sizeof(GC_CMD_IDENTIFY));
+    joybus_tx_frame_encode(&poll, GC_CMD_POLL, sizeof(GC_CMD_POLL));
+
+    // コントローラが応答するまでidentifyを送り続ける
+    uint32_t cycles[JOYBUS_LATENCY_INTERVALS];
+    while (bench_transaction(&identify, GC_IDENTIFY_REPLY_BYTES, cycles) !=
+           TransactionResult::Ok) {
+        sleep_ms(100);
+    }
+    printf("identify: %02X %02X %02X\n", joybus.work[0], joybus.work[1], joybus.work[2]);
+
+    while (true) {
+        dump_reset();
+        absolute_time_t next_poll = get_absolute_time();
+        for (uint32_t n = 1; n <= BENCH_TRANSACTIONS; ++n) {
+            sleep_until(next_poll);
+            next_poll = delayed_by_us(next_poll, POLL_INTERVAL_US);
+
+            switch (bench_transaction(&poll, GC_POLL_REPLY_BYTES, cycles)) {
+            case TransactionResult::Ok:
+                ++dump.transactions;
+                for (uint32_t i = 0; i < JOYBUS_LATENCY_INTERVALS; ++i) {
+                    joybus_latency_add(&dump.histograms[i], cycles[i]);
+                }
+                break;
+            case TransactionResult::Bad:
+                ++dump.errors;
+                break;
+            case TransactionResult::Timeout:
+                ++dump.timeouts;
+                break;
+            }
+
+            // 途中経過はやりとりの合間に出す（printfの待ちは次の間隔の中に収まる）
+            if (n % PROGRESS_EVERY == 0) {
+                printf("[%lu/%lu] ", (unsigned long)n, (unsigned long)BENCH_TRANSACTIONS);
+                print_summary();
+                next_poll = get_absolute_time();
+            }
+        }
+        print_summary();
+        write_dump();
+    }
+}
@@ -0,0 +1,655 @@
+// 1台のPicoで4ポート分のJoyBusを同時に扱う
+// PIOの8つのSMをすべて使い、プログラムはPIOごとに1回だけ読み込む
+//   pio0: 全ポートのTX（rel指定のjoy_tx5、SM n = ポートn）
+//   pio1: 全ポートのRX（joy_rx5、SM n = ポートn、irq nがフレーム終端）
+// DMAチャンネルはポートごとにTX用・RX用を1つずつ確保する（4ポートで8チャンネル）
+//
+// ポーリングは全ポートを同じPIOサイクルで送り始める（ALIGNED_POLL）
+//   - TXの4つのSMはpio_enable_sm_mask_in_syncでクロック分周の位相までそろえて起動しておく
+//   - 4ポート分のDMAをdma_start_channel_maskで同時に起動し、TX FIFOに積み終わってから
+//     irq_forceへの1回の書き込みで4つの開始フラグを同時に立てる
+//   - 応答は各ポートのDMAが受け取り、フレーム終端の割り込みでポートごとの時刻を記録する
+// 受信はポートごとにRX_SLOT_COUNT個の枠を持ち、DMAが枠へ直接書き込む
+//   割り込みハンドラは長さと時刻を記録して通し番号を進め、次の枠で受信を再開するだけ
+//   （受信データはコピーしない）。メインループは番号で枠を読み、読み終えたときに
+//   割り込みハンドラに追い越されていなければその内容を使う
+// 1周の時間がポート数に比例せず、1回のやりとり分で全ポートを読める
+// ALIGNED_POLLをfalseにすると1ポートずつ順番に送って応答を待つ（比較用）
+//
+// ビットレートはポートごとに自動で合わせる（AUTO_BIT_RATE）
+//   joy_tx5/joy_rx5は1ビット20 PIOサイクルで書いてあり、分周比だけで何us/bitにも合わせられる
+//   （4us/bitの相手にjoy_tx4/joy_rx4を別に用意しなくてよい）
+//   起動時にRXのSMを一時的にjoy_edgeへ差し替えてidentifyを送り、自分のコマンドの後に続く
+//   応答のビット周期を測ってから、そのポートのRXの分周比を計算し直す
+//   TXはプロトコルのコマンドの速さ（5us/bit）のまま変えない
+//   応答が続けて取れなくなったポートは相手が替わったとみなして測り直す
+//
+// ログはjoybus_log（リング+DMAのstdioドライバ）で出すので、毎秒の集計のprintfで
+// 次のポーリングが遅れない（UARTが追いつかない分は捨てて数える）
+//
+// 配線: ポートごとにTXとRXの2ピンをつなぐ（ループバック、3.3Vプルアップ）
+// 各ポートで自分の送ったフレームがそのまま受信できたかと、ポート間の受信時刻のずれを表示する
+// ループバックだけのポートには応答がないので、ビットレートは測れず公称のまま動く
+// 測定を試すときはそのポートの線に速さの違う相手（4us/bitで応答するexamples/controller_emuなど）を
+// つなぐ（ホストではpio_sim bitrateで同じ手順を確かめられる）
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/pio.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+#include "joy_edge.pio.h"
+#include "joy_rx5.pio.h"
+#include "joy_tx5.pio.h"
+#include "joybus_edge.h"
+#include "joybus_log.h"
+#include "joybus_tx.h"
+#include "pico/bootrom.h"
+#include "pico/stdlib.h"
+#include <stdio.h>
+
+namespace {
+constexpr size_t RX_BUFFER_SIZE = JOYBUS_MAX_FRAME_BYTES + 1; // ストップビット分も確保
+
+// 通電確認用のオンボードLED
+constexpr uint ONBOARD_LED_PIN = PICO_DEFAULT_LED_PIN;
+// BOOTSELに入るためのボタン入力
+constexpr uint BOOT_BTN_PIN = 26; // GP26
+
+// ポート数（1つのPIOのSM数と同じ）
+constexpr uint NUM_PORTS = 4;
+
+struct PortPins {
+    uint tx;
+    uint rx;
+};
+// ポート0は他のexampleと同じGP15/GP16、以降は2本ずつ
+constexpr PortPins PORT_PINS[NUM_PORTS] = {{15, 16}, {17, 18}, {19, 20}, {21, 22}};
+
+// ポートごとの受信枠の数（2のべき乗）
+constexpr uint32_t RX_SLOT_COUNT = 4;
+
+// 送信の完了通知に使うIRQフラグの先頭（joy_tx5の irq set 4 rel）
+constexpr uint TX_DONE_IRQ_BASE = 4;
+
+// trueなら全ポート同時、falseなら1ポートずつ順番にポーリングする
+constexpr bool ALIGNED_POLL = true;
+
+// trueなら起動時と応答が続けて取れなくなったときにポートごとのビットレートを測り直す
+constexpr bool AUTO_BIT_RATE = true;
+// joy_tx5/joy_rx5の1ビットあたりのPIOサイクル数（4MHzで5us）
+constexpr uint32_t PIO_CYCLES_PER_BIT = 20;
+// 測る前のビット周期（5us/bit）
+constexpr uint32_t NOMINAL_BIT_PERIOD_NS = 5000;
+// ビットレートの測定でjoy_edgeに渡す上限（us）。これより長いHighでフレーム終端とみなす
+constexpr uint32_t EDGE_LIMIT_US = 8;
+// 続けてこの回数だけ応答が取れなかったポートは測り直す
+constexpr uint32_t RETUNE_AFTER_FAILURES = 8;
+
+// 送信間隔（実機のポーリング間隔より少し短め）
+constexpr uint32_t POLL_INTERVAL_US = 10'000;
+// 送ってから全ポートの受信を待つ時間
+constexpr uint32_t RX_TIMEOUT_US = 2000;
+
+// 受信フレームの枠（DMAが直接書き込む）
+struct RxSlot {
+    uint8_t data[RX_BUFFER_SIZE] = {0}; // 受信データ（ストップビット分も確保）
+    volatile uint32_t length = 0;       // ストップビットを除いた長さ（不正なフレームは0）
+    volatile uint32_t end_us = 0;       // フレームの終端を検出した時刻
+};
+
+struct JoyBusPort {
+    uint index = 0;
+    JoyBusTx tx;
+    int rx_dma_channel = -1;
+    dma_channel_config rx_dma_config{};
+    RxSlot slot[RX_SLOT_COUNT];
+    // 受信し終えたフレームの数（割り込みハンドラだけが進める）
+    // DMAは常に slot[rx_seq % RX_SLOT_COUNT] に書いている
+    volatile uint32_t rx_seq = 0;
+    uint32_t read_seq = 0;          // 次に読むフレームの番号（メインループだけが進める）
+    volatile uint32_t start_us = 0; // このポートの送信を開始した時刻
+
+    // この周の受信結果（全ポートそろったときだけ時刻を集計する）
+    bool round_ok = false;
+    uint32_t round_end_us = 0;
+
+    // 集計
+    uint32_t ok = 0;
+    uint32_t mismatch = 0;
+    uint32_t bad_frames = 0;
+    uint32_t timeout = 0;
+    uint32_t overrun = 0; // 読む前に上書きされたフレーム
+
+    // 検出した応答のビット周期（RXの分周比はこれから決める）
+    uint32_t bit_period_ns = NOMINAL_BIT_PERIOD_NS;
+    uint32_t failures = 0; // 続けて応答が取れなかった回数
+    uint32_t retunes = 0;  // 測り直した回数
+};
+
+struct JoyBusPorts {
+    PIO pio_tx = nullptr;
+    PIO pio_rx = nullptr;
+    uint off_tx = 0;
+    uint off_rx = 0;
+    uint off_edge = 0; // ビットレートの測定中だけRXのSMで使う
+    JoyBusPort port[NUM_PORTS];
+};
+
+JoyBusPorts ports;
+
+void boot_btn_irq(uint gpio, uint32_t events) {
+    // ちょいデバウンス（押しっぱなし連打対策）
+    busy_wait_ms(100);
+    if (gpio_get(BOOT_BTN_PIN) == 0) {
+        printf("BOOTSEL button pressed. Entering USB boot mode...\n");
+        reset_usb_boot(0, 0);
+    }
+}
+
+void bootsel_button_init() {
+    gpio_init(BOOT_BTN_PIN);
+    gpio_set_dir(BOOT_BTN_PIN, GPIO_IN);
+    gpio_pull_up(BOOT_BTN_PIN);
+    gpio_set_irq_enabled_with_callback(BOOT_BTN_PIN, GPIO_IRQ_EDGE_FALL, true, &boot_btn_irq);
+}
+
+void init_bus_pins_safe() {
+    // バスへ接続するピンをHi-Zに設定
+    for (const PortPins &pins : PORT_PINS) {
+        gpio_init(pins.tx);
+        gpio_put(pins.tx, 0);
+        gpio_set_dir(pins.tx, GPIO_IN);
+
+        gpio_init(pins.rx);
+        gpio_set_dir(pins.rx, GPIO_IN);
+    }
+}
+
+void init_led() {
+    gpio_init(ONBOARD_LED_PIN);
+    gpio_set_dir(ONBOARD_LED_PIN, GPIO_OUT);
+    gpio_put(ONBOARD_LED_PIN, 1);
+}
+
+// 空いている命令メモリのうち、連続して確保できる最大の長さ
+// pio_can_add_programに長さを変えたnopだけのプログラムを渡して調べる
+uint pio_largest_free_block(PIO pio) {
+    static uint16_t nops[PIO_INSTRUCTION_COUNT];
+    for (uint16_t &instr : nops) {
+        instr = pio_encode_nop();
+    }
+    for (uint length = PIO_INSTRUCTION_COUNT; length > 0; --length) {
+        const pio_program_t probe = {nops, (uint8_t)length, -1};
+        if (pio_can_add_program(pio, &probe)) {
+            return length;
+        }
+    }
+    return 0;
+}
+
+// プログラムを読み込めるか確かめてから読み込み、残りの命令メモリを表示する
+bool add_program_checked(PIO pio, const pio_program_t *program, const char *name, uint *offset) {
+    if (!pio_can_add_program(pio, program)) {
+        printf("Error: pio%u has no room for %s (%u instructions, largest free block %u)\n",
+               pio_get_index(pio), name, program->length, pio_largest_free_block(pio));
+        return false;
+    }
+    *offset = pio_add_program(pio, program);
+    printf("pio%u: %s len=%u at %u, largest free block %u\n", pio_get_index(pio), name,
+           program->length, *offset, pio_largest_free_block(pio));
+    return true;
+}
+
+// 次の枠（rx_seqの番号の枠）へ受信を始める
+void __not_in_flash_func(port_start_receive)(JoyBusPort *port) {
+    const uint sm = port->index;
+    uint8_t *dst = port->slot[port->rx_seq & (RX_SLOT_COUNT - 1)].data;
+    dma_channel_abort(port->rx_dma_channel);
+    dma_channel_set_config(port->rx_dma_channel, &port->rx_dma_config, false);
+    dma_channel_set_read_addr(port->rx_dma_channel, &ports.pio_rx->rxf[sm], false);
+    dma_channel_set_write_addr(port->rx_dma_channel, dst, false);
+    dma_channel_transfer_to_buffer_now(port->rx_dma_channel, dst, RX_BUFFER_SIZE);
+}
+
+// 受信し終えた枠に長さと時刻を書いて番号を進める（データはDMAが書いたまま）
+void __not_in_flash_func(port_finish_receive_from_irq)(JoyBusPort *port, uint32_t now_us) {
+    dma_channel_hw_t *dma = dma_channel_hw_addr(port->rx_dma_channel);
+    const uint32_t count = RX_BUFFER_SIZE - dma->transfer_count;
+    dma_channel_abort(port->rx_dma_channel);
+
+    const uint32_t seq = port->rx_seq;
+    RxSlot &slot = port->slot[seq & (RX_SLOT_COUNT - 1)];
+    // 2バイト以上受信+最後のバイトがストップビット(0x01)
+    slot.length = (count >= 2 && slot.data[count - 1] == 0x01) ? count - 1 : 0;
+    slot.end_us = now_us;
+    port->rx_seq = seq + 1;
+}
+
+// 次に読むフレームの枠を返す（まだ届いていなければnullptr）
+// 割り込みハンドラに追い越されて上書きされた分は読み飛ばしてoverrunに数える
+const RxSlot *port_peek_frame(JoyBusPort *port) {
+    const uint32_t rx_seq = port->rx_seq;
+    if (rx_seq - port->read_seq >= RX_SLOT_COUNT) {
+        port->overrun += rx_seq - port->read_seq - (RX_SLOT_COUNT - 1);
+        port->read_seq = rx_seq - (RX_SLOT_COUNT - 1);
+    }
+    if (port->read_seq == rx_seq) {
+        return nullptr;
+    }
+    return &port->slot[port->read_seq & (RX_SLOT_COUNT - 1)];
+}
+
+// 読み終えた枠を返す
+// 読んでいる間にDMAがその枠へ書き始めていたらfalse（読んだ内容は使えない）
+bool port_release_frame(JoyBusPort *port) {
+    // 枠の中身を読み終えてから番号を確かめる
+    __compiler_memory_barrier();
+    const bool intact = port->rx_seq - port->read_seq < RX_SLOT_COUNT;
+    ++port->read_seq;
+    return intact;
+}
+
+// まだ読んでいないフレームを捨てる
+void port_discard_frames(JoyBusPort *port) { port->read_seq = port->rx_seq; }
+
+// pio1のirq 0〜3（SMごとのフレーム終端）をまとめて処理する
+// 同時に終わったポートには同じ時刻を付ける（ずれは割り込みの処理順に影響されない）
+void __isr __not_in_flash_func(rx_pio_irq_handler)() {
+    const uint32_t now_us = timer_hw->timerawl;
+    const uint32_t flags = ports.pio_rx->irq & ((1u << NUM_PORTS) - 1);
+    for (uint i = 0; i < NUM_PORTS; ++i) {
+        if (flags & (1u << i)) {
+            pio_interrupt_clear(ports.pio_rx, i);
+            port_finish_receive_from_irq(&ports.port[i], now_us);
+            port_start_receive(&ports.port[i]);
+        }
+    }
+}
+
+// ビット周期からjoy_tx5/joy_rx5の分周比を求める（どちらも1ビット = PIO_CYCLES_PER_BIT）
+float clkdiv_for_bit_period(uint32_t period_ns) {
+    return (float)clock_get_hz(clk_sys) * (float)period_ns / (1e9f * PIO_CYCLES_PER_BIT);
+}
+
+// ポートiのRXのSMをjoy_rx5で初期化する（起動はしない）
+void rx_sm_init(uint i, float div) {
+    const PortPins &pins = PORT_PINS[i];
+    pio_sm_config c_rx = joy_rx5_program_get_default_config(ports.off_rx);
+    sm_config_set_in_pins(&c_rx, pins.rx);
+    sm_config_set_in_shift(&c_rx,
+                           /*shift_right=*/false,
+                           /*autopush=*/true,
+                           /*push_thresh=*/8);
+    sm_config_set_jmp_pin(&c_rx, pins.rx);
+    sm_config_set_clkdiv(&c_rx, div);
+    pio_sm_init(ports.pio_rx, i, ports.off_rx, &c_rx);
+}
+
+// RXのSMを一時的にjoy_edgeへ差し替えてidentifyを送り、応答のビット周期を測る
+// RXにはまず自分のidentifyが聞こえるので、そのビット数分のワードを飛ばした後のフレームを測る
+// 測れたらそのポートのRXの分周比を計算し直す（測れなければ今の設定のまま）
+// joy_rx5に戻して受信を再開してから返る
+bool port_measure_bit_rate(JoyBusPort *port, const JoyBusTxFrame *identify) {
+    const uint sm = port->index;
+    PIO pio = ports.pio_rx;
+    const uint32_t clk_hz = clock_get_hz(clk_sys);
+    const uint32_t counts_per_us = clk_hz / 2'000'000; // joy_edgeは1カウント2サイクル
+    const uint32_t limit = EDGE_LIMIT_US * counts_per_us;
+
+    // フレーム終端の割り込みで受信が再開されないように、割り込みを止めてからSMとDMAを止める
+    const pio_interrupt_source_t source = (pio_interrupt_source_t)(pis_interrupt0 + sm);
+    pio_set_irq0_source_enabled(pio, source, false);
+    pio_sm_set_enabled(pio, sm, false);
+    dma_channel_abort(port->rx_dma_channel);
+    pio_interrupt_clear(pio, sm);
+
+    // 分解能を上げるため分周しない（125MHzで1カウント16ns）
+    pio_sm_config c = joy_edge_program_get_default_config(ports.off_edge);
+    sm_config_set_in_pins(&c, PORT_PINS[sm].rx);
+    sm_config_set_jmp_pin(&c, PORT_PINS[sm].rx);
+    sm_config_set_in_shift(&c,
+                           /*shift_right=*/false,
+                           /*autopush=*/true,
+                           /*push_thresh=*/32);
+    sm_config_set_clkdiv(&c, 1.0f);
+    pio_sm_init(pio, sm, ports.off_edge, &c);
+    // 上限カウントをyに設定してから起動
+    pio_sm_put_blocking(pio, sm, limit);
+    pio_sm_exec(pio, sm, pio_encode_pull(false, true));
+    pio_sm_exec(pio, sm, pio_encode_mov(pio_y, pio_osr));
+    pio_sm_set_enabled(pio, sm, true);
+
+    joybus_tx_send(&port->tx, identify);
+
+    // 1ワードは1ビット（数us）ごとに届くのでCPUがRX FIFOから直接読んでも間に合う
+    // 先頭のreply_offsetワードは自分のidentifyなので、その後ろの最初のフレーム終端まで集める
+    const size_t reply_offset = joybus_edge_reply_offset(identify->nbytes);
+    uint32_t words[JOYBUS_EDGE_MAX_WORDS * 2];
+    size_t count = 0;
+    bool complete = false;
+    const absolute_time_t start_time = get_absolute_time();
+    while (!complete && absolute_time_diff_us(start_time, get_absolute_time()) <= RX_TIMEOUT_US) {
+        if (pio_sm_is_rx_fifo_empty(pio, sm)) {
+            tight_loop_contents();
+            continue;
+        }
+        const uint32_t word = pio_sm_get(pio, sm);
+        if (count < reply_offset + JOYBUS_EDGE_MAX_WORDS) {
+            words[count++] = word;
+        }
+        complete = count > reply_offset && joybus_edge_is_frame_end(word);
+    }
+    pio_sm_set_enabled(pio, sm, false);
+
+    uint32_t period_ns = 0;
+    if (complete) {
+        JoyBusEdgeDecoder decoder;
+        joybus_edge_decoder_init(&decoder, limit, port->bit_period_ns * counts_per_us / 1000);
+        JoyBusEdgeFrame frame;
+        if (joybus_edge_decode(&decoder, words + reply_offset, count - reply_offset, &frame) ==
+            JoyBusEdgeStatus::Ok) {
+            period_ns = joybus_edge_bit_period_ns(frame, clk_hz);
+        }
+    }
+    if (period_ns != 0) {
+        port->bit_period_ns = period_ns;
+    }
+
+    rx_sm_init(sm, clkdiv_for_bit_period(port->bit_period_ns));
+    port_start_receive(port);
+    pio_set_irq0_source_enabled(pio, source, true);
+    pio_sm_set_enabled(pio, sm, true);
+    return period_ns != 0;
+}
+
+bool ports_init() {
+    ports.pio_tx = pio0;
+    ports.pio_rx = pio1;
+
+    // プログラムはPIOごとに1回だけ読み込み、4つのSMで共有する
+    if (!add_program_checked(ports.pio_tx, &joy_tx5_program, "joy_tx5", &ports.off_tx) ||
+        !add_program_checked(ports.pio_rx, &joy_rx5_program, "joy_rx5", &ports.off_rx)) {
+        return false;
+    }
+    if (AUTO_BIT_RATE &&
+        !add_program_checked(ports.pio_rx, &joy_edge_program, "joy_edge", &ports.off_edge)) {
+        return false;
+    }
+
+    // TXは公称の5us/bitのまま、RXは応答のビットレートを測ってから合わせ直す
+    const float div = clkdiv_for_bit_period(NOMINAL_BIT_PERIOD_NS);
+
+    for (uint i = 0; i < NUM_PORTS; ++i) {
+        JoyBusPort &port = ports.port[i];
+        const PortPins &pins = PORT_PINS[i];
+        port.index = i;
+
+        // --- TXステートマシン設定 ---
+        pio_sm_config c_tx = joy_tx5_program_get_default_config(ports.off_tx);
+        sm_config_set_set_pins(&c_tx, pins.tx, 1);
+        sm_config_set_out_shift(&c_tx,
+                                /*shift_right=*/false,
+                                /*autopull=*/true,
+                                /*pull_thresh=*/32);
+        sm_config_set_clkdiv(&c_tx, div);
+
+        pio_gpio_init(ports.pio_tx, pins.tx);
+        pio_gpio_init(ports.pio_rx, pins.rx);
+        gpio_pull_up(pins.tx); // open-drainのHigh維持の補助（外付けがあるなら無くてもOK）
+        gpio_pull_up(pins.rx); // 必須寄り
+        // TXを開放状態に設定
+        pio_sm_set_consecutive_pindirs(ports.pio_tx, i, pins.tx, 1, false);
+        pio_sm_set_pins_with_mask(ports.pio_tx, i, 0u, 1u << pins.tx);
+        // RXを入力に設定
+        pio_sm_set_consecutive_pindirs(ports.pio_rx, i, pins.rx, 1, false);
+
+        pio_sm_init(ports.pio_tx, i, ports.off_tx, &c_tx);
+        // --- RXステートマシン設定 ---
+        rx_sm_init(i, div);
+
+        // RX用DMA（ポートごとに1チャンネル）
+        port.rx_dma_channel = dma_claim_unused_channel(true);
+        port.rx_dma_config = dma_channel_get_default_config(port.rx_dma_channel);
+        channel_config_set_transfer_data_size(&port.rx_dma_config, DMA_SIZE_8);
+        channel_config_set_dreq(&port.rx_dma_config, pio_get_dreq(ports.pio_rx, i, false));
+        channel_config_set_read_increment(&port.rx_dma_config, false);
+        channel_config_set_write_increment(&port.rx_dma_config, true);
+
+        // TX用DMA（開始はirq i、完了はirq 4+i）
+        joybus_tx_init_with_irqs(&port.tx, ports.pio_tx, i, i, TX_DONE_IRQ_BASE + i);
+
+        pio_interrupt_clear(ports.pio_rx, i);
+        pio_set_irq0_source_enabled(ports.pio_rx, (pio_interrupt_source_t)(pis_interrupt0 + i),
+                                    true);
+        port_start_receive(&port);
+    }
+
+    // RXを先に起動し、受信待ちになってからTXを起動
+    // どちらもクロック分周の位相をそろえて同じサイクルで起動する
+    const uint32_t sm_mask = (1u << NUM_PORTS) - 1;
+    pio_enable_sm_mask_in_sync(ports.pio_rx, sm_mask);
+    int irq = (pio_get_index(ports.pio_rx) == 0) ? PIO0_IRQ_0 : PIO1_IRQ_0;
+    irq_set_exclusive_handler(irq, rx_pio_irq_handler);
+    irq_set_priority(irq, PICO_HIGHEST_IRQ_PRIORITY);
+    irq_set_enabled(irq, true);
+    sleep_ms(200); // 安全のため少し待つ
+    pio_enable_sm_mask_in_sync(ports.pio_tx, sm_mask);
+    return true;
+}
+
+// ビットレートを測り直す（only_failedなら続けて応答が取れなかったポートだけ）
+// 変えるのはRXの分周比だけなので、TXの分周の位相はそろったまま
+void ports_tune_bit_rate(const JoyBusTxFrame *identify, bool only_failed) {
+    for (JoyBusPort &port : ports.port) {
+        if (only_failed && port.failures < RETUNE_AFTER_FAILURES) {
+            continue;
+        }
+        const bool measured = port_measure_bit_rate(&port, identify);
+        if (only_failed) {
+            ++port.retunes;
+        }
+        port.failures = 0;
+        printf("port%u reply bit period %luns (rx div %.3f)%s\n", port.index,
+               (unsigned long)port.bit_period_ns, clkdiv_for_bit_period(port.bit_period_ns),
+               measured ? "" : " not detected, unchanged");
+    }
+}
+
+// 全ポートのポーリングを同じPIOサイクルで開始する
+void __not_in_flash_func(ports_start_poll_aligned)(const JoyBusTxFrame *const *frames) {
+    uint32_t dma_mask = 0;
+    uint32_t start_mask = 0;
+    for (JoyBusPort &port : ports.port) {
+        // 前の送信の完了を待つ
+        while (!joybus_tx_ready(&port.tx)) {
+            tight_loop_contents();
+        }
+        pio_interrupt_clear(ports.pio_tx, port.tx.done_irq);
+        port_discard_frames(&port);
+        // 読み込み元と転送数だけ書いておき、起動はまとめて行う
+        dma_channel_set_read_addr(port.tx.dma_channel, frames[port.index]->words, false);
+        dma_channel_set_trans_count(port.tx.dma_channel, frames[port.index]->word_count, false);
+        dma_mask |= 1u << port.tx.dma_channel;
+        start_mask |= 1u << port.tx.start_irq;
+    }
+    dma_start_channel_mask(dma_mask);
+    // 開始指示の前にフレームの先頭（ビット数と最初のデータ）がTX FIFOに入るのを待つ
+    // （残りはSMが送りながらDMAが補充する）
+    for (const JoyBusPort &port : ports.port) {
+        const JoyBusTxFrame *frame = frames[port.index];
+        const uint32_t head_words = frame->word_count < 2 ? frame->word_count : 2;
+        while (pio_sm_get_tx_fifo_level(ports.pio_tx, port.index) < head_words) {
+            tight_loop_contents();
+        }
+    }
+    const uint32_t start_us = timer_hw->timerawl;
+    ports.pio_tx->irq_force = start_mask;
+    for (JoyBusPort &port : ports.port) {
+        port.start_us = start_us;
+    }
+}
+
+// 1ポートだけポーリングを開始する（順番に送る場合）
+void ports_start_poll_one(JoyBusPort *port, const JoyBusTxFrame *frame) {
+    port_discard_frames(port);
+    port->start_us = time_us_32();
+    joybus_tx_send(&port->tx, frame);
+}
+
+// 1ポートの受信完了（またはタイムアウト）を待って集計する
+void collect_reply(JoyBusPort *port, const uint8_t *expected, absolute_time_t start_time) {
+    port->round_ok = false;
+    const RxSlot *slot = nullptr;
+    while ((slot = port_peek_frame(port)) == nullptr) {
+        if (absolute_time_diff_us(start_time, get_absolute_time()) > RX_TIMEOUT_US) {
+            break;
+        }
+        tight_loop_contents();
+    }
+    if (slot == nullptr) {
+        ++port->timeout;
+        return;
+    }
+
+    // 枠の中身を直接読む（コピーしない）
+    const uint32_t length = slot->length;
+    const uint32_t end_us = slot->end_us;
+    bool same = length == 3;
+    for (uint32_t i = 0; same && i < 3; ++i) {
+        same = slot->data[i] == expected[i];
+    }
+    if (!port_release_frame(port)) {
+        ++port->overrun;
+    } else if (length == 0) {
+        ++port->bad_frames;
+    } else if (same) {
+        ++port->ok;
+        port->round_ok = true;
+        port->round_end_us = end_us;
+    } else {
+        ++port->mismatch;
+    }
+}
+
+// 1周分の時刻の集計
+struct RoundStats {
+    uint32_t rounds = 0;
+    uint32_t round_max_us = 0; // 送信開始から最後のポートの受信終端まで
+    uint64_t round_sum_us = 0;
+    uint32_t skew_max_us = 0; // ポート間の受信終端のずれ（最大-最小）
+
+    void add(uint32_t round_us, uint32_t skew_us) {
+        ++rounds;
+        round_sum_us += round_us;
+        round_max_us = round_us > round_max_us ? round_us : round_max_us;
+        skew_max_us = skew_us > skew_max_us ? skew_us : skew_max_us;
+    }
+};
+
+// 全ポートが受信できた周だけ、受信終端の時刻から1周の時間とずれを求める
+void add_round_timing(RoundStats *stats) {
+    uint32_t first_start = UINT32_MAX;
+    uint32_t first_end = UINT32_MAX;
+    uint32_t last_end = 0;
+    for (const JoyBusPort &port : ports.port) {
+        if (!port.round_ok) {
+            return;
+        }
+        first_start = port.start_us < first_start ? port.start_us : first_start;
+        first_end = port.round_end_us < first_end ? port.round_end_us : first_end;
+        last_end = port.round_end_us > last_end ? port.round_end_us : last_end;
+    }
+    stats->add(last_end - first_start, last_end - first_end);
+}
+} // namespace
+
+int main() {
+    stdio_init_all();
+    // ログのDMAの完了割り込みはDMA_IRQ_1だけに出し、優先度を最低にしてバスの割り込みを先に通す
+    joybus_log_init(uart_default, PICO_DEFAULT_UART_BAUD_RATE, PICO_DEFAULT_UART_TX_PIN,
+                    PICO_DEFAULT_UART_RX_PIN, /*dma_irq_index=*/1);
+    irq_set_priority(DMA_IRQ_1, PICO_LOWEST_IRQ_PRIORITY);
+    bootsel_button_init();
+
+    // 動作開始の確認用にオンボードLEDを光らせる
+    init_led();
+
+    init_bus_pins_safe();
+
+    printf("Loading PIO programs...\n");
+    if (!ports_init()) {
+        while (true) {
+            tight_loop_contents();
+        }
+    }
+    printf("multi_port ready (%u ports, tx=pio0 sm0-%u, rx=pio1 sm0-%u, %s poll).\n", NUM_PORTS,
+           NUM_PORTS - 1, NUM_PORTS - 1, ALIGNED_POLL ? "aligned" : "sequential");
+
+    // ポーリングコマンド（3バイト目でポート番号を区別する）
+    uint8_t commands[NUM_PORTS][3];
+    const JoyBusTxFrame *frames[NUM_PORTS];
+    for (uint i = 0; i < NUM_PORTS; ++i) {
+        commands[i][0] = 0x40;
+        commands[i][1] = 0x03;
+        commands[i][2] = (uint8_t)(i << 4);
+        frames[i] = joybus_tx_frame_create(commands[i], sizeof(commands[i]));
+    }
+
+    // 最初のやりとり（identify）でポートごとのビットレートを合わせる
+    const uint8_t identify_command[] = {0x00};
+    const JoyBusTxFrame *identify =
+        joybus_tx_frame_create(identify_command, sizeof(identify_command));
+    if (AUTO_BIT_RATE) {
+        ports_tune_bit_rate(identify, /*only_failed=*/false);
+    }
+
+    RoundStats round;
+    uint32_t last_report_ms = 0;
+    absolute_time_t next_poll = get_absolute_time();
+    while (true) {
+        sleep_until(next_poll);
+        next_poll = delayed_by_us(next_poll, POLL_INTERVAL_US);
+
+        if (ALIGNED_POLL) {
+            ports_start_poll_aligned(frames);
+            const absolute_time_t start_time = get_absolute_time();
+            for (JoyBusPort &port : ports.port) {
+                collect_reply(&port, commands[port.index], start_time);
+            }
+        } else {
+            for (JoyBusPort &port : ports.port) {
+                ports_start_poll_one(&port, frames[port.index]);
+                collect_reply(&port, commands[port.index], get_absolute_time());
+            }
+        }
+        add_round_timing(&round);
+        if (AUTO_BIT_RATE) {
+            for (JoyBusPort &port : ports.port) {
+                port.failures = port.round_ok ? 0 : port.failures + 1;
+            }
+            ports_tune_bit_rate(identify, /*only_failed=*/true);
+        }
+
+        const uint32_t now_ms = to_ms_since_boot(get_absolute_time());
+        if (now_ms - last_report_ms >= 1000) {
+            last_report_ms = now_ms;
+            for (const JoyBusPort &port : ports.port) {
+                printf("port%u ok=%lu mismatch=%lu bad=%lu timeout=%lu overrun=%lu "
+                       "bit=%luns retune=%lu%s",
+                       port.index, (unsigned long)port.ok, (unsigned long)port.mismatch,
+                       (unsigned long)port.bad_frames, (unsigned long)port.timeout,
+                       (unsigned long)port.overrun, (unsigned long)port.bit_period_ns,
+                       (unsigned long)port.retunes, port.index + 1 < NUM_PORTS ? " | " : "\n");
+            }
+            if (round.rounds > 0) {
+                printf("round n=%lu avg=%luus max=%luus skew_max=%luus log_dropped=%lu\n",
+                       (unsigned long)round.rounds,
+                       (unsigned long)(round.round_sum_us / round.rounds),
+                       (unsigned long)round.round_max_us, (unsigned long)round.skew_max_us,
+                       (unsigned long)joybus_log_dropped());
+            }
+            round = RoundStats{};
+        }
+    }
+}
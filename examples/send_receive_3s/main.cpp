@@ -2,6 +2,7 @@
 #include "hardware/pio.h"
 #include "joy_rx4.pio.h"
 #include "joy_tx4.pio.h"
+#include "joybus_decode.h"
 #include "pico/stdlib.h"
 #include <stdio.h>
 
@@ -25,25 +26,6 @@ static void init_led() {
     gpio_put(ONBOARD_LED_PIN, 1);
 }
 
-static inline uint8_t decode_3sample_msbfirst(uint32_t w) {
-    // wは24ビットのサンプルデータ
-    // あるbitの受信結果について3つのサンプルが8組並んでいる
-    // 00000000 | s0, s1, s2 | s0, s1, s2 | ... | s0, s1, s2
-    // 最も古いサンプルがビット23、最新がビット0
-
-    uint8_t out = 0;
-    // 上位iビット目の3サンプルを抽出し多数決をとる
-    for (int i = 0; i < 8; ++i) {
-        int base = 23 - 3 * i;
-        uint32_t s0 = (w >> base) & 1u;       //  1.5us
-        uint32_t s1 = (w >> (base - 1)) & 1u; //  2.0us
-        uint32_t s2 = (w >> (base - 2)) & 1u; //  2.5us
-        uint32_t majority = (s0 & s1) | (s1 & s2) | (s2 & s0);
-        out = (uint8_t)((out << 1) | (majority & 1u));
-    }
-    return out;
-}
-
 int main() {
     stdio_init_all();
 
@@ -126,7 +108,7 @@ int main() {
                 // 受信
                 uint32_t rx_word = pio_sm_get_blocking(pio, sm_rx);
                 // 下位24ビットを3サンプル多数決でデコード
-                uint32_t rx_byte = decode_3sample_msbfirst(rx_word & 0x00FFFFFFu);
+                uint32_t rx_byte = joybus_decode_3sample(rx_word);
                 // 結果表示
                 printf("TX: %02X -> RX: %02X\n", tx_byte, rx_byte);
             }
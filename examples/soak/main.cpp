@@ -0,0 +1,321 @@
+// ループバックの連続負荷試験（ソーク）
+// 長さ1〜JOYBUS_MAX_FRAME_BYTESの乱数のフレームを、前のフレームのストップビットの確認が
+// 終わったらすぐに（joy_tx5が送信完了を通知した時点で）次を送り続け、何時間でも回す
+// 受信したバイトを送ったバイトと比べ、次を数えて一定時間ごとに表示する
+//   bit_err : 受信できたバイトの中で送ったものと違ったビット（BERはこれ/比べたビット数）
+//   stop    : ストップビットが来なかった（joy_rx5のirq 2）
+//   short   : 途中までしか受信できなかった（送ったバイト数に足りない）
+//   timeout : 1バイトも受信できなかった
+//   resync  : 同期が崩れて（short, timeout, stopが続いた）RXのSMを先頭に戻した回数
+//   samples : 3サンプルがそろわなかったビットの数と、どのサンプル（s0/s1/s2 = cycle8/10/12）が
+//             少数派だったか。バイトが壊れる前にサンプリングの位置の寄りやケーブルの劣化が見える
+// 送受信はstop_bitと同じjoy_tx5/joy_rx5（3点サンプリング）で、どちらもDMAで運ぶので
+// FIFOの段数に関係なく最大長のフレームまで送れる
+// 表示はjoybus_log（リング+DMA）で出すので、printfの間もバスは止まらない
+// 集計の行に続けてjoybus_telemetryの行も出す（FIFOのあふれなのか線の誤りなのかを見分ける）
+//
+// 配線: TX_PINとRX_PINをつなぐ（3.3Vプルアップ）
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/pio.h"
+#include "joy_rx5.pio.h"
+#include "joy_tx5.pio.h"
+#include "joybus_decode.h"
+#include "joybus_frame.h"
+#include "joybus_log.h"
+#include "joybus_resync.h"
+#include "joybus_telemetry.h"
+#include "joybus_tx.h"
+#include "pico/bootrom.h"
+#include "pico/stdlib.h"
+#include <stdio.h>
+
+namespace {
+// 乱数の種（同じ種なら同じフレームの列になる）
+constexpr uint32_t SOAK_SEED = 1;
+// 送信の完了を待つ上限（最長の16バイトでも送受信で約0.7ms）
+constexpr uint32_t FRAME_TIMEOUT_US = 2000;
+// joy_tx5/joy_rx5の1ビットの長さ（送信の完了から受信の完了までの猶予に使う）
+constexpr uint32_t BIT_PERIOD_US = 5;
+// 集計を表示する間隔
+constexpr uint32_t REPORT_INTERVAL_US = 10'000'000;
+
+// 通電確認用のオンボードLED
+constexpr uint ONBOARD_LED_PIN = PICO_DEFAULT_LED_PIN;
+// BOOTSELに入るためのボタン入力
+constexpr uint BOOT_BTN_PIN = 26; // GP26
+// JoyBus
+constexpr uint TX_PIN = 15; // GP15
+constexpr uint RX_PIN = 16; // GP16
+
+// pio0: 送信（joy_tx5）、pio1: 受信（joy_rx5）
+constexpr uint SM_TX = 0; // pio0
+constexpr uint SM_RX = 0; // pio1
+// joy_rx5がストップビットの欠けを知らせるIRQフラグ
+constexpr uint RX_STOP_ERROR_IRQ = 2;
+
+struct SoakFrame {
+    uint8_t data[JOYBUS_MAX_FRAME_BYTES] = {0};
+    JoyBusTxFrame tx;
+};
+
+// 何時間も回すので、バイト数とビット数は64ビットで数える
+struct SoakStats {
+    uint32_t frames = 0; // 送ったフレーム数
+    uint32_t ok = 0;     // 全バイトが一致し、ストップビットも来たフレーム数
+    uint32_t stop_errors = 0;
+    uint32_t short_frames = 0;
+    uint32_t timeouts = 0;
+    uint32_t corrupted = 0;    // 受信できたバイトに違いがあったフレーム数
+    uint64_t bytes_sent = 0;   // 送ったデータのバイト数（ストップビットを除く）
+    uint64_t bits_checked = 0; // 送ったものと比べたビット数
+    uint64_t bit_errors = 0;
+    JoyBusSampleStats samples; // 受信できたバイトの3サンプルのそろい具合
+};
+
+enum class FrameResult { Ok, Corrupted, StopError, Short, Timeout };
+
+JoyBusTx joybus_tx;
+JoyBusResync rx_resync;
+int rx_dma_channel = -1;
+dma_channel_config rx_dma_config{};
+uint32_t rx_words[JOYBUS_MAX_FRAME_BYTES]; // 1バイト = 24ビットのワード1つ
+
+void boot_btn_irq(uint gpio, uint32_t events) {
+    // ちょいデバウンス（押しっぱなし連打対策）
+    busy_wait_ms(100);
+    if (gpio_get(BOOT_BTN_PIN) == 0) {
+        printf("BOOTSEL button pressed. Entering USB boot mode...\n");
+        reset_usb_boot(0, 0);
+    }
+}
+
+void bootsel_button_init() {
+    gpio_init(BOOT_BTN_PIN);
+    gpio_set_dir(BOOT_BTN_PIN, GPIO_IN);
+    gpio_pull_up(BOOT_BTN_PIN);
+    gpio_set_irq_enabled_with_callback(BOOT_BTN_PIN, GPIO_IRQ_EDGE_FALL, true, &boot_btn_irq);
+}
+
+void init_bus_pins_safe() {
+    // バスへ接続するピンをHi-Zに設定
+    gpio_init(TX_PIN);
+    gpio_put(TX_PIN, 0);
+    gpio_set_dir(TX_PIN, GPIO_IN);
+
+    gpio_init(RX_PIN);
+    gpio_set_dir(RX_PIN, GPIO_IN);
+}
+
+void init_led() {
+    gpio_init(ONBOARD_LED_PIN);
+    gpio_set_dir(ONBOARD_LED_PIN, GPIO_OUT);
+    gpio_put(ONBOARD_LED_PIN, 1);
+}
+
+void loopback_init() {
+    const uint off_tx = pio_add_program(pio0, &joy_tx5_program);
+    const uint off_rx = pio_add_program(pio1, &joy_rx5_program);
+
+    // --- TXステートマシン設定 ---
+    pio_sm_config c_tx = joy_tx5_program_get_default_config(off_tx);
+    sm_config_set_set_pins(&c_tx, TX_PIN, 1);
+    sm_config_set_out_shift(&c_tx,
+                            /*shift_right=*/false,
+                            /*autopull=*/true,
+                            /*pull_thresh=*/32);
+
+    // --- RXステートマシン設定 ---
+    pio_sm_config c_rx = joy_rx5_program_get_default_config(off_rx);
+    sm_config_set_in_pins(&c_rx, RX_PIN);
+    sm_config_set_jmp_pin(&c_rx, RX_PIN);
+    // 3点でサンプリングするため3 * 8 = 24ビットずつ受信
+    sm_config_set_in_shift(&c_rx,
+                           /*shift_right=*/false,
+                           /*autopush=*/true,
+                           /*push_thresh=*/24);
+
+    const float pio_hz = 4'000'000; // 4MHz
+    const float div = (float)clock_get_hz(clk_sys) / pio_hz;
+    sm_config_set_clkdiv(&c_tx, div);
+    sm_config_set_clkdiv(&c_rx, div);
+
+    pio_gpio_init(pio0, TX_PIN);
+    pio_gpio_init(pio1, RX_PIN);
+    gpio_pull_up(TX_PIN); // open-drainのHigh維持の補助（外付けがあるなら無くてもOK）
+    gpio_pull_up(RX_PIN); // 必須寄り
+    pio_sm_set_consecutive_pindirs(pio0, SM_TX, TX_PIN, 1, false);
+    pio_sm_set_pins_with_mask(pio0, SM_TX, 0u, 1u << TX_PIN);
+    pio_sm_set_consecutive_pindirs(pio1, SM_RX, RX_PIN, 1, false);
+    pio_sm_init(pio0, SM_TX, off_tx, &c_tx);
+    pio_sm_init(pio1, SM_RX, off_rx, &c_rx);
+
+    // TXはDMAで運ぶ（TX FIFOの4ワードを超える長さも送れる）
+    joybus_tx_init(&joybus_tx, pio0, SM_TX);
+
+    // RX用DMA（24ビットのワードをそのままバッファへ）
+    rx_dma_channel = dma_claim_unused_channel(true);
+    rx_dma_config = dma_channel_get_default_config(rx_dma_channel);
+    channel_config_set_transfer_data_size(&rx_dma_config, DMA_SIZE_32);
+    channel_config_set_dreq(&rx_dma_config, pio_get_dreq(pio1, SM_RX, false));
+    channel_config_set_read_increment(&rx_dma_config, false);
+    channel_config_set_write_increment(&rx_dma_config, true);
+
+    joybus_resync_init(&rx_resync, pio1, SM_RX, off_rx, RX_STOP_ERROR_IRQ);
+    // RXステートマシンを先に起動
+    pio_sm_set_enabled(pio1, SM_RX, true);
+    sleep_ms(200);                         // 安全のため少し待つ
+    pio_sm_set_enabled(pio0, SM_TX, true); // RXが受信待ち状態になってからTXを起動
+}
+
+// 受信と送信を起動する（前の送信の完了はjoybus_tx_sendが待つ）
+void soak_frame_start(const SoakFrame &f) {
+    dma_channel_set_config(rx_dma_channel, &rx_dma_config, false);
+    dma_channel_set_read_addr(rx_dma_channel, &pio1->rxf[SM_RX], false);
+    dma_channel_transfer_to_buffer_now(rx_dma_channel, rx_words, f.tx.nbytes);
+    // RXには送るものと同じビット数を先に渡しておく
+    pio_sm_put(pio1, SM_RX, f.tx.nbytes * 8 - 1);
+    joybus_tx_send(&joybus_tx, &f.tx);
+}
+
+// 送信の完了（ストップビットの後のHighまで）を待ち、そこから1ビット周期のうちに全バイトを
+// 受信し終わらなければ同期が崩れたとみなして、RXのSMだけをその場で先頭に戻す
+// （FRAME_TIMEOUT_USまで待たないので、落とすのはこのフレームだけになる）
+// joy_rx5はストップビットの中点で判定するので、送信が完了した時点でirq 2も確定している
+FrameResult soak_frame_finish(const SoakFrame &f, SoakStats *stats) {
+    const uint32_t nbytes = f.tx.nbytes;
+    const uint32_t start_us = time_us_32();
+    // ループバックでは送信は止まらないが、念のため上限を設ける
+    while (!joybus_tx_ready(&joybus_tx) && time_us_32() - start_us <= FRAME_TIMEOUT_US) {
+        tight_loop_contents();
+    }
+    const uint32_t tx_done_us = time_us_32();
+    while (dma_channel_is_busy(rx_dma_channel) && time_us_32() - tx_done_us <= BIT_PERIOD_US) {
+        tight_loop_contents();
+    }
+    const uint32_t received = nbytes - dma_channel_hw_addr(rx_dma_channel)->transfer_count;
+    joybus_telemetry_record_dma(nbytes, received);
+    if (received < nbytes) {
+        // DMAは次のフレームのsoak_frame_startで張り直す
+        dma_channel_abort(rx_dma_channel);
+        joybus_resync_sm(&rx_resync, received == 0 ? JoyBusDesync::Timeout : JoyBusDesync::Short);
+    }
+
+    ++stats->frames;
+    stats->bytes_sent += nbytes;
+    uint32_t errors = 0;
+    for (uint32_t i = 0; i < received; ++i) {
+        const JoyBus3SampleDecode d = joybus_decode_3sample_checked(rx_words[i]);
+        joybus_sample_stats_add(&stats->samples, d);
+        errors += __builtin_popcount(d.value ^ f.data[i]);
+    }
+    stats->bits_checked += received * 8;
+    stats->bit_errors += errors;
+
+    if (received == 0) {
+        ++stats->timeouts;
+        return FrameResult::Timeout;
+    }
+    if (received < nbytes) {
+        ++stats->short_frames;
+        return FrameResult::Short;
+    }
+    // 1回だけならSMは自分で先頭に戻っている（続けて立てばjoybus_resyncがSMを戻す）
+    if (joybus_resync_check_stop_error(&rx_resync)) {
+        ++stats->stop_errors;
+        return FrameResult::StopError;
+    }
+    if (errors != 0) {
+        ++stats->corrupted;
+        return FrameResult::Corrupted;
+    }
+    ++stats->ok;
+    return FrameResult::Ok;
+}
+
+void print_report(const SoakStats &total, const SoakStats &at_report, uint32_t elapsed_s,
+                  uint32_t interval_us) {
+    const float interval_s = interval_us / 1e6f;
+    const uint32_t frames = total.frames - at_report.frames;
+    const uint32_t bytes = (uint32_t)(total.bytes_sent - at_report.bytes_sent);
+    const uint32_t failed = total.frames - total.ok;
+    printf("[%02lu:%02lu:%02lu] frames=%lu (%.0f/s, %.0f B/s) failed=%lu (%.4f%%) "
+           "stop=%lu short=%lu timeout=%lu corrupted=%lu resync=%lu (storm=%lu)\n",
+           (unsigned long)(elapsed_s / 3600), (unsigned long)(elapsed_s / 60 % 60),
+           (unsigned long)(elapsed_s % 60), (unsigned long)total.frames, frames / interval_s,
+           bytes / interval_s, (unsigned long)failed,
+           total.frames == 0 ? 0.0f : 100.0f * failed / total.frames,
+           (unsigned long)total.stop_errors, (unsigned long)total.short_frames,
+           (unsigned long)total.timeouts, (unsigned long)total.corrupted,
+           (unsigned long)rx_resync.stats.resyncs, (unsigned long)rx_resync.stats.stop_storms);
+    // 誤りが1つもなければ、比べたビット数から言える上限を出す
+    if (total.bit_errors == 0) {
+        printf("           bits=%llu bit_err=0 BER<%.1e\n", (unsigned long long)total.bits_checked,
+               total.bits_checked == 0 ? 1.0 : 1.0 / (double)total.bits_checked);
+    } else {
+        printf("           bits=%llu bit_err=%llu BER=%.2e\n",
+               (unsigned long long)total.bits_checked, (unsigned long long)total.bit_errors,
+               (double)total.bit_errors / (double)total.bits_checked);
+    }
+    const JoyBusSampleStats &q = total.samples;
+    printf("           samples: disagreed=%lu/%lu bits s0=%lu s1=%lu s2=%lu by_bit=",
+           (unsigned long)q.disagreed_bits, (unsigned long)q.bytes * 8,
+           (unsigned long)q.by_sample[0], (unsigned long)q.by_sample[1],
+           (unsigned long)q.by_sample[2]);
+    for (int i = 0; i < 8; ++i) {
+        printf(i == 0 ? "%lu" : "/%lu", (unsigned long)q.by_bit[i]);
+    }
+    printf("\n");
+}
+} // namespace
+
+int main() {
+    stdio_init_all();
+    // ログのDMAの完了割り込みはDMA_IRQ_1だけに出し、優先度を最低にしてバスの割り込みを先に通す
+    joybus_log_init(uart_default, PICO_DEFAULT_UART_BAUD_RATE, PICO_DEFAULT_UART_TX_PIN,
+                    PICO_DEFAULT_UART_RX_PIN, /*dma_irq_index=*/1);
+    irq_set_priority(DMA_IRQ_1, PICO_LOWEST_IRQ_PRIORITY);
+    bootsel_button_init();
+
+    // 動作開始の確認用にオンボードLEDを光らせる
+    init_led();
+
+    init_bus_pins_safe();
+
+    loopback_init();
+    printf("Soak test ready (seed=%lu, 1-%u bytes, report every %lus).\n",
+           (unsigned long)SOAK_SEED, (unsigned)JOYBUS_MAX_FRAME_BYTES,
+           (unsigned long)(REPORT_INTERVAL_US / 1'000'000));
+
+    // 送っている間に次のフレームを作っておく
+    SoakFrame frames[2];
+    uint32_t random_state = SOAK_SEED;
+    uint32_t current = 0;
+    joybus_frame_random(&frames[current].tx, frames[current].data, &random_state);
+
+    SoakStats total;
+    SoakStats at_report = total; // 前回の表示の時点（区間ごとの速さはこれとの差で出す）
+    uint32_t report_us = time_us_32();
+    uint32_t elapsed_s = 0; // time_us_32の折り返し（約71分）をまたいでも数え続ける
+    uint32_t elapsed_s_us = report_us;
+    while (true) {
+        soak_frame_start(frames[current]);
+        joybus_frame_random(&frames[current ^ 1].tx, frames[current ^ 1].data, &random_state);
+        soak_frame_finish(frames[current], &total);
+        joybus_telemetry_poll();
+        current ^= 1;
+
+        const uint32_t now_us = time_us_32();
+        while (now_us - elapsed_s_us >= 1'000'000) {
+            elapsed_s_us += 1'000'000;
+            ++elapsed_s;
+        }
+        if (now_us - report_us >= REPORT_INTERVAL_US) {
+            print_report(total, at_report, elapsed_s, now_us - report_us);
+            joybus_telemetry_print();
+            report_us = now_us;
+            at_report = total;
+        }
+    }
+}
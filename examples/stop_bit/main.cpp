@@ -2,6 +2,8 @@
 #include "hardware/pio.h"
 #include "joy_rx5.pio.h"
 #include "joy_tx5.pio.h"
+#include "joybus_decode.h"
+#include "joybus_telemetry.h"
 #include "pico/bootrom.h"
 #include "pico/stdlib.h"
 #include <stdio.h>
@@ -50,25 +52,6 @@ static void init_led() {
     gpio_put(ONBOARD_LED_PIN, 1);
 }
 
-static inline uint8_t decode_3sample_msbfirst(uint32_t w) {
-    // wは24ビットのサンプルデータ
-    // あるbitの受信結果について3つのサンプルが8組並んでいる
-    // 00000000 | s0, s1, s2 | s0, s1, s2 | ... | s0, s1, s2
-    // 最も古いサンプルがビット23、最新がビット0
-
-    uint8_t out = 0;
-    // 上位iビット目の3サンプルを抽出し多数決をとる
-    for (int i = 0; i < 8; ++i) {
-        int base = 23 - 3 * i;
-        uint32_t s0 = (w >> base) & 1u;
-        uint32_t s1 = (w >> (base - 1)) & 1u;
-        uint32_t s2 = (w >> (base - 2)) & 1u;
-        uint32_t majority = (s0 & s1) | (s1 & s2) | (s2 & s0);
-        out = (uint8_t)((out << 1) | (majority & 1u));
-    }
-    return out;
-}
-
 static bool joybus_rx_read_bytes(PIO pio, uint sm, uint8_t *out, size_t nbytes, int timeout_us) {
     absolute_time_t start = get_absolute_time();
 
@@ -80,8 +63,7 @@ static bool joybus_rx_read_bytes(PIO pio, uint sm, uint8_t *out, size_t nbytes,
             tight_loop_contents();
         }
         uint32_t raw = pio_sm_get_blocking(pio, sm);
-        uint32_t lo24 = raw & 0x00FFFFFFu;
-        out[i] = decode_3sample_msbfirst(lo24);
+        out[i] = joybus_decode_3sample(raw);
     }
     return true;
 }
@@ -212,6 +194,8 @@ int main() {
     sleep_ms(200);                           // 安全のため少し待つ
     pio_sm_set_enabled(pio_tx, sm_tx, true); // RXが受信待ち状態になってからTXを起動
     printf("Loopback test ready.\n");
+    // ストップビットが来なかったときのirq 2はここで数えて下ろす
+    joybus_telemetry_watch_irq(pio_rx, 2, "stop");
 
     const std::vector<std::vector<uint8_t>> test_frames = {
         {0xA5},
@@ -234,7 +218,11 @@ int main() {
             pio_sm_put_blocking(pio_rx, sm_rx, bits_to_receive_minus1);
             joybus_tx_send(pio_tx, sm_tx, frame.data(), expected_bytes);
             std::vector<uint8_t> rx_buffer(expected_bytes, 0);
-            if (!joybus_rx_read_bytes(pio_rx, sm_rx, rx_buffer.data(), expected_bytes, 200000)) {
+            const bool received =
+                joybus_rx_read_bytes(pio_rx, sm_rx, rx_buffer.data(), expected_bytes, 200000);
+            // 5バイトのフレームでRX FIFOがあふれるとpio1.sm0のRXSTALLが数えられる
+            joybus_telemetry_poll();
+            if (!received) {
                 printf("RX timeout (expected %lu bytes)\n", (unsigned long)expected_bytes);
                 continue;
             }
@@ -248,6 +236,7 @@ int main() {
             }
             printf("\n");
         }
+        joybus_telemetry_print();
         sleep_ms(5000);
     }
 }
@@ -0,0 +1,272 @@
+// 送信関数を呼んでからTX_PINに最初の立ち下がりが出るまでの時間を比べる
+//   legacy  : 旧joybus_tx_send_dma（毎回バッファを詰め直し、printfしながら送る）
+//   prepacked: joybus_tx_send（事前に詰めたフレームのDMAを起動してirq 0を立てるだけ）
+// 立ち下がりはTX_PINのGPIO割り込みでSysTickを読んで測る
+// 割り込みの入口までの遅れ（数十サイクル）は両方に同じだけ含まれる
+// RX側はつながなくてよい（TX_PINにプルアップがあれば単体で動く）
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/pio.h"
+#include "hardware/structs/systick.h"
+#include "joy_tx5.pio.h"
+#include "joybus_tx.h"
+#include "pico/stdlib.h"
+#include <stdio.h>
+
+namespace {
+// 通電確認用のオンボードLED
+constexpr uint ONBOARD_LED_PIN = PICO_DEFAULT_LED_PIN;
+// JoyBus
+constexpr uint TX_PIN = 15; // GP15
+
+// 測定回数
+constexpr int TRIALS = 32;
+
+// 旧実装のDMA
+int legacy_dma_chan = -1;
+dma_channel_config legacy_dma_config;
+volatile bool tx_dma_done = false;
+volatile bool tx_dma_error = false;
+
+// 立ち下がりを検出したときのSysTick
+volatile uint32_t edge_systick = 0;
+volatile bool edge_seen = false;
+
+JoyBusTx joybus_tx;
+
+void init_bus_pins_safe() {
+    // バスへ接続するピンをHi-Zに設定
+    gpio_init(TX_PIN);
+    gpio_put(TX_PIN, 0);
+    gpio_set_dir(TX_PIN, GPIO_IN);
+}
+
+void init_led() {
+    gpio_init(ONBOARD_LED_PIN);
+    gpio_set_dir(ONBOARD_LED_PIN, GPIO_OUT);
+    gpio_put(ONBOARD_LED_PIN, 1);
+}
+
+void systick_init() {
+    // 割り込みなし・clk_sysをそのまま数える24ビットのダウンカウンタ
+    systick_hw->csr = 0;
+    systick_hw->rvr = 0x00FFFFFFu;
+    systick_hw->cvr = 0;
+    systick_hw->csr = M0PLUS_SYST_CSR_CLKSOURCE_BITS | M0PLUS_SYST_CSR_ENABLE_BITS;
+}
+
+// TX_PINの立ち下がり割り込み（汎用のコールバック経由だと遅れが増えるので直接登録）
+void __isr tx_edge_irq_handler() {
+    const uint32_t now = systick_hw->cvr;
+    if (gpio_get_irq_event_mask(TX_PIN) & GPIO_IRQ_EDGE_FALL) {
+        gpio_acknowledge_irq(TX_PIN, GPIO_IRQ_EDGE_FALL);
+        if (!edge_seen) {
+            edge_systick = now;
+            edge_seen = true;
+        }
+    }
+}
+
+void tx_edge_irq_init() {
+    gpio_set_irq_enabled(TX_PIN, GPIO_IRQ_EDGE_FALL, true);
+    irq_set_exclusive_handler(IO_IRQ_BANK0, tx_edge_irq_handler);
+    irq_set_priority(IO_IRQ_BANK0, PICO_HIGHEST_IRQ_PRIORITY);
+    irq_set_enabled(IO_IRQ_BANK0, true);
+}
+
+// TXのDMA割り込みハンドラ（旧実装用）
+void __isr dma_tx_handler() {
+    uint32_t status = dma_hw->ints1;
+    if (legacy_dma_chan >= 0 && (status & (1u << legacy_dma_chan))) {
+        dma_hw->ints1 = 1u << legacy_dma_chan;
+        tx_dma_done = true;
+    } else {
+        tx_dma_error = true;
+    }
+}
+
+// examples/detect_stop_bitにあった送信関数をそのまま残したもの（比較用）
+void joybus_tx_send_dma_legacy(PIO pio, uint sm, const uint8_t *data, size_t nbytes,
+                               int tx_dma_chan, dma_channel_config *tx_dma_config) {
+    if (nbytes == 0) {
+        return;
+    }
+    if (nbytes > JOYBUS_MAX_FRAME_BYTES) {
+        printf("Error: joybus_tx_send_dma: nbytes=%zu exceeds max=%zu\n", nbytes,
+               JOYBUS_MAX_FRAME_BYTES);
+        return;
+    }
+
+    printf("Waiting for previous TX complete...\n");
+    // 万が一同期が崩れてもautopullされないように前の送信が完了しないうちはFIFOに積まない
+    while (!pio_interrupt_get(pio, 1)) {
+        // 送信が完了するのを待つ
+        tight_loop_contents();
+    }
+    printf("Previous TX complete.\n");
+    pio_interrupt_clear(pio, 1);
+
+    // 期待する送信ビット数-1
+    uint32_t bits_to_send_minus1 = (uint32_t)(nbytes * 8 - 1);
+    const size_t words_of_data = (nbytes + 3) / 4;
+    const size_t words_to_send = words_of_data + 1; // bits_to_send_minus1 + データワード数
+    uint32_t tx_buffer[words_to_send] = {0};
+    tx_buffer[0] = bits_to_send_minus1;
+    printf("[TX] bits_to_send_minus1=%lu\n", (unsigned long)bits_to_send_minus1);
+    for (size_t w = 0; w < words_of_data; ++w) {
+        uint32_t word = 0;
+        for (size_t b = 0; b < 4; ++b) {
+            size_t byte_index = w * 4 + b;
+            uint8_t byte = (byte_index < nbytes) ? data[byte_index] : 0;
+            word |= ((uint32_t)byte) << (8 * (3 - b));
+        }
+        tx_buffer[w + 1] = word;
+        printf("[TX] Prepared word %zu: 0x%08lX\n", w, (unsigned long)word);
+    }
+    tx_dma_done = false;
+    tx_dma_error = false;
+    dma_channel_configure(tx_dma_chan, tx_dma_config,
+                          &pio->txf[sm], // 書き込み先
+                          tx_buffer,     // 読み込み元
+                          words_to_send, // 転送するワード数（bits_to_send_minus1 + データワード数）
+                          true           // 即時開始
+    );
+    pio->irq_force = (1u << 0);
+    printf("[TX] TX start notified via DMA.\n");
+    while (!tx_dma_done && !tx_dma_error) {
+        // 送信完了待ち
+        tight_loop_contents();
+    }
+    if (tx_dma_error) {
+        printf("[TX] TX DMA error occurred.\n");
+        return;
+    }
+    printf("[TX] TX DMA complete.\n");
+}
+
+struct Stats {
+    uint32_t min = UINT32_MAX;
+    uint32_t max = 0;
+    uint64_t sum = 0;
+    int count = 0;
+    int timeouts = 0;
+
+    void add(uint32_t cycles) {
+        min = cycles < min ? cycles : min;
+        max = cycles > max ? cycles : max;
+        sum += cycles;
+        ++count;
+    }
+};
+
+// 前のフレームのストップビットまで送り終わってから次の試行を始める
+void wait_tx_idle(PIO pio) {
+    while (!pio_interrupt_get(pio, 1)) {
+        tight_loop_contents();
+    }
+    sleep_us(100);
+}
+
+// sendを呼んでから立ち下がりまでのサイクル数を測る
+template <typename Send> void measure(Stats *stats, PIO pio, Send &&send) {
+    wait_tx_idle(pio);
+    edge_seen = false;
+    const uint32_t start = systick_hw->cvr;
+    send();
+    // 旧実装はDMA完了まで戻ってこないので、その時点で立ち下がりは記録済み
+    absolute_time_t timeout = make_timeout_time_ms(50);
+    while (!edge_seen) {
+        if (time_reached(timeout)) {
+            ++stats->timeouts;
+            return;
+        }
+        tight_loop_contents();
+    }
+    // 24ビットのダウンカウンタなので134ms（125MHz時）以内の差なら正しく求まる
+    stats->add((start - edge_systick) & 0x00FFFFFFu);
+}
+
+void print_stats(const char *name, const Stats &s) {
+    const uint32_t mhz = clock_get_hz(clk_sys) / 1'000'000;
+    if (s.count == 0) {
+        printf("%-10s no samples (timeouts=%d)\n", name, s.timeouts);
+        return;
+    }
+    const uint32_t avg = (uint32_t)(s.sum / (uint64_t)s.count);
+    printf("%-10s min=%lu avg=%lu max=%lu cycles (avg %lu.%02lu us) timeouts=%d\n", name,
+           (unsigned long)s.min, (unsigned long)avg, (unsigned long)s.max,
+           (unsigned long)(avg / mhz), (unsigned long)(avg % mhz * 100 / mhz), s.timeouts);
+}
+} // namespace
+
+int main() {
+    stdio_init_all();
+
+    // 動作開始の確認用にオンボードLEDを光らせる
+    init_led();
+
+    init_bus_pins_safe();
+    systick_init();
+
+    PIO pio_tx = pio0;
+    uint sm_tx = 0;
+
+    uint off_tx = pio_add_program(pio_tx, &joy_tx5_program);
+
+    // --- TXステートマシン設定 ---
+    pio_sm_config c_tx = joy_tx5_program_get_default_config(off_tx);
+    // TXはSETとPINDIRSでラインを制御するので、ベースピンをTX_PINに設定
+    sm_config_set_set_pins(&c_tx, TX_PIN, 1);
+    // 何バイト送るかを動的に決めるためTXのPIOは1バイトずつ勝手にpullして送信する
+    sm_config_set_out_shift(&c_tx,
+                            /*shift_right=*/false,
+                            /*autopull=*/true,
+                            /*pull_thresh=*/32);
+    const float pio_hz = 4'000'000; // 4MHz
+    sm_config_set_clkdiv(&c_tx, (float)clock_get_hz(clk_sys) / pio_hz);
+
+    pio_gpio_init(pio_tx, TX_PIN);
+    gpio_pull_up(TX_PIN); // open-drainのHigh維持の補助（外付けがあるなら無くてもOK）
+    // TXを開放状態に設定
+    pio_sm_set_consecutive_pindirs(pio_tx, sm_tx, TX_PIN, 1, false);
+    pio_sm_set_pins_with_mask(pio_tx, sm_tx, 0u, 1u << TX_PIN);
+    pio_sm_init(pio_tx, sm_tx, off_tx, &c_tx);
+    pio_sm_set_enabled(pio_tx, sm_tx, true);
+
+    // 旧実装用のDMA
+    legacy_dma_chan = dma_claim_unused_channel(true);
+    legacy_dma_config = dma_channel_get_default_config(legacy_dma_chan);
+    channel_config_set_transfer_data_size(&legacy_dma_config, DMA_SIZE_32);
+    channel_config_set_read_increment(&legacy_dma_config, true);
+    channel_config_set_write_increment(&legacy_dma_config, false);
+    channel_config_set_dreq(&legacy_dma_config, pio_get_dreq(pio_tx, sm_tx, true));
+    dma_channel_set_irq1_enabled(legacy_dma_chan, true);
+    irq_set_exclusive_handler(DMA_IRQ_1, dma_tx_handler);
+    irq_set_enabled(DMA_IRQ_1, true);
+
+    // 新実装
+    joybus_tx_init(&joybus_tx, pio_tx, sm_tx);
+
+    tx_edge_irq_init();
+
+    // GCのポーリングコマンド（0x40 0x03 0x00）
+    const uint8_t poll_cmd[] = {0x40, 0x03, 0x00};
+    const JoyBusTxFrame *poll_frame = joybus_tx_frame_create(poll_cmd, sizeof(poll_cmd));
+
+    while (true) {
+        Stats legacy;
+        Stats prepacked;
+        for (int i = 0; i < TRIALS; ++i) {
+            measure(&legacy, pio_tx, [&] {
+                joybus_tx_send_dma_legacy(pio_tx, sm_tx, poll_cmd, sizeof(poll_cmd),
+                                          legacy_dma_chan, &legacy_dma_config);
+            });
+            measure(&prepacked, pio_tx, [&] { joybus_tx_send(&joybus_tx, poll_frame); });
+        }
+        printf("\n--- call -> first falling edge on GP%u (%d trials) ---\n", TX_PIN, TRIALS);
+        print_stats("legacy", legacy);
+        print_stats("prepacked", prepacked);
+        sleep_ms(5000);
+    }
+}
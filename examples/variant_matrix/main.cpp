@@ -0,0 +1,573 @@
+// ループバックの送受信方式（世代ごとのexamples）を同じフレームの列で続けて走らせて比べる
+//   polling  : send_receive_3s  joy_tx4/joy_rx4（4us/bit）。CPUが両方のFIFOを見続けて1バイトずつ運ぶ
+//   fifo     : stop_bit         joy_tx5/joy_rx5_3s。フレームをFIFOに積んで送り、終わってから読む
+//                               （TX FIFOは12バイト、RX FIFOは4バイトまでしか入らない）
+//   dma      : dma              joy_tx5/joy_rx_os。joybus_dma_chainで1回のやりとりを行う
+//   stop_bit : detect_stop_bit  joy_tx5/joy_rx5。送信はjoybus_tx、受信はストップビット検出の
+//                               割り込みでDMAの転送数からフレームの長さを知る
+// フレームの列（長さ1〜JOYBUS_MAX_FRAME_BYTESの乱数、種は固定）は最初に1回だけ作り、
+// どの方式も前のフレームが終わったらすぐに次を送る（フレーム間の隙間は方式ごとの最小）
+// 方式ごとに次を表示する
+//   frames/s : 正しく受信できたフレーム数/かかった時間
+//   err      : 受信できなかったか中身が違ったフレームの割合（FIFOに入らず送らなかった分も含む）
+//   cpu      : CPUが待ち以外に使った時間の割合（wait_idleで待っていた時間をtime_us_32()の差で
+//              足し合わせ、かかった時間から引く。待ちの間に入った割り込みハンドラの時間は待ちに入る）
+//   max_len  : その長さ以下のフレームがすべて正しく受信できた最大の長さ
+//
+// 配線: TX_PINとRX_PINをつなぐ（3.3Vプルアップ）
+// 方式ごとにPIOの命令メモリを空にして読み込み直すので、どの方式もpio0(TX)とpio1(RX)のSM0を使う
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/pio.h"
+#include "joy_rx4.pio.h"
+#include "joy_rx5.pio.h"
+#include "joy_rx5_3s.pio.h"
+#include "joy_rx_os.pio.h"
+#include "joy_tx4.pio.h"
+#include "joy_tx5.pio.h"
+#include "joybus_decode.h"
+#include "joybus_dma_chain.h"
+#include "joybus_frame.h"
+#include "joybus_tx.h"
+#include "pico/bootrom.h"
+#include "pico/stdlib.h"
+#include <stdio.h>
+
+namespace {
+constexpr size_t RX_BUFFER_SIZE = JOYBUS_MAX_FRAME_BYTES + 1; // ストップビット分も確保
+// PIOのFIFOの段数（つながない場合）
+constexpr uint32_t PIO_FIFO_DEPTH = 4;
+
+// フレームの列
+constexpr uint32_t FRAME_COUNT = 1024;
+constexpr uint32_t FRAME_SEED = 1;
+// 1フレームの待ち時間（最長の16バイトでも送受信で約0.7ms）
+constexpr uint32_t FRAME_TIMEOUT_US = 2000;
+
+// joy_rx_osの1ビットあたりのサンプル数と想定するビット周期（examples/dmaと同じ）
+constexpr uint32_t RX_OVERSAMPLING = 16;
+constexpr uint32_t RX_BIT_PERIOD_NS = 5000;
+
+// 通電確認用のオンボードLED
+constexpr uint ONBOARD_LED_PIN = PICO_DEFAULT_LED_PIN;
+// BOOTSELに入るためのボタン入力
+constexpr uint BOOT_BTN_PIN = 26; // GP26
+// JoyBus
+constexpr uint TX_PIN = 15; // GP15
+constexpr uint RX_PIN = 16; // GP16
+
+// pio0: 送信、pio1: 受信（方式を切り替えるたびに読み込み直す）
+constexpr uint SM_TX = 0; // pio0
+constexpr uint SM_RX = 0; // pio1
+
+struct TestFrame {
+    uint8_t data[JOYBUS_MAX_FRAME_BYTES] = {0};
+    uint32_t nbytes = 0;
+    JoyBusTxFrame tx; // joy_tx5用に詰めたワード列
+};
+
+enum class FrameResult {
+    Ok,       // 受信した（中身の比較は呼び出し側）
+    Bad,      // 長さが足りないかストップビットがない
+    TooLong,  // この方式のFIFOに入らないので送らなかった
+    Timeout,  // 受信が終わらなかった
+    Mismatch, // 受信したが中身が違った（呼び出し側が判定）
+};
+constexpr size_t FRAME_RESULT_COUNT = 5;
+
+struct Variant {
+    const char *name;
+    void (*setup)();
+    void (*teardown)();
+    FrameResult (*transfer)(const TestFrame &frame, uint8_t *rx);
+};
+
+struct VariantStats {
+    uint32_t results[FRAME_RESULT_COUNT] = {0};
+    uint32_t ok_by_length[JOYBUS_MAX_FRAME_BYTES + 1] = {0};
+    uint32_t failed_by_length[JOYBUS_MAX_FRAME_BYTES + 1] = {0};
+    uint32_t elapsed_us = 0;
+    uint32_t idle_us = 0;
+};
+
+// 方式をまたいで使い回すもの（DMAチャンネルは最初に確保したものを方式ごとに使う）
+int dma_channels[3] = {-1, -1, -1};
+JoyBusTx joybus_tx;
+uint off_tx = 0;
+uint off_rx = 0;
+
+TestFrame test_frames[FRAME_COUNT];
+
+// wait_idleで待っていた時間の合計
+uint32_t idle_us = 0;
+
+void boot_btn_irq(uint gpio, uint32_t events) {
+    // ちょいデバウンス（押しっぱなし連打対策）
+    busy_wait_ms(100);
+    if (gpio_get(BOOT_BTN_PIN) == 0) {
+        printf("BOOTSEL button pressed. Entering USB boot mode...\n");
+        reset_usb_boot(0, 0);
+    }
+}
+
+void bootsel_button_init() {
+    gpio_init(BOOT_BTN_PIN);
+    gpio_set_dir(BOOT_BTN_PIN, GPIO_IN);
+    gpio_pull_up(BOOT_BTN_PIN);
+    gpio_set_irq_enabled_with_callback(BOOT_BTN_PIN, GPIO_IRQ_EDGE_FALL, true, &boot_btn_irq);
+}
+
+void init_bus_pins_safe() {
+    // バスへ接続するピンをHi-Zに設定
+    gpio_init(TX_PIN);
+    gpio_put(TX_PIN, 0);
+    gpio_set_dir(TX_PIN, GPIO_IN);
+
+    gpio_init(RX_PIN);
+    gpio_set_dir(RX_PIN, GPIO_IN);
+}
+
+void init_led() {
+    gpio_init(ONBOARD_LED_PIN);
+    gpio_set_dir(ONBOARD_LED_PIN, GPIO_OUT);
+    gpio_put(ONBOARD_LED_PIN, 1);
+}
+
+// done()が真になるまで待つ（timeout_usを過ぎたらfalse）
+// 待っていた時間をidle_usに足していく
+template <typename Done> bool wait_idle(Done done, uint32_t timeout_us) {
+    const uint32_t start_us = time_us_32();
+    bool ok = true;
+    while (!done()) {
+        if (time_us_32() - start_us > timeout_us) {
+            ok = false;
+            break;
+        }
+    }
+    idle_us += time_us_32() - start_us;
+    return ok;
+}
+
+void test_frames_init() {
+    uint32_t state = FRAME_SEED;
+    for (TestFrame &f : test_frames) {
+        joybus_frame_random(&f.tx, f.data, &state);
+        f.nbytes = f.tx.nbytes;
+    }
+}
+
+// --- 方式に共通のSMの設定 ---
+
+float clkdiv_for_hz(float hz) { return (float)clock_get_hz(clk_sys) / hz; }
+
+// TXはSETとPINDIRSでラインを制御する（出力ラッチは0、ピンは開放から始める）
+void tx_sm_init(pio_sm_config c, bool autopull) {
+    sm_config_set_set_pins(&c, TX_PIN, 1);
+    sm_config_set_out_shift(&c,
+                            /*shift_right=*/false,
+                            /*autopull=*/autopull,
+                            /*pull_thresh=*/32);
+    sm_config_set_clkdiv(&c, clkdiv_for_hz(4'000'000)); // 4MHz
+    pio_sm_set_consecutive_pindirs(pio0, SM_TX, TX_PIN, 1, false);
+    pio_sm_set_pins_with_mask(pio0, SM_TX, 0u, 1u << TX_PIN);
+    pio_sm_init(pio0, SM_TX, off_tx, &c);
+}
+
+void rx_sm_init(pio_sm_config c, uint push_thresh, float div) {
+    sm_config_set_in_pins(&c, RX_PIN);
+    sm_config_set_jmp_pin(&c, RX_PIN);
+    sm_config_set_in_shift(&c,
+                           /*shift_right=*/false,
+                           /*autopush=*/true,
+                           /*push_thresh=*/push_thresh);
+    sm_config_set_clkdiv(&c, div);
+    pio_sm_set_consecutive_pindirs(pio1, SM_RX, RX_PIN, 1, false);
+    pio_sm_init(pio1, SM_RX, off_rx, &c);
+}
+
+// RXが先に受信待ちになってからTXを起動する
+void sms_start() {
+    pio_sm_set_enabled(pio1, SM_RX, true);
+    sleep_us(100);
+    pio_sm_set_enabled(pio0, SM_TX, true);
+}
+
+// 受信の途中で止まったRXのSMを先頭からやり直す（restartしてもyとosrの中身は残る）
+void rx_sm_reset() {
+    pio_sm_set_enabled(pio1, SM_RX, false);
+    pio_sm_clear_fifos(pio1, SM_RX);
+    pio_sm_restart(pio1, SM_RX);
+    pio_sm_exec(pio1, SM_RX, pio_encode_jmp(off_rx));
+    pio_interrupt_clear(pio1, 2);
+    pio_sm_set_enabled(pio1, SM_RX, true);
+}
+
+void sms_teardown() {
+    pio_sm_set_enabled(pio0, SM_TX, false);
+    pio_sm_set_enabled(pio1, SM_RX, false);
+    pio_sm_clear_fifos(pio0, SM_TX);
+    pio_sm_clear_fifos(pio1, SM_RX);
+    pio_sm_set_consecutive_pindirs(pio0, SM_TX, TX_PIN, 1, false);
+    pio_clear_instruction_memory(pio0);
+    pio_clear_instruction_memory(pio1);
+    for (uint i = 0; i < 8; ++i) {
+        pio_interrupt_clear(pio0, i);
+        pio_interrupt_clear(pio1, i);
+    }
+}
+
+// --- polling: joy_tx4/joy_rx4（send_receive_3s） ---
+
+void polling_setup() {
+    off_tx = pio_add_program(pio0, &joy_tx4_program);
+    off_rx = pio_add_program(pio1, &joy_rx4_program);
+    // joy_tx4は1バイトずつpullして上位8ビットを送る
+    tx_sm_init(joy_tx4_program_get_default_config(off_tx), /*autopull=*/false);
+    // 3点でサンプリングするため3 * 8 = 24ビットずつ受信
+    rx_sm_init(joy_rx4_program_get_default_config(off_rx), 24, clkdiv_for_hz(4'000'000));
+    sms_start();
+}
+
+// ストップビットもビット数の指定もないので、CPUが送ったバイト数だけ受け取るまで両方のFIFOを見続ける
+// TX FIFOに空きができるか受信データが来るまでが待ち
+FrameResult polling_transfer(const TestFrame &frame, uint8_t *rx) {
+    uint32_t sent = 0;
+    uint32_t received = 0;
+    const uint32_t start_us = time_us_32();
+    while (received < frame.nbytes) {
+        const uint32_t elapsed_us = time_us_32() - start_us;
+        const auto ready = [&] {
+            return (sent < frame.nbytes && !pio_sm_is_tx_fifo_full(pio0, SM_TX)) ||
+                   !pio_sm_is_rx_fifo_empty(pio1, SM_RX);
+        };
+        if (elapsed_us > FRAME_TIMEOUT_US || !wait_idle(ready, FRAME_TIMEOUT_US - elapsed_us)) {
+            pio_sm_clear_fifos(pio0, SM_TX);
+            rx_sm_reset();
+            return FrameResult::Timeout;
+        }
+        if (sent < frame.nbytes && !pio_sm_is_tx_fifo_full(pio0, SM_TX)) {
+            pio_sm_put(pio0, SM_TX, (uint32_t)frame.data[sent++] << 24);
+        }
+        if (!pio_sm_is_rx_fifo_empty(pio1, SM_RX)) {
+            rx[received++] = joybus_decode_3sample(pio_sm_get(pio1, SM_RX));
+        }
+    }
+    return FrameResult::Ok;
+}
+
+// --- fifo: joy_tx5/joy_rx5_3s（stop_bit） ---
+
+void fifo_setup() {
+    off_tx = pio_add_program(pio0, &joy_tx5_program);
+    off_rx = pio_add_program(pio1, &joy_rx5_3s_program);
+    tx_sm_init(joy_tx5_program_get_default_config(off_tx), /*autopull=*/true);
+    rx_sm_init(joy_rx5_3s_program_get_default_config(off_rx), 24, clkdiv_for_hz(4'000'000));
+    sms_start();
+}
+
+// ビット数とデータをTX FIFOに積んでから送信を指示し、フレームが終わるまでCPUは触らない
+// RX FIFOは4段なので、5バイト目からはSMがautopushで止まって取りこぼす
+FrameResult fifo_transfer(const TestFrame &frame, uint8_t *rx) {
+    // SMはirq 0まで待つので、FIFOに入る4ワード（ビット数+12バイト）までしか送れない
+    if (frame.tx.word_count > PIO_FIFO_DEPTH) {
+        return FrameResult::TooLong;
+    }
+    if (!wait_idle([] { return pio_interrupt_get(pio0, 1); }, FRAME_TIMEOUT_US)) {
+        return FrameResult::Timeout;
+    }
+    pio_interrupt_clear(pio0, 1);
+    pio_sm_put(pio1, SM_RX, frame.nbytes * 8 - 1);
+    for (uint32_t i = 0; i < frame.tx.word_count; ++i) {
+        pio_sm_put(pio0, SM_TX, frame.tx.words[i]);
+    }
+    pio0->irq_force = 1u << 0;
+
+    const uint32_t expected = frame.nbytes < PIO_FIFO_DEPTH ? frame.nbytes : PIO_FIFO_DEPTH;
+    const bool done = wait_idle(
+        [expected] {
+            return pio_interrupt_get(pio0, 1) &&
+                   pio_sm_get_rx_fifo_level(pio1, SM_RX) >= expected;
+        },
+        FRAME_TIMEOUT_US);
+    uint32_t received = 0;
+    while (received < frame.nbytes && !pio_sm_is_rx_fifo_empty(pio1, SM_RX)) {
+        rx[received++] = joybus_decode_3sample(pio_sm_get(pio1, SM_RX));
+    }
+    if (!done || received < frame.nbytes || pio_interrupt_get(pio1, 2)) {
+        // RXのSMは残りのビットかストップビットを待っている
+        rx_sm_reset();
+        return done ? FrameResult::Bad : FrameResult::Timeout;
+    }
+    return FrameResult::Ok;
+}
+
+// --- dma: joy_tx5/joy_rx_os + joybus_dma_chain（dma） ---
+
+// examples/dmaと同じブロックの列（RX起動・送信開始・TXワード・終端）
+struct DmaTransaction {
+    JoyBusDmaChain chain;
+    JoyBusDmaBlock blocks[4] = {};
+    uint32_t rx_buffer_addr = 0;
+    uint32_t start_irq_mask = 1u << 0;
+    uint8_t rx_data[RX_BUFFER_SIZE] = {0};
+    volatile bool done = false;
+};
+
+DmaTransaction dma_transaction;
+
+void __isr __not_in_flash_func(dma_transaction_irq_handler)() {
+    DmaTransaction &t = dma_transaction;
+    if (!joybus_dma_chain_take_rx_irq0(&t.chain)) {
+        return;
+    }
+    t.done = true;
+}
+
+void dma_setup() {
+    DmaTransaction &t = dma_transaction;
+    off_tx = pio_add_program(pio0, &joy_tx5_program);
+    off_rx = pio_add_program(pio1, &joy_rx_os_program);
+    tx_sm_init(joy_tx5_program_get_default_config(off_tx), /*autopull=*/true);
+    // RXは1サンプル2サイクルでRX_OVERSAMPLINGサンプル/ビットになるように分周する
+    const float rx_div = clkdiv_for_hz(2.0f * RX_OVERSAMPLING * 1e9f / RX_BIT_PERIOD_NS);
+    rx_sm_init(joy_rx_os_program_get_default_config(off_rx), 8, rx_div < 1.0f ? 1.0f : rx_div);
+    // しきい値（y）とフレーム終端の長さ（osr）をサンプル数で渡す
+    pio_sm_put_blocking(pio1, SM_RX, RX_OVERSAMPLING / 2 - 1);
+    pio_sm_exec(pio1, SM_RX, pio_encode_pull(false, true));
+    pio_sm_exec(pio1, SM_RX, pio_encode_mov(pio_y, pio_osr));
+    pio_sm_put_blocking(pio1, SM_RX, RX_OVERSAMPLING);
+    pio_sm_exec(pio1, SM_RX, pio_encode_pull(false, true));
+    sms_start();
+
+    joybus_dma_chain_init_with_channels(&t.chain, pio0, SM_TX, pio1, SM_RX, dma_channels[0],
+                                        dma_channels[1], dma_channels[2]);
+    irq_set_exclusive_handler(DMA_IRQ_0, dma_transaction_irq_handler);
+    irq_set_enabled(DMA_IRQ_0, true);
+}
+
+void dma_teardown() {
+    DmaTransaction &t = dma_transaction;
+    irq_set_enabled(DMA_IRQ_0, false);
+    irq_remove_handler(DMA_IRQ_0, dma_transaction_irq_handler);
+    dma_channel_set_irq0_enabled(t.chain.rx_chan, false);
+    joybus_dma_chain_abort(&t.chain);
+    sms_teardown();
+}
+
+FrameResult dma_transfer(const TestFrame &frame, uint8_t *rx) {
+    DmaTransaction &t = dma_transaction;
+    const JoyBusDmaChain *c = &t.chain;
+    t.rx_buffer_addr = (uint32_t)(uintptr_t)t.rx_data;
+    joybus_dma_chain_set_rx_count(c, frame.nbytes + 1);
+    t.blocks[0] = joybus_dma_block_rx_start(c, &t.rx_buffer_addr);
+    t.blocks[1] = joybus_dma_block_tx_start(c, &t.start_irq_mask);
+    t.blocks[2] = joybus_dma_block_tx_words(c, &frame.tx);
+    t.blocks[3] = joybus_dma_block_end();
+
+    t.done = false;
+    joybus_dma_chain_start(c, t.blocks);
+    if (!wait_idle([] { return dma_transaction.done; }, FRAME_TIMEOUT_US)) {
+        joybus_dma_chain_abort(c);
+        rx_sm_reset();
+        return FrameResult::Timeout;
+    }
+    // 受信データは判定済みのバイト列（最後がストップビット）
+    if (t.rx_data[frame.nbytes] != 0x01) {
+        return FrameResult::Bad;
+    }
+    for (uint32_t i = 0; i < frame.nbytes; ++i) {
+        rx[i] = t.rx_data[i];
+    }
+    return FrameResult::Ok;
+}
+
+// --- stop_bit: joybus_tx + joy_rx5のストップビット検出（detect_stop_bit） ---
+
+struct StopBitRx {
+    int dma_channel = -1;
+    dma_channel_config dma_config{};
+    uint8_t work[RX_BUFFER_SIZE] = {0};
+    volatile uint32_t length = 0; // ストップビットを除いた長さ
+    volatile bool ready = false;
+    volatile bool bad = false;
+};
+
+StopBitRx stop_bit_rx;
+
+// フレーム終端（joy_rx5のirq set 0 rel）
+void __isr __not_in_flash_func(stop_bit_irq_handler)() {
+    StopBitRx &r = stop_bit_rx;
+    if (!pio_interrupt_get(pio1, SM_RX)) {
+        return;
+    }
+    pio_interrupt_clear(pio1, SM_RX);
+    // 最後にpushされたバイト（ストップビット）がDMAで移るのを待つ
+    while (!pio_sm_is_rx_fifo_empty(pio1, SM_RX)) {
+        tight_loop_contents();
+    }
+    const uint32_t count = RX_BUFFER_SIZE - dma_channel_hw_addr(r.dma_channel)->transfer_count;
+    dma_channel_abort(r.dma_channel);
+    // 2バイト以上受信+最後のバイトがストップビット(0x01)
+    if (count >= 2 && r.work[count - 1] == 0x01) {
+        r.length = count - 1;
+        r.ready = true;
+    } else {
+        r.bad = true;
+    }
+}
+
+void stop_bit_setup() {
+    StopBitRx &r = stop_bit_rx;
+    off_tx = pio_add_program(pio0, &joy_tx5_program);
+    off_rx = pio_add_program(pio1, &joy_rx5_program);
+    tx_sm_init(joy_tx5_program_get_default_config(off_tx), /*autopull=*/true);
+    rx_sm_init(joy_rx5_program_get_default_config(off_rx), 8, clkdiv_for_hz(4'000'000));
+    sms_start();
+
+    r.dma_channel = dma_channels[0];
+    r.dma_config = dma_channel_get_default_config(r.dma_channel);
+    channel_config_set_transfer_data_size(&r.dma_config, DMA_SIZE_8);
+    channel_config_set_dreq(&r.dma_config, pio_get_dreq(pio1, SM_RX, false));
+    channel_config_set_read_increment(&r.dma_config, false);
+    channel_config_set_write_increment(&r.dma_config, true);
+
+    pio_interrupt_clear(pio1, SM_RX);
+    pio_set_irq0_source_enabled(pio1, (pio_interrupt_source_t)(pis_interrupt0 + SM_RX), true);
+    irq_set_exclusive_handler(PIO1_IRQ_0, stop_bit_irq_handler);
+    irq_set_priority(PIO1_IRQ_0, PICO_HIGHEST_IRQ_PRIORITY);
+    irq_set_enabled(PIO1_IRQ_0, true);
+}
+
+void stop_bit_teardown() {
+    irq_set_enabled(PIO1_IRQ_0, false);
+    irq_remove_handler(PIO1_IRQ_0, stop_bit_irq_handler);
+    pio_set_irq0_source_enabled(pio1, (pio_interrupt_source_t)(pis_interrupt0 + SM_RX), false);
+    dma_channel_abort(stop_bit_rx.dma_channel);
+    dma_channel_abort(joybus_tx.dma_channel);
+    sms_teardown();
+}
+
+FrameResult stop_bit_transfer(const TestFrame &frame, uint8_t *rx) {
+    StopBitRx &r = stop_bit_rx;
+    r.ready = false;
+    r.bad = false;
+    dma_channel_set_config(r.dma_channel, &r.dma_config, false);
+    dma_channel_set_read_addr(r.dma_channel, &pio1->rxf[SM_RX], false);
+    dma_channel_transfer_to_buffer_now(r.dma_channel, r.work, RX_BUFFER_SIZE);
+
+    joybus_tx_send(&joybus_tx, &frame.tx);
+    if (!wait_idle([] { return stop_bit_rx.ready || stop_bit_rx.bad; }, FRAME_TIMEOUT_US)) {
+        dma_channel_abort(r.dma_channel);
+        rx_sm_reset();
+        return FrameResult::Timeout;
+    }
+    if (r.bad || r.length != frame.nbytes) {
+        return FrameResult::Bad;
+    }
+    for (uint32_t i = 0; i < frame.nbytes; ++i) {
+        rx[i] = r.work[i];
+    }
+    return FrameResult::Ok;
+}
+
+const Variant VARIANTS[] = {
+    {"polling", polling_setup, sms_teardown, polling_transfer},
+    {"fifo", fifo_setup, sms_teardown, fifo_transfer},
+    {"dma", dma_setup, dma_teardown, dma_transfer},
+    {"stop_bit", stop_bit_setup, stop_bit_teardown, stop_bit_transfer},
+};
+constexpr size_t VARIANT_COUNT = sizeof(VARIANTS) / sizeof(VARIANTS[0]);
+
+VariantStats variant_stats[VARIANT_COUNT];
+
+void run_variant(const Variant &variant, VariantStats *stats) {
+    *stats = VariantStats{};
+    variant.setup();
+
+    idle_us = 0;
+    const uint32_t start_us = time_us_32();
+    for (const TestFrame &frame : test_frames) {
+        uint8_t rx[JOYBUS_MAX_FRAME_BYTES];
+        FrameResult result = variant.transfer(frame, rx);
+        if (result == FrameResult::Ok) {
+            for (uint32_t i = 0; i < frame.nbytes; ++i) {
+                if (rx[i] != frame.data[i]) {
+                    result = FrameResult::Mismatch;
+                    break;
+                }
+            }
+        }
+        ++stats->results[(size_t)result];
+        if (result == FrameResult::Ok) {
+            ++stats->ok_by_length[frame.nbytes];
+        } else {
+            ++stats->failed_by_length[frame.nbytes];
+        }
+    }
+    stats->elapsed_us = time_us_32() - start_us;
+    stats->idle_us = idle_us;
+
+    variant.teardown();
+}
+
+void print_matrix() {
+    printf("%-9s %9s %7s %6s %7s  %s\n", "variant", "frames/s", "err", "cpu", "max_len",
+           "ok/bad/too_long/timeout/mismatch");
+    for (size_t v = 0; v < VARIANT_COUNT; ++v) {
+        const VariantStats &s = variant_stats[v];
+        const uint32_t ok = s.results[(size_t)FrameResult::Ok];
+        const float seconds = s.elapsed_us / 1e6f;
+        const float busy = 100.0f * (1.0f - (float)s.idle_us / s.elapsed_us);
+
+        // その長さまでのフレームがすべて正しく受信できた最大の長さ
+        uint32_t max_len = 0;
+        for (uint32_t n = 1; n <= JOYBUS_MAX_FRAME_BYTES; ++n) {
+            if (s.failed_by_length[n] != 0) {
+                break;
+            }
+            max_len = s.ok_by_length[n] != 0 ? n : max_len;
+        }
+
+        printf("%-9s %9.0f %6.2f%% %5.1f%% %7lu  %lu/%lu/%lu/%lu/%lu\n", VARIANTS[v].name,
+               ok / seconds, 100.0f * (FRAME_COUNT - ok) / FRAME_COUNT, busy,
+               (unsigned long)max_len, (unsigned long)ok,
+               (unsigned long)s.results[(size_t)FrameResult::Bad],
+               (unsigned long)s.results[(size_t)FrameResult::TooLong],
+               (unsigned long)s.results[(size_t)FrameResult::Timeout],
+               (unsigned long)s.results[(size_t)FrameResult::Mismatch]);
+    }
+}
+} // namespace
+
+int main() {
+    stdio_init_all();
+    bootsel_button_init();
+
+    // 動作開始の確認用にオンボードLEDを光らせる
+    init_led();
+
+    init_bus_pins_safe();
+
+    pio_gpio_init(pio0, TX_PIN);
+    pio_gpio_init(pio1, RX_PIN);
+    gpio_pull_up(TX_PIN); // open-drainのHigh維持の補助（外付けがあるなら無くてもOK）
+    gpio_pull_up(RX_PIN); // 必須寄り
+
+    for (int &channel : dma_channels) {
+        channel = dma_claim_unused_channel(true);
+    }
+    // 書き込み先（pio0のSM0のTX FIFO）は方式を切り替えても変わらない
+    joybus_tx_init(&joybus_tx, pio0, SM_TX);
+
+    test_frames_init();
+    printf("variant_matrix ready (%lu frames).\n", (unsigned long)FRAME_COUNT);
+
+    while (true) {
+        for (size_t v = 0; v < VARIANT_COUNT; ++v) {
+            run_variant(VARIANTS[v], &variant_stats[v]);
+        }
+        print_matrix();
+        sleep_ms(5000);
+    }
+}
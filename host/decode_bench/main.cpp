@@ -0,0 +1,171 @@
+// 3点サンプリングのデコーダ（lib/joybus/joybus_decode.h）の検証とベンチマーク
+// 1. 24ビットの全パターンでloop版・SWAR版・表引き版の結果が一致するか確認する
+//    （そろわなかったサンプルも返すchecked版は、少数派のサンプルの位置も1ビットずつ確かめる）
+// 2. DMAバッファ相当のワード列をデコードして1バイトあたりの時間を比べる
+// 実機での比較は examples/decode_bench を使う
+#include "joybus_decode.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_RDTSC 1
+#endif
+
+namespace {
+
+// ベンチマーク用のバッファ長（JoyBusの最大フレーム長10バイト × 100フレーム分）
+constexpr size_t BENCH_WORDS = 1000;
+constexpr int BENCH_REPEAT = 20000;
+
+// checked版の少数派のサンプルの位置を1ビットずつ確かめる
+bool minority_matches(uint32_t w, const JoyBus3SampleDecode &d) {
+    for (int i = 0; i < 8; ++i) {
+        const int base = 23 - 3 * i;
+        const uint32_t s[3] = {(w >> base) & 1u, (w >> (base - 1)) & 1u, (w >> (base - 2)) & 1u};
+        const uint32_t majority = (s[0] + s[1] + s[2]) >= 2 ? 1u : 0u;
+        for (int k = 0; k < 3; ++k) {
+            if (((d.minority[k] >> (7 - i)) & 1u) != (s[k] ^ majority)) {
+                return false;
+            }
+        }
+    }
+    return d.disagree == (d.minority[0] | d.minority[1] | d.minority[2]);
+}
+
+bool verify_all() {
+    uint32_t mismatches = 0;
+    for (uint32_t w = 0; w < (1u << 24); ++w) {
+        const uint8_t ref = joybus_decode_3sample_loop(w);
+        // 上位8ビットにゴミが乗っていても結果が変わらないことも確認する
+        const uint32_t dirty = w | 0xA5000000u;
+        const JoyBus3SampleDecode checked = joybus_decode_3sample_checked(dirty);
+        if (joybus_decode_3sample_swar(dirty) != ref || joybus_decode_3sample_lut(w) != ref ||
+            checked.value != ref || !minority_matches(w, checked)) {
+            if (mismatches < 8) {
+                printf("mismatch: w=0x%06X loop=0x%02X swar=0x%02X lut=0x%02X\n", w, ref,
+                       joybus_decode_3sample_swar(dirty), joybus_decode_3sample_lut(w));
+            }
+            ++mismatches;
+        }
+    }
+    printf("verify: %u mismatches in 2^24 inputs\n", mismatches);
+    return mismatches == 0;
+}
+
+struct Timing {
+    double ns_per_byte;
+    double ticks_per_byte;
+};
+
+template <typename F> Timing measure(F &&decode_buffer) {
+    using clock = std::chrono::steady_clock;
+    const auto t0 = clock::now();
+#ifdef HAVE_RDTSC
+    const uint64_t c0 = __rdtsc();
+#endif
+    for (int r = 0; r < BENCH_REPEAT; ++r) {
+        decode_buffer();
+    }
+#ifdef HAVE_RDTSC
+    const uint64_t c1 = __rdtsc();
+#endif
+    const auto t1 = clock::now();
+    const double bytes = (double)BENCH_WORDS * BENCH_REPEAT;
+    Timing t{};
+    t.ns_per_byte = std::chrono::duration<double, std::nano>(t1 - t0).count() / bytes;
+#ifdef HAVE_RDTSC
+    t.ticks_per_byte = (double)(c1 - c0) / bytes;
+#endif
+    return t;
+}
+
+void print_timing(const char *name, const Timing &t, uint32_t checksum) {
+#ifdef HAVE_RDTSC
+    printf("  %-12s %6.3f ns/byte  %6.2f TSC ticks/byte  (checksum %08X)\n", name, t.ns_per_byte,
+           t.ticks_per_byte, checksum);
+#else
+    printf("  %-12s %6.3f ns/byte  (checksum %08X)\n", name, t.ns_per_byte, checksum);
+#endif
+}
+
+uint32_t checksum(const std::vector<uint8_t> &v) {
+    uint32_t sum = 0;
+    for (uint8_t b : v) {
+        sum = sum * 31 + b;
+    }
+    return sum;
+}
+
+} // namespace
+
+int main() {
+    if (!verify_all()) {
+        return 1;
+    }
+
+    // 実際の受信データに近い「3サンプルがそろった」ワードと完全ランダムなワードを混ぜる
+    std::mt19937 rng(1);
+    std::vector<uint32_t> words(BENCH_WORDS);
+    for (size_t i = 0; i < words.size(); ++i) {
+        uint32_t w = 0;
+        if (i % 2 == 0) {
+            for (int b = 0; b < 8; ++b) {
+                w = (w << 3) | ((rng() & 1u) ? 0x7u : 0x0u);
+            }
+        } else {
+            w = rng() & 0x00FFFFFFu;
+        }
+        words[i] = w;
+    }
+    std::vector<uint8_t> out(BENCH_WORDS);
+    volatile uint32_t sink = 0;
+
+    printf("bench: %zu words x %d\n", BENCH_WORDS, BENCH_REPEAT);
+    Timing t = measure([&] {
+        for (size_t i = 0; i < words.size(); ++i) {
+            out[i] = joybus_decode_3sample_loop(words[i]);
+        }
+        sink = sink + out[0];
+    });
+    print_timing("loop", t, checksum(out));
+    t = measure([&] {
+        for (size_t i = 0; i < words.size(); ++i) {
+            out[i] = joybus_decode_3sample_swar(words[i]);
+        }
+        sink = sink + out[0];
+    });
+    print_timing("swar", t, checksum(out));
+    t = measure([&] {
+        for (size_t i = 0; i < words.size(); ++i) {
+            out[i] = joybus_decode_3sample_lut(words[i]);
+        }
+        sink = sink + out[0];
+    });
+    print_timing("lut", t, checksum(out));
+    t = measure([&] {
+        uint32_t disagree = 0;
+        for (size_t i = 0; i < words.size(); ++i) {
+            const JoyBus3SampleDecode d = joybus_decode_3sample_checked(words[i]);
+            out[i] = d.value;
+            disagree += d.disagree;
+        }
+        sink = sink + out[0] + disagree;
+    });
+    print_timing("checked", t, checksum(out));
+    t = measure([&] {
+        joybus_decode_3sample_words(words.data(), out.data(), words.size());
+        sink = sink + out[0];
+    });
+    print_timing("words", t, checksum(out));
+    t = measure([&] {
+        joybus_decode_3sample_words_lut(words.data(), out.data(), words.size());
+        sink = sink + out[0];
+    });
+    print_timing("words_lut", t, checksum(out));
+    return 0;
+}
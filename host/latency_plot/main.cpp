@@ -0,0 +1,177 @@
+// examples/latency_benchがUARTに書き出したダンプ（lib/joybus/include/joybus_latency.h）を読み、
+// 区間ごとのmin/median/p99/maxとヒストグラムを表示する
+//   latency_plot <キャプチャしたファイル> [CSVの出力先]
+// キャプチャはUARTの出力をそのまま保存したもの（テキストの行の間に"#LATENCY <バイト数>"と
+// バイナリが挟まる）。ダンプが複数あれば最後のものを使う
+// CSVは1行1ビン（ビンの下端[us], 区間ごとの数）で、gnuplotなどでそのままグラフにできる
+//   gnuplot> set datafile separator ','
+//   gnuplot> plot for [i=2:4] 'latency.csv' using 1:i with steps title columnhead(i)
+#include "joybus_latency.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr size_t HISTOGRAM_ROWS = 24;
+constexpr size_t HISTOGRAM_WIDTH = 50;
+constexpr char DUMP_TAG[] = "#LATENCY ";
+
+std::vector<uint8_t> read_file(const char *path) {
+    std::vector<uint8_t> data;
+    FILE *f = fopen(path, "rb");
+    if (f == nullptr) {
+        return data;
+    }
+    uint8_t buf[4096];
+    size_t n = 0;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        data.insert(data.end(), buf, buf + n);
+    }
+    fclose(f);
+    return data;
+}
+
+// 最後の正しいダンプを探す（見つからなければfalse）
+bool find_last_dump(const std::vector<uint8_t> &data, JoyBusLatencyDump *out, size_t *found) {
+    const size_t tag_length = sizeof(DUMP_TAG) - 1;
+    bool ok = false;
+    *found = 0;
+    for (size_t i = 0; i + tag_length < data.size(); ++i) {
+        if (memcmp(&data[i], DUMP_TAG, tag_length) != 0) {
+            continue;
+        }
+        // "#LATENCY <バイト数>\n"（CRLFでもよい）
+        size_t p = i + tag_length;
+        unsigned long length = 0;
+        while (p < data.size() && data[p] >= '0' && data[p] <= '9') {
+            length = length * 10 + (data[p++] - '0');
+        }
+        if (p < data.size() && data[p] == '\r') {
+            ++p;
+        }
+        if (p >= data.size() || data[p] != '\n') {
+            continue;
+        }
+        ++p;
+        ++*found;
+        if (length != sizeof(JoyBusLatencyDump) || p + length > data.size()) {
+            fprintf(stderr, "dump at %zu: size %lu (expected %zu)\n", i, length,
+                    sizeof(JoyBusLatencyDump));
+            continue;
+        }
+        JoyBusLatencyDump d;
+        memcpy(&d, &data[p], length);
+        if (d.magic != JOYBUS_LATENCY_MAGIC || d.version != JOYBUS_LATENCY_VERSION ||
+            d.checksum != joybus_latency_checksum(d)) {
+            fprintf(stderr, "dump at %zu: bad magic/version/checksum\n", i);
+            continue;
+        }
+        *out = d;
+        ok = true;
+        i = p + length - 1;
+    }
+    return ok;
+}
+
+void print_histogram(uint32_t interval, const JoyBusLatencyHistogram &h, uint32_t clk_hz) {
+    const double cycles_per_us = clk_hz / 1e6;
+    printf("\n%s (%lu samples, %lu overflow)\n", joybus_latency_interval_name(interval),
+           (unsigned long)h.count, (unsigned long)h.overflow);
+    if (h.count == 0) {
+        return;
+    }
+    printf("  min=%.3fus median=%.3fus p99=%.3fus max=%.3fus\n", h.min / cycles_per_us,
+           joybus_latency_percentile(h, 500) / cycles_per_us,
+           joybus_latency_percentile(h, 990) / cycles_per_us, h.max / cycles_per_us);
+
+    // min〜maxのビンをHISTOGRAM_ROWS行以内にまとめる（overflowの分は表示しない）
+    const uint32_t first = h.min / h.bin_cycles;
+    uint32_t last = h.max / h.bin_cycles;
+    if (first >= JOYBUS_LATENCY_BINS) {
+        return;
+    }
+    last = last < JOYBUS_LATENCY_BINS ? last : JOYBUS_LATENCY_BINS - 1;
+    const uint32_t per_row = (last - first + HISTOGRAM_ROWS) / HISTOGRAM_ROWS;
+    std::vector<uint64_t> rows;
+    uint64_t peak = 0;
+    for (uint32_t bin = first; bin <= last; bin += per_row) {
+        uint64_t sum = 0;
+        for (uint32_t i = bin; i < bin + per_row && i <= last; ++i) {
+            sum += h.bins[i];
+        }
+        rows.push_back(sum);
+        peak = sum > peak ? sum : peak;
+    }
+    for (size_t r = 0; r < rows.size(); ++r) {
+        const uint32_t lo = (first + (uint32_t)r * per_row) * h.bin_cycles;
+        // 少数のはずれ値も見えるように、0でなければ最低1文字出す
+        size_t bar = peak == 0 ? 0 : (size_t)(rows[r] * HISTOGRAM_WIDTH / peak);
+        bar = rows[r] != 0 && bar == 0 ? 1 : bar;
+        printf("  %9.3fus %8llu %s\n", lo / cycles_per_us, (unsigned long long)rows[r],
+               std::string(bar, '#').c_str());
+    }
+}
+
+bool write_csv(const char *path, const JoyBusLatencyDump &d) {
+    FILE *f = fopen(path, "w");
+    if (f == nullptr) {
+        return false;
+    }
+    const double cycles_per_us = d.clk_hz / 1e6;
+    fprintf(f, "bin_us");
+    for (uint32_t i = 0; i < JOYBUS_LATENCY_INTERVALS; ++i) {
+        fprintf(f, ",%s", joybus_latency_interval_name(i));
+    }
+    fprintf(f, "\n");
+    // ビンの幅は区間ごとに持っているが、ファームウェアはすべて同じにしている
+    const uint32_t bin_cycles = d.histograms[0].bin_cycles;
+    for (uint32_t bin = 0; bin < JOYBUS_LATENCY_BINS; ++bin) {
+        fprintf(f, "%.4f", bin * bin_cycles / cycles_per_us);
+        for (uint32_t i = 0; i < JOYBUS_LATENCY_INTERVALS; ++i) {
+            fprintf(f, ",%lu", (unsigned long)d.histograms[i].bins[bin]);
+        }
+        fprintf(f, "\n");
+    }
+    fclose(f);
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <capture> [out.csv]\n", argv[0]);
+        return 1;
+    }
+    const std::vector<uint8_t> data = read_file(argv[1]);
+    if (data.empty()) {
+        fprintf(stderr, "cannot read %s\n", argv[1]);
+        return 1;
+    }
+
+    static JoyBusLatencyDump dump; // 6KB強あるので静的に置く
+    size_t found = 0;
+    if (!find_last_dump(data, &dump, &found)) {
+        fprintf(stderr, "no valid dump in %s (%zu tagged)\n", argv[1], found);
+        return 1;
+    }
+
+    printf("%zu dump(s), using the last: clk_sys=%luHz transactions=%lu timeout=%lu error=%lu\n",
+           found, (unsigned long)dump.clk_hz, (unsigned long)dump.transactions,
+           (unsigned long)dump.timeouts, (unsigned long)dump.errors);
+    for (uint32_t i = 0; i < JOYBUS_LATENCY_INTERVALS; ++i) {
+        print_histogram(i, dump.histograms[i], dump.clk_hz);
+    }
+
+    if (argc > 2) {
+        if (!write_csv(argv[2], dump)) {
+            fprintf(stderr, "cannot write %s\n", argv[2]);
+            return 1;
+        }
+        printf("\nwrote %s\n", argv[2]);
+    }
+    return 0;
+}
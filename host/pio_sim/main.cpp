@@ -0,0 +1,956 @@
+// examples/以下のJoyBus送受信プログラムをPIOシミュレータ上で動かす
+//
+//   pio_sim loopback [--variant NAME] [--frames N] [--max-len N] [--seed N] [--vcd FILE]
+//                    [--oversampling N]
+//     TX_PINとRX_PINをつないだループバックで送受信し、誤り数と実測したビット波形、
+//     3点サンプリングの受信側のサンプル位置とタイミング余裕を表示する
+//   pio_sim margin [--variant NAME] [--frames N] [--seed N] [--oversampling N]
+//     外部からビット長・Low期間を変えた波形を入れ、受信側が正しく読める範囲を求める
+//   pio_sim gencheck [--root DIR]
+//     joybus_pio_gen.hが4MHzで作るプログラムがjoy_tx5.pio / joy_rx5.pioと同じ命令語か確かめ、
+//     gen_*のバリアントで作ったプログラムの長さを表示する
+//   pio_sim bitrate [--root DIR]
+//     examples/multi_portと同じ手順で、5us/bitで送ったidentifyの後に違う速さで返る応答の
+//     ビット周期をjoy_edgeで測り、自分のコマンドではなく応答の速さが測れているか確かめる
+//
+// 誤りがあれば終了コード1を返すのでCIでも使える
+
+#include "joybus_decode.h"
+#include "joybus_edge.h"
+#include "joybus_frame.h"
+#include "joybus_pio_gen.h"
+#include "pio_asm.h"
+#include "pio_sim.h"
+#include "vcd_writer.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifndef GC_PLAYGROUND_ROOT
+#define GC_PLAYGROUND_ROOT "."
+#endif
+
+namespace {
+using namespace pio_sim;
+
+// 各exampleと同じくPIOは4MHzで動かす
+constexpr float PIO_HZ = 4'000'000;
+
+enum class TxKind {
+    PerByte, // joy_tx4: 1バイトずつpullして送る（ストップビットなし）
+    Counted, // joy_tx5: ビット数-1とデータワードをautopullで送り、最後にストップビット
+};
+
+enum class RxKind {
+    ThreeSamplePerByte, // joy_rx4: 3点サンプリングを1バイト(24サンプル)ずつpush
+    ThreeSampleCounted, // joy_rx5(stop_bit/dma): 期待ビット数を受け取り3点サンプリング+ストップビット確認
+    StopBitDetect,      // joy_rx5(detect_stop_bit): Low期間で0/1を判定、タイムアウトでフレーム終端
+    Oversampled,        // joy_rx_os(dma): Lowのサンプル数で0/1を判定、Highが1ビット続いたら終端
+};
+
+struct Variant {
+    const char *name;
+    const char *tx_file;
+    const char *tx_program;
+    const char *rx_file;
+    const char *rx_program;
+    TxKind tx;
+    RxKind rx;
+    uint32_t tx_pio;
+    uint32_t tx_sm;
+    uint32_t rx_pio;
+    uint32_t rx_sm;
+    uint32_t tx_pin;
+    uint32_t rx_pin;
+    double bit_us;
+    // RxKind::Oversampledの1ビットあたりのサンプル数（--oversamplingで変えられる）
+    uint32_t rx_oversampling = 0;
+    // clk_sys_hzが0でなければ.pioの代わりにjoybus_pio_gen.hで作ったプログラムを使う
+    // （tx_file, rx_fileは使わない。PIOはclk_sys_hz / clkdivの整数分周で動かす）
+    JoyBusPioTiming gen{};
+};
+
+// 各exampleのmain.cppと同じPIO・SM・ピンの割り当て
+const Variant VARIANTS[] = {
+    {"send_receive_3s", "examples/send_receive_3s/joy_tx4.pio", "joy_tx4",
+     "examples/send_receive_3s/joy_rx4.pio", "joy_rx4", TxKind::PerByte,
+     RxKind::ThreeSamplePerByte, 0, 0, 0, 1, 16, 17, 4.0},
+    {"stop_bit", "examples/stop_bit/joy_tx5.pio", "joy_tx5", "examples/stop_bit/joy_rx5.pio",
+     "joy_rx5", TxKind::Counted, RxKind::ThreeSampleCounted, 0, 0, 1, 0, 15, 16, 5.0},
+    {"dma", "examples/dma/joy_tx5.pio", "joy_tx5", "examples/dma/joy_rx_os.pio", "joy_rx_os",
+     TxKind::Counted, RxKind::Oversampled, 0, 0, 1, 0, 15, 16, 5.0, 16},
+    {"detect_stop_bit", "examples/detect_stop_bit/joy_tx5.pio", "joy_tx5",
+     "examples/detect_stop_bit/joy_rx5.pio", "joy_rx5", TxKind::Counted, RxKind::StopBitDetect, 0,
+     0, 1, 0, 15, 16, 5.0},
+    // joy_tx5 / joy_rx5と同じ構成を整数分周のクロックで作ったもの（examples/generated_pio）
+    {"gen_div25", nullptr, "joy_tx5_gen", nullptr, "joy_rx5_gen", TxKind::Counted,
+     RxKind::ThreeSampleCounted, 0, 0, 1, 0, 15, 16, 5.0, 0,
+     joybus_pio_timing(DEFAULT_CLK_SYS_HZ, 25)}, // 5MHz, 25サイクル/ビット
+    {"gen_div5", nullptr, "joy_tx5_gen", nullptr, "joy_rx5_gen", TxKind::Counted,
+     RxKind::ThreeSampleCounted, 0, 0, 1, 0, 15, 16, 5.0, 0,
+     joybus_pio_timing(DEFAULT_CLK_SYS_HZ, 5)}, // 25MHz, 125サイクル/ビット
+};
+
+enum class FrameResult { Ok, Mismatch, Timeout, StopError, LengthMismatch };
+
+const char *result_name(FrameResult r) {
+    switch (r) {
+    case FrameResult::Ok:
+        return "ok";
+    case FrameResult::Mismatch:
+        return "mismatch";
+    case FrameResult::Timeout:
+        return "timeout";
+    case FrameResult::StopError:
+        return "stop_error";
+    case FrameResult::LengthMismatch:
+        return "length_mismatch";
+    }
+    return "?";
+}
+
+struct Programs {
+    PioProgram tx;
+    PioProgram rx;
+};
+
+// joybus_pio_gen.hの命令語の配列をアセンブラの出力と同じ形にする
+PioProgram gen_program(const JoyBusPioCode &code, const char *name) {
+    if (code.error != nullptr) {
+        throw std::runtime_error(std::string(name) + ": " + code.error);
+    }
+    PioProgram p;
+    p.name = name;
+    p.instructions.assign(code.instructions, code.instructions + code.length);
+    p.wrap_target = code.wrap_target;
+    p.wrap = code.wrap;
+    return p;
+}
+
+bool is_generated(const Variant &v) { return v.gen.clk_sys_hz != 0; }
+
+// joy_rx_osは1サンプル2サイクルなので、1ビットがrx_oversamplingサンプルになるように分周する
+float oversampled_rx_div(const Variant &v) {
+    const double rx_hz = 2.0 * v.rx_oversampling * 1e6 / v.bit_us;
+    const double div = DEFAULT_CLK_SYS_HZ / rx_hz;
+    if (v.rx_oversampling < 2 || div < 1.0) {
+        throw std::runtime_error(std::string(v.name) + ": oversampling " +
+                                 std::to_string(v.rx_oversampling) + " is out of range");
+    }
+    return (float)div;
+}
+
+// PIOのクロック（.pioのものは4MHz、生成したものは整数分周）
+float variant_pio_hz(const Variant &v) {
+    return is_generated(v) ? (float)(v.gen.clk_sys_hz / v.gen.clkdiv) : PIO_HZ;
+}
+
+Programs load_programs(const std::string &root, const Variant &v) {
+    if (is_generated(v)) {
+        if (v.gen.clk_sys_hz != DEFAULT_CLK_SYS_HZ) {
+            throw std::runtime_error(std::string(v.name) + ": clk_sys_hz must match the simulator");
+        }
+        return {gen_program(joybus_pio_gen_tx(v.gen), v.tx_program),
+                gen_program(joybus_pio_gen_rx(v.gen), v.rx_program)};
+    }
+    return {pio_load_program(root + "/" + v.tx_file, v.tx_program),
+            pio_load_program(root + "/" + v.rx_file, v.rx_program)};
+}
+
+// 最小値・最大値・平均だけを持つ集計
+struct Range {
+    uint64_t n = 0;
+    double min = 0;
+    double max = 0;
+    double sum = 0;
+    void add(double v) {
+        if (n == 0 || v < min) {
+            min = v;
+        }
+        if (n == 0 || v > max) {
+            max = v;
+        }
+        sum += v;
+        ++n;
+    }
+    double mean() const { return n ? sum / (double)n : 0; }
+};
+
+// ファームウェア（CPUとDMA）の代わりにPIOを操作するハーネス
+class Bench {
+  public:
+    Bench(const Variant &v, const Programs &programs, bool with_tx) : v_(v) {
+        const float div = (float)chip_.clk_sys_hz() / variant_pio_hz(v);
+        PioBlock &rx = chip_.pio(v.rx_pio);
+        off_rx_ = rx.add_program(programs.rx);
+        SmConfig c_rx = SmConfig::from_program(programs.rx, off_rx_);
+        c_rx.in_base = v.rx_pin;
+        c_rx.jmp_pin = v.rx_pin;
+        const bool byte_push = v.rx == RxKind::StopBitDetect || v.rx == RxKind::Oversampled;
+        c_rx.set_in_shift(false, true, byte_push ? 8 : 24);
+        c_rx.set_clkdiv(v.rx == RxKind::Oversampled ? oversampled_rx_div(v) : div);
+        chip_.pio_gpio_init(v.rx_pio, v.rx_pin);
+        chip_.gpio().set_pull_up(v.rx_pin, true);
+        rx.set_pindirs_with_mask(0, 1u << v.rx_pin);
+        rx.sm_init(v.rx_sm, off_rx_, c_rx);
+        if (v.rx == RxKind::Oversampled) {
+            // examples/dmaと同じく、しきい値（y）とフレーム終端の長さ（osr）をサンプル数で渡す
+            constexpr uint16_t PULL_BLOCK = 0x80A0;
+            constexpr uint16_t MOV_Y_OSR = 0xA047;
+            rx.sm_put(v.rx_sm, v.rx_oversampling / 2 - 1);
+            rx.sm_exec(v.rx_sm, PULL_BLOCK);
+            rx.sm_exec(v.rx_sm, MOV_Y_OSR);
+            rx.sm_put(v.rx_sm, v.rx_oversampling);
+            rx.sm_exec(v.rx_sm, PULL_BLOCK);
+        }
+        rx.sm_set_enabled(v.rx_sm, true);
+
+        if (with_tx) {
+            PioBlock &tx = chip_.pio(v.tx_pio);
+            off_tx_ = tx.add_program(programs.tx);
+            SmConfig c_tx = SmConfig::from_program(programs.tx, off_tx_);
+            c_tx.set_base = v.tx_pin;
+            c_tx.set_count = 1;
+            c_tx.set_out_shift(false, v.tx == TxKind::Counted, 32);
+            c_tx.set_clkdiv(div);
+            chip_.pio_gpio_init(v.tx_pio, v.tx_pin);
+            chip_.gpio().set_pull_up(v.tx_pin, true);
+            chip_.gpio().connect(v.tx_pin, v.rx_pin);
+            tx.set_pindirs_with_mask(0, 1u << v.tx_pin);
+            tx.set_pins_with_mask(0, 1u << v.tx_pin);
+            tx.sm_init(v.tx_sm, off_tx_, c_tx);
+        }
+        // RXが受信待ちになってからTXを起動する
+        run_cycles(chip_.us_to_cycles(20));
+        // rx_init と同じく起動直後に立つフレーム終端通知（irq set 0 rel）を捨てておく
+        rx.irq_clear(0xFF);
+        if (with_tx) {
+            chip_.pio(v.tx_pio).sm_set_enabled(v.tx_sm, true);
+        }
+    }
+
+    Rp2040 &chip() { return chip_; }
+    PioBlock &tx() { return chip_.pio(v_.tx_pio); }
+    PioBlock &rx() { return chip_.pio(v_.rx_pio); }
+    uint32_t off_rx() const { return off_rx_; }
+
+    // DMAの代わりにTX FIFOへ流し込む・RX FIFOから吸い出す
+    void step() {
+        chip_.step();
+        if (!tx_pending_.empty() && !tx().tx_full(v_.tx_sm)) {
+            tx().sm_put(v_.tx_sm, tx_pending_.front());
+            tx_pending_.pop_front();
+        }
+        uint32_t word = 0;
+        while (!rx().rx_empty(v_.rx_sm) && rx().sm_get(v_.rx_sm, &word)) {
+            rx_words_.push_back(word);
+        }
+    }
+
+    void run_cycles(uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            step();
+        }
+    }
+
+    template <typename F> bool run_until(F cond, uint64_t max_cycles) {
+        for (uint64_t i = 0; i < max_cycles; ++i) {
+            if (cond()) {
+                return true;
+            }
+            step();
+        }
+        return cond();
+    }
+
+    uint64_t bit_cycles() const { return chip_.us_to_cycles(v_.bit_us); }
+
+    // joybus_tx_send_dma と同じ手順で送信を開始する
+    bool start_tx_counted(const std::vector<uint8_t> &frame) {
+        const uint8_t done_bit = 1u << 1;
+        // 前の送信が終わる（irq 1）まで待つ
+        if (!run_until([&] { return (tx().irq_flags() & done_bit) != 0; },
+                       bit_cycles() * (JOYBUS_MAX_FRAME_BYTES * 8 + 8))) {
+            return false;
+        }
+        tx().irq_clear(done_bit);
+        // ファームウェアと同じ形に詰めたワード列をDMAの代わりに順に渡す
+        JoyBusTxFrame words;
+        if (!joybus_tx_frame_encode(&words, frame.data(), frame.size())) {
+            return false;
+        }
+        tx_pending_.insert(tx_pending_.end(), words.words, words.words + words.word_count);
+        tx().irq_force(1u << 0);
+        return true;
+    }
+
+    // RX側の準備（期待ビット数を渡す受信プログラムのみ）
+    void prepare_rx(size_t nbytes) {
+        rx_words_.clear();
+        if (v_.rx == RxKind::ThreeSampleCounted) {
+            rx().sm_put(v_.rx_sm, (uint32_t)(nbytes * 8 - 1));
+        }
+    }
+
+    // 受信完了を待ってデコードする
+    FrameResult finish_rx(size_t nbytes, std::vector<uint8_t> *out) {
+        out->clear();
+        const uint64_t frame_cycles = bit_cycles() * (nbytes * 8 + 4) + chip_.us_to_cycles(50);
+        switch (v_.rx) {
+        case RxKind::ThreeSamplePerByte:
+        case RxKind::ThreeSampleCounted: {
+            if (!run_until([&] { return rx_words_.size() >= nbytes; }, frame_cycles)) {
+                return FrameResult::Timeout;
+            }
+            for (size_t i = 0; i < nbytes; ++i) {
+                out->push_back(joybus_decode_3sample(rx_words_[i]));
+            }
+            if (v_.rx == RxKind::ThreeSampleCounted) {
+                // ストップビットの判定（irq 2）が終わるまで進める
+                run_until([&] { return rx().pc(v_.rx_sm) == off_rx_; }, bit_cycles() * 3);
+                if (rx().irq_flags() & (1u << 2)) {
+                    rx().irq_clear(1u << 2);
+                    return FrameResult::StopError;
+                }
+            }
+            return FrameResult::Ok;
+        }
+        case RxKind::StopBitDetect: {
+            // irq 0 rel（SM番号のフラグ）でフレーム終端が通知される
+            const uint8_t done_bit = (uint8_t)(1u << v_.rx_sm);
+            if (!run_until([&] { return (rx().irq_flags() & done_bit) != 0; }, frame_cycles)) {
+                return FrameResult::Timeout;
+            }
+            rx().irq_clear(done_bit);
+            // rx_finish_receive_from_irq と同じく最後のバイトがストップビット(0x01)か確認
+            const size_t count = rx_words_.size();
+            if (count < 2 || (rx_words_[count - 1] & 0xFFu) != 0x01) {
+                return FrameResult::StopError;
+            }
+            for (size_t i = 0; i + 1 < count; ++i) {
+                out->push_back((uint8_t)(rx_words_[i] & 0xFFu));
+            }
+            return out->size() == nbytes ? FrameResult::Ok : FrameResult::LengthMismatch;
+        }
+        case RxKind::Oversampled: {
+            // 終端の通知はなく、Highが1ビット続いたところでストップビット(0x01)がpushされる
+            if (!run_until([&] { return rx_words_.size() >= nbytes + 1; }, frame_cycles)) {
+                return FrameResult::Timeout;
+            }
+            // 余分なバイトが続いていないか、終端の判定まで進めて確かめる
+            run_cycles(bit_cycles() * 2);
+            if ((rx_words_[nbytes] & 0xFFu) != 0x01) {
+                return FrameResult::StopError;
+            }
+            for (size_t i = 0; i < nbytes; ++i) {
+                out->push_back((uint8_t)(rx_words_[i] & 0xFFu));
+            }
+            return rx_words_.size() == nbytes + 1 ? FrameResult::Ok : FrameResult::LengthMismatch;
+        }
+        }
+        return FrameResult::Timeout;
+    }
+
+    // ループバックで1フレーム送受信する
+    FrameResult transfer(const std::vector<uint8_t> &frame, std::vector<uint8_t> *received) {
+        if (v_.tx == TxKind::PerByte) {
+            received->clear();
+            for (uint8_t byte : frame) {
+                std::vector<uint8_t> one;
+                prepare_rx(1);
+                // MSB-firstで送信するために上位8ビットに配置
+                tx_pending_.push_back((uint32_t)byte << 24);
+                FrameResult r = finish_rx(1, &one);
+                if (r != FrameResult::Ok) {
+                    return r;
+                }
+                received->push_back(one[0]);
+            }
+            return *received == frame ? FrameResult::Ok : FrameResult::Mismatch;
+        }
+        prepare_rx(frame.size());
+        if (!start_tx_counted(frame)) {
+            return FrameResult::Timeout;
+        }
+        FrameResult r = finish_rx(frame.size(), received);
+        if (r == FrameResult::Ok && *received != frame) {
+            return FrameResult::Mismatch;
+        }
+        return r;
+    }
+
+  private:
+    const Variant &v_;
+    Rp2040 chip_;
+    uint32_t off_tx_ = 0;
+    uint32_t off_rx_ = 0;
+    std::deque<uint32_t> tx_pending_;
+    std::vector<uint32_t> rx_words_;
+};
+
+std::vector<uint8_t> random_frame(std::mt19937 &rng, size_t max_len) {
+    std::uniform_int_distribution<size_t> len_dist(1, max_len);
+    std::uniform_int_distribution<int> byte_dist(0, 255);
+    std::vector<uint8_t> frame(len_dist(rng));
+    for (uint8_t &b : frame) {
+        b = (uint8_t)byte_dist(rng);
+    }
+    return frame;
+}
+
+// ループバック中の線の波形とRXのサンプル位置を記録する
+class WaveProbe {
+  public:
+    WaveProbe(const Variant &v, Bench &bench) : v_(v), bench_(bench) {}
+
+    void on_cycle(const Rp2040 &chip) {
+        const bool level = chip.gpio().level(v_.rx_pin);
+        const uint64_t now = chip.cycle();
+        const double us_per_cycle = 1e6 / chip.clk_sys_hz();
+        if (level != last_level_) {
+            if (!level) {
+                if (fall_valid_ && now - last_fall_ < bench_.bit_cycles() * 3 / 2) {
+                    period_us_.add((double)(now - last_fall_) * us_per_cycle);
+                }
+                last_fall_ = now;
+                fall_valid_ = true;
+                sample_index_ = 0;
+            } else if (fall_valid_) {
+                const double low_us = (double)(now - last_fall_) * us_per_cycle;
+                (low_us < v_.bit_us / 2 ? low1_us_ : low0_us_).add(low_us);
+            }
+            last_level_ = level;
+        }
+        // in pins の実行時刻（シンクロナイザの2サイクル分だけ前の線を見ている）
+        const int32_t instr = bench_.rx().executed(v_.rx_sm);
+        const bool three_sample =
+            v_.rx == RxKind::ThreeSamplePerByte || v_.rx == RxKind::ThreeSampleCounted;
+        if (three_sample && instr >= 0 && (instr & 0xE0E0) == 0x4000 && fall_valid_ &&
+            sample_index_ < 3) {
+            const double t = (double)(now - last_fall_ - 2) * us_per_cycle;
+            sample_us_[sample_index_++].add(t);
+        }
+    }
+
+    void report() const {
+        printf("  wire: period %.3f..%.3f us, '1' low %.3f..%.3f us, '0' low %.3f..%.3f us\n",
+               period_us_.min, period_us_.max, low1_us_.min, low1_us_.max, low0_us_.min,
+               low0_us_.max);
+        if (sample_us_[0].n == 0) {
+            return;
+        }
+        for (int i = 0; i < 3; ++i) {
+            printf("  sample s%d: %.3f..%.3f us after falling edge\n", i, sample_us_[i].min,
+                   sample_us_[i].max);
+        }
+        // 多数決が正しくなるには真ん中のサンプルs1が正しければよい
+        //   '1': s1までにHighへ戻っている必要がある / '0': s1の時点でまだLowである必要がある
+        printf("  majority margin: '1' %.3f us, '0' %.3f us\n",
+               sample_us_[1].min - low1_us_.max, low0_us_.min - sample_us_[1].max);
+    }
+
+  private:
+    const Variant &v_;
+    Bench &bench_;
+    bool last_level_ = true;
+    bool fall_valid_ = false;
+    uint64_t last_fall_ = 0;
+    int sample_index_ = 0;
+    Range period_us_;
+    Range low1_us_;
+    Range low0_us_;
+    Range sample_us_[3];
+};
+
+struct Options {
+    std::string variant;
+    size_t frames = 1000;
+    size_t max_len = 10;
+    uint32_t seed = 1;
+    std::string vcd;
+    size_t vcd_frames = 4;
+    uint32_t oversampling = 0; // 0ならバリアントの既定値
+};
+
+int run_loopback(const std::string &root, const Variant &v, const Options &opt) {
+    const Programs programs = load_programs(root, v);
+    Bench bench(v, programs, true);
+    WaveProbe probe(v, bench);
+
+    VcdWriter vcd;
+    int vcd_bus = -1, vcd_tx_pc = -1, vcd_rx_pc = -1, vcd_tx_irq = -1, vcd_rx_irq = -1;
+    int vcd_rx_fifo = -1;
+    bool vcd_active = false;
+    if (!opt.vcd.empty()) {
+        if (!vcd.open(opt.vcd, 1)) {
+            fprintf(stderr, "cannot open %s\n", opt.vcd.c_str());
+            return 2;
+        }
+        vcd_bus = vcd.add("bus", 1);
+        vcd_tx_pc = vcd.add("tx_pc", 5);
+        vcd_rx_pc = vcd.add("rx_pc", 5);
+        vcd_tx_irq = vcd.add("tx_pio_irq", 8);
+        vcd_rx_irq = vcd.add("rx_pio_irq", 8);
+        vcd_rx_fifo = vcd.add("rx_fifo_level", 4);
+        vcd.begin();
+        vcd_active = true;
+    }
+
+    bench.chip().on_cycle = [&](const Rp2040 &chip) {
+        probe.on_cycle(chip);
+        if (vcd_active) {
+            const uint64_t t_ns = chip.cycle() * 1'000'000'000ull / chip.clk_sys_hz();
+            vcd.change(t_ns, vcd_bus, chip.gpio().level(v.rx_pin));
+            vcd.change(t_ns, vcd_tx_pc, bench.tx().pc(v.tx_sm));
+            vcd.change(t_ns, vcd_rx_pc, bench.rx().pc(v.rx_sm));
+            vcd.change(t_ns, vcd_tx_irq, bench.tx().irq_flags());
+            vcd.change(t_ns, vcd_rx_irq, bench.rx().irq_flags());
+            vcd.change(t_ns, vcd_rx_fifo, bench.rx().rx_level(v.rx_sm));
+        }
+    };
+
+    std::mt19937 rng(opt.seed);
+    std::map<FrameResult, size_t> counts;
+    size_t bytes = 0;
+    const uint64_t start_cycle = bench.chip().cycle();
+    const auto wall_start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < opt.frames; ++i) {
+        const std::vector<uint8_t> frame = random_frame(rng, opt.max_len);
+        std::vector<uint8_t> received;
+        const FrameResult r = bench.transfer(frame, &received);
+        ++counts[r];
+        bytes += frame.size();
+        if (r != FrameResult::Ok && counts[r] <= 3) {
+            printf("  frame %zu (%zu bytes): %s\n", i, frame.size(), result_name(r));
+        }
+        if (vcd_active && i + 1 >= opt.vcd_frames) {
+            vcd.close();
+            vcd_active = false;
+        }
+    }
+    const double wall_s =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+    const double sim_ms = (double)(bench.chip().cycle() - start_cycle) * 1e3 /
+                          bench.chip().clk_sys_hz();
+
+    const size_t errors = opt.frames - counts[FrameResult::Ok];
+    printf("%s: %zu frames (%zu bytes), %zu errors", v.name, opt.frames, bytes, errors);
+    for (const auto &kv : counts) {
+        if (kv.first != FrameResult::Ok) {
+            printf(", %s=%zu", result_name(kv.first), kv.second);
+        }
+    }
+    printf("\n  simulated %.1f ms in %.2f s (%.0f frames/s)\n", sim_ms, wall_s,
+           (double)opt.frames / wall_s);
+    probe.report();
+    return errors == 0 ? 0 : 1;
+}
+
+// 外部から理想的な波形を入れ、受信側が全フレームを正しく読めるか調べる
+bool external_frames_ok(const Variant &v, const Programs &programs, double bit_us,
+                        double low1_us, double low0_us, size_t frames, uint32_t seed) {
+    Bench bench(v, programs, false);
+    Rp2040 &chip = bench.chip();
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<uint64_t> gap_dist(chip.us_to_cycles(10),
+                                                     chip.us_to_cycles(30));
+    const size_t max_len = v.rx == RxKind::ThreeSamplePerByte ? 1 : 4;
+
+    for (size_t f = 0; f < frames; ++f) {
+        const std::vector<uint8_t> frame = random_frame(rng, max_len);
+        std::vector<int> bits;
+        for (uint8_t byte : frame) {
+            for (int i = 7; i >= 0; --i) {
+                bits.push_back((byte >> i) & 1);
+            }
+        }
+        if (v.rx != RxKind::ThreeSamplePerByte) {
+            bits.push_back(1); // ストップビット
+        }
+        bench.prepare_rx(frame.size());
+        // アイドル時間を乱数にしてPIOクロックとの位相をばらつかせる
+        bench.run_cycles(gap_dist(rng));
+        for (int bit : bits) {
+            const uint64_t low = chip.us_to_cycles(bit ? low1_us : low0_us);
+            const uint64_t total = chip.us_to_cycles(bit_us);
+            chip.gpio().set_external_low(v.rx_pin, true);
+            bench.run_cycles(low);
+            chip.gpio().set_external_low(v.rx_pin, false);
+            bench.run_cycles(total > low ? total - low : 0);
+        }
+        std::vector<uint8_t> received;
+        if (bench.finish_rx(frame.size(), &received) != FrameResult::Ok || received != frame) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// nominalを含む合格範囲 [lo, hi] を探す（範囲外まで含めて線形に走査）
+bool find_pass_range(const std::vector<double> &points, const std::vector<bool> &ok,
+                     double nominal, double *lo, double *hi) {
+    size_t center = 0;
+    for (size_t i = 0; i < points.size(); ++i) {
+        if (std::abs(points[i] - nominal) < std::abs(points[center] - nominal)) {
+            center = i;
+        }
+    }
+    if (!ok[center]) {
+        return false;
+    }
+    size_t a = center;
+    size_t b = center;
+    while (a > 0 && ok[a - 1]) {
+        --a;
+    }
+    while (b + 1 < points.size() && ok[b + 1]) {
+        ++b;
+    }
+    *lo = points[a];
+    *hi = points[b];
+    return true;
+}
+
+int run_margin(const std::string &root, const Variant &v, const Options &opt) {
+    const Programs programs = load_programs(root, v);
+    const double bit = v.bit_us;
+    const size_t frames = std::min<size_t>(opt.frames, 20);
+    printf("%s: nominal bit %.2f us ('1' low %.2f us, '0' low %.2f us)\n", v.name, bit, bit / 4,
+           bit * 3 / 4);
+
+    auto sweep = [&](const char *label, double nominal, double from, double to, double step,
+                     auto make) {
+        std::vector<double> points;
+        std::vector<bool> ok;
+        for (double p = from; p <= to + 1e-9; p += step) {
+            double b = 0, l1 = 0, l0 = 0;
+            make(p, &b, &l1, &l0);
+            points.push_back(p);
+            ok.push_back(external_frames_ok(v, programs, b, l1, l0, frames, opt.seed));
+        }
+        double lo = 0, hi = 0;
+        if (find_pass_range(points, ok, nominal, &lo, &hi)) {
+            printf("  %-14s %.3f .. %.3f us (nominal %.3f us)\n", label, lo, hi, nominal);
+            return true;
+        }
+        printf("  %-14s FAILS at nominal %.3f us\n", label, nominal);
+        return false;
+    };
+
+    bool ok = true;
+    // 全体を伸び縮みさせる（4us/bitと5us/bitの機器との相性）
+    ok &= sweep("bit period", bit, bit * 0.5, bit * 1.6, bit * 0.02,
+                [&](double p, double *b, double *l1, double *l0) {
+                    *b = p;
+                    *l1 = p / 4;
+                    *l0 = p * 3 / 4;
+                });
+    ok &= sweep("'1' low time", bit / 4, bit * 0.02, bit * 0.98, bit * 0.01,
+                [&](double p, double *b, double *l1, double *l0) {
+                    *b = bit;
+                    *l1 = p;
+                    *l0 = bit * 3 / 4;
+                });
+    ok &= sweep("'0' low time", bit * 3 / 4, bit * 0.02, bit * 0.98, bit * 0.01,
+                [&](double p, double *b, double *l1, double *l0) {
+                    *b = bit;
+                    *l1 = bit / 4;
+                    *l0 = p;
+                });
+    return ok ? 0 : 1;
+}
+
+// 4MHzで作ったプログラムを手で書いた.pioと命令語ごとに比べる
+bool gen_matches(const PioProgram &hand, const JoyBusPioCode &code) {
+    const PioProgram gen = gen_program(code, hand.name.c_str());
+    bool same = gen.instructions.size() == hand.instructions.size() &&
+                gen.wrap_target == hand.wrap_target && gen.wrap == hand.wrap;
+    const size_t n = std::max(gen.instructions.size(), hand.instructions.size());
+    for (size_t i = 0; i < n; ++i) {
+        const int h = i < hand.instructions.size() ? hand.instructions[i] : -1;
+        const int g = i < gen.instructions.size() ? gen.instructions[i] : -1;
+        if (h != g) {
+            printf("  %s[%zu]: .pio %04X, generated %04X\n", hand.name.c_str(), i, h & 0xFFFF,
+                   g & 0xFFFF);
+            same = false;
+        }
+    }
+    printf("%s: %s (%zu instructions)\n", hand.name.c_str(), same ? "identical" : "DIFFERS",
+           gen.instructions.size());
+    return same;
+}
+
+int run_gencheck(const std::string &root) {
+    const JoyBusPioTiming hand_timing = joybus_pio_timing(4'000'000, 1);
+    bool ok = gen_matches(pio_load_program(root + "/examples/stop_bit/joy_tx5.pio", "joy_tx5"),
+                          joybus_pio_gen_tx(hand_timing));
+    ok &= gen_matches(pio_load_program(root + "/examples/stop_bit/joy_rx5.pio", "joy_rx5"),
+                      joybus_pio_gen_rx(hand_timing));
+    for (const Variant &v : VARIANTS) {
+        if (!is_generated(v)) {
+            continue;
+        }
+        const JoyBusPioCode tx = joybus_pio_gen_tx(v.gen);
+        const JoyBusPioCode rx = joybus_pio_gen_rx(v.gen);
+        printf("%s: clkdiv %u, %u cycles/bit, tx %u instructions, rx %u instructions\n", v.name,
+               v.gen.clkdiv, tx.bit_cycles, tx.length, rx.length);
+    }
+    return ok ? 0 : 1;
+}
+
+// examples/multi_portのport_measure_bit_rateと同じ構成（pio0 sm0にjoy_tx5、pio1 sm0にjoy_edge）
+// joy_tx5が4MHz（5us/bit）でidentifyを送り、相手役は送信完了（irq 4）からgap_us後に
+// reply_bit_usの速さで応答する（reply_bit_usが0なら応答しない = ループバックだけのポート）
+// 測れた応答のビット周期（ns）を返す。測れなければ0
+uint32_t measure_reply_bit_period(const std::string &root, double reply_bit_us, double gap_us) {
+    constexpr uint32_t TX_PIN = 15;
+    constexpr uint32_t RX_PIN = 16;
+    constexpr uint32_t EDGE_LIMIT_US = 8;
+    constexpr uint32_t NOMINAL_BIT_PERIOD_NS = 5000;
+    constexpr uint32_t RX_TIMEOUT_US = 2000;
+    constexpr uint8_t TX_START_IRQ = 1u << 0;
+    constexpr uint8_t TX_DONE_IRQ = 1u << 4;
+    constexpr uint16_t PULL_BLOCK = 0x80A0;
+    constexpr uint16_t MOV_Y_OSR = 0xA047;
+
+    Rp2040 chip;
+    const PioProgram tx_program =
+        pio_load_program(root + "/examples/multi_port/joy_tx5.pio", "joy_tx5");
+    const PioProgram edge_program =
+        pio_load_program(root + "/examples/multi_port/joy_edge.pio", "joy_edge");
+    const uint32_t clk_hz = chip.clk_sys_hz();
+    const uint32_t counts_per_us = clk_hz / 2'000'000;
+    const uint32_t limit = EDGE_LIMIT_US * counts_per_us;
+
+    PioBlock &tx = chip.pio(0);
+    const uint32_t off_tx = tx.add_program(tx_program);
+    SmConfig c_tx = SmConfig::from_program(tx_program, off_tx);
+    c_tx.set_base = TX_PIN;
+    c_tx.set_count = 1;
+    c_tx.set_out_shift(false, true, 32);
+    c_tx.set_clkdiv((float)clk_hz / PIO_HZ);
+    chip.pio_gpio_init(0, TX_PIN);
+    chip.gpio().set_pull_up(TX_PIN, true);
+    tx.set_pindirs_with_mask(0, 1u << TX_PIN);
+    tx.set_pins_with_mask(0, 1u << TX_PIN);
+    tx.sm_init(0, off_tx, c_tx);
+
+    PioBlock &rx = chip.pio(1);
+    const uint32_t off_edge = rx.add_program(edge_program);
+    SmConfig c_rx = SmConfig::from_program(edge_program, off_edge);
+    c_rx.in_base = RX_PIN;
+    c_rx.jmp_pin = RX_PIN;
+    c_rx.set_in_shift(false, true, 32);
+    c_rx.set_clkdiv(1.0f);
+    chip.pio_gpio_init(1, RX_PIN);
+    chip.gpio().set_pull_up(RX_PIN, true);
+    rx.set_pindirs_with_mask(0, 1u << RX_PIN);
+    rx.sm_init(0, off_edge, c_rx);
+    rx.sm_put(0, limit);
+    rx.sm_exec(0, PULL_BLOCK);
+    rx.sm_exec(0, MOV_Y_OSR);
+    chip.gpio().connect(TX_PIN, RX_PIN);
+
+    tx.sm_set_enabled(0, true);
+    rx.sm_set_enabled(0, true);
+    chip.run_cycles(chip.us_to_cycles(20));
+
+    // joybus_tx_sendと同じく完了フラグを消してからフレームを積み、開始を指示する
+    const uint8_t identify[] = {0x00};
+    JoyBusTxFrame frame;
+    joybus_tx_frame_encode(&frame, identify, sizeof(identify));
+    tx.irq_clear(TX_DONE_IRQ);
+    for (uint32_t i = 0; i < frame.word_count; ++i) {
+        tx.sm_put(0, frame.words[i]);
+    }
+    tx.irq_force(TX_START_IRQ);
+
+    // port_measure_bit_rateと同じく、自分のidentifyの後ろの最初のフレーム終端まで集める
+    const size_t reply_offset = joybus_edge_reply_offset(frame.nbytes);
+    std::vector<uint32_t> words;
+    bool complete = false;
+    auto collect = [&] {
+        uint32_t word = 0;
+        while (!complete && rx.sm_get(0, &word)) {
+            if (words.size() < reply_offset + JOYBUS_EDGE_MAX_WORDS) {
+                words.push_back(word);
+            }
+            complete = words.size() > reply_offset && joybus_edge_is_frame_end(word);
+        }
+        return complete;
+    };
+    const uint64_t deadline = chip.cycle() + chip.us_to_cycles(RX_TIMEOUT_US);
+    auto run_until_collected = [&](const std::function<bool()> &cond) {
+        while (chip.cycle() < deadline && !cond()) {
+            chip.step();
+            collect();
+        }
+    };
+
+    if (reply_bit_us > 0) {
+        // 相手役: identifyの応答（3バイト + ストップビット）を理想的な波形で返す
+        run_until_collected([&] { return (tx.irq_flags() & TX_DONE_IRQ) != 0; });
+        const uint64_t reply_at = chip.cycle() + chip.us_to_cycles(gap_us);
+        run_until_collected([&] { return chip.cycle() >= reply_at; });
+        const uint8_t reply[] = {0x09, 0x00, 0x03};
+        std::vector<int> bits;
+        for (uint8_t byte : reply) {
+            for (int i = 7; i >= 0; --i) {
+                bits.push_back((byte >> i) & 1);
+            }
+        }
+        bits.push_back(1);
+        for (int bit : bits) {
+            const uint64_t start = chip.cycle();
+            const uint64_t low = chip.us_to_cycles(reply_bit_us * (bit ? 0.25 : 0.75));
+            const uint64_t total = chip.us_to_cycles(reply_bit_us);
+            chip.gpio().set_external_low(RX_PIN, true);
+            run_until_collected([&] { return chip.cycle() >= start + low; });
+            chip.gpio().set_external_low(RX_PIN, false);
+            run_until_collected([&] { return chip.cycle() >= start + total; });
+        }
+    }
+    run_until_collected([&] { return complete; });
+    if (!complete) {
+        return 0;
+    }
+
+    JoyBusEdgeDecoder decoder;
+    joybus_edge_decoder_init(&decoder, limit, NOMINAL_BIT_PERIOD_NS * counts_per_us / 1000);
+    JoyBusEdgeFrame reply_frame;
+    if (joybus_edge_decode(&decoder, words.data() + reply_offset, words.size() - reply_offset,
+                           &reply_frame) != JoyBusEdgeStatus::Ok) {
+        return 0;
+    }
+    return joybus_edge_bit_period_ns(reply_frame, clk_hz);
+}
+
+int run_bitrate(const std::string &root) {
+    // 応答の速さ（0は応答なし）と、送信完了から応答の立ち下がりまでの間隔
+    const double reply_bits_us[] = {0.0, 4.0, 4.4, 5.0, 5.6};
+    const double gaps_us[] = {1.0, 4.0, 20.0};
+    bool ok = true;
+    for (double bit_us : reply_bits_us) {
+        for (double gap_us : gaps_us) {
+            const uint32_t measured = measure_reply_bit_period(root, bit_us, gap_us);
+            const double expected_ns = bit_us * 1000;
+            // 応答がなければ測れないこと、あれば1%以内で応答の速さになること
+            const bool pass = bit_us == 0
+                                  ? measured == 0
+                                  : measured != 0 && std::abs(measured - expected_ns) <
+                                                         expected_ns * 0.01;
+            ok &= pass;
+            if (bit_us == 0) {
+                printf("no reply, gap %4.1f us: %s\n", gap_us,
+                       measured == 0 ? "not detected" : "detected");
+            } else {
+                printf("reply %.1f us/bit, gap %4.1f us: measured %u ns%s\n", bit_us, gap_us,
+                       measured, pass ? "" : " FAIL");
+            }
+            if (bit_us == 0) {
+                break; // 応答がなければ間隔は関係ない
+            }
+        }
+    }
+    return ok ? 0 : 1;
+}
+
+void usage() {
+    printf("usage: pio_sim loopback|margin|gencheck|bitrate [--variant NAME] [--frames N] "
+           "[--max-len N] [--seed N] [--vcd FILE] [--vcd-frames N] [--oversampling N] "
+           "[--root DIR]\n");
+    printf("variants:");
+    for (const Variant &v : VARIANTS) {
+        printf(" %s", v.name);
+    }
+    printf("\n");
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        usage();
+        return 2;
+    }
+    const std::string command = argv[1];
+    Options opt;
+    std::string root = GC_PLAYGROUND_ROOT;
+    for (int i = 2; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            usage();
+            return 2;
+        }
+        const char *val = argv[++i];
+        if (arg == "--variant") {
+            opt.variant = val;
+        } else if (arg == "--frames") {
+            opt.frames = (size_t)std::strtoul(val, nullptr, 0);
+        } else if (arg == "--max-len") {
+            opt.max_len = (size_t)std::strtoul(val, nullptr, 0);
+        } else if (arg == "--seed") {
+            opt.seed = (uint32_t)std::strtoul(val, nullptr, 0);
+        } else if (arg == "--vcd") {
+            opt.vcd = val;
+        } else if (arg == "--vcd-frames") {
+            opt.vcd_frames = (size_t)std::strtoul(val, nullptr, 0);
+        } else if (arg == "--oversampling") {
+            opt.oversampling = (uint32_t)std::strtoul(val, nullptr, 0);
+        } else if (arg == "--root") {
+            root = val;
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (opt.max_len < 1 || opt.max_len > JOYBUS_MAX_FRAME_BYTES) {
+        fprintf(stderr, "--max-len must be 1..%zu\n", JOYBUS_MAX_FRAME_BYTES);
+        return 2;
+    }
+
+    int status = 0;
+    bool matched = false;
+    try {
+        if (command == "gencheck") {
+            return run_gencheck(root);
+        }
+        if (command == "bitrate") {
+            return run_bitrate(root);
+        }
+        for (const Variant &v : VARIANTS) {
+            if (!opt.variant.empty() && opt.variant != v.name) {
+                continue;
+            }
+            matched = true;
+            Variant run = v;
+            if (opt.oversampling != 0 && run.rx == RxKind::Oversampled) {
+                run.rx_oversampling = opt.oversampling;
+            }
+            if (command == "loopback") {
+                status |= run_loopback(root, run, opt);
+            } else if (command == "margin") {
+                status |= run_margin(root, run, opt);
+            } else {
+                usage();
+                return 2;
+            }
+        }
+    } catch (const std::exception &e) {
+        fprintf(stderr, "error: %s\n", e.what());
+        return 2;
+    }
+    if (!matched) {
+        usage();
+        return 2;
+    }
+    return status;
+}
@@ -0,0 +1,527 @@
+#include "pio_asm.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace pio_sim {
+namespace {
+
+struct SourceLine {
+    int line_no = 0;
+    std::vector<std::string> tokens;
+};
+
+struct ProgramSource {
+    PioProgram program;
+    std::vector<SourceLine> lines; // 命令行のみ（ラベル・ディレクティブは除去済み）
+    bool has_wrap_target = false;
+    bool has_wrap = false;
+};
+
+std::string to_lower(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(),
+                   [](unsigned char c) { return (char)std::tolower(c); });
+    return s;
+}
+
+[[noreturn]] void fail(const std::string &filename, int line_no, const std::string &msg) {
+    std::ostringstream oss;
+    oss << filename << ":" << line_no << ": " << msg;
+    throw std::runtime_error(oss.str());
+}
+
+// コメントを除去してトークンに分割する
+// カンマは区切りとして扱い、"[n]" は1トークンにまとめる
+std::vector<std::string> tokenize(const std::string &raw) {
+    std::string line = raw;
+    size_t comment = line.find(';');
+    if (comment != std::string::npos) {
+        line.erase(comment);
+    }
+    comment = line.find("//");
+    if (comment != std::string::npos) {
+        line.erase(comment);
+    }
+
+    std::string spaced;
+    for (char c : line) {
+        if (c == ',') {
+            spaced += ' ';
+        } else if (c == '[') {
+            spaced += " [";
+        } else if (c == ']') {
+            spaced += "] ";
+        } else {
+            spaced += c;
+        }
+    }
+
+    std::vector<std::string> tokens;
+    std::istringstream iss(spaced);
+    std::string tok;
+    while (iss >> tok) {
+        // "[ 4 ]" のように空白を含む遅延指定を "[4]" にまとめる
+        if (!tokens.empty() && tokens.back().front() == '[' && tokens.back().back() != ']') {
+            tokens.back() += tok;
+        } else {
+            tokens.push_back(tok);
+        }
+    }
+    return tokens;
+}
+
+class Encoder {
+  public:
+    Encoder(const std::string &filename, const std::map<std::string, int64_t> &defines,
+            const ProgramSource &src)
+        : filename_(filename), defines_(defines), src_(src) {}
+
+    uint16_t encode(const SourceLine &line) {
+        line_no_ = line.line_no;
+        std::vector<std::string> toks = line.tokens;
+
+        // 末尾の遅延 [n] と side n を取り出す
+        int delay = 0;
+        bool has_side = false;
+        int side = 0;
+        for (size_t i = 0; i < toks.size();) {
+            if (toks[i].front() == '[') {
+                std::string inner = toks[i].substr(1, toks[i].size() - 2);
+                delay = (int)value(inner);
+                toks.erase(toks.begin() + (long)i);
+            } else if (to_lower(toks[i]) == "side" || to_lower(toks[i]) == "sideset") {
+                if (i + 1 >= toks.size()) {
+                    fail(filename_, line_no_, "side requires a value");
+                }
+                has_side = true;
+                side = (int)value(toks[i + 1]);
+                toks.erase(toks.begin() + (long)i, toks.begin() + (long)i + 2);
+            } else {
+                ++i;
+            }
+        }
+        if (toks.empty()) {
+            fail(filename_, line_no_, "empty instruction");
+        }
+
+        const std::string op = to_lower(toks[0]);
+        std::vector<std::string> args(toks.begin() + 1, toks.end());
+        uint16_t instr = 0;
+        if (op == "nop") {
+            expect_args(args, 0);
+            instr = 0xA042; // mov y, y
+        } else if (op == "jmp") {
+            instr = encode_jmp(args);
+        } else if (op == "wait") {
+            instr = encode_wait(args);
+        } else if (op == "in") {
+            expect_args(args, 2);
+            instr = (uint16_t)(0x4000 | (in_source(args[0]) << 5) | bit_count(args[1]));
+        } else if (op == "out") {
+            expect_args(args, 2);
+            instr = (uint16_t)(0x6000 | (out_dest(args[0]) << 5) | bit_count(args[1]));
+        } else if (op == "push" || op == "pull") {
+            instr = encode_push_pull(op == "pull", args);
+        } else if (op == "mov") {
+            instr = encode_mov(args);
+        } else if (op == "irq") {
+            instr = encode_irq(args);
+        } else if (op == "set") {
+            expect_args(args, 2);
+            int64_t data = value(args[1]);
+            if (data < 0 || data > 31) {
+                fail(filename_, line_no_, "set value out of range: " + args[1]);
+            }
+            instr = (uint16_t)(0xE000 | (set_dest(args[0]) << 5) | data);
+        } else {
+            fail(filename_, line_no_, "unknown instruction: " + toks[0]);
+        }
+
+        const PioProgram &p = src_.program;
+        const uint32_t side_total = p.sideset_bits + (p.sideset_opt ? 1u : 0u);
+        const uint32_t delay_bits = 5 - side_total;
+        if (delay < 0 || delay >= (1 << delay_bits)) {
+            fail(filename_, line_no_, "delay out of range");
+        }
+        uint32_t field = (uint32_t)delay;
+        if (has_side) {
+            if (p.sideset_bits == 0) {
+                fail(filename_, line_no_, "side used without .side_set");
+            }
+            if (side < 0 || side >= (1 << p.sideset_bits)) {
+                fail(filename_, line_no_, "side value out of range");
+            }
+            uint32_t s = (uint32_t)side;
+            if (p.sideset_opt) {
+                s |= 1u << p.sideset_bits;
+            }
+            field |= s << delay_bits;
+        } else if (p.sideset_bits != 0 && !p.sideset_opt) {
+            fail(filename_, line_no_, "side is mandatory for this program");
+        }
+        return (uint16_t)(instr | (field << 8));
+    }
+
+  private:
+    int64_t value(const std::string &tok) const {
+        auto it = defines_.find(tok);
+        if (it != defines_.end()) {
+            return it->second;
+        }
+        auto lbl = src_.program.labels.find(tok);
+        if (lbl != src_.program.labels.end()) {
+            return lbl->second;
+        }
+        try {
+            size_t pos = 0;
+            int64_t v = 0;
+            if (tok.size() > 2 && (tok[1] == 'b' || tok[1] == 'B') && tok[0] == '0') {
+                v = std::stoll(tok.substr(2), &pos, 2);
+                pos += 2;
+            } else {
+                v = std::stoll(tok, &pos, 0);
+            }
+            if (pos != tok.size()) {
+                throw std::invalid_argument(tok);
+            }
+            return v;
+        } catch (const std::exception &) {
+            fail(filename_, line_no_, "bad value: " + tok);
+        }
+    }
+
+    void expect_args(const std::vector<std::string> &args, size_t n) const {
+        if (args.size() != n) {
+            fail(filename_, line_no_, "wrong number of operands");
+        }
+    }
+
+    uint32_t bit_count(const std::string &tok) const {
+        int64_t n = value(tok);
+        if (n < 1 || n > 32) {
+            fail(filename_, line_no_, "bit count out of range: " + tok);
+        }
+        return (uint32_t)(n & 31);
+    }
+
+    uint16_t encode_jmp(const std::vector<std::string> &args) const {
+        static const std::map<std::string, uint32_t> conds = {
+            {"!x", 1}, {"~x", 1}, {"x--", 2}, {"!y", 3},    {"~y", 3},
+            {"y--", 4}, {"x!=y", 5}, {"pin", 6}, {"!osre", 7}, {"~osre", 7},
+        };
+        uint32_t cond = 0;
+        std::string target;
+        if (args.size() == 1) {
+            target = args[0];
+        } else if (args.size() == 2) {
+            auto it = conds.find(to_lower(args[0]));
+            if (it == conds.end()) {
+                fail(filename_, line_no_, "unknown jmp condition: " + args[0]);
+            }
+            cond = it->second;
+            target = args[1];
+        } else {
+            fail(filename_, line_no_, "wrong number of operands");
+        }
+        int64_t addr = value(target);
+        if (addr < 0 || addr > 31) {
+            fail(filename_, line_no_, "jmp target out of range");
+        }
+        return (uint16_t)(0x0000 | (cond << 5) | (uint32_t)addr);
+    }
+
+    uint16_t encode_wait(const std::vector<std::string> &args) const {
+        if (args.size() < 3 || args.size() > 4) {
+            fail(filename_, line_no_, "wrong number of operands");
+        }
+        int64_t pol = value(args[0]);
+        const std::string src = to_lower(args[1]);
+        uint32_t src_bits = 0;
+        if (src == "gpio") {
+            src_bits = 0;
+        } else if (src == "pin") {
+            src_bits = 1;
+        } else if (src == "irq") {
+            src_bits = 2;
+        } else {
+            fail(filename_, line_no_, "unknown wait source: " + args[1]);
+        }
+        int64_t index = value(args[2]);
+        if (args.size() == 4) {
+            if (src_bits != 2 || to_lower(args[3]) != "rel") {
+                fail(filename_, line_no_, "unexpected operand: " + args[3]);
+            }
+            index |= 0x10;
+        }
+        return (uint16_t)(0x2000 | ((pol ? 1u : 0u) << 7) | (src_bits << 5) | (index & 0x1F));
+    }
+
+    uint16_t encode_push_pull(bool pull, const std::vector<std::string> &args) const {
+        bool if_flag = false;
+        bool block = true;
+        for (const auto &a : args) {
+            const std::string s = to_lower(a);
+            if (s == (pull ? "ifempty" : "iffull")) {
+                if_flag = true;
+            } else if (s == "block") {
+                block = true;
+            } else if (s == "noblock") {
+                block = false;
+            } else {
+                fail(filename_, line_no_, "unexpected operand: " + a);
+            }
+        }
+        return (uint16_t)(0x8000 | ((pull ? 1u : 0u) << 7) | ((if_flag ? 1u : 0u) << 6) |
+                          ((block ? 1u : 0u) << 5));
+    }
+
+    uint16_t encode_mov(std::vector<std::string> args) const {
+        // "mov x, ~ isr" のように演算子が分かれている場合をまとめる
+        if (args.size() == 3 && (args[1] == "!" || args[1] == "~" || args[1] == "::")) {
+            args[1] += args[2];
+            args.pop_back();
+        }
+        expect_args(args, 2);
+        static const std::map<std::string, uint32_t> dests = {
+            {"pins", 0}, {"x", 1}, {"y", 2}, {"exec", 4}, {"pc", 5}, {"isr", 6}, {"osr", 7},
+        };
+        static const std::map<std::string, uint32_t> srcs = {
+            {"pins", 0}, {"x", 1}, {"y", 2}, {"null", 3}, {"status", 5}, {"isr", 6}, {"osr", 7},
+        };
+        auto d = dests.find(to_lower(args[0]));
+        if (d == dests.end()) {
+            fail(filename_, line_no_, "unknown mov destination: " + args[0]);
+        }
+        std::string src = args[1];
+        uint32_t op = 0;
+        if (src.rfind("::", 0) == 0) {
+            op = 2;
+            src = src.substr(2);
+        } else if (src.front() == '!' || src.front() == '~') {
+            op = 1;
+            src = src.substr(1);
+        }
+        auto s = srcs.find(to_lower(src));
+        if (s == srcs.end()) {
+            fail(filename_, line_no_, "unknown mov source: " + args[1]);
+        }
+        return (uint16_t)(0xA000 | (d->second << 5) | (op << 3) | s->second);
+    }
+
+    uint16_t encode_irq(const std::vector<std::string> &args) const {
+        bool clear = false;
+        bool wait = false;
+        size_t i = 0;
+        if (i < args.size()) {
+            const std::string mode = to_lower(args[i]);
+            if (mode == "set" || mode == "nowait") {
+                ++i;
+            } else if (mode == "wait") {
+                wait = true;
+                ++i;
+            } else if (mode == "clear") {
+                clear = true;
+                ++i;
+            }
+        }
+        if (i >= args.size()) {
+            fail(filename_, line_no_, "irq requires an index");
+        }
+        int64_t index = value(args[i++]);
+        if (index < 0 || index > 7) {
+            fail(filename_, line_no_, "irq index out of range");
+        }
+        if (i < args.size()) {
+            if (to_lower(args[i]) != "rel") {
+                fail(filename_, line_no_, "unexpected operand: " + args[i]);
+            }
+            index |= 0x10;
+            ++i;
+        }
+        if (i != args.size()) {
+            fail(filename_, line_no_, "wrong number of operands");
+        }
+        return (uint16_t)(0xC000 | ((clear ? 1u : 0u) << 6) | ((wait ? 1u : 0u) << 5) |
+                          (uint32_t)index);
+    }
+
+    uint32_t in_source(const std::string &tok) const {
+        static const std::map<std::string, uint32_t> m = {
+            {"pins", 0}, {"x", 1}, {"y", 2}, {"null", 3}, {"isr", 6}, {"osr", 7},
+        };
+        return lookup(m, tok, "in source");
+    }
+
+    uint32_t out_dest(const std::string &tok) const {
+        static const std::map<std::string, uint32_t> m = {
+            {"pins", 0}, {"x", 1},  {"y", 2},   {"null", 3},
+            {"pindirs", 4}, {"pc", 5}, {"isr", 6}, {"exec", 7},
+        };
+        return lookup(m, tok, "out destination");
+    }
+
+    uint32_t set_dest(const std::string &tok) const {
+        static const std::map<std::string, uint32_t> m = {
+            {"pins", 0}, {"x", 1}, {"y", 2}, {"pindirs", 4},
+        };
+        return lookup(m, tok, "set destination");
+    }
+
+    uint32_t lookup(const std::map<std::string, uint32_t> &m, const std::string &tok,
+                    const char *what) const {
+        auto it = m.find(to_lower(tok));
+        if (it == m.end()) {
+            fail(filename_, line_no_, std::string("unknown ") + what + ": " + tok);
+        }
+        return it->second;
+    }
+
+    const std::string &filename_;
+    const std::map<std::string, int64_t> &defines_;
+    const ProgramSource &src_;
+    int line_no_ = 0;
+};
+
+} // namespace
+
+std::vector<PioProgram> pio_assemble(const std::string &source, const std::string &filename) {
+    std::vector<ProgramSource> programs;
+    std::map<std::string, int64_t> defines;
+
+    std::istringstream iss(source);
+    std::string raw;
+    int line_no = 0;
+    bool in_code_block = false; // "% c-sdk { ... %}" はC側の埋め込みなので読み飛ばす
+    while (std::getline(iss, raw)) {
+        ++line_no;
+        if (in_code_block) {
+            if (raw.find("%}") != std::string::npos) {
+                in_code_block = false;
+            }
+            continue;
+        }
+        if (raw.find_first_not_of(" \t") != std::string::npos &&
+            raw[raw.find_first_not_of(" \t")] == '%') {
+            in_code_block = true;
+            continue;
+        }
+
+        std::vector<std::string> toks = tokenize(raw);
+        while (!toks.empty()) {
+            const std::string head = to_lower(toks[0]);
+            if (head == ".program") {
+                if (toks.size() != 2) {
+                    fail(filename, line_no, ".program requires a name");
+                }
+                programs.emplace_back();
+                programs.back().program.name = toks[1];
+                toks.clear();
+            } else if (head == ".define") {
+                size_t i = 1;
+                if (i < toks.size() && to_lower(toks[i]) == "public") {
+                    ++i;
+                }
+                if (i + 2 != toks.size()) {
+                    fail(filename, line_no, ".define requires a name and a value");
+                }
+                defines[toks[i]] = std::stoll(toks[i + 1], nullptr, 0);
+                toks.clear();
+            } else if (head[0] == '.') {
+                if (programs.empty()) {
+                    fail(filename, line_no, "directive outside of .program");
+                }
+                ProgramSource &p = programs.back();
+                const uint32_t here = (uint32_t)p.lines.size();
+                if (head == ".wrap_target") {
+                    p.program.wrap_target = here;
+                    p.has_wrap_target = true;
+                } else if (head == ".wrap") {
+                    if (here == 0) {
+                        fail(filename, line_no, ".wrap before any instruction");
+                    }
+                    p.program.wrap = here - 1;
+                    p.has_wrap = true;
+                } else if (head == ".origin") {
+                    p.program.origin = (int)std::stol(toks.at(1), nullptr, 0);
+                } else if (head == ".side_set") {
+                    p.program.sideset_bits = (uint32_t)std::stoul(toks.at(1), nullptr, 0);
+                    for (size_t i = 2; i < toks.size(); ++i) {
+                        const std::string opt = to_lower(toks[i]);
+                        if (opt == "opt") {
+                            p.program.sideset_opt = true;
+                        } else if (opt == "pindirs") {
+                            p.program.sideset_pindirs = true;
+                        }
+                    }
+                } else if (head == ".lang_opt" || head == ".word") {
+                    // シミュレータでは不要
+                } else {
+                    fail(filename, line_no, "unknown directive: " + toks[0]);
+                }
+                toks.clear();
+            } else if (toks[0].back() == ':' ||
+                       (head == "public" && toks.size() > 1 && toks[1].back() == ':')) {
+                if (programs.empty()) {
+                    fail(filename, line_no, "label outside of .program");
+                }
+                size_t idx = head == "public" ? 1 : 0;
+                std::string label = toks[idx].substr(0, toks[idx].size() - 1);
+                ProgramSource &p = programs.back();
+                p.program.labels[label] = (uint32_t)p.lines.size();
+                toks.erase(toks.begin(), toks.begin() + (long)idx + 1);
+            } else {
+                if (programs.empty()) {
+                    fail(filename, line_no, "instruction outside of .program");
+                }
+                programs.back().lines.push_back({line_no, toks});
+                toks.clear();
+            }
+        }
+    }
+
+    std::vector<PioProgram> result;
+    for (ProgramSource &p : programs) {
+        if (p.lines.empty()) {
+            fail(filename, line_no, "program " + p.program.name + " has no instructions");
+        }
+        if (p.lines.size() > 32) {
+            fail(filename, line_no, "program " + p.program.name + " is longer than 32");
+        }
+        if (!p.has_wrap) {
+            p.program.wrap = (uint32_t)p.lines.size() - 1;
+        }
+        if (!p.has_wrap_target) {
+            p.program.wrap_target = 0;
+        }
+        Encoder enc(filename, defines, p);
+        for (const SourceLine &line : p.lines) {
+            p.program.instructions.push_back(enc.encode(line));
+        }
+        result.push_back(p.program);
+    }
+    return result;
+}
+
+std::vector<PioProgram> pio_assemble_file(const std::string &path) {
+    std::ifstream ifs(path);
+    if (!ifs) {
+        throw std::runtime_error("cannot open " + path);
+    }
+    std::ostringstream oss;
+    oss << ifs.rdbuf();
+    return pio_assemble(oss.str(), path);
+}
+
+PioProgram pio_load_program(const std::string &path, const std::string &name) {
+    for (const PioProgram &p : pio_assemble_file(path)) {
+        if (p.name == name) {
+            return p;
+        }
+    }
+    throw std::runtime_error("program " + name + " not found in " + path);
+}
+
+} // namespace pio_sim
@@ -0,0 +1,39 @@
+#pragma once
+
+// .pioファイルをホスト上でアセンブルする簡易アセンブラ
+// pioasmと同じ16ビット命令エンコーディングを出力するので、
+// シミュレータは実機と同じ命令語をそのまま実行できる
+// （pico-sdkのpioasmに依存せずLinux単体でビルドするため自前で持っている）
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace pio_sim {
+
+struct PioProgram {
+    std::string name;
+    std::vector<uint16_t> instructions;
+    // pioasmの *_wrap_target / *_wrap と同じくプログラム先頭からの相対位置
+    uint32_t wrap_target = 0;
+    uint32_t wrap = 0;
+    int origin = -1;
+    // .side_set（オプションビットを含まないビット数）
+    uint32_t sideset_bits = 0;
+    bool sideset_opt = false;
+    bool sideset_pindirs = false;
+    std::map<std::string, uint32_t> labels;
+};
+
+// .pioのソース文字列をアセンブルする（複数の.programを含んでもよい）
+// 構文エラーは std::runtime_error で通知する
+std::vector<PioProgram> pio_assemble(const std::string &source, const std::string &filename);
+
+// ファイルを読み込んでアセンブルする
+std::vector<PioProgram> pio_assemble_file(const std::string &path);
+
+// ファイル内の指定した名前の.programを取り出す（見つからなければ例外）
+PioProgram pio_load_program(const std::string &path, const std::string &name);
+
+} // namespace pio_sim
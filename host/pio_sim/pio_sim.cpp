@@ -0,0 +1,764 @@
+#include "pio_sim.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace pio_sim {
+namespace {
+
+uint32_t mask_bits(uint32_t n) { return n >= 32 ? 0xFFFFFFFFu : ((1u << n) - 1u); }
+
+uint32_t rotate_right(uint32_t v, uint32_t n) {
+    n &= 31;
+    return n == 0 ? v : (v >> n) | (v << (32 - n));
+}
+
+uint32_t bit_reverse(uint32_t v) {
+    uint32_t r = 0;
+    for (int i = 0; i < 32; ++i) {
+        r = (r << 1) | (v & 1u);
+        v >>= 1;
+    }
+    return r;
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// SmConfig
+
+SmConfig SmConfig::from_program(const PioProgram &program, uint32_t offset) {
+    SmConfig c;
+    c.wrap_target = offset + program.wrap_target;
+    c.wrap = offset + program.wrap;
+    if (program.sideset_bits != 0) {
+        c.sideset_bits = program.sideset_bits + (program.sideset_opt ? 1u : 0u);
+        c.sideset_opt = program.sideset_opt;
+        c.sideset_pindirs = program.sideset_pindirs;
+    }
+    return c;
+}
+
+void SmConfig::set_clkdiv(float div) {
+    // pico-sdkのsm_config_set_clkdivと同じく整数部16ビット・小数部8ビットに切り捨てる
+    clkdiv_int = (uint32_t)div;
+    clkdiv_frac = clkdiv_int == 0 ? 0 : (uint32_t)((div - (float)clkdiv_int) * 256.0f);
+}
+
+void SmConfig::set_in_shift(bool shift_right, bool autopush_enabled, uint32_t threshold) {
+    in_shift_right = shift_right;
+    autopush = autopush_enabled;
+    push_thresh = threshold;
+}
+
+void SmConfig::set_out_shift(bool shift_right, bool autopull_enabled, uint32_t threshold) {
+    out_shift_right = shift_right;
+    autopull = autopull_enabled;
+    pull_thresh = threshold;
+}
+
+// ---------------------------------------------------------------------------
+// GpioBus
+
+GpioBus::GpioBus() {
+    for (uint32_t i = 0; i < NUM_GPIOS; ++i) {
+        net_[i] = i;
+        func_[i] = GpioFunction::Null;
+    }
+}
+
+uint32_t GpioBus::root(uint32_t pin) const {
+    while (net_[pin] != pin) {
+        pin = net_[pin];
+    }
+    return pin;
+}
+
+void GpioBus::connect(uint32_t a, uint32_t b) {
+    uint32_t ra = root(a);
+    uint32_t rb = root(b);
+    if (ra != rb) {
+        net_[rb] = ra;
+    }
+    valid_ = false;
+}
+
+void GpioBus::set_function(uint32_t pin, GpioFunction func) {
+    func_[pin] = func;
+    valid_ = false;
+}
+
+void GpioBus::set_pull_up(uint32_t pin, bool enabled) {
+    if (enabled) {
+        pull_up_mask_ |= 1u << pin;
+    } else {
+        pull_up_mask_ &= ~(1u << pin);
+    }
+    valid_ = false;
+}
+
+void GpioBus::set_external_low(uint32_t pin, bool low) {
+    if (low) {
+        external_low_mask_ |= 1u << pin;
+    } else {
+        external_low_mask_ &= ~(1u << pin);
+    }
+}
+
+void GpioBus::update(const std::array<uint32_t, NUM_PIOS> &pin_values,
+                     const std::array<uint32_t, NUM_PIOS> &pin_dirs) {
+    synced_[1] = synced_[0];
+    synced_[0] = levels_;
+
+    // 出力に変化がなければ線のレベルも変わらない
+    const uint32_t ext = external_low_mask_;
+    if (valid_ && pin_values == last_values_ && pin_dirs == last_dirs_ && ext == last_external_) {
+        return;
+    }
+    valid_ = true;
+    last_values_ = pin_values;
+    last_dirs_ = pin_dirs;
+    last_external_ = ext;
+
+    // ネットごとに「誰かがLowを出しているか」「誰かがHighを出しているか」を集計する
+    std::array<uint8_t, NUM_GPIOS> low{};
+    std::array<uint8_t, NUM_GPIOS> high{};
+    for (uint32_t pin = 0; pin < NUM_GPIOS; ++pin) {
+        const uint32_t r = root(pin);
+        const uint32_t bit = 1u << pin;
+        if (external_low_mask_ & bit) {
+            low[r] = 1;
+        }
+        int pio = -1;
+        if (func_[pin] == GpioFunction::Pio0) {
+            pio = 0;
+        } else if (func_[pin] == GpioFunction::Pio1) {
+            pio = 1;
+        }
+        if (pio >= 0 && (pin_dirs[pio] & bit)) {
+            if (pin_values[pio] & bit) {
+                high[r] = 1;
+            } else {
+                low[r] = 1;
+            }
+        }
+        if (pull_up_mask_ & bit) {
+            high[r] = 1;
+        }
+    }
+    uint32_t levels = 0;
+    for (uint32_t pin = 0; pin < NUM_GPIOS; ++pin) {
+        const uint32_t r = root(pin);
+        if (!low[r] && high[r]) {
+            levels |= 1u << pin;
+        }
+    }
+    levels_ = levels;
+}
+
+// ---------------------------------------------------------------------------
+// PioBlock
+
+PioBlock::PioBlock(uint32_t index) : index_(index) {}
+
+bool PioBlock::can_add_program(const PioProgram &program) const {
+    const uint32_t len = (uint32_t)program.instructions.size();
+    const uint32_t mask = mask_bits(len);
+    if (program.origin >= 0) {
+        return (uint32_t)program.origin + len <= INSTRUCTION_COUNT &&
+               !(used_mask_ & (mask << program.origin));
+    }
+    for (int off = (int)(INSTRUCTION_COUNT - len); off >= 0; --off) {
+        if (!(used_mask_ & (mask << off))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t PioBlock::add_program(const PioProgram &program) {
+    const uint32_t len = (uint32_t)program.instructions.size();
+    const uint32_t mask = mask_bits(len);
+    int offset = -1;
+    if (program.origin >= 0) {
+        if ((uint32_t)program.origin + len <= INSTRUCTION_COUNT &&
+            !(used_mask_ & (mask << program.origin))) {
+            offset = program.origin;
+        }
+    } else {
+        for (int off = (int)(INSTRUCTION_COUNT - len); off >= 0; --off) {
+            if (!(used_mask_ & (mask << off))) {
+                offset = off;
+                break;
+            }
+        }
+    }
+    if (offset < 0) {
+        throw std::runtime_error("no program space for " + program.name);
+    }
+    for (uint32_t i = 0; i < len; ++i) {
+        uint16_t instr = program.instructions[i];
+        // JMPだけはロード位置に合わせて飛び先を再配置する（pio_add_programと同じ）
+        if ((instr >> 13) == 0) {
+            instr = (uint16_t)((instr & ~0x1Fu) | ((instr + (uint32_t)offset) & 0x1Fu));
+        }
+        instr_mem_[(uint32_t)offset + i] = instr;
+    }
+    used_mask_ |= mask << offset;
+    return (uint32_t)offset;
+}
+
+void PioBlock::sm_init(uint32_t sm, uint32_t initial_pc, const SmConfig &config) {
+    StateMachine &s = sms_[sm];
+    s.enabled = false;
+    s.config = config;
+    sm_clear_fifos(sm);
+    fdebug_ &= ~((1u << (FDEBUG_RXSTALL_LSB + sm)) | (1u << (FDEBUG_RXUNDER_LSB + sm)) |
+                 (1u << (FDEBUG_TXOVER_LSB + sm)) | (1u << (FDEBUG_TXSTALL_LSB + sm)));
+    sm_restart(sm);
+    sm_clkdiv_restart(sm);
+    s.pc = initial_pc & 31;
+}
+
+void PioBlock::sm_set_enabled(uint32_t sm, bool enabled) { sms_[sm].enabled = enabled; }
+
+void PioBlock::enable_sm_mask_in_sync(uint32_t mask) {
+    for (uint32_t sm = 0; sm < NUM_SMS; ++sm) {
+        if (mask & (1u << sm)) {
+            sm_clkdiv_restart(sm);
+            sms_[sm].enabled = true;
+        }
+    }
+}
+
+void PioBlock::sm_set_clkdiv(uint32_t sm, float div) { sms_[sm].config.set_clkdiv(div); }
+
+void PioBlock::sm_clkdiv_restart(uint32_t sm) { sms_[sm].div_acc = 0; }
+
+void PioBlock::sm_exec(uint32_t sm, uint16_t instr) {
+    StateMachine &s = sms_[sm];
+    uint32_t jump_to = 0;
+    Result r = execute(sm, instr, last_synced_, &jump_to);
+    if (r == Result::Stall) {
+        s.exec_pending = true;
+        s.exec_instr = instr;
+    } else if (r == Result::Jump) {
+        s.pc = jump_to;
+    }
+}
+
+void PioBlock::sm_clear_fifos(uint32_t sm) {
+    sms_[sm].tx.clear();
+    sms_[sm].rx.clear();
+}
+
+void PioBlock::sm_restart(uint32_t sm) {
+    StateMachine &s = sms_[sm];
+    s.isr = 0;
+    s.isr_count = 0;
+    s.osr_count = 32;
+    s.delay = 0;
+    s.exec_pending = false;
+    s.irq_waiting = false;
+}
+
+uint32_t PioBlock::tx_capacity(const StateMachine &s) const {
+    if (s.config.join_tx) {
+        return FIFO_DEPTH * 2;
+    }
+    return s.config.join_rx ? 0 : FIFO_DEPTH;
+}
+
+uint32_t PioBlock::rx_capacity(const StateMachine &s) const {
+    if (s.config.join_rx) {
+        return FIFO_DEPTH * 2;
+    }
+    return s.config.join_tx ? 0 : FIFO_DEPTH;
+}
+
+bool PioBlock::sm_put(uint32_t sm, uint32_t word) {
+    StateMachine &s = sms_[sm];
+    if (s.tx.count >= tx_capacity(s)) {
+        fdebug_ |= 1u << (FDEBUG_TXOVER_LSB + sm);
+        return false;
+    }
+    s.tx.push(word);
+    return true;
+}
+
+bool PioBlock::sm_get(uint32_t sm, uint32_t *word) {
+    StateMachine &s = sms_[sm];
+    if (s.rx.count == 0) {
+        fdebug_ |= 1u << (FDEBUG_RXUNDER_LSB + sm);
+        return false;
+    }
+    *word = s.rx.pop();
+    return true;
+}
+
+uint32_t PioBlock::tx_level(uint32_t sm) const { return sms_[sm].tx.count; }
+
+uint32_t PioBlock::rx_level(uint32_t sm) const { return sms_[sm].rx.count; }
+
+bool PioBlock::tx_full(uint32_t sm) const { return sms_[sm].tx.count >= tx_capacity(sms_[sm]); }
+
+void PioBlock::set_pins_with_mask(uint32_t values, uint32_t mask) {
+    pin_values_ = (pin_values_ & ~mask) | (values & mask);
+}
+
+void PioBlock::set_pindirs_with_mask(uint32_t dirs, uint32_t mask) {
+    pin_dirs_ = (pin_dirs_ & ~mask) | (dirs & mask);
+}
+
+void PioBlock::write_pins(uint32_t base, uint32_t count, uint32_t value) {
+    for (uint32_t i = 0; i < count; ++i) {
+        const uint32_t bit = 1u << ((base + i) & 31);
+        pin_values_ = (value >> i) & 1u ? (pin_values_ | bit) : (pin_values_ & ~bit);
+    }
+}
+
+void PioBlock::write_pindirs(uint32_t base, uint32_t count, uint32_t value) {
+    for (uint32_t i = 0; i < count; ++i) {
+        const uint32_t bit = 1u << ((base + i) & 31);
+        pin_dirs_ = (value >> i) & 1u ? (pin_dirs_ | bit) : (pin_dirs_ & ~bit);
+    }
+}
+
+uint32_t PioBlock::irq_index(uint32_t sm, uint32_t field) const {
+    uint32_t idx = field & 7;
+    if (field & 0x10) {
+        // rel: 下位2ビットにSM番号を足す
+        idx = (idx & 4) | ((idx + sm) & 3);
+    }
+    return idx;
+}
+
+void PioBlock::background_autopull(StateMachine &s) {
+    // autopull有効時、OSRが閾値まで空になっていればOUTを待たずに裏で補充される
+    if (s.config.autopull && s.osr_count >= s.config.pull_thresh && s.tx.count > 0) {
+        s.osr = s.tx.pop();
+        s.osr_count = 0;
+    }
+}
+
+void PioBlock::step(uint32_t synced_pins) {
+    last_synced_ = synced_pins;
+    for (uint32_t sm = 0; sm < NUM_SMS; ++sm) {
+        StateMachine &s = sms_[sm];
+        s.ticked = false;
+        s.executed = -1;
+        if (!s.enabled) {
+            continue;
+        }
+        const uint32_t div256 = s.config.clkdiv_int == 0
+                                    ? 65536u * 256u
+                                    : s.config.clkdiv_int * 256u + s.config.clkdiv_frac;
+        s.div_acc += 256;
+        if (s.div_acc < div256) {
+            continue;
+        }
+        s.div_acc -= div256;
+        tick(sm, synced_pins);
+    }
+}
+
+void PioBlock::tick(uint32_t sm, uint32_t synced_pins) {
+    StateMachine &s = sms_[sm];
+    s.ticked = true;
+    if (s.delay > 0) {
+        --s.delay;
+        return;
+    }
+
+    const bool from_exec = s.exec_pending;
+    const uint16_t instr = from_exec ? s.exec_instr : instr_mem_[s.pc];
+    s.exec_pending = false;
+
+    // side-setは命令の発行時点で反映される（ストールしても反映済み）
+    const uint32_t side_bits = s.config.sideset_bits;
+    const uint32_t delay_bits = 5 - side_bits;
+    const uint32_t field = (instr >> 8) & 0x1F;
+    if (side_bits != 0) {
+        uint32_t side = field >> delay_bits;
+        bool apply = true;
+        uint32_t value_bits = side_bits;
+        if (s.config.sideset_opt) {
+            value_bits = side_bits - 1;
+            apply = (side >> value_bits) & 1u;
+            side &= mask_bits(value_bits);
+        }
+        if (apply) {
+            if (s.config.sideset_pindirs) {
+                write_pindirs(s.config.sideset_base, value_bits, side);
+            } else {
+                write_pins(s.config.sideset_base, value_bits, side);
+            }
+        }
+    }
+
+    uint32_t jump_to = 0;
+    const Result r = execute(sm, instr, synced_pins, &jump_to);
+    if (r == Result::Stall) {
+        if (from_exec) {
+            s.exec_pending = true;
+        }
+        return;
+    }
+
+    const uint32_t op = instr >> 13;
+    const bool is_exec_write = (op == 3 && ((instr >> 5) & 7) == 7) ||
+                               (op == 5 && ((instr >> 5) & 7) == 4);
+    s.executed = instr;
+    // OUT EXEC / MOV EXEC自身の遅延は無視される
+    s.delay = is_exec_write ? 0 : field & mask_bits(delay_bits);
+
+    if (r == Result::Jump) {
+        s.pc = jump_to;
+    } else if (!from_exec) {
+        s.pc = (s.pc == s.config.wrap) ? s.config.wrap_target : ((s.pc + 1) & 31);
+    }
+    background_autopull(s);
+}
+
+PioBlock::Result PioBlock::execute(uint32_t sm, uint16_t instr, uint32_t synced_pins,
+                                   uint32_t *jump_to) {
+    StateMachine &s = sms_[sm];
+    const SmConfig &c = s.config;
+    const uint32_t op = instr >> 13;
+    const uint32_t arg1 = (instr >> 5) & 7;
+    const uint32_t arg2 = instr & 0x1F;
+
+    switch (op) {
+    case 0: { // JMP
+        bool take = false;
+        switch (arg1) {
+        case 0:
+            take = true;
+            break;
+        case 1:
+            take = s.x == 0;
+            break;
+        case 2:
+            take = s.x != 0;
+            --s.x;
+            break;
+        case 3:
+            take = s.y == 0;
+            break;
+        case 4:
+            take = s.y != 0;
+            --s.y;
+            break;
+        case 5:
+            take = s.x != s.y;
+            break;
+        case 6:
+            take = (synced_pins >> c.jmp_pin) & 1u;
+            break;
+        case 7:
+            take = s.osr_count < c.pull_thresh;
+            break;
+        }
+        if (take) {
+            *jump_to = arg2;
+            return Result::Jump;
+        }
+        return Result::Next;
+    }
+    case 1: { // WAIT
+        const uint32_t polarity = (instr >> 7) & 1u;
+        const uint32_t source = (instr >> 5) & 3u;
+        uint32_t level = 0;
+        if (source == 0) {
+            level = (synced_pins >> arg2) & 1u;
+        } else if (source == 1) {
+            level = (synced_pins >> ((c.in_base + arg2) & 31)) & 1u;
+        } else if (source == 2) {
+            const uint32_t idx = irq_index(sm, arg2);
+            level = (irq_flags_ >> idx) & 1u;
+            if (polarity && level) {
+                // wait 1 irq は条件成立時にフラグをクリアする
+                irq_flags_ &= (uint8_t)~(1u << idx);
+            }
+        }
+        return level == polarity ? Result::Next : Result::Stall;
+    }
+    case 2: { // IN
+        const uint32_t n = arg2 == 0 ? 32 : arg2;
+        uint32_t data = 0;
+        switch (arg1) {
+        case 0:
+            data = rotate_right(synced_pins, c.in_base);
+            break;
+        case 1:
+            data = s.x;
+            break;
+        case 2:
+            data = s.y;
+            break;
+        case 6:
+            data = s.isr;
+            break;
+        case 7:
+            data = s.osr;
+            break;
+        default:
+            data = 0;
+            break;
+        }
+        if (c.autopush && s.isr_count + n >= c.push_thresh && s.rx.count >= rx_capacity(s)) {
+            fdebug_ |= 1u << (FDEBUG_RXSTALL_LSB + sm);
+            return Result::Stall;
+        }
+        data &= mask_bits(n);
+        if (c.in_shift_right) {
+            s.isr = n == 32 ? data : (s.isr >> n) | (data << (32 - n));
+        } else {
+            s.isr = n == 32 ? data : (s.isr << n) | data;
+        }
+        s.isr_count = std::min<uint32_t>(32, s.isr_count + n);
+        if (c.autopush && s.isr_count >= c.push_thresh) {
+            s.rx.push(s.isr);
+            s.isr = 0;
+            s.isr_count = 0;
+        }
+        return Result::Next;
+    }
+    case 3: { // OUT
+        const uint32_t n = arg2 == 0 ? 32 : arg2;
+        if (c.autopull && s.osr_count >= c.pull_thresh) {
+            if (s.tx.count == 0) {
+                fdebug_ |= 1u << (FDEBUG_TXSTALL_LSB + sm);
+                return Result::Stall;
+            }
+            s.osr = s.tx.pop();
+            s.osr_count = 0;
+        }
+        uint32_t data = 0;
+        if (c.out_shift_right) {
+            data = s.osr & mask_bits(n);
+            s.osr = n == 32 ? 0 : s.osr >> n;
+        } else {
+            data = n == 32 ? s.osr : s.osr >> (32 - n);
+            s.osr = n == 32 ? 0 : s.osr << n;
+        }
+        s.osr_count = std::min<uint32_t>(32, s.osr_count + n);
+        switch (arg1) {
+        case 0:
+            write_pins(c.out_base, c.out_count, data);
+            break;
+        case 1:
+            s.x = data;
+            break;
+        case 2:
+            s.y = data;
+            break;
+        case 4:
+            write_pindirs(c.out_base, c.out_count, data);
+            break;
+        case 5:
+            *jump_to = data & 31;
+            return Result::Jump;
+        case 6:
+            s.isr = data;
+            s.isr_count = n;
+            break;
+        case 7:
+            s.exec_pending = true;
+            s.exec_instr = (uint16_t)data;
+            break;
+        default:
+            break;
+        }
+        return Result::Next;
+    }
+    case 4: { // PUSH / PULL
+        const bool is_pull = (instr >> 7) & 1u;
+        const bool if_flag = (instr >> 6) & 1u;
+        const bool block = (instr >> 5) & 1u;
+        if (!is_pull) {
+            if (if_flag && s.isr_count < c.push_thresh) {
+                return Result::Next;
+            }
+            if (s.rx.count >= rx_capacity(s)) {
+                fdebug_ |= 1u << (FDEBUG_RXSTALL_LSB + sm);
+                if (block) {
+                    return Result::Stall;
+                }
+                // noblockで満杯なら捨てられる
+            } else {
+                s.rx.push(s.isr);
+            }
+            s.isr = 0;
+            s.isr_count = 0;
+            return Result::Next;
+        }
+        if (if_flag && s.osr_count < c.pull_thresh) {
+            return Result::Next;
+        }
+        // autopull有効時のPULLはOSRが満杯（まだ1ビットも出していない）ならno-op
+        // autopullで既に補充済みなら何もしない、というフェンスとして働く
+        if (c.autopull && s.osr_count == 0) {
+            return Result::Next;
+        }
+        if (s.tx.count == 0) {
+            if (block) {
+                fdebug_ |= 1u << (FDEBUG_TXSTALL_LSB + sm);
+                return Result::Stall;
+            }
+            s.osr = s.x; // noblockで空ならXをコピー
+        } else {
+            s.osr = s.tx.pop();
+        }
+        s.osr_count = 0;
+        return Result::Next;
+    }
+    case 5: { // MOV
+        const uint32_t mov_op = (instr >> 3) & 3u;
+        uint32_t v = 0;
+        switch (instr & 7u) {
+        case 0:
+            v = rotate_right(synced_pins, c.in_base);
+            break;
+        case 1:
+            v = s.x;
+            break;
+        case 2:
+            v = s.y;
+            break;
+        case 5: {
+            const uint32_t level = c.status_sel_rx ? s.rx.count : s.tx.count;
+            v = level < c.status_n ? 0xFFFFFFFFu : 0;
+            break;
+        }
+        case 6:
+            v = s.isr;
+            break;
+        case 7:
+            v = s.osr;
+            break;
+        default:
+            v = 0;
+            break;
+        }
+        if (mov_op == 1) {
+            v = ~v;
+        } else if (mov_op == 2) {
+            v = bit_reverse(v);
+        }
+        switch (arg1) {
+        case 0:
+            write_pins(c.out_base, c.out_count, v);
+            break;
+        case 1:
+            s.x = v;
+            break;
+        case 2:
+            s.y = v;
+            break;
+        case 4:
+            s.exec_pending = true;
+            s.exec_instr = (uint16_t)v;
+            break;
+        case 5:
+            *jump_to = v & 31;
+            return Result::Jump;
+        case 6:
+            s.isr = v;
+            s.isr_count = 0;
+            break;
+        case 7:
+            s.osr = v;
+            s.osr_count = 0;
+            break;
+        default:
+            break;
+        }
+        return Result::Next;
+    }
+    case 6: { // IRQ
+        const bool clear = (instr >> 6) & 1u;
+        const bool wait = (instr >> 5) & 1u;
+        const uint32_t bit = 1u << irq_index(sm, arg2);
+        if (clear) {
+            irq_flags_ &= (uint8_t)~bit;
+            return Result::Next;
+        }
+        if (!wait) {
+            irq_flags_ |= (uint8_t)bit;
+            return Result::Next;
+        }
+        // irq wait: フラグを立てたあと、誰かにクリアされるまでストール
+        if (!s.irq_waiting) {
+            irq_flags_ |= (uint8_t)bit;
+            s.irq_waiting = true;
+            return Result::Stall;
+        }
+        if (irq_flags_ & bit) {
+            return Result::Stall;
+        }
+        s.irq_waiting = false;
+        return Result::Next;
+    }
+    case 7: { // SET
+        switch (arg1) {
+        case 0:
+            write_pins(c.set_base, c.set_count, arg2);
+            break;
+        case 1:
+            s.x = arg2;
+            break;
+        case 2:
+            s.y = arg2;
+            break;
+        case 4:
+            write_pindirs(c.set_base, c.set_count, arg2);
+            break;
+        default:
+            break;
+        }
+        return Result::Next;
+    }
+    }
+    return Result::Next;
+}
+
+// ---------------------------------------------------------------------------
+// Rp2040
+
+Rp2040::Rp2040(uint32_t clk_sys_hz) : clk_sys_hz_(clk_sys_hz), pios_{PioBlock(0), PioBlock(1)} {}
+
+void Rp2040::pio_gpio_init(uint32_t pio_index, uint32_t pin) {
+    gpio_.set_function(pin, pio_index == 0 ? GpioFunction::Pio0 : GpioFunction::Pio1);
+}
+
+void Rp2040::step() {
+    gpio_.update({pios_[0].pin_values(), pios_[1].pin_values()},
+                 {pios_[0].pin_dirs(), pios_[1].pin_dirs()});
+    const uint32_t synced = gpio_.synced_levels();
+    for (PioBlock &p : pios_) {
+        p.step(synced);
+    }
+    ++cycle_;
+    if (on_cycle) {
+        on_cycle(*this);
+    }
+}
+
+void Rp2040::run_cycles(uint64_t n) {
+    for (uint64_t i = 0; i < n; ++i) {
+        step();
+    }
+}
+
+bool Rp2040::run_until(const std::function<bool()> &cond, uint64_t max_cycles) {
+    for (uint64_t i = 0; i < max_cycles; ++i) {
+        if (cond()) {
+            return true;
+        }
+        step();
+    }
+    return cond();
+}
+
+} // namespace pio_sim
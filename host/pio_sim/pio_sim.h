@@ -0,0 +1,256 @@
+#pragma once
+
+// RP2040のPIOをclk_sys 1サイクル単位で再現するシミュレータ
+// 対象:
+//   - 命令メモリ32ワード・ステートマシン4つ×PIOブロック2つ
+//   - TX/RX FIFO（4段、FJOINで8段）、autopush/autopull、FDEBUGフラグ
+//   - IRQフラグ8本（rel指定、wait irqによる自動クリア）
+//   - jmp pin、クロック分周（整数+1/256の小数部）、GPIO入力の2段シンクロナイザ
+//   - オープンドレインの配線（TX_PINとRX_PINを外部でつないだループバック）
+// 実機との違い:
+//   - CPUやDMAの動作は呼び出し側（ハーネス）が1サイクル単位で模擬する
+//   - side-setのpindirs指定やMOV STATUSのIRQ選択などRP2350の拡張は扱わない
+
+#include "pio_asm.h"
+
+#include <array>
+#include <cstdint>
+#include <functional>
+
+namespace pio_sim {
+
+constexpr uint32_t NUM_GPIOS = 30;
+constexpr uint32_t NUM_PIOS = 2;
+constexpr uint32_t NUM_SMS = 4;
+constexpr uint32_t INSTRUCTION_COUNT = 32;
+constexpr uint32_t FIFO_DEPTH = 4;
+
+// RP2040のデフォルトのclk_sys
+constexpr uint32_t DEFAULT_CLK_SYS_HZ = 125'000'000;
+
+// FDEBUGレジスタのビット位置（smごとに+sm）
+constexpr uint32_t FDEBUG_RXSTALL_LSB = 0;
+constexpr uint32_t FDEBUG_RXUNDER_LSB = 8;
+constexpr uint32_t FDEBUG_TXOVER_LSB = 16;
+constexpr uint32_t FDEBUG_TXSTALL_LSB = 24;
+
+enum class GpioFunction { Null, Pio0, Pio1 };
+
+// pio_sm_configに相当する設定（sm_config_set_*と同じ意味のフィールドを持つ）
+struct SmConfig {
+    uint32_t clkdiv_int = 1;
+    uint32_t clkdiv_frac = 0; // 1/256単位
+    uint32_t wrap_target = 0;
+    uint32_t wrap = INSTRUCTION_COUNT - 1;
+    uint32_t in_base = 0;
+    uint32_t jmp_pin = 0;
+    uint32_t set_base = 0;
+    uint32_t set_count = 0;
+    uint32_t out_base = 0;
+    uint32_t out_count = 0;
+    uint32_t sideset_base = 0;
+    uint32_t sideset_bits = 0; // オプションビットを含むビット数
+    bool sideset_opt = false;
+    bool sideset_pindirs = false;
+    bool in_shift_right = true;
+    bool autopush = false;
+    uint32_t push_thresh = 32;
+    bool out_shift_right = true;
+    bool autopull = false;
+    uint32_t pull_thresh = 32;
+    bool join_tx = false;
+    bool join_rx = false;
+    bool status_sel_rx = false;
+    uint32_t status_n = 0;
+
+    // pioasmが生成する *_program_get_default_config(offset) と同じ初期値
+    static SmConfig from_program(const PioProgram &program, uint32_t offset);
+    // sm_config_set_clkdiv(c, div) と同じ丸めで分周比を設定
+    void set_clkdiv(float div);
+    void set_in_shift(bool shift_right, bool autopush_enabled, uint32_t threshold);
+    void set_out_shift(bool shift_right, bool autopull_enabled, uint32_t threshold);
+};
+
+// 外部配線を含むGPIOの状態
+// 同じネットにつながったピンはすべて同じレベルになる（オープンドレイン+プルアップ）
+class GpioBus {
+  public:
+    GpioBus();
+
+    // 2本のピンを外部でつなぐ（ループバック配線）
+    void connect(uint32_t a, uint32_t b);
+    void set_function(uint32_t pin, GpioFunction func);
+    void set_pull_up(uint32_t pin, bool enabled);
+    // 外部機器がピンをLowに引く（コンソールやコントローラ役の波形生成用）
+    void set_external_low(uint32_t pin, bool low);
+
+    // 現在の線のレベル
+    bool level(uint32_t pin) const { return (levels_ >> pin) & 1u; }
+    uint32_t levels() const { return levels_; }
+    // 2段シンクロナイザを通した後のレベル（PIOから見える値）
+    uint32_t synced_levels() const { return synced_[1]; }
+
+    // PIOの出力を反映して1サイクル進める
+    void update(const std::array<uint32_t, NUM_PIOS> &pin_values,
+                const std::array<uint32_t, NUM_PIOS> &pin_dirs);
+
+  private:
+    uint32_t root(uint32_t pin) const;
+
+    std::array<uint32_t, NUM_GPIOS> net_{};
+    std::array<GpioFunction, NUM_GPIOS> func_{};
+    uint32_t pull_up_mask_ = 0;
+    uint32_t external_low_mask_ = 0;
+    uint32_t levels_ = 0;
+    std::array<uint32_t, 2> synced_{};
+    // 前回計算したときの入力（変化がなければ再計算しない）
+    bool valid_ = false;
+    std::array<uint32_t, NUM_PIOS> last_values_{};
+    std::array<uint32_t, NUM_PIOS> last_dirs_{};
+    uint32_t last_external_ = 0;
+};
+
+class PioBlock {
+  public:
+    explicit PioBlock(uint32_t index);
+
+    uint32_t index() const { return index_; }
+
+    // pio_can_add_program / pio_add_program と同じく空きの一番上の番地に配置する
+    bool can_add_program(const PioProgram &program) const;
+    uint32_t add_program(const PioProgram &program);
+    uint32_t used_instruction_mask() const { return used_mask_; }
+
+    void sm_init(uint32_t sm, uint32_t initial_pc, const SmConfig &config);
+    void sm_set_enabled(uint32_t sm, bool enabled);
+    // 複数のSMを同じサイクルで有効化する（pio_enable_sm_mask_in_sync相当）
+    void enable_sm_mask_in_sync(uint32_t mask);
+    void sm_set_clkdiv(uint32_t sm, float div);
+    void sm_clkdiv_restart(uint32_t sm);
+    // SMx_INSTRへの書き込み（pio_sm_exec相当、即時実行）
+    void sm_exec(uint32_t sm, uint16_t instr);
+    void sm_clear_fifos(uint32_t sm);
+    void sm_restart(uint32_t sm);
+
+    bool sm_put(uint32_t sm, uint32_t word); // 満杯ならfalse（FDEBUG_TXOVERが立つ）
+    bool sm_get(uint32_t sm, uint32_t *word); // 空ならfalse（FDEBUG_RXUNDERが立つ）
+    uint32_t tx_level(uint32_t sm) const;
+    uint32_t rx_level(uint32_t sm) const;
+    bool tx_full(uint32_t sm) const;
+    bool rx_empty(uint32_t sm) const { return rx_level(sm) == 0; }
+
+    uint32_t pc(uint32_t sm) const { return sms_[sm].pc; }
+    uint32_t x(uint32_t sm) const { return sms_[sm].x; }
+    uint32_t y(uint32_t sm) const { return sms_[sm].y; }
+    bool enabled(uint32_t sm) const { return sms_[sm].enabled; }
+    // 直前のサイクルでこのSMが命令を実行（または遅延を消化）したか
+    bool ticked(uint32_t sm) const { return sms_[sm].ticked; }
+    // 直前のサイクルで実行を完了した命令語（遅延消化中やストール中は-1）
+    int32_t executed(uint32_t sm) const { return sms_[sm].executed; }
+    const SmConfig &config(uint32_t sm) const { return sms_[sm].config; }
+
+    uint8_t irq_flags() const { return irq_flags_; }
+    void irq_force(uint8_t mask) { irq_flags_ |= mask; }
+    void irq_clear(uint8_t mask) { irq_flags_ &= (uint8_t)~mask; }
+    uint32_t fdebug() const { return fdebug_; }
+    void fdebug_clear(uint32_t mask) { fdebug_ &= ~mask; }
+
+    uint32_t pin_values() const { return pin_values_; }
+    uint32_t pin_dirs() const { return pin_dirs_; }
+    void set_pins_with_mask(uint32_t values, uint32_t mask);
+    void set_pindirs_with_mask(uint32_t dirs, uint32_t mask);
+
+    // clk_sys 1サイクル分進める
+    void step(uint32_t synced_pins);
+
+  private:
+    struct Fifo {
+        std::array<uint32_t, FIFO_DEPTH * 2> data{};
+        uint32_t head = 0;
+        uint32_t count = 0;
+        void clear() { head = count = 0; }
+        void push(uint32_t v) { data[(head + count++) % data.size()] = v; }
+        uint32_t pop() {
+            uint32_t v = data[head];
+            head = (head + 1) % (uint32_t)data.size();
+            --count;
+            return v;
+        }
+    };
+
+    struct StateMachine {
+        SmConfig config;
+        bool enabled = false;
+        bool ticked = false;
+        int32_t executed = -1;
+        uint32_t pc = 0;
+        uint32_t x = 0;
+        uint32_t y = 0;
+        uint32_t isr = 0;
+        uint32_t osr = 0;
+        uint32_t isr_count = 0;
+        uint32_t osr_count = 32;
+        uint32_t delay = 0;
+        uint32_t div_acc = 0;
+        bool exec_pending = false;
+        uint16_t exec_instr = 0;
+        bool irq_waiting = false;
+        Fifo tx;
+        Fifo rx;
+    };
+
+    enum class Result { Next, Jump, Stall };
+
+    uint32_t tx_capacity(const StateMachine &s) const;
+    uint32_t rx_capacity(const StateMachine &s) const;
+    void tick(uint32_t sm, uint32_t synced_pins);
+    Result execute(uint32_t sm, uint16_t instr, uint32_t synced_pins, uint32_t *jump_to);
+    uint32_t irq_index(uint32_t sm, uint32_t field) const;
+    void write_pins(uint32_t base, uint32_t count, uint32_t value);
+    void write_pindirs(uint32_t base, uint32_t count, uint32_t value);
+    void background_autopull(StateMachine &s);
+
+    uint32_t index_;
+    std::array<uint16_t, INSTRUCTION_COUNT> instr_mem_{};
+    uint32_t used_mask_ = 0;
+    std::array<StateMachine, NUM_SMS> sms_{};
+    uint8_t irq_flags_ = 0;
+    uint32_t fdebug_ = 0;
+    uint32_t pin_values_ = 0;
+    uint32_t pin_dirs_ = 0;
+    uint32_t last_synced_ = 0;
+};
+
+// PIOブロック2つとGPIOをまとめたチップ全体
+class Rp2040 {
+  public:
+    explicit Rp2040(uint32_t clk_sys_hz = DEFAULT_CLK_SYS_HZ);
+
+    PioBlock &pio(uint32_t index) { return pios_[index]; }
+    GpioBus &gpio() { return gpio_; }
+    const GpioBus &gpio() const { return gpio_; }
+
+    uint32_t clk_sys_hz() const { return clk_sys_hz_; }
+    uint64_t cycle() const { return cycle_; }
+    double now_us() const { return (double)cycle_ * 1e6 / clk_sys_hz_; }
+    uint64_t us_to_cycles(double us) const { return (uint64_t)(us * clk_sys_hz_ / 1e6 + 0.5); }
+
+    // pio_gpio_init相当（ピンをPIOに割り当ててプルアップを有効にする）
+    void pio_gpio_init(uint32_t pio_index, uint32_t pin);
+
+    // 1サイクル進める（毎サイクルの後に観測用コールバックを呼ぶ）
+    void step();
+    void run_cycles(uint64_t n);
+    // cond()が真になるまで進める。max_cycles以内に成立しなければfalse
+    bool run_until(const std::function<bool()> &cond, uint64_t max_cycles);
+
+    std::function<void(const Rp2040 &)> on_cycle;
+
+  private:
+    uint32_t clk_sys_hz_;
+    uint64_t cycle_ = 0;
+    GpioBus gpio_;
+    std::array<PioBlock, NUM_PIOS> pios_;
+};
+
+} // namespace pio_sim
@@ -0,0 +1,88 @@
+#pragma once
+
+// GTKWaveなどで開けるVCD（Value Change Dump）を書き出す
+// 値が変化したときだけ記録するので長時間のシミュレーションでもそれなりのサイズに収まる
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace pio_sim {
+
+class VcdWriter {
+  public:
+    bool open(const std::string &path, uint32_t timescale_ns) {
+        out_.open(path);
+        timescale_ns_ = timescale_ns;
+        return (bool)out_;
+    }
+
+    bool is_open() const { return out_.is_open(); }
+
+    // ヘッダを書き出す前に信号を登録する
+    int add(const std::string &name, uint32_t width) {
+        vars_.push_back({name, width, id_for((int)vars_.size()), ~0ull});
+        return (int)vars_.size() - 1;
+    }
+
+    void begin() {
+        out_ << "$timescale " << timescale_ns_ << " ns $end\n";
+        out_ << "$scope module gc_playground $end\n";
+        for (const Var &v : vars_) {
+            out_ << "$var wire " << v.width << " " << v.id << " " << v.name << " $end\n";
+        }
+        out_ << "$upscope $end\n$enddefinitions $end\n";
+    }
+
+    // time: timescale単位の時刻
+    void change(uint64_t time, int var, uint64_t value) {
+        Var &v = vars_[(size_t)var];
+        if (v.last == value) {
+            return;
+        }
+        v.last = value;
+        if (time != last_time_ || !time_written_) {
+            out_ << "#" << time << "\n";
+            last_time_ = time;
+            time_written_ = true;
+        }
+        if (v.width == 1) {
+            out_ << (value & 1u) << v.id << "\n";
+        } else {
+            out_ << "b";
+            for (int i = (int)v.width - 1; i >= 0; --i) {
+                out_ << ((value >> i) & 1u);
+            }
+            out_ << " " << v.id << "\n";
+        }
+    }
+
+    void close() { out_.close(); }
+
+  private:
+    struct Var {
+        std::string name;
+        uint32_t width;
+        std::string id;
+        uint64_t last;
+    };
+
+    static std::string id_for(int n) {
+        // VCDの識別子は印字可能なASCII(!〜~)の並び
+        std::string id;
+        do {
+            id += (char)('!' + n % 94);
+            n /= 94;
+        } while (n > 0);
+        return id;
+    }
+
+    std::ofstream out_;
+    uint32_t timescale_ns_ = 1;
+    std::vector<Var> vars_;
+    uint64_t last_time_ = 0;
+    bool time_written_ = false;
+};
+
+} // namespace pio_sim
@@ -0,0 +1,167 @@
+// 実機のトレースリング（lib/joybus/include/joybus_trace_ring.h）が書き出した行を読み、
+// やりとりごとの区間の長さをヒストグラムにする
+//   trace_decode [ログファイル]   （省略時は標準入力。"#"で始まらない行は読み飛ばす）
+// 区間（同じコアのイベント同士はSysTickのサイクル数、コアをまたぐとタイマの差で求める）
+//   tx_armed  → first_edge  : 送信を指示してから線が動くまで
+//   first_edge→ stop_bit    : フレームの長さ
+//   stop_bit  → rx_complete : フレーム終端の割り込みからメインループが取り出すまで
+//   tx_armed  → rx_complete : やりとり全体
+#include "joybus_trace.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr uint32_t DEFAULT_CLK_HZ = 125'000'000;
+constexpr size_t HISTOGRAM_BINS = 16;
+constexpr size_t HISTOGRAM_WIDTH = 50;
+
+struct Interval {
+    const char *name;
+    JoyBusTraceEvent from;
+    JoyBusTraceEvent to;
+    std::vector<uint64_t> cycles;
+};
+
+// 1回のやりとり（tx_armedから終わりのイベントまで）に見えたイベント
+struct Transaction {
+    bool open = false;
+    bool seen[8] = {};
+    JoyBusTraceRecord records[8] = {};
+
+    void add(const JoyBusTraceRecord &r) {
+        if (r.event < 8 && !seen[r.event]) {
+            seen[r.event] = true;
+            records[r.event] = r;
+        }
+    }
+};
+
+void print_histogram(const Interval &interval, uint32_t clk_hz) {
+    const std::vector<uint64_t> &v = interval.cycles;
+    printf("\n%s (%zu samples)\n", interval.name, v.size());
+    if (v.empty()) {
+        return;
+    }
+    uint64_t min = UINT64_MAX;
+    uint64_t max = 0;
+    uint64_t sum = 0;
+    for (uint64_t c : v) {
+        min = c < min ? c : min;
+        max = c > max ? c : max;
+        sum += c;
+    }
+    const double cycles_per_us = clk_hz / 1e6;
+    printf("  min=%.2fus avg=%.2fus max=%.2fus (min=%llu max=%llu cycles)\n",
+           min / cycles_per_us, (double)sum / v.size() / cycles_per_us, max / cycles_per_us,
+           (unsigned long long)min, (unsigned long long)max);
+
+    const uint64_t span = max - min + 1;
+    const uint64_t bin_width = (span + HISTOGRAM_BINS - 1) / HISTOGRAM_BINS;
+    size_t bins[HISTOGRAM_BINS] = {};
+    size_t peak = 0;
+    for (uint64_t c : v) {
+        size_t &bin = bins[(c - min) / bin_width];
+        ++bin;
+        peak = bin > peak ? bin : peak;
+    }
+    for (size_t i = 0; i < HISTOGRAM_BINS; ++i) {
+        const uint64_t lo = min + i * bin_width;
+        if (lo > max) {
+            break;
+        }
+        const size_t bar = bins[i] * HISTOGRAM_WIDTH / peak;
+        printf("  %9.2fus %6zu %s\n", lo / cycles_per_us, bins[i], std::string(bar, '#').c_str());
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    FILE *in = stdin;
+    if (argc > 1) {
+        in = fopen(argv[1], "r");
+        if (in == nullptr) {
+            fprintf(stderr, "cannot open %s\n", argv[1]);
+            return 1;
+        }
+    }
+
+    std::vector<Interval> intervals = {
+        {"tx_armed -> first_edge", JoyBusTraceEvent::TxArmed, JoyBusTraceEvent::FirstEdge, {}},
+        {"first_edge -> stop_bit", JoyBusTraceEvent::FirstEdge, JoyBusTraceEvent::StopBit, {}},
+        {"stop_bit -> rx_complete", JoyBusTraceEvent::StopBit, JoyBusTraceEvent::RxComplete, {}},
+        {"tx_armed -> rx_complete", JoyBusTraceEvent::TxArmed, JoyBusTraceEvent::RxComplete, {}},
+    };
+    uint32_t clk_hz = DEFAULT_CLK_HZ;
+    uint32_t event_counts[8] = {};
+    unsigned long dropped = 0;
+    size_t records = 0;
+    size_t unmatched = 0; // tx_armedより前に来たイベント
+
+    // やりとりはtx_armedで始まり、rx_complete/timeout/errorで終わる
+    // 割り込みハンドラのイベントは別のコアで記録されることもあるので、コアは区別せずに組にする
+    Transaction current;
+    char line[256];
+    while (fgets(line, sizeof(line), in) != nullptr) {
+        unsigned long value = 0;
+        unsigned core = 0;
+        if (sscanf(line, "#C %lu", &value) == 1) {
+            clk_hz = (uint32_t)value;
+            continue;
+        }
+        if (sscanf(line, "#D %u %lu", &core, &value) == 2) {
+            dropped += value;
+            continue;
+        }
+        JoyBusTraceRecord r;
+        if (!joybus_trace_parse(line, &r)) {
+            continue;
+        }
+        ++records;
+        if (r.event < 8) {
+            ++event_counts[r.event];
+        }
+
+        const JoyBusTraceEvent event = (JoyBusTraceEvent)r.event;
+        if (event == JoyBusTraceEvent::TxArmed) {
+            current = Transaction{};
+            current.open = true;
+        } else if (!current.open) {
+            ++unmatched;
+            continue;
+        }
+        current.add(r);
+
+        if (event == JoyBusTraceEvent::RxComplete || event == JoyBusTraceEvent::Timeout ||
+            event == JoyBusTraceEvent::Error) {
+            for (Interval &interval : intervals) {
+                const uint8_t from = (uint8_t)interval.from;
+                const uint8_t to = (uint8_t)interval.to;
+                if (current.seen[from] && current.seen[to]) {
+                    interval.cycles.push_back(joybus_trace_cycles_between(
+                        current.records[from], current.records[to], clk_hz));
+                }
+            }
+            current.open = false;
+        }
+    }
+    if (in != stdin) {
+        fclose(in);
+    }
+
+    printf("%zu records, clk_sys=%luHz, dropped=%lu, unmatched=%zu\n", records,
+           (unsigned long)clk_hz, dropped, unmatched);
+    for (uint8_t e = 1; e < 8; ++e) {
+        if (event_counts[e] > 0) {
+            printf("  %-12s %lu\n", joybus_trace_event_name(e), (unsigned long)event_counts[e]);
+        }
+    }
+    for (const Interval &interval : intervals) {
+        print_histogram(interval, clk_hz);
+    }
+    return 0;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+// JoyBusのコマンド表（コマンドの1バイト目 → コマンドの長さ, 応答の長さ）
+// 応答の長さはコマンドの1バイト目だけで決まるので、受信の準備に使う値をコマンドごとに
+// コンパイル時に計算して256エントリの表にしておく
+//   - 1バイトの表は256バイト境界に並べるので、エントリのアドレスはコマンドの1バイト目を
+//     表の先頭アドレスの下位8ビットに書くだけで作れる（CPUを使わずDMAだけで表を引ける。
+//     examples/command_tableは送るコマンドの1バイト目から応答の転送数をDMAで引く）
+//   - 表にないコマンドは長さ0（request_bytes[cmd] == 0で見分ける）
+//
+// pico-sdkに依存しないのでホスト側（host/）のツールからも同じものを使う
+
+#include "joybus_frame.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct JoyBusCommandInfo {
+    uint8_t command;       // コマンドの1バイト目
+    uint8_t request_bytes; // コマンドの長さ（1バイト目を含む）
+    uint8_t reply_bytes;   // 応答の長さ（ストップビットを除く）
+    const char *name;
+};
+
+// GameCubeの標準コントローラのコマンド（examples/controller_emuが応答するもの）
+constexpr JoyBusCommandInfo JOYBUS_GC_COMMANDS[] = {
+    {0x00, 1, 3, "identify"},   // → デバイスの種類
+    {0x40, 3, 8, "poll"},       // 0x40 モード ランブル → ボタンとスティック
+    {0x41, 1, 10, "origin"},    // → スティックの中心（起動時の値）
+    {0x42, 3, 10, "calibrate"}, // 0x42 0x00 0x00 → 中心を取り直してoriginと同じ応答
+    {0xFF, 1, 3, "reset"},      // → identifyと同じ応答
+};
+
+struct alignas(256) JoyBusCommandTable {
+    uint8_t request_bytes[256] = {};
+    uint8_t reply_bytes[256] = {};
+    // 応答をストップビット(0x01)まで受け取るDMAの転送数（reply_bytes + 1）
+    // 受信のSMがストップビットを最後のバイトとしてpushするもの（joy_txrx, joy_rx_os）用
+    uint8_t reply_dma_count[256] = {};
+    // ビット数を受け取る受信のSM（pull blockで待つjoy_rx5など）に渡す値（reply_bytes * 8 - 1）
+    uint32_t reply_bits_minus1[256] = {};
+};
+
+// コマンドの一覧から表を作る（同じコマンドが重なったら後のものが残る）
+template <size_t N>
+constexpr JoyBusCommandTable joybus_command_table_make(const JoyBusCommandInfo (&commands)[N]) {
+    JoyBusCommandTable t{};
+    for (size_t i = 0; i < N; ++i) {
+        const JoyBusCommandInfo &c = commands[i];
+        t.request_bytes[c.command] = c.request_bytes;
+        t.reply_bytes[c.command] = c.reply_bytes;
+        t.reply_dma_count[c.command] = (uint8_t)(c.reply_bytes + 1u);
+        t.reply_bits_minus1[c.command] = c.reply_bytes * 8u - 1u;
+    }
+    return t;
+}
+
+// 一覧の長さがフレームの上限に収まっているか（static_assertで使う）
+template <size_t N>
+constexpr bool joybus_command_list_valid(const JoyBusCommandInfo (&commands)[N]) {
+    for (size_t i = 0; i < N; ++i) {
+        const JoyBusCommandInfo &c = commands[i];
+        if (c.request_bytes == 0 || c.request_bytes > JOYBUS_MAX_FRAME_BYTES ||
+            c.reply_bytes == 0 || c.reply_bytes > JOYBUS_MAX_FRAME_BYTES) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(offsetof(JoyBusCommandTable, reply_dma_count) % 256 == 0,
+              "reply_dma_count must start on a 256-byte boundary");
+static_assert(joybus_command_list_valid(JOYBUS_GC_COMMANDS),
+              "JOYBUS_GC_COMMANDS has a length outside 1..JOYBUS_MAX_FRAME_BYTES");
+
+// コマンドの一覧から名前を引く（表示用。見つからなければnullptr）
+template <size_t N>
+constexpr const char *joybus_command_name(const JoyBusCommandInfo (&commands)[N],
+                                          uint8_t command) {
+    for (size_t i = 0; i < N; ++i) {
+        if (commands[i].command == command) {
+            return commands[i].name;
+        }
+    }
+    return nullptr;
+}
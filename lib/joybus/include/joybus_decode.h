@@ -0,0 +1,120 @@
+#pragma once
+
+// 3点サンプリングで受信したワードをバイトに戻すデコーダ
+// joy_rx4 / joy_rx5（3点サンプリング版）はビットごとに3サンプルをINし、
+// 24ビット（8ビット分）たまったところでautopushする
+//   00000000 | s0, s1, s2 | s0, s1, s2 | ... | s0, s1, s2
+//   最も古いサンプルがビット23、最新がビット0
+// 各ビットの値は3サンプルの多数決で決める
+//
+// pico-sdkに依存しないのでホスト側（host/）のツールからも同じものを使う
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 各3サンプル組の最下位ビット（s2の位置）に1が立ったマスク
+constexpr uint32_t JOYBUS_3SAMPLE_LSB_MASK = 0x00249249u;
+
+// 元の実装（1ビットずつ取り出して多数決）
+// 結果の比較とベンチマークの基準用に残している
+inline uint8_t joybus_decode_3sample_loop(uint32_t w) {
+    uint8_t out = 0;
+    // 上位iビット目の3サンプルを抽出し多数決をとる
+    for (int i = 0; i < 8; ++i) {
+        int base = 23 - 3 * i;
+        uint32_t s0 = (w >> base) & 1u;
+        uint32_t s1 = (w >> (base - 1)) & 1u;
+        uint32_t s2 = (w >> (base - 2)) & 1u;
+        uint32_t majority = (s0 & s1) | (s1 & s2) | (s2 & s0);
+        out = (uint8_t)((out << 1) | (majority & 1u));
+    }
+    return out;
+}
+
+// 3ビット間隔に並んだ8ビット（各組のs2の位置、ビット0,3,6,...,21）を詰める
+// ビット0,3,6,...,21 -> 2ビットずつ -> 4ビットずつ -> 8ビット
+constexpr uint8_t joybus_3sample_pack(uint32_t x) {
+    x = (x | (x >> 2)) & 0x000C30C3u;
+    x = (x | (x >> 4)) & 0x0000F00Fu;
+    x = (x | (x >> 8)) & 0x000000FFu;
+    return (uint8_t)x;
+}
+
+// 8ビット分の多数決を32ビット演算でまとめて計算する（分岐なし）
+// 上位8ビット（24ビット目以降）は無視するのでマスク不要
+constexpr uint8_t joybus_decode_3sample_swar(uint32_t w) {
+    // 3サンプルを各組のs2の位置にそろえて多数決
+    const uint32_t s2 = w;
+    const uint32_t s1 = w >> 1;
+    const uint32_t s0 = w >> 2;
+    return joybus_3sample_pack(((s0 & s1) | (s1 & s2) | (s2 & s0)) & JOYBUS_3SAMPLE_LSB_MASK);
+}
+
+// 多数決の結果と、3サンプルがそろわなかったビット
+// そろわないビットが増えるのは、サンプリングの位置がビットの境目に寄っているか線がノイズを
+// 拾っているときで、多数決で正しく読めているうちから見える（バイトが壊れる前の兆候）
+//   minority[k] : サンプルskだけがほかの2つと違ったビット（MSB-first、joy_rx5ならs0/s1/s2は
+//                 cycle8/10/12）。どの位置が外れやすいかでサンプリングの位置を動かす向きがわかる
+struct JoyBus3SampleDecode {
+    uint8_t value = 0;
+    uint8_t disagree = 0; // minority[0] | minority[1] | minority[2]
+    uint8_t minority[3] = {};
+};
+
+constexpr JoyBus3SampleDecode joybus_decode_3sample_checked(uint32_t w) {
+    const uint32_t s2 = w;
+    const uint32_t s1 = w >> 1;
+    const uint32_t s0 = w >> 2;
+    const uint32_t majority = (s0 & s1) | (s1 & s2) | (s2 & s0);
+    JoyBus3SampleDecode d{};
+    d.value = joybus_3sample_pack(majority & JOYBUS_3SAMPLE_LSB_MASK);
+    d.minority[0] = joybus_3sample_pack((s0 ^ majority) & JOYBUS_3SAMPLE_LSB_MASK);
+    d.minority[1] = joybus_3sample_pack((s1 ^ majority) & JOYBUS_3SAMPLE_LSB_MASK);
+    d.minority[2] = joybus_3sample_pack((s2 ^ majority) & JOYBUS_3SAMPLE_LSB_MASK);
+    d.disagree = (uint8_t)(d.minority[0] | d.minority[1] | d.minority[2]);
+    return d;
+}
+
+// ポートごとに持つ、そろわなかったサンプルのヒストグラム
+struct JoyBusSampleStats {
+    uint32_t bytes = 0;          // 数えたバイト数
+    uint32_t disagreed_bits = 0; // 3サンプルがそろわなかったビット数
+    uint32_t by_sample[3] = {};  // s0/s1/s2のどれが少数派だったか
+    uint32_t by_bit[8] = {};     // バイトの何ビット目（MSBが0）でそろわなかったか
+};
+
+inline void joybus_sample_stats_add(JoyBusSampleStats *s, const JoyBus3SampleDecode &d) {
+    ++s->bytes;
+    if (d.disagree == 0) {
+        return;
+    }
+    s->disagreed_bits += (uint32_t)__builtin_popcount(d.disagree);
+    for (int k = 0; k < 3; ++k) {
+        s->by_sample[k] += (uint32_t)__builtin_popcount(d.minority[k]);
+    }
+    for (int i = 0; i < 8; ++i) {
+        s->by_bit[i] += (d.disagree >> (7 - i)) & 1u;
+    }
+}
+
+// 12ビット（4ビット分の3サンプル）-> 4ビットの表（4096エントリ）
+struct JoyBusNibbleTable {
+    uint8_t v[4096];
+};
+// 実機では表引きがフラッシュのキャッシュミスに引っかからないようRAMに置く
+extern const JoyBusNibbleTable joybus_3sample_nibble_table;
+
+// 24ビットを上下12ビットに分けて表引きする
+inline uint8_t joybus_decode_3sample_lut(uint32_t w) {
+    return (uint8_t)((joybus_3sample_nibble_table.v[(w >> 12) & 0xFFFu] << 4) |
+                     joybus_3sample_nibble_table.v[w & 0xFFFu]);
+}
+
+// 受信処理で使う標準のデコーダ
+// 表引きと速度がほぼ変わらず4KBのRAMを使わないのでSWAR版にしている
+inline uint8_t joybus_decode_3sample(uint32_t w) { return joybus_decode_3sample_swar(w); }
+
+// DMAで受け取ったワード列（1ワード=1バイト分）をまとめてデコードする
+void joybus_decode_3sample_words(const uint32_t *words, uint8_t *out, size_t nbytes);
+// 同じく表引き版
+void joybus_decode_3sample_words_lut(const uint32_t *words, uint8_t *out, size_t nbytes);
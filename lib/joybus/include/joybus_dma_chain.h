@@ -0,0 +1,103 @@
+#pragma once
+
+// 1回のやりとり（RXの準備→TXへのワード供給→送信開始→受信）をDMAの制御ブロックの列で行う
+//   ctrl  : 制御ブロック（4ワード）をworkerのレジスタ（READ/WRITE/COUNT/CTRL_TRIG）に書いて起動する
+//   worker: ブロックどおりに転送し、終わるとctrlへチェインして次のブロックを読ませる
+//   rx    : RX FIFO → 受信バッファ（1バイトずつ。書き込み先と転送数はブロックかCPUが書く）
+// 呼び出し側はブロックの列をRAMに作っておき、joybus_dma_chain_startでctrlを起動するだけ
+// 列の最後はjoybus_dma_block_end（CTRLが0のヌルトリガ）で終える
+// 完了はrxの割り込み（DMA_IRQ_0）で知る。ハンドラは呼び出し側が登録し、
+// その中でjoybus_dma_chain_take_rx_irq0を呼ぶ
+
+#include "hardware/dma.h"
+#include "hardware/pio.h"
+#include "joybus_frame.h"
+
+// workerのREAD_ADDR, WRITE_ADDR, TRANS_COUNT, CTRL_TRIGの順（ctrlはこの4ワードを書き込む）
+struct JoyBusDmaBlock {
+    const volatile void *read_addr;
+    volatile void *write_addr;
+    uint32_t transfer_count;
+    uint32_t ctrl;
+};
+
+struct JoyBusDmaChain {
+    PIO pio_tx = nullptr;
+    uint sm_tx = 0;
+    PIO pio_rx = nullptr;
+    uint sm_rx = 0;
+    int ctrl_chan = -1;
+    int worker_chan = -1;
+    int rx_chan = -1;
+    uint32_t ctrl_single = 0; // 1ワードをすぐに書くブロック用のCTRL
+    uint32_t ctrl_byte = 0;   // 1バイトをすぐに書くブロック用のCTRL
+    uint32_t ctrl_tx = 0;     // TX FIFOの空きに合わせてワード列を書くブロック用のCTRL
+};
+
+// DMAチャンネルを3つ確保して設定する（rxの完了割り込みはDMA_IRQ_0に出す）
+void joybus_dma_chain_init(JoyBusDmaChain *c, PIO pio_tx, uint sm_tx, PIO pio_rx, uint sm_rx);
+// 確保済みのチャンネルを使う場合用（例えばexamples/variant_matrixは方式ごとに使い回す）
+void joybus_dma_chain_init_with_channels(JoyBusDmaChain *c, PIO pio_tx, uint sm_tx, PIO pio_rx,
+                                         uint sm_rx, int ctrl_chan, int worker_chan, int rx_chan);
+
+// ctrlを起動してブロックの列を先頭から実行する
+inline void joybus_dma_chain_start(const JoyBusDmaChain *c, const JoyBusDmaBlock *blocks) {
+    dma_channel_set_read_addr(c->ctrl_chan, blocks, true);
+}
+
+// 途中で止まった列を止める（RXのSMのやり直しは呼び出し側で行う）
+void joybus_dma_chain_abort(const JoyBusDmaChain *c);
+
+// rxの転送数をCPUが書いておく（トリガ付きレジスタへの書き込みで起動するたびに読み直される）
+// 応答の長さが決まっているなら、ブロックで運ばずにこれで済む
+inline void joybus_dma_chain_set_rx_count(const JoyBusDmaChain *c, uint32_t count) {
+    dma_channel_set_trans_count(c->rx_chan, count, false);
+}
+
+// DMA_IRQ_0のハンドラから呼ぶ。rxが完了していればフラグを下ろしてtrue
+inline bool joybus_dma_chain_take_rx_irq0(const JoyBusDmaChain *c) {
+    if (!(dma_hw->ints0 & (1u << c->rx_chan))) {
+        return false;
+    }
+    dma_hw->ints0 = 1u << c->rx_chan;
+    return true;
+}
+
+// --- ブロックを作る ---
+
+// srcの1ワードをdstへ書く
+inline JoyBusDmaBlock joybus_dma_block_word(const JoyBusDmaChain *c, const volatile void *src,
+                                            volatile void *dst) {
+    return {src, dst, 1, c->ctrl_single};
+}
+
+// srcの1バイトをdstへ書く（書き込み先がRAMならそのバイトだけが変わる）
+inline JoyBusDmaBlock joybus_dma_block_byte(const JoyBusDmaChain *c, const volatile void *src,
+                                            volatile void *dst) {
+    return {src, dst, 1, c->ctrl_byte};
+}
+
+// *countをrxの転送数にする（トリガなしのレジスタ）
+inline JoyBusDmaBlock joybus_dma_block_rx_count(const JoyBusDmaChain *c, const uint32_t *count) {
+    return joybus_dma_block_word(c, count, &dma_hw->ch[c->rx_chan].transfer_count);
+}
+
+// *buffer_addr（受信バッファのアドレス）を書き込み先にしてrxを起動する
+inline JoyBusDmaBlock joybus_dma_block_rx_start(const JoyBusDmaChain *c,
+                                                const uint32_t *buffer_addr) {
+    return joybus_dma_block_word(c, buffer_addr, &dma_hw->ch[c->rx_chan].al2_write_addr_trig);
+}
+
+// *mask（IRQフラグのビット）をTXのPIOのIRQ_FORCEへ書いて送信開始を指示する
+inline JoyBusDmaBlock joybus_dma_block_tx_start(const JoyBusDmaChain *c, const uint32_t *mask) {
+    return joybus_dma_block_word(c, mask, &c->pio_tx->irq_force);
+}
+
+// フレームのワード列をTX FIFOの空きに合わせて書く
+inline JoyBusDmaBlock joybus_dma_block_tx_words(const JoyBusDmaChain *c,
+                                                const JoyBusTxFrame *frame) {
+    return {frame->words, &c->pio_tx->txf[c->sm_tx], frame->word_count, c->ctrl_tx};
+}
+
+// ヌルトリガ（workerを起動せずにチェインを終える）
+inline JoyBusDmaBlock joybus_dma_block_end() { return {nullptr, nullptr, 0, 0}; }
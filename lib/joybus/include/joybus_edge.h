@@ -0,0 +1,141 @@
+#pragma once
+
+// エッジ間隔キャプチャ（examples/edge_captureのjoy_edge）で受信したワードをビットに戻すデコーダ
+// joy_edgeは1ビットごとにLowとHighの長さを数え、1ワードにまとめてpushする
+//   上位16ビット: Lowの残りカウント / 下位16ビット: Highの残りカウント
+//   どちらも上限(limit)からのカウントダウン値（長さ = limit - 残り）
+//   Highが上限を超えると残りは0xFFFFになり、そのビットがフレームの最後（ストップビット）
+// ビットの値は同じビットのLowとHighを比べて決める（Lowが短ければ'1'）
+// 絶対的なしきい値を持たないので、送信側のビット周期が公称からずれていても読める
+// ストップビットだけはHighの長さがわからないので、同じフレームのビット周期の半分と比べる
+//
+// pico-sdkに依存しないのでホスト側（host/）のツールからも同じものを使う
+
+#include "joybus_frame.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 残りカウントがこの値なら上限を超えた（Highならフレーム終端、Lowなら異常）
+constexpr uint32_t JOYBUS_EDGE_TIMEOUT = 0xFFFFu;
+// 各区間でカウントされない2サイクル（mov x, y と in x, 16）の分をカウント単位で足す
+constexpr uint32_t JOYBUS_EDGE_PHASE_OVERHEAD = 1;
+// 1フレームのワード数の上限（データビット + ストップビット）
+constexpr size_t JOYBUS_EDGE_MAX_WORDS = JOYBUS_MAX_FRAME_BYTES * 8 + 1;
+
+enum class JoyBusEdgeStatus {
+    Ok,
+    LowTimeout, // Lowが上限を超えた（線がLowに張り付いた）
+    NoStopBit,  // 最後のビットが'1'でない
+    BadLength,  // データビット数が8の倍数でないか最大長を超えた
+};
+
+// ストップビット判定のしきい値（フレームをまたいで引き継ぐ）
+struct JoyBusEdgeDecoder {
+    uint32_t limit = 0;     // joy_edgeのyに設定した上限カウント
+    uint32_t threshold = 0; // Lowがこれより短ければ'1'（直前のフレームのビット周期の半分）
+};
+
+// 1フレーム分のデコード結果と、そのフレームのタイミング（すべてカウント単位）
+struct JoyBusEdgeFrame {
+    uint8_t data[JOYBUS_MAX_FRAME_BYTES] = {};
+    uint32_t nbytes = 0;
+    uint32_t nbits = 0; // ストップビットを含む受信ビット数
+    JoyBusEdgeStatus status = JoyBusEdgeStatus::Ok;
+
+    // ビット周期（Low + High）。Highの長さがわかるストップビット以外のビットが対象
+    uint32_t period_min = 0;
+    uint32_t period_max = 0;
+    uint32_t period_sum = 0;
+    uint32_t period_count = 0;
+    // '1'と'0'それぞれのLowの長さ
+    uint32_t low1_min = 0;
+    uint32_t low1_max = 0;
+    uint32_t low0_min = 0;
+    uint32_t low0_max = 0;
+    uint32_t threshold = 0; // ストップビットの判定に使ったしきい値
+};
+
+// limit: joy_edgeの上限カウント、nominal_period: 公称のビット周期（カウント単位）
+constexpr void joybus_edge_decoder_init(JoyBusEdgeDecoder *dec, uint32_t limit,
+                                        uint32_t nominal_period) {
+    dec->limit = limit;
+    dec->threshold = nominal_period / 2;
+}
+
+constexpr bool joybus_edge_is_frame_end(uint32_t word) {
+    return (word & 0xFFFFu) == JOYBUS_EDGE_TIMEOUT;
+}
+
+// コマンドを送った側の受信ピンには自分のコマンドも聞こえるので、応答はその後ろから始まる
+// 応答が早く返るとコマンドのストップビットのHighが応答の立ち下がりで切れてフレーム終端の
+// ワードにならないため、終端ではなくビット数（データビット + ストップビット）で飛ばす
+constexpr size_t joybus_edge_reply_offset(size_t command_nbytes) {
+    return command_nbytes * 8 + 1;
+}
+
+// words[0..n-1]: 1フレーム分のワード（最後のワードだけがjoybus_edge_is_frame_endを満たす）
+constexpr JoyBusEdgeStatus joybus_edge_decode(JoyBusEdgeDecoder *dec, const uint32_t *words,
+                                              size_t n, JoyBusEdgeFrame *out) {
+    *out = JoyBusEdgeFrame{};
+    out->nbits = (uint32_t)n;
+    out->low1_min = out->low0_min = out->period_min = 0xFFFFFFFFu;
+    if (n == 0 || n > JOYBUS_EDGE_MAX_WORDS) {
+        out->status = JoyBusEdgeStatus::BadLength;
+        return out->status;
+    }
+
+    // ストップビット以外はLowとHighを比べる
+    for (size_t i = 0; i + 1 < n; ++i) {
+        const uint32_t low_rem = words[i] >> 16;
+        const uint32_t high_rem = words[i] & 0xFFFFu;
+        if (low_rem == JOYBUS_EDGE_TIMEOUT) {
+            out->status = JoyBusEdgeStatus::LowTimeout;
+            return out->status;
+        }
+        const uint32_t low = dec->limit - low_rem + JOYBUS_EDGE_PHASE_OVERHEAD;
+        const uint32_t high = dec->limit - high_rem + JOYBUS_EDGE_PHASE_OVERHEAD;
+        const uint32_t period = low + high;
+        const bool one = low < high;
+        out->data[i / 8] = (uint8_t)((out->data[i / 8] << 1) | (one ? 1u : 0u));
+
+        out->period_min = period < out->period_min ? period : out->period_min;
+        out->period_max = period > out->period_max ? period : out->period_max;
+        out->period_sum += period;
+        ++out->period_count;
+        if (one) {
+            out->low1_min = low < out->low1_min ? low : out->low1_min;
+            out->low1_max = low > out->low1_max ? low : out->low1_max;
+        } else {
+            out->low0_min = low < out->low0_min ? low : out->low0_min;
+            out->low0_max = low > out->low0_max ? low : out->low0_max;
+        }
+    }
+
+    // このフレームで測ったビット周期の半分をしきい値にして次のフレームにも引き継ぐ
+    if (out->period_count > 0) {
+        dec->threshold = out->period_sum / out->period_count / 2;
+    }
+    out->threshold = dec->threshold;
+
+    const uint32_t stop_low_rem = words[n - 1] >> 16;
+    if (stop_low_rem == JOYBUS_EDGE_TIMEOUT) {
+        out->status = JoyBusEdgeStatus::LowTimeout;
+    } else if (dec->limit - stop_low_rem + JOYBUS_EDGE_PHASE_OVERHEAD >= dec->threshold) {
+        out->status = JoyBusEdgeStatus::NoStopBit;
+    } else if ((n - 1) % 8 != 0 || n == 1) {
+        out->status = JoyBusEdgeStatus::BadLength;
+    } else {
+        out->nbytes = (uint32_t)((n - 1) / 8);
+    }
+    return out->status;
+}
+
+// フレームの平均ビット周期（ns）。送信側のビットレートの検出に使う
+// clk_hz: joy_edgeを動かしているSMのクロック（1カウント = 2サイクル）。測れなければ0
+constexpr uint32_t joybus_edge_bit_period_ns(const JoyBusEdgeFrame &f, uint32_t clk_hz) {
+    if (f.period_count == 0 || clk_hz == 0) {
+        return 0;
+    }
+    return (uint32_t)((uint64_t)f.period_sum * 2 * 1'000'000'000u / f.period_count / clk_hz);
+}
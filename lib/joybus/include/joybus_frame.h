@@ -0,0 +1,73 @@
+#pragma once
+
+// joy_tx5（ビット数指定版）に渡す送信フレームのワード列
+//   words[0]  : 送信するデータビット数-1（PIOの out x, 32 で受け取る）
+//   words[1~] : データバイト列をMSB-firstで4バイトずつ詰めたもの（余りは0埋め）
+// 送信のたびに詰め直さず、あらかじめ作っておいたものをそのままDMAに渡す
+//
+// pico-sdkに依存しないのでホスト側（host/）のツールからも同じものを使う
+
+#include <stddef.h>
+#include <stdint.h>
+
+// JoyBusでやりとりする最大フレーム長（バイト数）
+// 実際はせいぜい10バイトだが非DMAでの限界を超えられるか試した16に合わせている
+constexpr size_t JOYBUS_MAX_FRAME_BYTES = 16;
+// ビット数ワード + データワード（ストップビットをデータに含める場合の1ビット分も確保）
+constexpr size_t JOYBUS_TX_FRAME_MAX_WORDS = 1 + (JOYBUS_MAX_FRAME_BYTES * 8 + 1 + 31) / 32;
+
+struct JoyBusTxFrame {
+    uint32_t words[JOYBUS_TX_FRAME_MAX_WORDS] = {};
+    uint32_t word_count = 0; // DMAで転送するワード数（0なら未設定）
+    uint32_t nbytes = 0;
+};
+
+// dataをDMAにそのまま渡せる形に詰める
+// nbytesが0または最大長を超える場合はfalse（frameは空のまま）
+constexpr bool joybus_tx_frame_encode(JoyBusTxFrame *frame, const uint8_t *data, size_t nbytes) {
+    *frame = JoyBusTxFrame{};
+    if (nbytes == 0 || nbytes > JOYBUS_MAX_FRAME_BYTES) {
+        return false;
+    }
+    frame->words[0] = (uint32_t)(nbytes * 8 - 1);
+    for (size_t i = 0; i < nbytes; ++i) {
+        frame->words[1 + i / 4] |= (uint32_t)data[i] << (8 * (3 - i % 4));
+    }
+    frame->word_count = (uint32_t)(1 + (nbytes + 3) / 4);
+    frame->nbytes = (uint32_t)nbytes;
+    return true;
+}
+
+// ストップビット('1')もデータの最後の1ビットとして詰める
+// ストップビットを自前で送らない送信プログラム（examples/controller_emuのjoy_reply4）用
+//   words[0] : ストップビットを含む送信ビット数-1
+constexpr bool joybus_tx_frame_encode_with_stop(JoyBusTxFrame *frame, const uint8_t *data,
+                                                size_t nbytes) {
+    if (!joybus_tx_frame_encode(frame, data, nbytes)) {
+        return false;
+    }
+    const size_t stop = nbytes * 8; // ストップビットの位置（先頭から）
+    frame->words[0] = (uint32_t)stop;
+    frame->words[1 + stop / 32] |= 1u << (31 - stop % 32);
+    frame->word_count = (uint32_t)(1 + (stop + 1 + 31) / 32);
+    return true;
+}
+
+// nbytesのフレームをストップビットまで送りきるのにかかる時間（bit_period_usは1ビットの長さ）
+// 受信の待ち時間を固定の長さではなくフレームの長さから決めるのに使う
+constexpr uint32_t joybus_frame_duration_us(size_t nbytes, uint32_t bit_period_us) {
+    return (uint32_t)(nbytes * 8 + 1) * bit_period_us;
+}
+
+// 試験用の乱数フレーム（長さ1〜JOYBUS_MAX_FRAME_BYTES、中身も乱数）を作ってframeに詰める
+// data: JOYBUS_MAX_FRAME_BYTESバイトの領域（詰める前のバイト列が入る）
+// state: 線形合同法の状態。同じ種からは実機でもホストでも同じ列になる
+constexpr void joybus_frame_random(JoyBusTxFrame *frame, uint8_t *data, uint32_t *state) {
+    *state = *state * 1664525u + 1013904223u;
+    const size_t nbytes = 1 + (*state >> 16) % JOYBUS_MAX_FRAME_BYTES;
+    for (size_t i = 0; i < nbytes; ++i) {
+        *state = *state * 1664525u + 1013904223u;
+        data[i] = (uint8_t)(*state >> 24);
+    }
+    joybus_tx_frame_encode(frame, data, nbytes);
+}
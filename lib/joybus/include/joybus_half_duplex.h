@@ -0,0 +1,63 @@
+#pragma once
+
+// 1本のデータ線で送受信するjoy_txrx（examples/half_duplexなど）のSMと受信のDMA
+// joy_txrxは送信→ストップビット→線の開放→応答の受信までを1つのSMで続けて行い、
+// 応答の終端でirq set 0 rel（SMの番号のフラグ）を立てる
+// 受信はRX FIFO → workをDMAで運び、終端の割り込みでDMAの転送数から長さを知る
+// .pioは使う側のexamplesにあるので、読み込みは呼び出し側で行いoffsetとデフォルトの設定を渡す
+// 割り込みハンドラも呼び出し側が用意し、その中でjoybus_half_duplex_irqを呼ぶ
+// （終端を知ってすぐに何かしたい場合はjoybus_half_duplex_frame_endとfinish_rxに分けて呼ぶ）
+
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/pio.h"
+#include "joybus_frame.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+constexpr size_t JOYBUS_HALF_DUPLEX_BUFFER_SIZE = JOYBUS_MAX_FRAME_BYTES + 1; // ストップビット分も確保
+
+struct JoyBusHalfDuplex {
+    PIO pio = nullptr;
+    uint sm = 0;
+    uint offset = 0;
+    uint pin = 0;
+    int dma_channel = -1;
+    dma_channel_config dma_config{};
+    uint8_t work[JOYBUS_HALF_DUPLEX_BUFFER_SIZE] = {0}; // 受信バッファ
+    volatile uint32_t length = 0;                       // ストップビットを除いた長さ
+    volatile bool ready = false;
+    volatile bool bad = false;
+};
+
+// SMだけを設定する（止めたまま）。受信を自前のDMAで行う場合用（例えばexamples/command_table）
+// c: joy_txrx_program_get_default_config(offset)
+void joybus_half_duplex_sm_init(PIO pio, uint sm, uint offset, pio_sm_config c, uint pin);
+// 応答が来ずに受信待ちで止まったSMを先頭（コマンド待ち）からやり直す（線も開放する）
+void joybus_half_duplex_sm_reset(PIO pio, uint sm, uint offset, uint pin);
+
+// SMと受信のDMAを設定し、終端の割り込み（PIOn_IRQ_0、最高優先度）にhandlerを登録してSMを起動する
+void joybus_half_duplex_init(JoyBusHalfDuplex *hd, PIO pio, uint sm, uint offset, pio_sm_config c,
+                             uint pin, irq_handler_t handler);
+
+// 受信を待ち受ける（コマンドをTX FIFOに入れる前に呼ぶ）
+void joybus_half_duplex_arm_rx(JoyBusHalfDuplex *hd);
+
+// 割り込みハンドラから呼ぶ。応答の終端ならtrue
+inline bool joybus_half_duplex_frame_end(const JoyBusHalfDuplex *hd) {
+    return pio_interrupt_get(hd->pio, hd->sm);
+}
+// 終端のフラグを下ろし、受信した長さとストップビットからreadyかbadを立てる
+void joybus_half_duplex_finish_rx(JoyBusHalfDuplex *hd);
+// 上の2つをまとめたもの
+inline bool joybus_half_duplex_irq(JoyBusHalfDuplex *hd) {
+    if (!joybus_half_duplex_frame_end(hd)) {
+        return false;
+    }
+    joybus_half_duplex_finish_rx(hd);
+    return true;
+}
+
+// 受信のDMAを止めてSMをやり直す
+void joybus_half_duplex_reset(JoyBusHalfDuplex *hd);
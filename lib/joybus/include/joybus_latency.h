@@ -0,0 +1,112 @@
+#pragma once
+
+// やりとりの区間ごとの遅れのヒストグラムと、それをまとめて書き出すバイナリダンプの形式
+// 実機（examples/latency_bench）で数十万回分を集計し、ホスト（host/latency_plot）で読む
+// ダンプは "#LATENCY <バイト数>" の行に続けてJoyBusLatencyDumpをそのまま送る
+// （RP2040もホストもリトルエンディアンなので変換しない。末尾のchecksumで壊れを検出する）
+//
+// pico-sdkに依存しないのでホスト側（host/）のツールからも同じものを使う
+
+#include <stddef.h>
+#include <stdint.h>
+
+constexpr uint32_t JOYBUS_LATENCY_MAGIC = 0x4C42594Au; // "JYBL"
+constexpr uint32_t JOYBUS_LATENCY_VERSION = 1;
+// ヒストグラムのビン数（これを超えた分はoverflowに数える。min/maxは超えた分も含む）
+constexpr uint32_t JOYBUS_LATENCY_BINS = 512;
+
+enum class JoyBusLatencyInterval : uint32_t {
+    ArmToEdge = 0,   // 送信の開始を指示してからコマンドの最初の立ち下がりまで
+    StopToReply,     // コマンドのストップビットの終わりから応答の最初の立ち下がりまで
+    LastBitToNotify, // 応答のストップビットの終わりからCPUの割り込みハンドラまで
+    Count,
+};
+constexpr uint32_t JOYBUS_LATENCY_INTERVALS = (uint32_t)JoyBusLatencyInterval::Count;
+
+struct JoyBusLatencyHistogram {
+    uint32_t count = 0;
+    uint32_t min = UINT32_MAX; // サイクル
+    uint32_t max = 0;          // サイクル
+    uint32_t overflow = 0;     // 最後のビンより長かった数
+    uint32_t bin_cycles = 1;   // 1ビンの幅（サイクル）
+    uint32_t bins[JOYBUS_LATENCY_BINS] = {};
+};
+
+struct JoyBusLatencyDump {
+    uint32_t magic = JOYBUS_LATENCY_MAGIC;
+    uint32_t version = JOYBUS_LATENCY_VERSION;
+    uint32_t clk_hz = 0;       // サイクル数の換算用
+    uint32_t transactions = 0; // 3区間とも測れたやりとりの数
+    uint32_t timeouts = 0;
+    uint32_t errors = 0;
+    JoyBusLatencyHistogram histograms[JOYBUS_LATENCY_INTERVALS];
+    uint32_t checksum = 0; // checksumより前の全ワードの和
+};
+
+// 一時オブジェクトを作らずにその場で空にする（実機のスタックは2KBしかない）
+inline void joybus_latency_reset(JoyBusLatencyHistogram *h, uint32_t bin_cycles) {
+    h->count = 0;
+    h->min = UINT32_MAX;
+    h->max = 0;
+    h->overflow = 0;
+    h->bin_cycles = bin_cycles;
+    for (uint32_t i = 0; i < JOYBUS_LATENCY_BINS; ++i) {
+        h->bins[i] = 0;
+    }
+}
+
+inline void joybus_latency_add(JoyBusLatencyHistogram *h, uint32_t cycles) {
+    ++h->count;
+    h->min = cycles < h->min ? cycles : h->min;
+    h->max = cycles > h->max ? cycles : h->max;
+    const uint32_t bin = cycles / h->bin_cycles;
+    if (bin < JOYBUS_LATENCY_BINS) {
+        ++h->bins[bin];
+    } else {
+        ++h->overflow;
+    }
+}
+
+// 全体のpermille/1000番目に当たるサンプルを含むビンの上端（サイクル）
+// ビンの幅の分だけ粗いので[min, max]に収める。overflowに入っていればmaxを返す
+inline uint32_t joybus_latency_percentile(const JoyBusLatencyHistogram &h, uint32_t permille) {
+    if (h.count == 0) {
+        return 0;
+    }
+    // 1始まりの順位（permille=500なら中央、990ならp99）
+    uint64_t rank = ((uint64_t)h.count * permille + 999) / 1000;
+    rank = rank == 0 ? 1 : rank;
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < JOYBUS_LATENCY_BINS; ++i) {
+        seen += h.bins[i];
+        if (seen >= rank) {
+            const uint32_t upper = (i + 1) * h.bin_cycles - 1;
+            return upper < h.min ? h.min : (upper > h.max ? h.max : upper);
+        }
+    }
+    return h.max;
+}
+
+inline uint32_t joybus_latency_checksum(const JoyBusLatencyDump &d) {
+    const uint32_t *words = (const uint32_t *)&d;
+    const size_t n = offsetof(JoyBusLatencyDump, checksum) / sizeof(uint32_t);
+    uint32_t sum = 0;
+    for (size_t i = 0; i < n; ++i) {
+        sum += words[i];
+    }
+    return sum;
+}
+
+inline const char *joybus_latency_interval_name(uint32_t interval) {
+    switch ((JoyBusLatencyInterval)interval) {
+    case JoyBusLatencyInterval::ArmToEdge:
+        return "tx_arm -> first_edge";
+    case JoyBusLatencyInterval::StopToReply:
+        return "stop_bit -> reply_edge";
+    case JoyBusLatencyInterval::LastBitToNotify:
+        return "last_bit -> cpu_notify";
+    case JoyBusLatencyInterval::Count:
+        break;
+    }
+    return "unknown";
+}
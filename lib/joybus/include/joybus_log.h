@@ -0,0 +1,35 @@
+#pragma once
+
+// printfを待たせないUART出力（pico-sdkのstdioドライバとして登録する）
+// pico_enable_stdio_uartの出力はUARTのFIFOが空くまでCPUが待つので、115200bpsでは
+// 1行で数百us〜数ms止まり、JoyBusの1回のやりとりより長くなる
+// このドライバは文字をリングバッファに詰めるだけで戻り、UARTへはDMAが送る
+//   - リングがいっぱいなら待たずに捨て、捨てたバイト数を数える
+//     （空きができたら "[log] N bytes dropped" の行を差し込む）
+//   - DMAはリングの読み出し側を折り返すので、リングの終端をまたぐ範囲も1回で送れる
+//   - DMAの完了割り込みは呼び出し側が選んだDMA_IRQ_0/1に共有ハンドラとして足す
+// 使うときはpico_enable_stdio_uartを0にして、stdio_init_allの後にjoybus_log_initを呼ぶ
+
+#include "hardware/uart.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// リングバッファの大きさ（2のべき乗、DMAの折り返し指定はバイト数のlog2）
+constexpr uint JOYBUS_LOG_RING_BITS = 12;
+constexpr uint32_t JOYBUS_LOG_RING_SIZE = 1u << JOYBUS_LOG_RING_BITS;
+
+// UARTとピンを設定し、DMAチャンネルを確保してstdioドライバとして登録する
+// dma_irq_index: 完了割り込みに使うDMA_IRQ_<n>の番号（0か1）
+//   - その線に排他ハンドラ（irq_set_exclusive_handler）を登録していないこと
+//     （irq_add_shared_handlerがassertする。例えばexamples/tx_latencyはDMA_IRQ_1を排他で使う）
+//   - 線の優先度は変えない。共有している他のハンドラにも効くので呼び出し側で決める
+//     （バスの割り込みを先に通したいなら、ログ専用の線にしてPICO_LOWEST_IRQ_PRIORITYにする）
+void joybus_log_init(uart_inst_t *uart, uint baudrate, uint tx_pin, uint rx_pin,
+                     uint dma_irq_index);
+
+// これまでに捨てたバイト数（差し込んだ行で報告済みの分も含む）
+uint32_t joybus_log_dropped();
+
+// リングに残っている分を送り終わるまで待つ（止まってもよいところでだけ呼ぶ）
+void joybus_log_flush();
@@ -0,0 +1,49 @@
+#pragma once
+
+// 1対1（書き手1つ・読み手1つ）で最新の値だけを受け渡すロックフリーのメールボックス
+// コア間でコントローラの状態を渡すのに使う（core0が書き、core1が読む）
+// シーケンス番号が奇数の間は書き込み中で、読み手は前後の番号が一致するまで読み直す（seqlock）
+//   - 書き手は待たない（読み手の有無に関係なく一定時間で終わる）
+//   - 読み手は書き込みとぶつかったときだけ読み直す（Tは数バイトの想定なので一瞬）
+// RP2040（Cortex-M0+）にはLDREX/STREXがないので、32ビットの読み書きとメモリバリアだけで作っている
+//
+// pico-sdkには依存しない（ヘッダのみ）
+
+#include <stdint.h>
+
+template <typename T> struct JoyBusMailbox {
+    volatile uint32_t seq = 0;
+    T value{};
+};
+
+// 書き手側: 値を置く
+template <typename T> inline void joybus_mailbox_write(JoyBusMailbox<T> *mb, const T &v) {
+    const uint32_t seq = mb->seq;
+    mb->seq = seq + 1; // 奇数: 書き込み中
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    mb->value = v;
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    mb->seq = seq + 2; // 偶数: 書き込み完了
+}
+
+// 読み手側: *last_seqより新しい値があれば*outに写してtrue
+// 最初は*last_seq = 0で呼ぶ（一度も書かれていなければfalse）
+template <typename T>
+inline bool joybus_mailbox_read(JoyBusMailbox<T> *mb, T *out, uint32_t *last_seq) {
+    while (true) {
+        const uint32_t before = mb->seq;
+        if (before == *last_seq) {
+            return false;
+        }
+        if (before & 1u) {
+            continue; // 書き込み中
+        }
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        *out = mb->value;
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (mb->seq == before) {
+            *last_seq = before;
+            return true;
+        }
+    }
+}
@@ -0,0 +1,253 @@
+#pragma once
+
+// joy_tx5 / joy_rx5（examples/stop_bitの3点サンプリング版）と同じ構成のPIOプログラムを
+// コンパイル時に組み立てる
+// 手で書いた.pioは4MHz（1ビット20サイクル）で遅延を数えてあるので、PIOのクロックやビット周期を
+// 変えるたびに書き直すことになる。ここではclk_sysと分周比、ビット周期、'1'/'0'のLowの長さ、
+// 3つのサンプリング位置から各命令の遅延を計算し、命令語の配列を作る
+//   - 分周比は整数に限る（小数の分周ではPIOのサイクルの長さが揺れる）
+//   - 1命令の遅延（最大31）に収まらない待ちは nop を足して埋める
+//   - サイクルの割り振りが成り立たない・32命令に収まらないときはerrorに理由が入る
+//     constexprで作ってstatic_assert(code.error == nullptr)で弾く
+// 4MHz・5us（joybus_pio_timing(4'000'000, 1)）ではjoy_tx5.pio / joy_rx5.pioと同じ命令語になる
+// （host/pio_simのgencheckで確かめられる）
+//
+// pico-sdkに依存しないのでホスト側（host/）のツールからも同じものを使う
+// pio_program_tへの詰め替えは使う側で行う（examples/generated_pio）
+
+#include <stdint.h>
+
+// PIOの命令メモリの段数
+constexpr uint32_t JOYBUS_PIO_MAX_INSTRUCTIONS = 32;
+// 1命令に付けられる遅延の上限（side-setなし）
+constexpr uint32_t JOYBUS_PIO_MAX_DELAY = 31;
+
+struct JoyBusPioTiming {
+    uint32_t clk_sys_hz = 0;
+    uint32_t clkdiv = 1; // 整数の分周比（PIOのクロック = clk_sys_hz / clkdiv）
+    uint32_t bit_period_ns = 5000;
+    uint32_t one_low_ns = 1250;  // '1'のLowの長さ
+    uint32_t zero_low_ns = 3750; // '0'のLowの長さ
+    // 立ち下がりからのサンプリング位置（真ん中はストップビットの判定にも使う）
+    uint32_t sample_ns[3] = {2000, 2500, 3000};
+};
+
+// 既定のビット周期・Lowの長さ・サンプリング位置でclk_sysと分周比だけを決める
+constexpr JoyBusPioTiming joybus_pio_timing(uint32_t clk_sys_hz, uint32_t clkdiv) {
+    JoyBusPioTiming t{};
+    t.clk_sys_hz = clk_sys_hz;
+    t.clkdiv = clkdiv;
+    return t;
+}
+
+struct JoyBusPioCode {
+    uint16_t instructions[JOYBUS_PIO_MAX_INSTRUCTIONS] = {};
+    uint32_t length = 0;
+    uint32_t wrap_target = 0; // プログラムの先頭からの位置
+    uint32_t wrap = 0;
+    uint32_t bit_cycles = 0;    // 1ビットのPIOサイクル数
+    const char *error = nullptr; // 作れなかった理由（作れたらnullptr）
+};
+
+// PIOの命令語（pioasmと同じエンコーディング）
+namespace joybus_pio {
+constexpr uint16_t JMP_ALWAYS = 0, JMP_X_DEC = 2, JMP_NOT_Y = 3, JMP_PIN = 6;
+constexpr uint16_t WAIT_PIN = 1, WAIT_IRQ = 2;
+constexpr uint16_t DEST_PINS = 0, DEST_X = 1, DEST_Y = 2, DEST_PINDIRS = 4;
+
+constexpr uint16_t jmp(uint16_t cond, uint32_t addr) { return (uint16_t)(cond << 5 | addr); }
+constexpr uint16_t wait(uint16_t polarity, uint16_t source, uint16_t index) {
+    return (uint16_t)(0x2000 | polarity << 7 | source << 5 | index);
+}
+constexpr uint16_t in_pins(uint16_t bits) { return (uint16_t)(0x4000 | (bits & 31)); }
+constexpr uint16_t out(uint16_t dest, uint16_t bits) {
+    return (uint16_t)(0x6000 | dest << 5 | (bits & 31));
+}
+constexpr uint16_t pull_block() { return 0x80A0; }
+constexpr uint16_t nop() { return 0xA042; } // mov y, y
+constexpr uint16_t irq_set(uint16_t index) { return (uint16_t)(0xC000 | index); }
+constexpr uint16_t irq_clear(uint16_t index) { return (uint16_t)(0xC040 | index); }
+constexpr uint16_t set(uint16_t dest, uint16_t data) {
+    return (uint16_t)(0xE000 | dest << 5 | data);
+}
+
+// 命令を並べながら遅延を割り振る
+class Builder {
+  public:
+    constexpr uint32_t here() const { return code_.length; }
+
+    // instrを置き、それに続く待ちも含めてcyclesサイクルを使う
+    // 遅延に収まらない分はnopで埋める。instrがnopでcyclesが0なら何も置かない
+    constexpr void emit(uint16_t instr, uint32_t cycles) {
+        if (cycles == 0) {
+            if (instr != nop()) {
+                fail("an instruction was given no cycles");
+            }
+            return;
+        }
+        uint32_t delay = cycles - 1;
+        put(instr, delay < JOYBUS_PIO_MAX_DELAY ? delay : JOYBUS_PIO_MAX_DELAY);
+        delay -= delay < JOYBUS_PIO_MAX_DELAY ? delay : JOYBUS_PIO_MAX_DELAY;
+        while (delay > 0 && code_.error == nullptr) {
+            const uint32_t d = delay - 1 < JOYBUS_PIO_MAX_DELAY ? delay - 1 : JOYBUS_PIO_MAX_DELAY;
+            put(nop(), d);
+            delay -= d + 1;
+        }
+    }
+    constexpr void emit(uint16_t instr) { emit(instr, 1); }
+
+    constexpr void fail(const char *error) {
+        if (code_.error == nullptr) {
+            code_.error = error;
+        }
+    }
+    constexpr JoyBusPioCode &code() { return code_; }
+
+  private:
+    constexpr void put(uint16_t instr, uint32_t delay) {
+        if (code_.length >= JOYBUS_PIO_MAX_INSTRUCTIONS) {
+            fail("program does not fit in 32 instructions");
+            return;
+        }
+        code_.instructions[code_.length++] = (uint16_t)(instr | delay << 8);
+    }
+
+    JoyBusPioCode code_{};
+};
+
+// 時間（ns）をPIOのサイクル数にする（四捨五入）
+constexpr uint32_t cycles(const JoyBusPioTiming &t, uint32_t ns) {
+    const uint64_t pio_hz = t.clk_sys_hz / t.clkdiv;
+    return (uint32_t)(((uint64_t)ns * pio_hz + 500'000'000) / 1'000'000'000);
+}
+
+// パラメータの確かめ（成り立たなければ理由、成り立てばnullptr）
+constexpr const char *check(const JoyBusPioTiming &t) {
+    if (t.clkdiv < 1 || t.clkdiv > 0xFFFF) {
+        return "clkdiv must be an integer in 1..65535";
+    }
+    if (t.clk_sys_hz % t.clkdiv != 0 ||
+        (uint64_t)t.bit_period_ns * (t.clk_sys_hz / t.clkdiv) % 1'000'000'000 != 0) {
+        return "bit period is not a whole number of PIO cycles";
+    }
+    if (!(t.one_low_ns < t.sample_ns[0] && t.sample_ns[0] < t.sample_ns[1] &&
+          t.sample_ns[1] < t.sample_ns[2] && t.sample_ns[2] < t.zero_low_ns &&
+          t.zero_low_ns < t.bit_period_ns)) {
+        return "samples must fall between the '1' low and '0' low times";
+    }
+    const uint32_t c = cycles(t, t.bit_period_ns);
+    const uint32_t one = cycles(t, t.one_low_ns);
+    const uint32_t zero = cycles(t, t.zero_low_ns);
+    const uint32_t s0 = cycles(t, t.sample_ns[0]);
+    const uint32_t s1 = cycles(t, t.sample_ns[1]);
+    const uint32_t s2 = cycles(t, t.sample_ns[2]);
+    // 送信: Highの後ろでjmp cont, jmp x--, out, jmp !yの4サイクルを使う
+    if (one < 1 || c < zero + 5) {
+        return "bit period leaves no cycles for the TX loop";
+    }
+    // 受信: サンプルは1サイクルずつずらし、最後のサンプルの後ろにnopとjmp x--を置く
+    if (s0 < 1 || s1 <= s0 || s2 <= s1 || c < s2 + 2 || c < s1 + 3) {
+        return "sample points are too close at this PIO clock";
+    }
+    return nullptr;
+}
+} // namespace joybus_pio
+
+// joy_tx5と同じ送信プログラム
+//   word0: 送信するデータビット数-1、word1~: データ（MSB-first、autopull）
+//   irq 0で送信開始の指示を待ち、ストップビットの後にirq 1で完了を通知する（joybus_txと同じ）
+constexpr JoyBusPioCode joybus_pio_gen_tx(const JoyBusPioTiming &t) {
+    using namespace joybus_pio;
+    Builder b;
+    if (const char *error = check(t)) {
+        b.fail(error);
+        return b.code();
+    }
+    const uint32_t c = cycles(t, t.bit_period_ns);
+    const uint32_t one = cycles(t, t.one_low_ns);
+    const uint32_t zero = cycles(t, t.zero_low_ns);
+    // 分岐先は命令の数が決まるまでわからないので、1回目で位置を調べて2回目で埋める
+    uint32_t send0 = 0, cont = 0, bitloop = 0;
+    for (int pass = 0; pass < 2; ++pass) {
+        b = Builder{};
+        b.emit(irq_set(1));
+        b.emit(wait(1, WAIT_IRQ, 0));
+        b.emit(irq_clear(0));
+        b.emit(pull_block());
+        b.emit(out(DEST_X, 32));
+        b.emit(pull_block());
+        b.emit(set(DEST_PINS, 0));
+        b.emit(set(DEST_PINDIRS, 0));
+        bitloop = b.here();
+        b.emit(out(DEST_Y, 1));
+        b.emit(jmp(JMP_NOT_Y, send0));
+        b.emit(set(DEST_PINDIRS, 1), one);         // '1'のLow
+        b.emit(set(DEST_PINDIRS, 0), c - one - 4); // Highの残りはjmp cont以降の4サイクル
+        b.emit(jmp(JMP_ALWAYS, cont));
+        send0 = b.here();
+        b.emit(set(DEST_PINDIRS, 1), zero);
+        b.emit(set(DEST_PINDIRS, 0), c - zero - 4);
+        b.emit(jmp(JMP_ALWAYS, cont));
+        cont = b.here();
+        b.emit(jmp(JMP_X_DEC, bitloop));
+        b.emit(nop(), 2); // 最後のビットのHighの長さ調整（out, jmp !yの代わり）
+        b.emit(set(DEST_PINDIRS, 1), one); // ストップビット
+        b.emit(set(DEST_PINDIRS, 0), c - one);
+    }
+    JoyBusPioCode &code = b.code();
+    code.wrap_target = 0;
+    code.wrap = code.length - 1;
+    code.bit_cycles = c;
+    return code;
+}
+
+// joy_rx5（3点サンプリング+ストップビットの確認）と同じ受信プログラム
+//   受信するビット数-1をpullし、1ビットを3サンプルでin（autopush=24）
+//   ストップビットを真ん中のサンプル位置で確かめ、Lowならirq 2を立てる
+constexpr JoyBusPioCode joybus_pio_gen_rx(const JoyBusPioTiming &t) {
+    using namespace joybus_pio;
+    Builder b;
+    if (const char *error = check(t)) {
+        b.fail(error);
+        return b.code();
+    }
+    const uint32_t c = cycles(t, t.bit_period_ns);
+    const uint32_t s0 = cycles(t, t.sample_ns[0]);
+    const uint32_t s1 = cycles(t, t.sample_ns[1]);
+    const uint32_t s2 = cycles(t, t.sample_ns[2]);
+    uint32_t bitloop = 0, stop_ok = 0;
+    for (int pass = 0; pass < 2; ++pass) {
+        b = Builder{};
+        b.emit(pull_block());
+        b.emit(out(DEST_X, 32));
+        b.emit(wait(1, WAIT_PIN, 0));
+        bitloop = b.here();
+        b.emit(wait(0, WAIT_PIN, 0)); // cycle0
+        b.emit(nop(), s0 - 1);
+        b.emit(in_pins(1)); // cycle s0
+        b.emit(nop(), s1 - s0 - 1);
+        b.emit(in_pins(1)); // cycle s1
+        b.emit(nop(), s2 - s1 - 1);
+        b.emit(in_pins(1)); // cycle s2
+        b.emit(nop(), c - s2 - 2);
+        b.emit(jmp(JMP_X_DEC, bitloop)); // cycle c-1
+        b.emit(wait(0, WAIT_PIN, 0));    // ストップビットのcycle0
+        b.emit(nop(), s1 - 1);
+        b.emit(jmp(JMP_PIN, stop_ok)); // cycle s1
+        b.emit(irq_set(2));
+        b.emit(nop(), c - s1 - 3); // ビットの終端まで待つ
+        b.emit(jmp(JMP_ALWAYS, 0));
+        stop_ok = b.here();
+        b.emit(nop(), c - s1 - 1); // ストップビットの終端まで（.wrapは0サイクル）
+    }
+    JoyBusPioCode &code = b.code();
+    code.wrap_target = 0;
+    code.wrap = code.length - 1;
+    code.bit_cycles = c;
+    return code;
+}
+
+static_assert(joybus_pio_gen_tx(joybus_pio_timing(4'000'000, 1)).error == nullptr,
+              "joy_tx5 must be generated at the hand-written 4MHz timing");
+static_assert(joybus_pio_gen_rx(joybus_pio_timing(4'000'000, 1)).error == nullptr,
+              "joy_rx5 must be generated at the hand-written 4MHz timing");
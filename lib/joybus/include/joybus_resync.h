@@ -0,0 +1,54 @@
+#pragma once
+
+// ビット数を受け取って受信するRXのSM（examples/stop_bitのjoy_rx5など、先頭でpull blockする
+// プログラム）の同期が崩れたときに、SMを止めずに受信待ちの先頭へ戻す
+// 同期が崩れるのは、渡したビット数と実際のフレームの長さが合わなかったとき
+//   - 短いフレーム: SMは残りのビットを待ち続け、次のフレームの先頭をこのフレームの続きとして読む
+//     以降はストップビットの位置がずれてirq 2（ストップビットの欠け）が続けて立つ
+//   - 1バイトも来ない: SMは最初の立ち下がりを待ったまま、次のフレームを取り違える
+// どちらもタイムアウト（examples/detect_stop_bitでは2000us）まで待ってからSMを作り直すと、
+// その間のポーリングをすべて落とすことになる
+// ここでは次のどれかで同期が崩れたとみなし、その場でSMだけを戻す
+//   - 送信の完了から1ビット周期たっても受信し終わらない（短い・来ない）
+//   - irq 2がstorm_threshold回続けて立った
+// 戻すのはexecとFIFOの読み捨てだけなので数usで終わり、呼び出し側はそのままDMAを張り直して
+// 次のフレームを受けられる（落とすのは同期の崩れたフレーム1つだけ）
+
+#include "hardware/pio.h"
+
+#include <stdint.h>
+
+enum class JoyBusDesync : uint32_t {
+    Short,     // 途中までしか受信できなかった
+    Timeout,   // 1バイトも受信できなかった
+    StopStorm, // irq 2が続けて立った
+};
+
+struct JoyBusResyncStats {
+    uint32_t resyncs = 0;
+    uint32_t short_frames = 0;
+    uint32_t timeouts = 0;
+    uint32_t stop_storms = 0;
+    uint32_t stop_errors = 0; // irq 2が立った回数（続かなければ同期は保たれている）
+};
+
+struct JoyBusResync {
+    PIO pio = nullptr;
+    uint sm = 0;
+    uint offset = 0;         // プログラムの先頭（ビット数をpullする命令）
+    uint stop_error_irq = 2; // ストップビットの欠けを知らせるIRQフラグ
+    uint32_t storm_threshold = 3;
+    uint32_t consecutive_stop_errors = 0;
+    JoyBusResyncStats stats;
+};
+
+void joybus_resync_init(JoyBusResync *r, PIO pio, uint sm, uint offset, uint stop_error_irq);
+
+// フレームの受信を終えたところで呼び、irq 2が立っていれば数えて下ろす
+// 立っていればtrue。続けてstorm_threshold回立ったときはSMも戻す
+bool joybus_resync_check_stop_error(JoyBusResync *r);
+
+// SMを止めずに先頭（ビット数待ち）へ戻す
+// RX FIFOとTX FIFO（使われなかったビット数）を読み捨て、ISRのシフトカウンタも空にする
+// 線がアイドルのHighのとき（送信が終わったあと）に呼ぶこと
+void joybus_resync_sm(JoyBusResync *r, JoyBusDesync reason);
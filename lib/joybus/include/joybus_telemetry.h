@@ -0,0 +1,62 @@
+#pragma once
+
+// PIOのFIFOのあふれ・詰まりとDMAの転送数、ストップビットの欠けを数え続けるテレメトリ
+// FIFOを使い切った場合（DMAなしの受信で5バイト目、送信で13バイト目）は実行時には何も起きず、
+// 壊れたバイトとして見えるだけなので、線のノイズと区別するためにここで数える
+//   - FDEBUGのフラグ（RXSTALL, RXUNDER, TXOVER, TXSTALL）はSMごとに立ったままになるので、
+//     joybus_telemetry_pollで読んで数え、数えた分だけ書き戻して下ろす
+//   - フラグもIRQも立ったままになるだけなので、ポーリングの間に何回立っても1回と数える
+//   - TXSTALLはSMが空のTX FIFOからpullしようとしただけでも立つ（送信待ちのpull blockでも立つ）
+//     ので、それ自体は異常ではない。TXOVER（満杯のFIFOへの書き込み）とRXSTALL（autopushで
+//     止まった）が取りこぼしを表す
+// 集計は "#TELEMETRY ..." の1行で出す（UARTのキャプチャからgrepで拾える）
+
+#include "hardware/pio.h"
+
+#include <stdint.h>
+
+// 見張れるPIO側のIRQフラグの数
+constexpr uint32_t JOYBUS_TELEMETRY_MAX_IRQS = 4;
+
+struct JoyBusFifoCounters {
+    uint32_t rx_stall = 0; // RX FIFOが満杯でpushできずSMが止まった
+    uint32_t rx_under = 0; // 空のRX FIFOを読んだ
+    uint32_t tx_over = 0;  // 満杯のTX FIFOに書いた（書いたワードは捨てられる）
+    uint32_t tx_stall = 0; // 空のTX FIFOからpullしようとしてSMが待った
+};
+
+struct JoyBusIrqCounter {
+    PIO pio = nullptr;
+    uint irq = 0;
+    const char *name = nullptr;
+    uint32_t count = 0;
+};
+
+struct JoyBusTelemetry {
+    uint32_t polls = 0;
+    JoyBusFifoCounters fifo[NUM_PIOS][NUM_PIO_STATE_MACHINES];
+    JoyBusIrqCounter irqs[JOYBUS_TELEMETRY_MAX_IRQS];
+    uint32_t irq_count = 0;
+    uint32_t dma_frames = 0; // joybus_telemetry_record_dmaで記録したフレーム数
+    uint32_t dma_words = 0;  // 実際に転送したワード（バイト）数の合計
+    uint32_t dma_short = 0;  // 期待した数に足りなかったフレーム数
+};
+
+// 立ったら数えて下ろすIRQフラグを登録する（例えばjoy_rx5のストップビットの欠けのirq 2）
+// 同じフラグを自分で見て下ろしている場合は登録しない（取り合いになる）
+// 登録できる数を超えたらfalse
+bool joybus_telemetry_watch_irq(PIO pio, uint irq, const char *name);
+
+// FDEBUGと登録したIRQフラグを読んで数え、下ろす（メインループなどから定期的に呼ぶ）
+void joybus_telemetry_poll();
+
+// DMAで受け取ったフレームの転送数を記録する（expectedは受け取るはずだった数）
+// 割り込みハンドラから呼んでもよいが、呼ぶのは1か所（1つのコア）だけにすること
+void joybus_telemetry_record_dma(uint32_t expected, uint32_t transferred);
+
+const JoyBusTelemetry &joybus_telemetry_get();
+void joybus_telemetry_reset();
+
+// "#TELEMETRY polls=... dma=... <irqの名前>=... pio1.sm0=rs/ru/to/ts"の1行を出す
+// FIFOのカウンタはどれかが0でないSMだけを出す
+void joybus_telemetry_print();
@@ -0,0 +1,89 @@
+#pragma once
+
+// 送受信の経路に置くトレース（イベントと時刻）の記録形式
+// 実機ではjoybus_trace_ring.hのリングに記録し、あとからまとめてstdioへ1行ずつ書き出す
+// ホストではhost/trace_decodeがその行を読んで区間ごとの遅れを集計する
+//   "#C <clk_hz>"                                      : サイクル数の換算用（10進）
+//   "#T <core> <event> <time_us> <cycles> <arg>"       : 1イベント（16進）
+//   "#D <core> <count>"                                : リングがあふれて捨てた数（10進）
+// time_usはタイマ（1us）、cyclesはそのコアのSysTick（clk_sysで減る24ビットのカウンタ）
+// 同じコアの134ms（125MHz時）以内のイベント同士ならcyclesの差でサイクル単位まで求まる
+//
+// pico-sdkに依存しないのでホスト側（host/）のツールからも同じものを使う
+
+#include <stdint.h>
+#include <stdio.h>
+
+enum class JoyBusTraceEvent : uint8_t {
+    TxArmed = 1, // 送信のDMAを起動して開始を指示した
+    FirstEdge,   // 受信側で最初の立ち下がりを見た
+    StopBit,     // ストップビット（フレーム終端）を検出した
+    RxComplete,  // 受信したフレームを取り出した（arg: バイト数）
+    Timeout,     // 応答が来なかった
+    Error,       // 受信したフレームが不正（arg: 理由）
+};
+
+struct JoyBusTraceRecord {
+    uint32_t time_us = 0;
+    uint32_t cycles = 0; // SysTickの値（下位24ビット、減っていく）
+    uint8_t event = 0;
+    uint8_t core = 0;
+    uint16_t arg = 0;
+};
+
+constexpr uint32_t JOYBUS_TRACE_SYSTICK_MASK = 0x00FFFFFFu;
+
+inline const char *joybus_trace_event_name(uint8_t event) {
+    switch ((JoyBusTraceEvent)event) {
+    case JoyBusTraceEvent::TxArmed:
+        return "tx_armed";
+    case JoyBusTraceEvent::FirstEdge:
+        return "first_edge";
+    case JoyBusTraceEvent::StopBit:
+        return "stop_bit";
+    case JoyBusTraceEvent::RxComplete:
+        return "rx_complete";
+    case JoyBusTraceEvent::Timeout:
+        return "timeout";
+    case JoyBusTraceEvent::Error:
+        return "error";
+    }
+    return "unknown";
+}
+
+// 1行分の文字列にする（改行は含まない）
+inline int joybus_trace_format(const JoyBusTraceRecord &r, char *buf, size_t size) {
+    return snprintf(buf, size, "#T %u %u %08lx %06lx %04x", r.core, r.event,
+                    (unsigned long)r.time_us, (unsigned long)(r.cycles & JOYBUS_TRACE_SYSTICK_MASK),
+                    r.arg);
+}
+
+// "#T"の行ならrに読み込んでtrue
+inline bool joybus_trace_parse(const char *line, JoyBusTraceRecord *r) {
+    unsigned core = 0;
+    unsigned event = 0;
+    unsigned long time_us = 0;
+    unsigned long cycles = 0;
+    unsigned arg = 0;
+    if (sscanf(line, "#T %u %u %lx %lx %x", &core, &event, &time_us, &cycles, &arg) != 5) {
+        return false;
+    }
+    r->core = (uint8_t)core;
+    r->event = (uint8_t)event;
+    r->time_us = (uint32_t)time_us;
+    r->cycles = (uint32_t)cycles;
+    r->arg = (uint16_t)arg;
+    return true;
+}
+
+// 同じコアで記録した2つのイベントの間のサイクル数（a→b）
+// SysTickが一周する時間を超えていればタイマの差から求める
+inline uint64_t joybus_trace_cycles_between(const JoyBusTraceRecord &a, const JoyBusTraceRecord &b,
+                                            uint32_t clk_hz) {
+    const uint32_t elapsed_us = b.time_us - a.time_us;
+    const uint64_t wrap_us = (uint64_t)(JOYBUS_TRACE_SYSTICK_MASK + 1) * 1'000'000u / clk_hz;
+    if (a.core != b.core || elapsed_us + 1 >= wrap_us) {
+        return (uint64_t)elapsed_us * clk_hz / 1'000'000u;
+    }
+    return (a.cycles - b.cycles) & JOYBUS_TRACE_SYSTICK_MASK;
+}
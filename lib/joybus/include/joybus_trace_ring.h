@@ -0,0 +1,24 @@
+#pragma once
+
+// 送受信の経路（割り込みハンドラを含む）からイベントを記録するコアごとのリング
+// 記録はレコードを1つ書いてheadを進めるだけで、printfもロックもしない
+// （同じコアの割り込みに割り込まれないように数命令だけ割り込みを止める。コア間では待たない）
+// 書き出しはjoybus_trace_drainでメインループの空き時間にまとめて行う
+// リングがいっぱいのときは新しいイベントを捨てて数だけ数える（記録側は待たない）
+
+#include "joybus_trace.h"
+
+#include <stddef.h>
+
+// コアごとのレコード数（2のべき乗）
+constexpr uint32_t JOYBUS_TRACE_RING_SIZE = 256;
+
+// 呼んだコアのSysTickを割り込みなしのフリーランで起動する（記録するコアごとに1回呼ぶ）
+void joybus_trace_init();
+
+// イベントを1つ記録する（どのコア・割り込みハンドラからでも呼べる。RAMに置いてある）
+void joybus_trace(JoyBusTraceEvent event, uint16_t arg = 0);
+
+// 両コアのリングからmax_records個までを"#T"の行としてstdioへ書き出す
+// 書き出した数を返す（drainは1つのコアからだけ呼ぶこと）
+size_t joybus_trace_drain(size_t max_records);
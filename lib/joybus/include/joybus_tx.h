@@ -0,0 +1,44 @@
+#pragma once
+
+// joy_tx5（ビット数指定版）をDMAで駆動する送信側
+// フレームは事前にjoybus_tx_frame_encodeでワード列にしておき、
+// 送信時はDMAの読み込み元を差し替えてirq 0を立てるだけにする
+// （送信のたびのバッファ確保・詰め直し・printfをなくして送信開始までの時間を縮める）
+
+#include "hardware/dma.h"
+#include "hardware/pio.h"
+#include "joybus_frame.h"
+
+// 静的に確保しておく送信フレームの数
+constexpr size_t JOYBUS_TX_POOL_SIZE = 16;
+
+struct JoyBusTx {
+    PIO pio = nullptr;
+    uint sm = 0;
+    int dma_channel = -1;
+    dma_channel_config dma_config{};
+    uint start_irq = 0; // CPU→SMの送信開始指示に使うIRQフラグ
+    uint done_irq = 1;  // SM→CPUの送信完了通知に使うIRQフラグ
+};
+
+// DMAチャンネルを確保して書き込み先をTX FIFOに固定する
+// SMはjoy_tx5を読み込んで起動済みであること（送信開始はirq 0、完了はirq 1）
+void joybus_tx_init(JoyBusTx *tx, PIO pio, uint sm);
+// 1つのPIOで複数のSMが送信する場合用に、使うIRQフラグを指定して初期化する
+// （例えばrel指定のjoy_tx5なら開始がsm、完了が4+sm）
+void joybus_tx_init_with_irqs(JoyBusTx *tx, PIO pio, uint sm, uint start_irq, uint done_irq);
+
+// プールから1つ取り出してdataを詰める（プールが尽きたか長さが不正ならnullptr）
+// 作ったフレームは使い回す前提なので個別には返却しない
+const JoyBusTxFrame *joybus_tx_frame_create(const uint8_t *data, size_t nbytes);
+// プールをすべて空に戻す（送信中のフレームがないときだけ呼ぶこと）
+void joybus_tx_pool_reset();
+
+// 前の送信の完了（done_irq）を待ってからDMAを起動し、start_irqで送信開始を指示する
+// DMAの完了は待たずに戻る
+void joybus_tx_send(JoyBusTx *tx, const JoyBusTxFrame *frame);
+
+// 前の送信が終わっていて、すぐに送信を始められるか
+inline bool joybus_tx_ready(const JoyBusTx *tx) {
+    return pio_interrupt_get(tx->pio, tx->done_irq);
+}
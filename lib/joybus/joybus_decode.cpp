@@ -0,0 +1,46 @@
+#include "joybus_decode.h"
+
+// 実機ではpico-sdkの__not_in_flashでRAMに配置する（ホストでは何もしない）
+#if __has_include("pico.h")
+#include "pico.h"
+#endif
+#ifndef __not_in_flash
+#define __not_in_flash(group)
+#endif
+#ifndef __not_in_flash_func
+#define __not_in_flash_func(func_name) func_name
+#endif
+
+namespace {
+// コンパイル時に表を作る（各エントリはSWAR版で4ビット分をデコードした値）
+constexpr JoyBusNibbleTable make_nibble_table() {
+    JoyBusNibbleTable t{};
+    for (uint32_t i = 0; i < 4096; ++i) {
+        t.v[i] = joybus_decode_3sample_swar(i);
+    }
+    return t;
+}
+} // namespace
+
+// 返信を組み立てる最中にフラッシュから読むとキャッシュミスで待たされるのでRAMに置く
+__not_in_flash("joybus") const JoyBusNibbleTable joybus_3sample_nibble_table = make_nibble_table();
+
+void __not_in_flash_func(joybus_decode_3sample_words)(const uint32_t *words, uint8_t *out,
+                                                      size_t nbytes) {
+    // 2バイトずつ展開してループのオーバーヘッドを減らす
+    size_t i = 0;
+    for (; i + 2 <= nbytes; i += 2) {
+        out[i] = joybus_decode_3sample_swar(words[i]);
+        out[i + 1] = joybus_decode_3sample_swar(words[i + 1]);
+    }
+    if (i < nbytes) {
+        out[i] = joybus_decode_3sample_swar(words[i]);
+    }
+}
+
+void __not_in_flash_func(joybus_decode_3sample_words_lut)(const uint32_t *words, uint8_t *out,
+                                                          size_t nbytes) {
+    for (size_t i = 0; i < nbytes; ++i) {
+        out[i] = joybus_decode_3sample_lut(words[i]);
+    }
+}
@@ -0,0 +1,59 @@
+#include "joybus_dma_chain.h"
+
+void joybus_dma_chain_init(JoyBusDmaChain *c, PIO pio_tx, uint sm_tx, PIO pio_rx, uint sm_rx) {
+    const int ctrl_chan = dma_claim_unused_channel(true);
+    const int worker_chan = dma_claim_unused_channel(true);
+    const int rx_chan = dma_claim_unused_channel(true);
+    joybus_dma_chain_init_with_channels(c, pio_tx, sm_tx, pio_rx, sm_rx, ctrl_chan, worker_chan,
+                                        rx_chan);
+}
+
+void joybus_dma_chain_init_with_channels(JoyBusDmaChain *c, PIO pio_tx, uint sm_tx, PIO pio_rx,
+                                         uint sm_rx, int ctrl_chan, int worker_chan, int rx_chan) {
+    c->pio_tx = pio_tx;
+    c->sm_tx = sm_tx;
+    c->pio_rx = pio_rx;
+    c->sm_rx = sm_rx;
+    c->ctrl_chan = ctrl_chan;
+    c->worker_chan = worker_chan;
+    c->rx_chan = rx_chan;
+
+    // worker: 転送が終わるたびにctrlへチェインする
+    dma_channel_config dc = dma_channel_get_default_config(worker_chan);
+    channel_config_set_transfer_data_size(&dc, DMA_SIZE_32);
+    channel_config_set_read_increment(&dc, false);
+    channel_config_set_write_increment(&dc, false);
+    channel_config_set_chain_to(&dc, ctrl_chan);
+    c->ctrl_single = channel_config_get_ctrl_value(&dc);
+    channel_config_set_transfer_data_size(&dc, DMA_SIZE_8);
+    c->ctrl_byte = channel_config_get_ctrl_value(&dc);
+    channel_config_set_transfer_data_size(&dc, DMA_SIZE_32);
+    channel_config_set_read_increment(&dc, true);
+    channel_config_set_dreq(&dc, pio_get_dreq(pio_tx, sm_tx, true));
+    c->ctrl_tx = channel_config_get_ctrl_value(&dc);
+
+    // ctrl: ブロック1つ分（4ワード）をworkerのレジスタへ書く（書き込み側を16バイトで折り返す）
+    dc = dma_channel_get_default_config(ctrl_chan);
+    channel_config_set_transfer_data_size(&dc, DMA_SIZE_32);
+    channel_config_set_read_increment(&dc, true);
+    channel_config_set_write_increment(&dc, true);
+    channel_config_set_ring(&dc, /*write=*/true, 4);
+    dma_channel_configure(ctrl_chan, &dc, &dma_hw->ch[worker_chan].read_addr, nullptr, 4, false);
+
+    // rx: RX FIFO → 受信バッファ（書き込み先のトリガ付きレジスタへの書き込みで起動）
+    dc = dma_channel_get_default_config(rx_chan);
+    channel_config_set_transfer_data_size(&dc, DMA_SIZE_8);
+    channel_config_set_read_increment(&dc, false);
+    channel_config_set_write_increment(&dc, true);
+    channel_config_set_dreq(&dc, pio_get_dreq(pio_rx, sm_rx, false));
+    dma_channel_configure(rx_chan, &dc, nullptr, &pio_rx->rxf[sm_rx], 0, false);
+
+    // 完了割り込みはrxだけ
+    dma_channel_set_irq0_enabled(rx_chan, true);
+}
+
+void joybus_dma_chain_abort(const JoyBusDmaChain *c) {
+    dma_channel_abort(c->ctrl_chan);
+    dma_channel_abort(c->worker_chan);
+    dma_channel_abort(c->rx_chan);
+}
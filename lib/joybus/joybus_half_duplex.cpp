@@ -0,0 +1,95 @@
+#include "joybus_half_duplex.h"
+
+#include "hardware/clocks.h"
+#include "hardware/gpio.h"
+
+void joybus_half_duplex_sm_init(PIO pio, uint sm, uint offset, pio_sm_config c, uint pin) {
+    // 送信はSETでpindirsを切り替え、受信は同じピンをIN/JMPで読む
+    sm_config_set_set_pins(&c, pin, 1);
+    sm_config_set_in_pins(&c, pin);
+    sm_config_set_jmp_pin(&c, pin);
+    sm_config_set_out_shift(&c,
+                            /*shift_right=*/false,
+                            /*autopull=*/true,
+                            /*pull_thresh=*/32);
+    sm_config_set_in_shift(&c,
+                           /*shift_right=*/false,
+                           /*autopush=*/true,
+                           /*push_thresh=*/8);
+    const float pio_hz = 4'000'000; // 4MHz
+    sm_config_set_clkdiv(&c, (float)clock_get_hz(clk_sys) / pio_hz);
+
+    pio_gpio_init(pio, pin);
+    gpio_pull_up(pin); // open-drainのHigh維持の補助（外付けがあるなら無くてもOK）
+    // 出力ラッチを0、ピンは開放（プログラムはpindirsだけを切り替える）
+    pio_sm_set_pins_with_mask(pio, sm, 0u, 1u << pin);
+    pio_sm_set_consecutive_pindirs(pio, sm, pin, 1, false);
+    pio_sm_init(pio, sm, offset, &c);
+}
+
+void joybus_half_duplex_sm_reset(PIO pio, uint sm, uint offset, uint pin) {
+    pio_sm_set_enabled(pio, sm, false);
+    pio_sm_clear_fifos(pio, sm);
+    pio_sm_restart(pio, sm);
+    pio_sm_exec(pio, sm, pio_encode_jmp(offset));
+    // 送信の途中で止めた場合に備えて線を開放する
+    pio_sm_set_consecutive_pindirs(pio, sm, pin, 1, false);
+    pio_interrupt_clear(pio, sm);
+    pio_sm_set_enabled(pio, sm, true);
+}
+
+void joybus_half_duplex_init(JoyBusHalfDuplex *hd, PIO pio, uint sm, uint offset, pio_sm_config c,
+                             uint pin, irq_handler_t handler) {
+    hd->pio = pio;
+    hd->sm = sm;
+    hd->offset = offset;
+    hd->pin = pin;
+    joybus_half_duplex_sm_init(pio, sm, offset, c, pin);
+
+    // RX用DMA
+    hd->dma_channel = dma_claim_unused_channel(true);
+    hd->dma_config = dma_channel_get_default_config(hd->dma_channel);
+    channel_config_set_transfer_data_size(&hd->dma_config, DMA_SIZE_8);
+    channel_config_set_dreq(&hd->dma_config, pio_get_dreq(pio, sm, false));
+    channel_config_set_read_increment(&hd->dma_config, false);
+    channel_config_set_write_increment(&hd->dma_config, true);
+
+    // PIO IRQへ割り込みを接続
+    pio_interrupt_clear(pio, sm);
+    pio_set_irq0_source_enabled(pio, (pio_interrupt_source_t)(pis_interrupt0 + sm), true);
+    const int irq = (pio_get_index(pio) == 0) ? PIO0_IRQ_0 : PIO1_IRQ_0;
+    irq_set_exclusive_handler(irq, handler);
+    irq_set_priority(irq, PICO_HIGHEST_IRQ_PRIORITY);
+    irq_set_enabled(irq, true);
+
+    pio_sm_set_enabled(pio, sm, true);
+}
+
+void __not_in_flash_func(joybus_half_duplex_arm_rx)(JoyBusHalfDuplex *hd) {
+    hd->ready = false;
+    hd->bad = false;
+    dma_channel_abort(hd->dma_channel);
+    dma_channel_set_config(hd->dma_channel, &hd->dma_config, false);
+    dma_channel_set_read_addr(hd->dma_channel, &hd->pio->rxf[hd->sm], false);
+    dma_channel_transfer_to_buffer_now(hd->dma_channel, hd->work, JOYBUS_HALF_DUPLEX_BUFFER_SIZE);
+}
+
+void __not_in_flash_func(joybus_half_duplex_finish_rx)(JoyBusHalfDuplex *hd) {
+    pio_interrupt_clear(hd->pio, hd->sm);
+
+    dma_channel_hw_t *dma = dma_channel_hw_addr(hd->dma_channel);
+    const uint32_t count = JOYBUS_HALF_DUPLEX_BUFFER_SIZE - dma->transfer_count;
+    dma_channel_abort(hd->dma_channel);
+    // 2バイト以上受信+最後のバイトがストップビット(0x01)
+    if (count >= 2 && hd->work[count - 1] == 0x01) {
+        hd->length = count - 1;
+        hd->ready = true;
+    } else {
+        hd->bad = true;
+    }
+}
+
+void joybus_half_duplex_reset(JoyBusHalfDuplex *hd) {
+    dma_channel_abort(hd->dma_channel);
+    joybus_half_duplex_sm_reset(hd->pio, hd->sm, hd->offset, hd->pin);
+}
@@ -0,0 +1,147 @@
+#include "joybus_log.h"
+
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "pico/stdio.h"
+#include "pico/stdio/driver.h"
+
+#include <stdio.h>
+
+namespace {
+struct JoyBusLog {
+    uart_inst_t *uart = nullptr;
+    int dma_channel = -1;
+    uint dma_irq_index = 0;
+    spin_lock_t *lock = nullptr; // head/tailとDMAの起動を割り込みハンドラと取り合う
+
+    volatile uint32_t head = 0;      // 書き込み位置（通算バイト数）
+    volatile uint32_t tail = 0;      // DMAが送り終えた位置（通算バイト数）
+    volatile uint32_t in_flight = 0; // DMAが送っている途中のバイト数（0なら止まっている）
+
+    volatile uint32_t dropped = 0; // 捨てた通算バイト数
+    uint32_t reported = 0;         // 差し込んだ行で報告済みの分
+};
+
+// DMAの読み出し側の折り返し指定はバッファがその大きさにそろっている必要がある
+alignas(JOYBUS_LOG_RING_SIZE) uint8_t log_ring[JOYBUS_LOG_RING_SIZE];
+
+JoyBusLog joybus_log;
+stdio_driver_t log_driver;
+
+// 止まっていれば、まだ送っていない分をまとめてDMAで送り始める（ロックを取って呼ぶ）
+void __not_in_flash_func(log_kick_locked)() {
+    if (joybus_log.in_flight != 0) {
+        return;
+    }
+    const uint32_t count = joybus_log.head - joybus_log.tail;
+    if (count == 0) {
+        return;
+    }
+    joybus_log.in_flight = count;
+    dma_channel_transfer_from_buffer_now(
+        joybus_log.dma_channel, &log_ring[joybus_log.tail & (JOYBUS_LOG_RING_SIZE - 1)], count);
+}
+
+void __isr __not_in_flash_func(log_dma_irq_handler)() {
+    if (!dma_irqn_get_channel_status(joybus_log.dma_irq_index, joybus_log.dma_channel)) {
+        return;
+    }
+    dma_irqn_acknowledge_channel(joybus_log.dma_irq_index, joybus_log.dma_channel);
+    const uint32_t save = spin_lock_blocking(joybus_log.lock);
+    joybus_log.tail = joybus_log.tail + joybus_log.in_flight;
+    joybus_log.in_flight = 0;
+    log_kick_locked();
+    spin_unlock(joybus_log.lock, save);
+}
+
+// リングに入るなら詰める（入らなければfalse、部分的には詰めない）
+bool log_put_locked(const char *buf, uint32_t length) {
+    const uint32_t used = joybus_log.head - joybus_log.tail;
+    if (length > JOYBUS_LOG_RING_SIZE - used) {
+        return false;
+    }
+    for (uint32_t i = 0; i < length; ++i) {
+        log_ring[(joybus_log.head + i) & (JOYBUS_LOG_RING_SIZE - 1)] = (uint8_t)buf[i];
+    }
+    joybus_log.head = joybus_log.head + length;
+    return true;
+}
+
+void log_out_chars(const char *buf, int length) {
+    const uint32_t save = spin_lock_blocking(joybus_log.lock);
+    // 前に捨てた分があれば、空きができたところで報告の行を先に差し込む
+    const uint32_t unreported = joybus_log.dropped - joybus_log.reported;
+    if (unreported != 0) {
+        char note[48];
+        const int n = snprintf(note, sizeof(note), "\r\n[log] %lu bytes dropped\r\n",
+                               (unsigned long)unreported);
+        if (log_put_locked(note, (uint32_t)n)) {
+            joybus_log.reported += unreported;
+        }
+    }
+    if (!log_put_locked(buf, (uint32_t)length)) {
+        joybus_log.dropped = joybus_log.dropped + (uint32_t)length;
+    }
+    log_kick_locked();
+    spin_unlock(joybus_log.lock, save);
+}
+
+void log_out_flush() { joybus_log_flush(); }
+
+int log_in_chars(char *buf, int length) {
+    int n = 0;
+    while (n < length && uart_is_readable(joybus_log.uart)) {
+        buf[n++] = (char)uart_getc(joybus_log.uart);
+    }
+    return n > 0 ? n : PICO_ERROR_NO_DATA;
+}
+} // namespace
+
+void joybus_log_init(uart_inst_t *uart, uint baudrate, uint tx_pin, uint rx_pin,
+                     uint dma_irq_index) {
+    joybus_log.uart = uart;
+    joybus_log.dma_irq_index = dma_irq_index;
+    uart_init(uart, baudrate);
+    gpio_set_function(tx_pin, GPIO_FUNC_UART);
+    gpio_set_function(rx_pin, GPIO_FUNC_UART);
+
+    joybus_log.lock = spin_lock_init(spin_lock_claim_unused(true));
+    joybus_log.dma_channel = dma_claim_unused_channel(true);
+
+    // リング → UARTのTX FIFO（読み出し側をリングの大きさで折り返す）
+    dma_channel_config c = dma_channel_get_default_config(joybus_log.dma_channel);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_ring(&c, /*write=*/false, JOYBUS_LOG_RING_BITS);
+    channel_config_set_dreq(&c, uart_get_dreq(uart, /*is_tx=*/true));
+    dma_channel_configure(joybus_log.dma_channel, &c, &uart_get_hw(uart)->dr, log_ring, 0, false);
+
+    // 完了割り込みは呼び出し側が選んだ線を共有する（優先度は呼び出し側が決める）
+    const uint irq = DMA_IRQ_0 + dma_irq_index;
+    dma_irqn_set_channel_enabled(dma_irq_index, joybus_log.dma_channel, true);
+    irq_add_shared_handler(irq, log_dma_irq_handler,
+                           PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(irq, true);
+
+    log_driver = stdio_driver_t{};
+    log_driver.out_chars = log_out_chars;
+    log_driver.out_flush = log_out_flush;
+    log_driver.in_chars = log_in_chars;
+#if PICO_STDIO_ENABLE_CRLF_SUPPORT
+    log_driver.crlf_enabled = PICO_STDIO_DEFAULT_CRLF;
+#endif
+    stdio_set_driver_enabled(&log_driver, true);
+}
+
+uint32_t joybus_log_dropped() { return joybus_log.dropped; }
+
+void joybus_log_flush() {
+    while (joybus_log.tail != joybus_log.head) {
+        tight_loop_contents();
+    }
+    // DMAが最後のバイトをFIFOに入れたあと、UARTが送り終わるまで待つ
+    uart_tx_wait_blocking(joybus_log.uart);
+}
@@ -0,0 +1,51 @@
+#include "joybus_resync.h"
+
+void joybus_resync_init(JoyBusResync *r, PIO pio, uint sm, uint offset, uint stop_error_irq) {
+    *r = JoyBusResync{};
+    r->pio = pio;
+    r->sm = sm;
+    r->offset = offset;
+    r->stop_error_irq = stop_error_irq;
+    pio_interrupt_clear(pio, stop_error_irq);
+}
+
+bool __not_in_flash_func(joybus_resync_check_stop_error)(JoyBusResync *r) {
+    if (!pio_interrupt_get(r->pio, r->stop_error_irq)) {
+        r->consecutive_stop_errors = 0;
+        return false;
+    }
+    // SMはirq 2を立てたあと自分で先頭に戻っているので、1回だけならフラグを下ろすだけでよい
+    pio_interrupt_clear(r->pio, r->stop_error_irq);
+    ++r->stats.stop_errors;
+    if (++r->consecutive_stop_errors >= r->storm_threshold) {
+        joybus_resync_sm(r, JoyBusDesync::StopStorm);
+    }
+    return true;
+}
+
+void __not_in_flash_func(joybus_resync_sm)(JoyBusResync *r, JoyBusDesync reason) {
+    PIO pio = r->pio;
+    const uint sm = r->sm;
+    // 先にFIFOを空にする（先頭に戻したSMが古いビット数をpullしないように）
+    // SMはピンかpullで止まっているので、この間に進むことはない
+    pio_sm_clear_fifos(pio, sm);
+    // 止まっている命令はexecした命令で置き換わる
+    // ISRを空にしてシフトカウンタを0に戻し、先頭（pull block）へ飛ぶ
+    pio_sm_exec(pio, sm, pio_encode_mov(pio_isr, pio_null));
+    pio_sm_exec(pio, sm, pio_encode_jmp(r->offset));
+    pio_interrupt_clear(pio, r->stop_error_irq);
+
+    r->consecutive_stop_errors = 0;
+    ++r->stats.resyncs;
+    switch (reason) {
+    case JoyBusDesync::Short:
+        ++r->stats.short_frames;
+        break;
+    case JoyBusDesync::Timeout:
+        ++r->stats.timeouts;
+        break;
+    case JoyBusDesync::StopStorm:
+        ++r->stats.stop_storms;
+        break;
+    }
+}
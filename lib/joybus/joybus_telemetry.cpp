@@ -0,0 +1,96 @@
+#include "joybus_telemetry.h"
+
+#include <stdio.h>
+
+namespace {
+JoyBusTelemetry telemetry;
+} // namespace
+
+bool joybus_telemetry_watch_irq(PIO pio, uint irq, const char *name) {
+    if (telemetry.irq_count >= JOYBUS_TELEMETRY_MAX_IRQS) {
+        return false;
+    }
+    JoyBusIrqCounter &c = telemetry.irqs[telemetry.irq_count++];
+    c.pio = pio;
+    c.irq = irq;
+    c.name = name;
+    c.count = 0;
+    // 登録前から立っていた分は数えない
+    pio_interrupt_clear(pio, irq);
+    return true;
+}
+
+void joybus_telemetry_poll() {
+    ++telemetry.polls;
+    for (uint p = 0; p < NUM_PIOS; ++p) {
+        PIO pio = pio_get_instance(p);
+        const uint32_t flags = pio->fdebug;
+        if (flags == 0) {
+            continue;
+        }
+        // 書き込んだビットだけが下りるので、読んでから立った分は次のポーリングで数える
+        pio->fdebug = flags;
+        for (uint sm = 0; sm < NUM_PIO_STATE_MACHINES; ++sm) {
+            JoyBusFifoCounters &c = telemetry.fifo[p][sm];
+            c.rx_stall += (flags >> (PIO_FDEBUG_RXSTALL_LSB + sm)) & 1u;
+            c.rx_under += (flags >> (PIO_FDEBUG_RXUNDER_LSB + sm)) & 1u;
+            c.tx_over += (flags >> (PIO_FDEBUG_TXOVER_LSB + sm)) & 1u;
+            c.tx_stall += (flags >> (PIO_FDEBUG_TXSTALL_LSB + sm)) & 1u;
+        }
+    }
+    for (uint32_t i = 0; i < telemetry.irq_count; ++i) {
+        JoyBusIrqCounter &c = telemetry.irqs[i];
+        if (pio_interrupt_get(c.pio, c.irq)) {
+            pio_interrupt_clear(c.pio, c.irq);
+            ++c.count;
+        }
+    }
+}
+
+void joybus_telemetry_record_dma(uint32_t expected, uint32_t transferred) {
+    ++telemetry.dma_frames;
+    telemetry.dma_words += transferred;
+    if (transferred < expected) {
+        ++telemetry.dma_short;
+    }
+}
+
+const JoyBusTelemetry &joybus_telemetry_get() { return telemetry; }
+
+void joybus_telemetry_reset() {
+    // 見張るIRQフラグの登録は残す
+    telemetry.polls = 0;
+    for (auto &pio_counters : telemetry.fifo) {
+        for (JoyBusFifoCounters &c : pio_counters) {
+            c = JoyBusFifoCounters{};
+        }
+    }
+    for (JoyBusIrqCounter &c : telemetry.irqs) {
+        c.count = 0;
+    }
+    telemetry.dma_frames = 0;
+    telemetry.dma_words = 0;
+    telemetry.dma_short = 0;
+}
+
+void joybus_telemetry_print() {
+    printf("#TELEMETRY polls=%lu dma=%lu/%lu/%lu", (unsigned long)telemetry.polls,
+           (unsigned long)telemetry.dma_frames, (unsigned long)telemetry.dma_words,
+           (unsigned long)telemetry.dma_short);
+    for (uint32_t i = 0; i < telemetry.irq_count; ++i) {
+        const JoyBusIrqCounter &c = telemetry.irqs[i];
+        printf(" %s=%lu", c.name, (unsigned long)c.count);
+    }
+    for (uint p = 0; p < NUM_PIOS; ++p) {
+        for (uint sm = 0; sm < NUM_PIO_STATE_MACHINES; ++sm) {
+            const JoyBusFifoCounters &c = telemetry.fifo[p][sm];
+            if (c.rx_stall == 0 && c.rx_under == 0 && c.tx_over == 0 && c.tx_stall == 0) {
+                continue;
+            }
+            // rs=RXSTALL, ru=RXUNDER, to=TXOVER, ts=TXSTALL
+            printf(" pio%u.sm%u=%lu/%lu/%lu/%lu", p, sm, (unsigned long)c.rx_stall,
+                   (unsigned long)c.rx_under, (unsigned long)c.tx_over, (unsigned long)c.tx_stall);
+        }
+    }
+    printf("\n");
+}
@@ -0,0 +1,87 @@
+#include "joybus_trace_ring.h"
+
+#include "hardware/clocks.h"
+#include "hardware/structs/systick.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+#include "pico/platform.h"
+
+namespace {
+constexpr uint NUM_CORES = 2;
+
+struct TraceRing {
+    JoyBusTraceRecord records[JOYBUS_TRACE_RING_SIZE];
+    volatile uint32_t head = 0;    // 記録するコアだけが進める
+    volatile uint32_t tail = 0;    // drainだけが進める
+    volatile uint32_t dropped = 0; // 記録するコアだけが増やす
+    uint32_t reported_dropped = 0; // drainだけが使う
+};
+
+TraceRing trace_rings[NUM_CORES];
+} // namespace
+
+void joybus_trace_init() {
+    // 割り込みなし・clk_sysをそのまま数える24ビットのダウンカウンタ
+    systick_hw->csr = 0;
+    systick_hw->rvr = JOYBUS_TRACE_SYSTICK_MASK;
+    systick_hw->cvr = 0;
+    systick_hw->csr = M0PLUS_SYST_CSR_CLKSOURCE_BITS | M0PLUS_SYST_CSR_ENABLE_BITS;
+}
+
+void __not_in_flash_func(joybus_trace)(JoyBusTraceEvent event, uint16_t arg) {
+    const uint core = get_core_num();
+    TraceRing &ring = trace_rings[core];
+    // 時刻の読み取りからheadの更新までを同じコアの割り込みに割り込まれないようにする
+    const uint32_t save = save_and_disable_interrupts();
+    const uint32_t cycles = systick_hw->cvr;
+    const uint32_t time_us = timer_hw->timerawl;
+    const uint32_t head = ring.head;
+    if (head - ring.tail >= JOYBUS_TRACE_RING_SIZE) {
+        ring.dropped = ring.dropped + 1;
+    } else {
+        JoyBusTraceRecord &r = ring.records[head & (JOYBUS_TRACE_RING_SIZE - 1)];
+        r.time_us = time_us;
+        r.cycles = cycles;
+        r.event = (uint8_t)event;
+        r.core = (uint8_t)core;
+        r.arg = arg;
+        // レコードを書き終えてからheadを進める（drainは別のコアから読むことがある）
+        __dmb();
+        ring.head = head + 1;
+    }
+    restore_interrupts(save);
+}
+
+size_t joybus_trace_drain(size_t max_records) {
+    size_t drained = 0;
+    bool clock_printed = false;
+    for (uint core = 0; core < NUM_CORES; ++core) {
+        TraceRing &ring = trace_rings[core];
+        const uint32_t dropped = ring.dropped;
+        if (dropped != ring.reported_dropped) {
+            printf("#D %u %lu\n", core, (unsigned long)(dropped - ring.reported_dropped));
+            ring.reported_dropped = dropped;
+        }
+
+        const uint32_t head = ring.head;
+        // headを読んでからレコードを読む
+        __dmb();
+        uint32_t tail = ring.tail;
+        while (tail != head && drained < max_records) {
+            if (!clock_printed) {
+                printf("#C %lu\n", (unsigned long)clock_get_hz(clk_sys));
+                clock_printed = true;
+            }
+            const JoyBusTraceRecord r = ring.records[tail & (JOYBUS_TRACE_RING_SIZE - 1)];
+            // 読み終えてから枠を返す
+            __dmb();
+            ring.tail = ++tail;
+
+            char line[48];
+            joybus_trace_format(r, line, sizeof(line));
+            puts(line);
+            ++drained;
+        }
+    }
+    return drained;
+}
@@ -0,0 +1,50 @@
+#include "joybus_tx.h"
+
+namespace {
+JoyBusTxFrame tx_pool[JOYBUS_TX_POOL_SIZE];
+size_t tx_pool_used = 0;
+} // namespace
+
+void joybus_tx_init(JoyBusTx *tx, PIO pio, uint sm) { joybus_tx_init_with_irqs(tx, pio, sm, 0, 1); }
+
+void joybus_tx_init_with_irqs(JoyBusTx *tx, PIO pio, uint sm, uint start_irq, uint done_irq) {
+    tx->pio = pio;
+    tx->sm = sm;
+    tx->start_irq = start_irq;
+    tx->done_irq = done_irq;
+    tx->dma_channel = dma_claim_unused_channel(true);
+    tx->dma_config = dma_channel_get_default_config(tx->dma_channel);
+    channel_config_set_transfer_data_size(&tx->dma_config, DMA_SIZE_32);
+    // バッファから順次読み込むのでインクリメント
+    channel_config_set_read_increment(&tx->dma_config, true);
+    // TX FIFOへ書き続けるので固定
+    channel_config_set_write_increment(&tx->dma_config, false);
+    channel_config_set_dreq(&tx->dma_config, pio_get_dreq(pio, sm, true));
+    // 書き込み先と設定はここで済ませておき、送信時は読み込み元と転送数だけ書く
+    dma_channel_configure(tx->dma_channel, &tx->dma_config, &pio->txf[sm], nullptr, 0, false);
+}
+
+const JoyBusTxFrame *joybus_tx_frame_create(const uint8_t *data, size_t nbytes) {
+    if (tx_pool_used >= JOYBUS_TX_POOL_SIZE) {
+        return nullptr;
+    }
+    JoyBusTxFrame *frame = &tx_pool[tx_pool_used];
+    if (!joybus_tx_frame_encode(frame, data, nbytes)) {
+        return nullptr;
+    }
+    ++tx_pool_used;
+    return frame;
+}
+
+void joybus_tx_pool_reset() { tx_pool_used = 0; }
+
+void __not_in_flash_func(joybus_tx_send)(JoyBusTx *tx, const JoyBusTxFrame *frame) {
+    // 万が一同期が崩れてもautopullされないように前の送信が完了しないうちはFIFOに積まない
+    while (!pio_interrupt_get(tx->pio, tx->done_irq)) {
+        tight_loop_contents();
+    }
+    pio_interrupt_clear(tx->pio, tx->done_irq);
+    // 読み込み元と転送数（トリガ付き）を書くだけでDMAが走り出す
+    dma_channel_transfer_from_buffer_now(tx->dma_channel, frame->words, frame->word_count);
+    tx->pio->irq_force = (1u << tx->start_irq);
+}